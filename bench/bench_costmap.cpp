@@ -0,0 +1,51 @@
+// Micro-benchmark of the adaptive-embedding cost map.
+// Build with -DSTEGANO_BUILD_BENCHMARKS=ON and run ./bench_costmap [width height channels]
+
+#include "cost_map.h"
+#include "parallel.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+namespace {
+
+template <typename Fn>
+double measureMs(Fn&& fn, int repeats) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeats; i++) fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / repeats;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int width = argc > 3 ? std::atoi(argv[1]) : 4000;
+    int height = argc > 3 ? std::atoi(argv[2]) : 3000;
+    int channels = argc > 3 ? std::atoi(argv[3]) : 3;
+
+    // Синтетическое изображение: плавный градиент с шумными участками
+    ImageHandler::Image image{ width, height, channels, std::vector<uint8_t>(static_cast<size_t>(width) * height * channels) };
+    std::mt19937 rng(7);
+    for (size_t i = 0; i < image.data.size(); i++) {
+        size_t x = (i / channels) % width;
+        image.data[i] = static_cast<uint8_t>(x * 255 / width + ((x / 64) % 2 ? rng() % 32 : 0));
+    }
+    const double megapixels = static_cast<double>(width) * height / 1e6;
+    std::printf("image: %dx%dx%d (%.1f MP)\n", width, height, channels, megapixels);
+
+    for (unsigned int threads = 1; threads <= Parallel::defaultThreadCount(); threads *= 2) {
+        double ms = measureMs([&]() { volatile uint8_t sink = Stegano::computeCostMap(image, threads)[0]; (void)sink; }, 5);
+        std::printf("cost map, %2u threads: %8.2f ms (%.2f ms/MP)\n", threads, ms, ms / megapixels);
+    }
+
+    std::vector<uint8_t> costMap = Stegano::computeCostMap(image, Parallel::defaultThreadCount());
+    for (uint8_t level = 1; level <= Stegano::MAX_ADAPTIVE_LEVEL; level++) {
+        size_t selected = 0;
+        double ms = measureMs([&]() { selected = Stegano::selectTexturedPositions(costMap, level).size(); }, 3);
+        std::printf("select level %u: %8.2f ms (%zu candidates)\n", level, ms, selected);
+    }
+    return 0;
+}
@@ -0,0 +1,54 @@
+// Micro-benchmark of batch PBKDF2-HMAC-SHA256 (KeyDerivation::deriveKeys) against one OpenSSL call per key.
+// Build with -DSTEGANO_BUILD_BENCHMARKS=ON and run ./bench_kdf [keys]
+// Exits with status 1 if any kernel's output differs from PKCS5_PBKDF2_HMAC.
+
+#include "encryption/key_derivation.h"
+#include "encryption/data_conversion.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+namespace {
+
+template <typename Fn>
+double measureMs(Fn&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 64;
+    const int iterations = DataConversion::KDF_ITERATIONS;
+
+    // Разные пароли и соли, как у ключей из --keys-file или у контейнеров пакетного встраивания
+    std::mt19937 rng(5);
+    std::vector<std::string> passphrases(count);
+    std::vector<std::vector<uint8_t>> salts(count, std::vector<uint8_t>(DataConversion::SALT_SIZE));
+    for (size_t i = 0; i < count; i++) {
+        passphrases[i] = "candidate-" + std::to_string(rng());
+        for (uint8_t& byte : salts[i]) byte = static_cast<uint8_t>(rng());
+    }
+    std::printf("%zu keys, %d iterations, widest kernel: %u lanes\n", count, iterations, KeyDerivation::batchLanes());
+
+    std::vector<std::vector<uint8_t>> expected;
+    double baseMs = measureMs([&]() { expected = KeyDerivation::deriveKeys(passphrases, salts, iterations, 32, 1); });
+    std::printf("OpenSSL, one by one: %9.1f ms (%.3f ms/key)\n", baseMs, baseMs / count);
+
+    int status = 0;
+    for (unsigned int lanes = 4; lanes <= KeyDerivation::batchLanes(); lanes *= 2) {
+        std::vector<std::vector<uint8_t>> keys;
+        double ms = measureMs([&]() { keys = KeyDerivation::deriveKeys(passphrases, salts, iterations, 32, lanes); });
+        bool same = keys == expected;
+        std::printf("%2u lanes:            %9.1f ms (%.3f ms/key, x%.2f) %s\n", lanes, ms, ms / count, baseMs / ms,
+                    same ? "identical" : "MISMATCH");
+        if (!same) status = 1;
+    }
+    return status;
+}
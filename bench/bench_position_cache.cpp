@@ -0,0 +1,64 @@
+// Micro-benchmark of the position cache: generating a payload prefix with the lazy stream against
+// answering it from memory and from a mapped entry of the cache directory.
+// Build with -DSTEGANO_BUILD_BENCHMARKS=ON and run ./bench_position_cache [carrier MiB] [cache dir]
+// Exits with status 1 if cached positions differ from the generated ones.
+
+#include "position_cache.h"
+#include "position_stream.h"
+
+#include <spdlog/spdlog.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+
+namespace {
+
+template <typename Fn>
+double measureMs(Fn&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t carrierMiB = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 64;
+    std::string directory = argc > 2 ? argv[2] : (std::filesystem::temp_directory_path() / "bench_position_cache").string();
+    spdlog::set_level(spdlog::level::warn);
+
+    const size_t n = carrierMiB << 20;
+    const std::vector<uint8_t> key = { 's', 'h', 'o', 'p' };
+    const Stegano::EngineId engine = Stegano::DEFAULT_ENGINE;
+    Stegano::PositionCache& cache = Stegano::PositionCache::instance();
+    std::printf("carrier: %zu bytes, cache directory: %s\n", n, directory.c_str());
+
+    int status = 0;
+    // Доля носителя под сообщение: короткий текст, заметная нагрузка и плотный поток
+    for (size_t divisor : { 1000, 50, 4 }) {
+        const size_t count = n / divisor;
+        std::error_code ec;
+        std::filesystem::remove_all(directory, ec);
+
+        std::vector<size_t> expected, generated, fromFile, fromMemory;
+        double streamMs = measureMs([&]() {
+            Stegano::PositionStream stream(n, key, engine);
+            expected = stream.take(count);
+        });
+        cache.configure(uint64_t{1} << 32, directory);
+        double missMs = measureMs([&]() { generated = cache.take(n, key, engine, Stegano::POSITION_STREAM, count); });
+        cache.configure(uint64_t{1} << 32, directory); // память очищается, запись остаётся в каталоге
+        double fileMs = measureMs([&]() { fromFile = cache.take(n, key, engine, Stegano::POSITION_STREAM, count); });
+        double memoryMs = measureMs([&]() { fromMemory = cache.take(n, key, engine, Stegano::POSITION_STREAM, count); });
+
+        bool same = generated == expected && fromFile == expected && fromMemory == expected;
+        if (!same) status = 1;
+        std::printf("%10zu positions: stream %8.2f ms  miss %8.2f ms  directory hit %7.2f ms  memory hit %7.2f ms  %s\n",
+                    count, streamMs, missMs, fileMs, memoryMs, same ? "identical" : "MISMATCH");
+    }
+    cache.logStats();
+    return status;
+}
@@ -0,0 +1,76 @@
+// Micro-benchmark of the position-generator engines.
+// Build with -DSTEGANO_BUILD_BENCHMARKS=ON and run ./bench_positions [carrier_bytes]
+
+#include "position_stream.h"
+#include "rng_engines.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <algorithm>
+#include <numeric>
+#include <type_traits>
+
+namespace {
+
+volatile uint64_t sink; // не даём компилятору выбросить результат
+
+template <typename Fn>
+double measureMs(Fn&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+template <typename Engine>
+void benchEngine(const char* name, size_t carrierBytes, const std::vector<uint8_t>& key) {
+    constexpr size_t draws = 50'000'000;
+    Engine engine(key, Stegano::POSITION_STREAM);
+
+    double rawMs = measureMs([&]() {
+        uint64_t acc = 0;
+        for (size_t i = 0; i < draws; i++) acc ^= engine.next();
+        sink = acc;
+    });
+    double rangeMs = measureMs([&]() {
+        uint64_t acc = 0;
+        for (size_t i = 0; i < draws; i++) acc += Stegano::uniformBelow(engine, carrierBytes - (i % carrierBytes));
+        sink = acc;
+    });
+    double prefixMs = measureMs([&]() {
+        Stegano::BasicPositionStream<Engine> stream(carrierBytes, key);
+        sink = stream.take(8 * 1024)[0]; // 1 KiB полезной нагрузки
+    });
+    double fullMs = measureMs([&]() {
+        Stegano::BasicPositionStream<Engine> stream(carrierBytes, key);
+        sink = stream.takeRest().back();
+    });
+
+    std::printf("%-10s next: %7.2f ns  uniformBelow: %7.2f ns  1KiB prefix: %8.3f ms  full permutation: %9.1f ms\n",
+                name, rawMs * 1e6 / draws, rangeMs * 1e6 / draws, prefixMs, fullMs);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t carrierBytes = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 3000ull * 2000 * 3;
+    std::vector<uint8_t> key = { 'b', 'e', 'n', 'c', 'h' };
+    std::printf("carrier: %zu bytes\n", carrierBytes);
+
+    benchEngine<Stegano::Xoshiro256StarStar>("xoshiro", carrierBytes, key);
+    benchEngine<Stegano::ChaCha20Engine>("chacha", carrierBytes, key);
+
+    // Прежняя схема для сравнения: mt19937 + std::shuffle по всему носителю
+    double legacyMs = measureMs([&]() {
+        std::vector<size_t> indices(carrierBytes);
+        std::iota(indices.begin(), indices.end(), size_t{0});
+        std::seed_seq seedSeq(key.begin(), key.end());
+        std::mt19937 rng(seedSeq);
+        std::shuffle(indices.begin(), indices.end(), rng);
+        sink = indices.back();
+    });
+    std::printf("%-10s full permutation (mt19937 + std::shuffle): %9.1f ms\n", "legacy", legacyMs);
+    return 0;
+}
@@ -0,0 +1,94 @@
+// Micro-benchmark of range extraction (Decryption::tryDecryptRange) from a chunked container against
+// extracting the whole payload and against a payload as small as the range.
+// Build with -DSTEGANO_BUILD_BENCHMARKS=ON and run ./bench_range [payload MiB] [range bytes]
+// Exits with status 1 if an extracted message or range differs from the embedded one.
+
+#include "encryption/encryption.h"
+#include "encryption/decrytpion.h"
+#include "stegano.h"
+
+#include <spdlog/spdlog.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+namespace {
+
+template <typename Fn>
+double measureMs(Fn&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Случайный носитель, в который сообщение занимает около 80% позиций
+ImageHandler::Image makeCarrier(size_t payloadBytes, std::mt19937& rng) {
+    const int width = 4096;
+    const size_t bytes = (payloadBytes + 1024) * 8 * 5 / 4;
+    ImageHandler::Image image{ width, static_cast<int>(bytes / (width * 3) + 1), 3, {} };
+    image.data.resize(static_cast<size_t>(image.width) * image.height * 3);
+    for (uint8_t& byte : image.data) byte = static_cast<uint8_t>(rng());
+    return image;
+}
+
+// Встраивание так же, как в --crypt: раскладка по длине сообщения, без шума (он не влияет на извлечение)
+void embed(ImageHandler::Image& image, const std::string& message, const std::vector<uint8_t>& steganoKey) {
+    CliConfig& config = CliConfig::getInstance();
+    config.textMessage = message;
+    DataConversion::ContainerLayout layout = DataConversion::layoutForMessage(message.size());
+    std::vector<uint8_t> container = Encryption::getEncryptedContainer(config, layout);
+
+    Stegano::EmbedOptions options;
+    options.headerBytes = DataConversion::HEADER_SIZE + DataConversion::KEY_CHECK_SIZE;
+    options.noiseDensity = 0;
+    options.indexed = layout == DataConversion::ContainerLayout::Chunked;
+    DataConversion::ContainerHeader header;
+    header.engine = static_cast<uint8_t>(options.engine);
+    header.layout = layout;
+    Stegano::embedData(image, Encryption::getReadyToEmbedText(container, header, steganoKey), steganoKey, options);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t payloadMiB = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 16;
+    size_t rangeBytes = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 4096;
+    spdlog::set_level(spdlog::level::warn);
+
+    CliConfig& config = CliConfig::getInstance();
+    config.passphrase = "range-bench";
+    const std::vector<uint8_t> steganoKey = DataConversion::stringToBytes(config.passphrase);
+
+    std::mt19937 rng(11);
+    std::string message(payloadMiB << 20, ' ');
+    for (char& c : message) c = static_cast<char>('a' + rng() % 26);
+    std::string small = message.substr(0, rangeBytes);
+
+    ImageHandler::Image large = makeCarrier(message.size(), rng);
+    ImageHandler::Image little = makeCarrier(small.size(), rng);
+    double embedMs = measureMs([&]() { embed(large, message, steganoKey); });
+    embed(little, small, steganoKey);
+    std::printf("%zu MiB payload in %zu carrier bytes, embedded in %.1f ms\n", payloadMiB, large.data.size(), embedMs);
+
+    int status = 0;
+    auto report = [&](const char* name, double ms, const std::string& got, const std::string& expected) {
+        bool same = got == expected;
+        std::printf("%-32s %9.2f ms %s\n", name, ms, same ? "identical" : "MISMATCH");
+        if (!same) status = 1;
+    };
+
+    Decryption::ExtractResult result;
+    double ms = measureMs([&]() { result = Decryption::tryDecryptMessage(config.passphrase, large, steganoKey); });
+    report("whole payload", ms, result.message, message);
+
+    const uint64_t offset = message.size() / 2 + 123;
+    ms = measureMs([&]() { result = Decryption::tryDecryptRange(config.passphrase, large, steganoKey, offset, rangeBytes); });
+    report("range from the middle", ms, result.message, message.substr(offset, rangeBytes));
+
+    ms = measureMs([&]() { result = Decryption::tryDecryptMessage(config.passphrase, little, steganoKey); });
+    report("payload of the range size", ms, result.message, small);
+    return status;
+}
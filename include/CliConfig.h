@@ -2,6 +2,8 @@
 #define CLI_CONFIG_H
 
 #include <string>
+#include <vector>
+#include <cstdint>
 #include <iostream>
 
 /**
@@ -17,6 +19,27 @@ struct CliConfig {
     std::string inFile;        ///< Input file path.
     std::string outFile;       ///< Output file path.
     std::string passphrase;    ///< Encryption passphrase.
+    std::string outFormat{"png"}; ///< Image format used when the output is the standard output ("-").
+    std::string engineName{"xoshiro"}; ///< Position generator engine used for embedding.
+    bool adaptive = false;     ///< Embed only into textured regions selected by the cost map.
+    bool matrix = false;       ///< Use matrix embedding (Hamming codes) to change fewer carrier bytes.
+    bool analyze = false;      ///< Run the steganalysis self-check on the embedded image.
+    bool update = false;       ///< Replace the message of an existing stego image instead of embedding anew.
+    unsigned int noiseDensity = 100; ///< Share of unused carrier bytes (in percent) that receive cover noise.
+    unsigned int threadCount = 0;    ///< Worker threads for embedding, extraction and analysis (0 - one per hardware thread).
+    size_t maxMemory = 0;            ///< Memory budget in bytes (0 - no limit).
+    std::string cacheDir;            ///< Directory of the decoded-carrier cache (extract mode; empty - no cache).
+    uint64_t cacheSize = uint64_t{1} << 30; ///< Size limit of the decoded-carrier cache in bytes.
+    uint64_t positionCacheSize = 0;  ///< Byte limit of the position cache (0 - no cache; 64 MiB by default with --watch or --position-cache-dir).
+    std::string positionCacheDir;    ///< Directory of the mapped position cache entries shared between processes (empty - memory only).
+    std::string watchDir;            ///< Spool directory watched for carriers to embed into (empty - no watch).
+    std::string outDir;              ///< Directory that receives the stego images of the watch mode.
+    std::string tracePath;           ///< Chrome trace-event file written at exit (empty - no tracing).
+    uint64_t rangeOffset = 0;        ///< First message byte to extract (--range).
+    uint64_t rangeLength = UINT64_MAX; ///< Number of message bytes to extract (--range; the rest of the message by default).
+    std::string keysFile;      ///< File with candidate passphrases, one per line (extract mode).
+    std::vector<std::string> candidateKeys; ///< Passphrases read from keysFile.
+    std::vector<size_t> candidateKeyLines;  ///< 1-based line of each candidate key in keysFile.
 
     /**
      * @brief Returns a singleton instance of the CliConfig.
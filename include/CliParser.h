@@ -83,11 +83,26 @@
       * @brief Validates the specified output file path.
       * 
       * Ensures that the output directory exists and that the filename is correctly formatted.
-      * If necessary, prompts the user to modify the output path.
+      * If necessary, prompts the user to modify the output path. When the image is read
+      * from stdin no prompt is shown: a bare filename is placed in the current directory
+      * and a missing directory is an error.
       * 
       * @param outputPath Reference to the output file path string.
       */
      static void validateOutputPath(std::string& outputPath);
+
+     /**
+      * @brief Reads candidate passphrases from a file, one per line.
+      * 
+      * Empty lines are skipped and a trailing carriage return is removed.
+      * 
+      * @param path Path to the keys file.
+      * @param keys Reference to the vector that receives the passphrases.
+      * @param lines Reference to the vector that receives the 1-based line number of each passphrase.
+      * @return true If at least one passphrase was read.
+      * @return false If the file cannot be read or contains no passphrases.
+      */
+     static bool readKeysFile(const std::string& path, std::vector<std::string>& keys, std::vector<size_t>& lines);
  };
  
  #endif // CLI_PARSER_H
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef AUDIO_STEGANO_H
+#define AUDIO_STEGANO_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "wav_audio.h"
+#include "stegano.h"
+
+namespace Stegano {
+
+    /**
+     * @brief Embeds a message into a copy of a 16- or 24-bit PCM WAV file.
+     *
+     * The samples are the carrier positions, so the payload goes to the same keyed positions (stream or
+     * indexed permutation, matrix embedding after the header) as in an image of that many bytes. Only
+     * the positions of the message are generated; with k > 1 their current LSBs are read first. Payloads
+     * of at least `size / PLANE_READ_DIVISOR` samples are kept as two bit-planes over the samples, smaller
+     * ones as a sorted list. The file
+     * then streams through a bounded pipeline of `WavFile::BLOCK_SAMPLES`-sample blocks: `threadCount`
+     * workers set the payload LSBs of their block and add ±1 cover noise to the other samples from the
+     * block's own noise stream, while the next block is read and the previous one written. Bytes outside
+     * the samples (the RIFF header and every other chunk) are copied unchanged.
+     *
+     * @param inFile Path to the input .wav file.
+     * @param outFile Path to the output .wav file.
+     * @param message The header, the key check and the container.
+     * @param key The steganographic key.
+     * @param options Engine, matrix parameter, header length, layout and noise density (adaptive levels are not supported).
+     * @param threadCount Number of embedding workers.
+     * @throws Terminates the program if the input is not a supported WAV file or the message does not fit.
+     */
+    void embedAudio(const std::string& inFile, const std::string& outFile, const std::vector<uint8_t>& message,
+                    const std::vector<uint8_t>& key, const EmbedOptions& options, unsigned int threadCount);
+
+    /**
+     * @brief Reads the LSBs of carrier positions (samples) of a WAV file.
+     *
+     * At least `size / PLANE_READ_DIVISOR` positions are answered from an `LsbPlane` of all samples, read
+     * block by block. Fewer positions are sorted by block and the blocks are split between `threadCount`
+     * workers; dense runs of a block are read at once, sparse positions sample by sample. Every worker
+     * has its own handle on the file.
+     *
+     * @param carrier The carrier (only its path and format are used).
+     * @param positions Sample indices in message bit order.
+     * @param threadCount Number of reading workers.
+     * @return std::vector<uint8_t> One byte (0 or 1) per position.
+     */
+    std::vector<uint8_t> readSampleLsbs(const AudioHandler::WavFile& carrier, const std::vector<size_t>& positions,
+                                        unsigned int threadCount);
+
+} // namespace Stegano
+
+#endif // AUDIO_STEGANO_H
@@ -0,0 +1,96 @@
+#ifndef CACHE_DIRECTORY_H
+#define CACHE_DIRECTORY_H
+
+#include <string>
+#include <cstdint>
+
+/**
+ * @brief Shared mechanics of the on-disk caches: entries renamed into place atomically, LRU eviction
+ * by modification time and hit/miss/eviction counters, shared by every process that uses the directory.
+ *
+ * An entry is one file `<key><extension>` whose modification time is its last use. Entries are written
+ * to a temporary file and renamed into place, so a reader sees either a complete entry or none.
+ * Eviction and the counters in `DIR/stats` are serialized by a lock file.
+ */
+namespace CacheDirectory {
+
+    /**
+     * @brief Hit, miss and eviction counters of a cache directory, summed over all processes.
+     */
+    struct Stats {
+        uint64_t hits = 0;      ///< Lookups answered by a cached entry.
+        uint64_t misses = 0;    ///< Lookups that had to compute the entry.
+        uint64_t evictions = 0; ///< Entries removed to stay within the size limit.
+    };
+
+    /**
+     * @brief Exclusive lock of a cache directory (between processes) for the lifetime of the object.
+     *
+     * A no-op on platforms without flock.
+     */
+    class Lock {
+    public:
+        explicit Lock(const std::string& directory);
+        Lock(const Lock&) = delete;
+        Lock& operator=(const Lock&) = delete;
+        ~Lock();
+
+    private:
+        int fd = -1;
+    };
+
+    /**
+     * @brief Creates the directory if needed.
+     *
+     * @param directory The cache directory.
+     * @return true if the directory exists and can be used.
+     */
+    bool prepare(const std::string& directory);
+
+    /**
+     * @brief Returns the path of an entry.
+     */
+    std::string entryPath(const std::string& directory, const std::string& key, const std::string& extension);
+
+    /**
+     * @brief Returns a unique temporary path for an entry being written (ignored by lookups and eviction).
+     */
+    std::string temporaryPath(const std::string& directory, const std::string& key, const std::string& extension);
+
+    /**
+     * @brief Renames a complete temporary file into place; on failure the temporary file is removed.
+     *
+     * @param temporary Path returned by `temporaryPath`.
+     * @param path Path returned by `entryPath`.
+     * @return true if the entry was published.
+     */
+    bool publish(const std::string& temporary, const std::string& path);
+
+    /**
+     * @brief Marks an entry as used now, which moves it to the end of the eviction order.
+     */
+    void touch(const std::string& path);
+
+    /**
+     * @brief Adds to the counters of the directory.
+     *
+     * @return Stats The counters after the update, including other processes.
+     */
+    Stats record(const std::string& directory, uint64_t hits, uint64_t misses);
+
+    /**
+     * @brief Returns the counters of the directory, including other processes.
+     */
+    Stats stats(const std::string& directory);
+
+    /**
+     * @brief Removes the least recently used entries until the entries with `extension` take at most
+     * `limit` bytes; temporary files left by interrupted processes are removed once they are stale.
+     *
+     * Entries mapped by other processes stay readable to them until they are unmapped.
+     */
+    void evict(const std::string& directory, uint64_t limit, const std::string& extension);
+
+} // namespace CacheDirectory
+
+#endif // CACHE_DIRECTORY_H
@@ -0,0 +1,76 @@
+#ifndef CARRIER_CACHE_H
+#define CARRIER_CACHE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+#include <unordered_map>
+#include "image_handler.h"
+#include "mapped_image.h"
+#include "cache_directory.h"
+
+namespace ImageHandler {
+
+    /**
+     * @brief Hit, miss and eviction counters of a carrier cache directory, summed over all processes.
+     */
+    using CarrierCacheStats = CacheDirectory::Stats;
+
+    /**
+     * @brief On-disk cache of decoded carriers (the --cache-dir option).
+     *
+     * Every entry is the decoded pixels of one compressed image stored as a PAM file, so a repeated
+     * load is a `MappedImage` mapping with no decoding. An entry is keyed by the canonical path, size,
+     * modification time and SHA-256 of the encoded file, so an edited or replaced image never hits a
+     * stale entry. The directory is shared between processes and kept under a size limit as described
+     * in `CacheDirectory` (hits refresh the entry's modification time).
+     */
+    class CarrierCache {
+    public:
+        /**
+         * @brief Opens (and creates if needed) a cache directory.
+         *
+         * @param directory The cache directory.
+         * @param limit Maximum total size of the entries in bytes.
+         */
+        CarrierCache(std::string directory, uint64_t limit);
+
+        /**
+         * @brief Maps the cached decoded pixels of an image.
+         *
+         * @param filename Path to the encoded image.
+         * @return std::optional<MappedImage> The mapped entry, or std::nullopt on a miss (the image
+         * has to be decoded and can then be passed to `store`).
+         */
+        std::optional<MappedImage> load(const std::string& filename);
+
+        /**
+         * @brief Stores the decoded pixels of an image after a miss and evicts old entries if the limit is exceeded.
+         *
+         * Failures are logged as warnings: the cache only saves work and never fails the extraction.
+         *
+         * @param filename Path to the encoded image, as passed to `load`.
+         * @param image The decoded image.
+         */
+        void store(const std::string& filename, const Image& image);
+
+        /**
+         * @brief Returns the counters of the directory, including this process.
+         */
+        CarrierCacheStats stats() const;
+
+    private:
+        std::optional<std::string> entryKey(const std::string& filename);
+        void record(uint64_t hits, uint64_t misses);
+
+        std::string directory;
+        uint64_t limit = 0;
+        bool usable = false;
+        std::unordered_map<std::string, std::string> keys; ///< Keys computed by `load`, reused by `store`.
+    };
+
+} // namespace ImageHandler
+
+#endif // CARRIER_CACHE_H
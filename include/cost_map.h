@@ -0,0 +1,66 @@
+#ifndef COST_MAP_H
+#define COST_MAP_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "image_handler.h"
+
+namespace Stegano {
+
+    /**
+     * @brief Highest adaptive level: level L keeps roughly the 1/2^L most textured carrier bytes.
+     */
+    constexpr uint8_t MAX_ADAPTIVE_LEVEL = 3;
+
+    /**
+     * @brief Computes a per-byte texture cost map of the image.
+     *
+     * The cost of a channel byte is the saturated sum of absolute differences to its left, right,
+     * upper and lower neighbours in the same channel. Only bits 1..7 are used, so embedding and
+     * LSB-only noise do not change the map and the extractor recomputes exactly the same values.
+     * Rows are split into bands processed by `threadCount` threads; the inner loop uses SSE2
+     * where available.
+     *
+     * @param image The decoded image.
+     * @param threadCount Number of worker threads.
+     * @return std::vector<uint8_t> One cost value per byte of `image.data` (higher means more texture).
+     */
+    std::vector<uint8_t> computeCostMap(const ImageHandler::Image& image, unsigned int threadCount);
+
+    /**
+     * @brief Returns the carrier bytes kept at an adaptive level, in memory order.
+     *
+     * The threshold is the largest cost T such that at least n / 2^level bytes have cost >= T,
+     * so the set depends only on the cost map and the level.
+     *
+     * @param costMap The cost map from `computeCostMap`.
+     * @param level Adaptive level in [1, MAX_ADAPTIVE_LEVEL].
+     * @return std::vector<size_t> Indices of the selected bytes.
+     */
+    std::vector<size_t> selectTexturedPositions(const std::vector<uint8_t>& costMap, uint8_t level);
+
+    /**
+     * @brief Returns how many carrier bytes `selectTexturedPositions` keeps at a level, without building the list.
+     *
+     * @param costMap The cost map from `computeCostMap`.
+     * @param level Adaptive level in [1, MAX_ADAPTIVE_LEVEL].
+     * @return size_t Number of candidate bytes.
+     */
+    size_t countTexturedPositions(const std::vector<uint8_t>& costMap, uint8_t level);
+
+    /**
+     * @brief Picks the most selective adaptive level that still leaves room for the payload.
+     *
+     * A level is accepted when its candidate set holds at least twice `requiredPositions`,
+     * so the payload never fills more than half of the textured region.
+     *
+     * @param costMap The cost map from `computeCostMap`.
+     * @param requiredPositions Number of positions the framed message needs.
+     * @return uint8_t The adaptive level, or 0 if even level 1 is too small.
+     */
+    uint8_t chooseAdaptiveLevel(const std::vector<uint8_t>& costMap, size_t requiredPositions);
+
+} // namespace Stegano
+
+#endif // COST_MAP_H
@@ -0,0 +1,91 @@
+#ifndef CHUNKED_CONTAINER_H
+#define CHUNKED_CONTAINER_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+#include "encryption/data_conversion.h"
+
+/**
+ * @brief Chunked container layout: salt, nonce, then the message in CHUNK_SIZE pieces, each encrypted
+ * with AES-256-GCM and followed by its tag.
+ *
+ * Chunk i uses the nonce with i added to its last 8 bytes, and authenticates i and the full message
+ * length as additional data, so a chunk can be decrypted on its own, and chunks cannot be reordered,
+ * dropped or moved to a container of another length without the tag check failing.
+ */
+namespace ChunkedContainer {
+
+    /**
+     * @brief Bytes before the first chunk: the KDF salt and the base nonce.
+     */
+    constexpr size_t PREFIX_SIZE = DataConversion::SALT_SIZE + DataConversion::CHUNK_NONCE_SIZE;
+
+    /**
+     * @brief Geometry of a chunked container.
+     */
+    struct Layout {
+        uint64_t messageLength = 0; ///< Plaintext length in bytes.
+        uint64_t chunkCount = 0;    ///< Number of chunks (at least 1, an empty message has one empty chunk).
+    };
+
+    /**
+     * @brief Byte range of one chunk (ciphertext and tag) inside the container.
+     */
+    struct ChunkSpan {
+        uint64_t offset = 0; ///< Offset of the chunk from the start of the container.
+        uint64_t length = 0; ///< Ciphertext length plus CHUNK_TAG_SIZE.
+    };
+
+    /**
+     * @brief Returns the container size for a message of `messageLength` bytes.
+     */
+    uint64_t containerSize(uint64_t messageLength);
+
+    /**
+     * @brief Recovers the geometry from the container length stored in the header.
+     *
+     * @param containerLength Length of the container in bytes.
+     * @return std::optional<Layout> The geometry, or std::nullopt if no message has a container of this length.
+     */
+    std::optional<Layout> layoutFromLength(uint64_t containerLength);
+
+    /**
+     * @brief Returns where chunk `index` lies in the container.
+     */
+    ChunkSpan chunkSpan(const Layout& layout, uint64_t index);
+
+    /**
+     * @brief Encrypts a message into a chunked container.
+     *
+     * @param plaintext The message.
+     * @param salt The KDF salt (SALT_SIZE bytes), stored at the start of the container.
+     * @param key The 32-byte AES key derived from the passphrase and the salt.
+     * @return std::vector<uint8_t> The container (salt + nonce + chunks).
+     */
+    std::vector<uint8_t> seal(const std::vector<uint8_t>& plaintext, const std::vector<uint8_t>& salt,
+                              const std::vector<uint8_t>& key);
+
+    /**
+     * @brief `seal` that returns std::nullopt instead of terminating if the key is invalid or the encryption fails.
+     */
+    std::optional<std::vector<uint8_t>> trySeal(const std::vector<uint8_t>& plaintext, const std::vector<uint8_t>& salt,
+                                                const std::vector<uint8_t>& key);
+
+    /**
+     * @brief Decrypts and authenticates one chunk.
+     *
+     * @param chunk The chunk bytes (ciphertext followed by the tag), as located by `chunkSpan`.
+     * @param nonce The base nonce from the container prefix (CHUNK_NONCE_SIZE bytes).
+     * @param key The 32-byte AES key.
+     * @param layout The container geometry.
+     * @param index The chunk index.
+     * @return std::optional<std::vector<uint8_t>> The plaintext of the chunk, or std::nullopt if the tag does not match.
+     */
+    std::optional<std::vector<uint8_t>> openChunk(const std::vector<uint8_t>& chunk, const uint8_t* nonce,
+                                                  const std::vector<uint8_t>& key, const Layout& layout, uint64_t index);
+
+} // namespace ChunkedContainer
+
+#endif // CHUNKED_CONTAINER_H
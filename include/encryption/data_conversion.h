@@ -7,9 +7,44 @@
 
 namespace DataConversion {
     /**
-     * @brief Size of the header in bytes.
+     * @brief Size of the container length field at the start of the header, in bytes.
+     *
+     * The length is 64-bit, so containers larger than 4 GiB fit into gigapixel carriers.
      */
-    constexpr size_t HEADER_SIZE = 4;
+    constexpr size_t LENGTH_SIZE = 8;
+
+    /**
+     * @brief Size of the header in bytes: the container length, the generator engine id, the adaptive level,
+     * the matrix embedding parameter and the container layout.
+     */
+    constexpr size_t HEADER_SIZE = LENGTH_SIZE + 4;
+
+    /**
+     * @brief How the container is encrypted and where its bytes are embedded.
+     */
+    enum class ContainerLayout : uint8_t {
+        Single  = 0, ///< salt + IV + one AES-256-CBC ciphertext on the shuffled position stream.
+        Chunked = 1  ///< salt + nonce + independently authenticated AES-256-GCM chunks on indexed positions.
+    };
+
+    /**
+     * @brief Fields of the header that precedes the key check value and the container.
+     */
+    struct ContainerHeader {
+        uint64_t containerLength = 0; ///< Length of the container (salt + IV + ciphertext) in bytes.
+        uint8_t engine = 0;           ///< Position generator engine id (Stegano::EngineId).
+        uint8_t adaptiveLevel = 0;    ///< 0 for uniform positions, otherwise the adaptive level.
+        uint8_t matrixK = 1;          ///< Hamming parameter of the container (1 - plain LSB embedding).
+        ContainerLayout layout = ContainerLayout::Single; ///< Layout of the container.
+    };
+
+    /**
+     * @brief Size of the keyed check value that follows the header, in bytes.
+     *
+     * Lets the extractor reject a wrong key after reading the first 128 embedded bits,
+     * before any key derivation or bulk extraction.
+     */
+    constexpr size_t KEY_CHECK_SIZE = 4;
 
     /**
      * @brief Size of the salt in bytes.
@@ -21,6 +56,25 @@ namespace DataConversion {
      */
     constexpr int KDF_ITERATIONS = 10'000;
 
+    /**
+     * @brief Plaintext bytes per chunk of a chunked container (the last chunk may be shorter).
+     */
+    constexpr size_t CHUNK_SIZE = 4096;
+
+    /**
+     * @brief Size of the authentication tag after every chunk and of the nonce after the salt, in bytes.
+     */
+    constexpr size_t CHUNK_TAG_SIZE = 16;
+    constexpr size_t CHUNK_NONCE_SIZE = 12;
+
+    /**
+     * @brief Chooses the container layout for a message: messages longer than one chunk are chunked,
+     * so that parts of them can be extracted without the rest.
+     * @param messageLength Length of the plaintext in bytes.
+     * @return The layout.
+     */
+    ContainerLayout layoutForMessage(size_t messageLength);
+
     /**
      * @brief Converts a string to a vector of bytes.
      * @param str The string to convert.
@@ -41,6 +95,34 @@ namespace DataConversion {
      * @return The uint32_t value obtained from the bytes.
      */
     uint32_t bytesToUint32(const std::vector<uint8_t>& bytes);
+
+    /**
+     * @brief Converts a uint64_t value to 8 bytes (big-endian).
+     * @param value The uint64_t value to convert.
+     * @return A vector containing the bytes of the uint64_t value.
+     */
+    std::vector<uint8_t> uint64ToBytes(uint64_t value);
+
+    /**
+     * @brief Converts 8 bytes (big-endian) to a uint64_t value.
+     * @param bytes The vector of bytes to convert.
+     * @return The uint64_t value obtained from the bytes.
+     */
+    uint64_t bytesToUint64(const std::vector<uint8_t>& bytes);
+
+    /**
+     * @brief Serializes a container header into HEADER_SIZE bytes.
+     * @param header The header fields.
+     * @return A vector containing the serialized header.
+     */
+    std::vector<uint8_t> headerToBytes(const ContainerHeader& header);
+
+    /**
+     * @brief Parses HEADER_SIZE bytes into a container header.
+     * @param bytes The serialized header.
+     * @return The header fields.
+     */
+    ContainerHeader bytesToHeader(const std::vector<uint8_t>& bytes);
 }
 
 #endif // DATA_CONVERSION_H
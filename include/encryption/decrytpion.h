@@ -6,17 +6,167 @@
 #include "encryption/data_conversion.h"
 #include "external/logger.h"
 #include "image_handler.h"
+#include "mapped_image.h"
 #include "CliConfig.h"
 #include "stegano.h"
+#include "cost_map.h"
+#include "matrix_embedding.h"
+#include "video_stegano.h"
+#include "tiled_tiff.h"
+#include "wav_audio.h"
 
 #include <string>
+#include <optional>
 
 namespace Decryption {
+    /**
+     * @brief Outcome of an extraction attempt with one key.
+     */
+    enum class ExtractStatus {
+        Ok,               ///< The container was authenticated and decrypted.
+        KeyMismatch,      ///< The keyed check value after the header does not match.
+        CapacityExceeded, ///< The container length does not fit into the image.
+        ContainerTooSmall,///< The container is shorter than the salt.
+        DecryptionFailed  ///< The ciphertext did not decrypt (wrong key or corrupted data).
+    };
+
+    /**
+     * @brief Result of an extraction attempt.
+     */
+    struct ExtractResult {
+        ExtractStatus status = ExtractStatus::KeyMismatch; ///< Outcome of the attempt.
+        std::string message;                               ///< Decrypted message when status is Ok.
+        DataConversion::ContainerHeader header;            ///< Header of the container when status is Ok.
+        uint64_t messageLength = 0;                        ///< Length of the whole message, also when only a range was read.
+    };
+
+    /**
+     * @brief Result of trying a list of candidate keys against one image.
+     */
+    struct KeyTrialResult {
+        bool found = false;    ///< True if one of the keys authenticated the container.
+        size_t keyIndex = 0;   ///< Index of the matching key in the candidate list.
+        std::string message;   ///< Decrypted message of the matching key.
+    };
+
+    /**
+     * @brief Tries to extract and decrypt the hidden message with one passphrase.
+     * 
+     * Unlike `getDecryptedMessage` this function never terminates the program, so it can be used
+     * to probe keys. The image is only read.
+     * 
+     * @param passphrase The passphrase used for the KDF.
+     * @param image The image object from which the hidden message will be extracted.
+     * @param steganoKey The key used to generate the embedding positions.
+     * @return ExtractResult The status and, on success, the decrypted message.
+     */
+    ExtractResult tryDecryptMessage(const std::string& passphrase, const ImageHandler::Image& image, const std::vector<uint8_t>& steganoKey);
+
+    /**
+     * @brief Tries to extract and decrypt the hidden message directly from a mapped carrier file.
+     * 
+     * Only the pages holding the key's positions are read; the file is decoded completely only
+     * for adaptive embeddings, whose positions depend on the cost map.
+     * 
+     * @param passphrase The passphrase used for the KDF.
+     * @param image The mapped carrier file.
+     * @param steganoKey The key used to generate the embedding positions.
+     * @return ExtractResult The status and, on success, the decrypted message.
+     */
+    ExtractResult tryDecryptMessage(const std::string& passphrase, const ImageHandler::MappedImage& image, const std::vector<uint8_t>& steganoKey);
+
+    /**
+     * @brief Tries to extract and decrypt the hidden message from a tiled TIFF.
+     * 
+     * Only the tiles holding the key's positions are decoded, in parallel. Adaptive embeddings are not
+     * supported for tiled carriers.
+     * 
+     * @param passphrase The passphrase used for the KDF.
+     * @param image The tiled TIFF carrier.
+     * @param steganoKey The key used to generate the embedding positions.
+     * @return ExtractResult The status and, on success, the decrypted message.
+     */
+    ExtractResult tryDecryptMessage(const std::string& passphrase, const ImageHandler::TiledTiff& image, const std::vector<uint8_t>& steganoKey);
+
+    /**
+     * @brief Tries to extract and decrypt the hidden message from a PCM WAV file.
+     * 
+     * The samples are read through the file handle, only at the key's positions; the file is never
+     * loaded as a whole. Adaptive embeddings are not supported for audio carriers.
+     * 
+     * @param passphrase The passphrase used for the KDF.
+     * @param audio The WAV carrier.
+     * @param steganoKey The key used to generate the embedding positions.
+     * @return ExtractResult The status and, on success, the decrypted message.
+     */
+    ExtractResult tryDecryptMessage(const std::string& passphrase, const AudioHandler::WavFile& audio, const std::vector<uint8_t>& steganoKey);
+
+    /**
+     * @brief Tries to extract and decrypt the bytes [offset, offset + length) of the hidden message.
+     * 
+     * The range is clipped to the end of the message. For a chunked container only the keyed
+     * positions of the chunks that cover the range are computed and read, and only those chunks are
+     * decrypted and authenticated, so the cost follows the range rather than the message. A
+     * single-ciphertext container is decrypted whole and then cut.
+     * 
+     * @param passphrase The passphrase used for the KDF.
+     * @param image The image object from which the hidden message will be extracted.
+     * @param steganoKey The key used to generate the embedding positions.
+     * @param offset First message byte to return.
+     * @param length Number of bytes to return.
+     * @return ExtractResult The status and, on success, the requested bytes and the full message length.
+     */
+    ExtractResult tryDecryptRange(const std::string& passphrase, const ImageHandler::Image& image, const std::vector<uint8_t>& steganoKey,
+                                  uint64_t offset, uint64_t length);
+
+    /**
+     * @brief `tryDecryptRange` on a mapped carrier file; only the pages holding the range's positions are read.
+     */
+    ExtractResult tryDecryptRange(const std::string& passphrase, const ImageHandler::MappedImage& image, const std::vector<uint8_t>& steganoKey,
+                                  uint64_t offset, uint64_t length);
+
+    /**
+     * @brief `tryDecryptRange` on a tiled TIFF; only the tiles holding the range's positions are decoded.
+     */
+    ExtractResult tryDecryptRange(const std::string& passphrase, const ImageHandler::TiledTiff& image, const std::vector<uint8_t>& steganoKey,
+                                  uint64_t offset, uint64_t length);
+
+    /**
+     * @brief `tryDecryptRange` on a WAV file; only the samples holding the range's positions are read.
+     */
+    ExtractResult tryDecryptRange(const std::string& passphrase, const AudioHandler::WavFile& audio, const std::vector<uint8_t>& steganoKey,
+                                  uint64_t offset, uint64_t length);
+
+    /**
+     * @brief Tries to extract and decrypt the hidden message from a YUV4MPEG2 clip.
+     * 
+     * @param passphrase The passphrase used for the KDF.
+     * @param inFile Path to the .y4m file, or "-" for the standard input.
+     * @param steganoKey The key used to generate the embedding positions.
+     * @return ExtractResult The status and, on success, the decrypted message.
+     */
+    ExtractResult tryDecryptVideo(const std::string& passphrase, const std::string& inFile, const std::vector<uint8_t>& steganoKey);
+
+    /**
+     * @brief Tries candidate passphrases against one decoded image in parallel.
+     * 
+     * The decoded pixels are shared read-only between the worker threads, every key only generates
+     * the positions it needs, and the workers stop as soon as a key authenticates. If several keys
+     * match, the one with the lowest index is reported.
+     * 
+     * @param passphrases The candidate passphrases.
+     * @param image The image object from which the hidden message will be extracted.
+     * @param threadCount Number of worker threads.
+     * @return KeyTrialResult The matching key index and message, if any.
+     */
+    KeyTrialResult findMessageWithKeys(const std::vector<std::string>& passphrases, const ImageHandler::Image& image, unsigned int threadCount);
+
     /**
      * @brief Extracts and decrypts a hidden message from an image.
      * 
      * This function retrieves the encrypted data hidden within the image
-     * and decrypts it using the provided steganographic key.
+     * and decrypts it using the provided steganographic key. With `--range` only the requested
+     * bytes are returned (see `tryDecryptRange`).
      * 
      * @param config The CLI configuration containing user-specified parameters.
      * @param image The image object from which the hidden message will be extracted.
@@ -24,6 +174,45 @@ namespace Decryption {
      * @return std::string The decrypted message.
      */
     std::string getDecryptedMessage(const CliConfig& config, ImageHandler::Image& image, std::vector<uint8_t>& steganoKey);
+
+    /**
+     * @brief Extracts and decrypts a hidden message from a mapped carrier file.
+     * 
+     * @param config The CLI configuration containing user-specified parameters.
+     * @param image The mapped carrier file.
+     * @param steganoKey The key used for extracting and decrypting the hidden message.
+     * @return std::string The decrypted message.
+     */
+    std::string getDecryptedMessage(const CliConfig& config, const ImageHandler::MappedImage& image, std::vector<uint8_t>& steganoKey);
+
+    /**
+     * @brief Extracts and decrypts a hidden message from a tiled TIFF.
+     * 
+     * @param config The CLI configuration containing user-specified parameters.
+     * @param image The tiled TIFF carrier.
+     * @param steganoKey The key used for extracting and decrypting the hidden message.
+     * @return std::string The decrypted message.
+     */
+    std::string getDecryptedMessage(const CliConfig& config, const ImageHandler::TiledTiff& image, std::vector<uint8_t>& steganoKey);
+
+    /**
+     * @brief Extracts and decrypts a hidden message from a PCM WAV file.
+     * 
+     * @param config The CLI configuration containing user-specified parameters.
+     * @param audio The WAV carrier.
+     * @param steganoKey The key used for extracting and decrypting the hidden message.
+     * @return std::string The decrypted message.
+     */
+    std::string getDecryptedMessage(const CliConfig& config, const AudioHandler::WavFile& audio, std::vector<uint8_t>& steganoKey);
+
+    /**
+     * @brief Extracts and decrypts a hidden message from the YUV4MPEG2 clip given by `config.inFile`.
+     * 
+     * @param config The CLI configuration containing user-specified parameters.
+     * @param steganoKey The key used for extracting and decrypting the hidden message.
+     * @return std::string The decrypted message.
+     */
+    std::string getDecryptedVideoMessage(const CliConfig& config, std::vector<uint8_t>& steganoKey);
 }
 
 namespace {
@@ -35,10 +224,10 @@ namespace {
      * 
      * @param ciphertext A vector containing the IV (16 bytes) followed by the encrypted data.
      * @param key The binary decryption key (32 bytes).
-     * @return std::vector<uint8_t> A vector containing the decrypted plaintext.
+     * @return std::optional<std::vector<uint8_t>> The decrypted plaintext, or std::nullopt if the padding check fails.
      * @throws std::runtime_error If the key size is incorrect, the data is insufficient, or an error occurs during decryption.
      */
-    std::vector<uint8_t> decryptData(const std::vector<uint8_t>& ciphertext, const std::vector<uint8_t>& key);
+    std::optional<std::vector<uint8_t>> decryptData(const std::vector<uint8_t>& ciphertext, const std::vector<uint8_t>& key);
 }
 
 #endif // DECRYPTION_H
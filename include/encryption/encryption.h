@@ -4,6 +4,7 @@
 #include <vector>
 #include <cstdint>
 #include <iostream>
+#include <optional>
 #include "encryption/key_derivation.h"
 #include "encryption/data_conversion.h"
 #include "encryption/utils.h"
@@ -11,15 +12,63 @@
 
 namespace Encryption {
     /**
-     * @brief Prepares text for embedding in an image.
+     * @brief Encrypts the text from the CLI configuration into a container.
      * 
-     * This function retrieves and processes the input text from the CLI configuration,
-     * encrypts it if necessary, and returns it as a binary vector ready for steganographic embedding.
+     * A random salt is generated, the AES key is derived from the passphrase with PBKDF2,
+     * and the container is laid out as salt followed by IV and ciphertext, or, for the chunked
+     * layout, by a nonce and AES-256-GCM chunks (see `ChunkedContainer`).
      * 
      * @param config The CLI configuration containing user-specified parameters.
-     * @return std::vector<uint8_t> A vector containing the processed text, ready for embedding.
+     * @param layout The container layout; it must be stored in the header.
+     * @return std::vector<uint8_t> The container.
      */
-    std::vector<uint8_t> getReadyToEmbedText(CliConfig& config);
+    std::vector<uint8_t> getEncryptedContainer(CliConfig& config,
+                                               DataConversion::ContainerLayout layout = DataConversion::ContainerLayout::Single);
+
+    /**
+     * @brief Encrypts the text from the CLI configuration into several containers at once.
+     * 
+     * Every container gets its own random salt and IV; the keys are derived together with
+     * `KeyDerivation::deriveKeys`, so a batch costs about as much PBKDF2 work as one container.
+     * A container whose encryption fails is std::nullopt, so one failure does not stop the batch.
+     * 
+     * @param config The CLI configuration containing user-specified parameters.
+     * @param count Number of containers.
+     * @param layout The container layout.
+     * @return std::vector<std::optional<std::vector<uint8_t>>> The containers.
+     */
+    std::vector<std::optional<std::vector<uint8_t>>> getEncryptedContainers(const CliConfig& config, size_t count,
+                                                             DataConversion::ContainerLayout layout = DataConversion::ContainerLayout::Single);
+
+    /**
+     * @brief Returns the size of the container that `getEncryptedContainer` makes for a message.
+     * 
+     * @param messageLength Length of the message in bytes.
+     * @param layout The container layout.
+     * @return size_t The container size in bytes.
+     */
+    size_t containerSize(size_t messageLength, DataConversion::ContainerLayout layout);
+
+    /**
+     * @brief Prepares a container for embedding in an image.
+     * 
+     * Prepends the header (container length, engine id, adaptive level, matrix parameter, layout) and the keyed check value,
+     * and returns the result as a binary vector ready for steganographic embedding.
+     * 
+     * @param container The container from `getEncryptedContainer`.
+     * @param header Header fields; the container length is filled in by this function.
+     * @param steganoKey The key used to generate the embedding positions.
+     * @return std::vector<uint8_t> A vector containing the framed container, ready for embedding.
+     */
+    std::vector<uint8_t> getReadyToEmbedText(const std::vector<uint8_t>& container, DataConversion::ContainerHeader header,
+                                             const std::vector<uint8_t>& steganoKey);
+
+    /**
+     * @brief `getReadyToEmbedText` that returns std::nullopt instead of terminating if the check value cannot be computed.
+     */
+    std::optional<std::vector<uint8_t>> tryGetReadyToEmbedText(const std::vector<uint8_t>& container,
+                                                               DataConversion::ContainerHeader header,
+                                                               const std::vector<uint8_t>& steganoKey);
 } // namespace Encryption
 
 namespace {
@@ -31,10 +80,10 @@ namespace {
      * 
      * @param plaintext A vector containing the plaintext data to be encrypted.
      * @param key The binary encryption key (32 bytes).
-     * @return std::vector<uint8_t> A vector containing the IV (16 bytes) followed by the encrypted data.
-     * @throws std::runtime_error If the key size is incorrect or an error occurs during encryption.
+     * @return std::optional<std::vector<uint8_t>> The IV (16 bytes) followed by the encrypted data, or
+     * std::nullopt if the key size is incorrect or an error occurs during encryption.
      */
-    std::vector<uint8_t> encryptData(const std::vector<uint8_t>& plaintext, const std::vector<uint8_t>& key);
+    std::optional<std::vector<uint8_t>> encryptData(const std::vector<uint8_t>& plaintext, const std::vector<uint8_t>& key);
 }
 
 #endif // ENCRYPTION_H
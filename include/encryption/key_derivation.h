@@ -22,6 +22,43 @@ namespace KeyDerivation {
                                    int iterations, 
                                    size_t keyLength);
 
+    /**
+     * @brief Derives many independent PBKDF2-HMAC-SHA256 keys at once.
+     *
+     * The instances run in lockstep in the SIMD lanes of a multi-buffer SHA-256 kernel (16 with AVX-512,
+     * 8 with AVX2, 4 with SSE2; the widest one the CPU supports is chosen at run time). Every kernel is
+     * checked once against OpenSSL's `PKCS5_PBKDF2_HMAC` before its first use and disabled if the results
+     * differ, so the output is always byte-identical to calling `deriveKey` for each instance, which is
+     * also what happens without a kernel or for a single instance.
+     *
+     * @param passphrases The passphrase of every instance.
+     * @param salts The salt of every instance (as many as passphrases).
+     * @param iterations The number of iterations, shared by all instances.
+     * @param keyLength The length of every derived key in bytes.
+     * @param maxLanes Use a kernel with at most this many lanes (0 - the widest; 1 - OpenSSL one by one).
+     * @return std::vector<std::vector<uint8_t>> The derived keys, in the order of the passphrases.
+     */
+    std::vector<std::vector<uint8_t>> deriveKeys(const std::vector<std::string>& passphrases,
+                                                const std::vector<std::vector<uint8_t>>& salts,
+                                                int iterations,
+                                                size_t keyLength,
+                                                unsigned int maxLanes = 0);
+
+    /**
+     * @brief Number of instances `deriveKeys` processes together (1 if no SIMD kernel is available).
+     *
+     * @param maxLanes Consider only kernels with at most this many lanes (0 - any).
+     */
+    unsigned int batchLanes(unsigned int maxLanes = 0);
+
+    /**
+     * @brief Lane counts of the kernels the build and the CPU support, widest first.
+     *
+     * Unlike `batchLanes`, this ignores the self-test against OpenSSL, so a kernel listed here but not
+     * selected by `batchLanes(lanes)` was disabled because its output was wrong.
+     */
+    std::vector<unsigned int> supportedLanes();
+
     /**
      * @brief Generates a cryptographically strong random salt of the specified length.
      *
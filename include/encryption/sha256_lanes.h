@@ -0,0 +1,142 @@
+#ifndef SHA256_LANES_H
+#define SHA256_LANES_H
+
+#include <cstdint>
+#include <cstddef>
+
+// Ядра AVX2 и AVX-512 собираются с атрибутом target и выбираются по CPUID во время работы
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define STEGANO_KDF_AVX 1
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define STEGANO_KDF_SSE2 1
+#endif
+
+namespace KeyDerivation {
+
+    /**
+     * @brief Number of PBKDF2 instances processed in lockstep by each multi-buffer kernel.
+     */
+    constexpr unsigned int SSE2_LANES = 4;
+    constexpr unsigned int AVX2_LANES = 8;
+    constexpr unsigned int AVX512_LANES = 16;
+
+    /**
+     * @brief Runs PBKDF2-HMAC-SHA256 iterations 2..`iterations` for a group of independent instances.
+     *
+     * All arrays are word-major: word j of lane l is at `[j * lanes + l]`, so one vector load fetches
+     * word j of every lane. `inner` and `outer` are the SHA-256 states after the HMAC key block XOR ipad
+     * and XOR opad; `u` holds U_1 on entry, and `t` holds T = U_1 on entry and U_1 ^ ... ^ U_c on return.
+     * The kernels are compiled in separate translation units for their instruction sets; the AVX2 and
+     * AVX-512 ones may only be called when the CPU supports them (see `KeyDerivation::batchLanes`).
+     *
+     * @param inner Inner HMAC states, 8 words per lane.
+     * @param outer Outer HMAC states, 8 words per lane.
+     * @param u The previous block U, 8 words per lane (overwritten).
+     * @param t The running XOR of the blocks, 8 words per lane.
+     * @param iterations The PBKDF2 iteration count.
+     */
+    void iterateSse2(const uint32_t* inner, const uint32_t* outer, uint32_t* u, uint32_t* t, int iterations);
+    void iterateAvx2(const uint32_t* inner, const uint32_t* outer, uint32_t* u, uint32_t* t, int iterations);
+    void iterateAvx512(const uint32_t* inner, const uint32_t* outer, uint32_t* u, uint32_t* t, int iterations);
+
+namespace Lanes {
+
+    constexpr uint32_t SHA256_K[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+    };
+
+    constexpr uint32_t SHA256_IV[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+
+    // Сжатие SHA-256 одного блока сразу во всех дорожках. V задаёт тип вектора и операции над 32-битными
+    // дорожками (load, store, set1, add, bitwise, shr<N>, rotr<N>). Шаблоны инстанцируются только с типами
+    // из безымянных пространств имён, поэтому код для разных наборов инструкций не смешивается при линковке.
+    template <typename V>
+    inline void compress(typename V::Vec state[8], const typename V::Vec block[16]) {
+        using Vec = typename V::Vec;
+        Vec w[64];
+        for (int i = 0; i < 16; i++) w[i] = block[i];
+        for (int i = 16; i < 64; i++) {
+            Vec s0 = V::bxor(V::bxor(V::template rotr<7>(w[i - 15]), V::template rotr<18>(w[i - 15])), V::template shr<3>(w[i - 15]));
+            Vec s1 = V::bxor(V::bxor(V::template rotr<17>(w[i - 2]), V::template rotr<19>(w[i - 2])), V::template shr<10>(w[i - 2]));
+            w[i] = V::add(V::add(w[i - 16], s0), V::add(w[i - 7], s1));
+        }
+
+        Vec a = state[0], b = state[1], c = state[2], d = state[3];
+        Vec e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; i++) {
+            Vec s1 = V::bxor(V::bxor(V::template rotr<6>(e), V::template rotr<11>(e)), V::template rotr<25>(e));
+            Vec ch = V::bxor(V::band(e, f), V::bandnot(e, g));
+            Vec t1 = V::add(V::add(h, s1), V::add(V::add(ch, V::set1(SHA256_K[i])), w[i]));
+            Vec s0 = V::bxor(V::bxor(V::template rotr<2>(a), V::template rotr<13>(a)), V::template rotr<22>(a));
+            Vec maj = V::bor(V::band(a, b), V::band(c, V::bor(a, b)));
+            Vec t2 = V::add(s0, maj);
+            h = g;
+            g = f;
+            f = e;
+            e = V::add(d, t1);
+            d = c;
+            c = b;
+            b = a;
+            a = V::add(t1, t2);
+        }
+        state[0] = V::add(state[0], a);
+        state[1] = V::add(state[1], b);
+        state[2] = V::add(state[2], c);
+        state[3] = V::add(state[3], d);
+        state[4] = V::add(state[4], e);
+        state[5] = V::add(state[5], f);
+        state[6] = V::add(state[6], g);
+        state[7] = V::add(state[7], h);
+    }
+
+    // Итерации PBKDF2 2..c: U_j = HMAC(P, U_{j-1}) - два сжатия с готовыми состояниями ipad/opad,
+    // оба блока - 32 байта данных с дополнением до длины (64 + 32) * 8 бит
+    template <typename V>
+    inline void iterate(const uint32_t* inner, const uint32_t* outer, uint32_t* u, uint32_t* t, int iterations) {
+        using Vec = typename V::Vec;
+        constexpr size_t lanes = V::LANES;
+        Vec innerState[8], outerState[8], block[16], acc[8];
+        for (int j = 0; j < 8; j++) {
+            innerState[j] = V::load(inner + j * lanes);
+            outerState[j] = V::load(outer + j * lanes);
+            block[j] = V::load(u + j * lanes);
+            acc[j] = V::load(t + j * lanes);
+        }
+        block[8] = V::set1(0x80000000u);
+        for (int j = 9; j < 15; j++) block[j] = V::set1(0);
+        block[15] = V::set1((64 + 32) * 8);
+
+        for (int round = 1; round < iterations; round++) {
+            Vec state[8];
+            for (int j = 0; j < 8; j++) state[j] = innerState[j];
+            compress<V>(state, block);
+            for (int j = 0; j < 8; j++) block[j] = state[j];
+            for (int j = 0; j < 8; j++) state[j] = outerState[j];
+            compress<V>(state, block);
+            for (int j = 0; j < 8; j++) {
+                block[j] = state[j];
+                acc[j] = V::bxor(acc[j], state[j]);
+            }
+        }
+        for (int j = 0; j < 8; j++) {
+            V::store(u + j * lanes, block[j]);
+            V::store(t + j * lanes, acc[j]);
+        }
+    }
+
+} // namespace Lanes
+
+} // namespace KeyDerivation
+
+#endif // SHA256_LANES_H
@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <cstdint>
+#include <optional>
 #include "external/logger.h"
 
 namespace Utils {
@@ -18,6 +19,30 @@ namespace Utils {
      */
     std::vector<uint8_t> computeHMAC(const std::vector<uint8_t>& data, const std::vector<uint8_t>& key);
 
+    /**
+     * @brief `computeHMAC` that returns std::nullopt instead of terminating if the computation fails.
+     */
+    std::optional<std::vector<uint8_t>> tryComputeHMAC(const std::vector<uint8_t>& data, const std::vector<uint8_t>& key);
+
+    /**
+     * @brief Computes the short keyed check value stored right after the container header.
+     *
+     * The value is a truncated HMAC-SHA256 of the header under the steganographic key,
+     * so it can be verified without running the KDF.
+     *
+     * @param header The container header (length field).
+     * @param key The steganographic key.
+     * @param length The number of bytes to keep.
+     * @return std::vector<uint8_t> The check value.
+     */
+    std::vector<uint8_t> computeKeyCheck(const std::vector<uint8_t>& header, const std::vector<uint8_t>& key, size_t length);
+
+    /**
+     * @brief `computeKeyCheck` that returns std::nullopt instead of terminating if the HMAC fails.
+     */
+    std::optional<std::vector<uint8_t>> tryComputeKeyCheck(const std::vector<uint8_t>& header, const std::vector<uint8_t>& key,
+                                                           size_t length);
+
     /**
      * @brief Converts a vector of bytes to a hexadecimal string representation.
      *
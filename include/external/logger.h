@@ -100,6 +100,15 @@ inline void setup_logger() {
     LoggerConfigBuilder().setupLogger();  // Use default configuration
 }
 
+// Keeps stdout clean when it carries binary data (e.g. an image written to "-")
+inline void use_stderr_logger() {
+    auto logger = spdlog::get("stderr");
+    if (!logger) {
+        logger = spdlog::stderr_color_mt("stderr");
+    }
+    spdlog::set_default_logger(logger);
+}
+
 #define LOG_DEBUG(msg, ...)    do{spdlog::debug    (msg, ##__VA_ARGS__);}while(0)
 #define LOG_INFO(msg, ...)     do{spdlog::info     (msg, ##__VA_ARGS__);}while(0)
 #define LOG_WARN(msg, ...)     do{spdlog::warn     (msg, ##__VA_ARGS__);}while(0)
@@ -108,6 +117,7 @@ inline void setup_logger() {
 
 #else
 void setup_logger() {}
+inline void use_stderr_logger() {}
 #define LOG_DEBUG(msg, ...)    do{}while(0)
 #define LOG_INFO(msg, ...)     do{}while(0)
 #define LOG_WARN(msg,...)      do{}while(0)
@@ -0,0 +1,121 @@
+#ifndef FRAME_PIPELINE_H
+#define FRAME_PIPELINE_H
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+#include <string>
+#include "trace.h"
+#include <condition_variable>
+
+namespace Parallel {
+
+    /**
+     * @brief Runs a bounded read -> process -> write pipeline over a sequence of items (e.g. video frames).
+     *
+     * The calling thread reads, `workerCount` threads process and one thread writes, so item N + 1 is
+     * read while item N is processed and item N - 1 is written. Items are processed in any order but
+     * written in input order. Only `workerCount + 2` item buffers exist at any time, so memory does not
+     * depend on the length of the sequence; buffers are reused between items.
+     *
+     * @param workerCount Number of processing threads (values below 1 are treated as 1).
+     * @param read Callable `bool(Item&)` filling the next item; returns false at the end of the input.
+     * @param process Callable `void(size_t index, Item&)`; may run concurrently for different items.
+     * @param write Callable `void(size_t index, Item&)`, called once per item in input order.
+     * @return size_t Number of items that passed through the pipeline.
+     */
+    template <typename Item, typename Read, typename Process, typename Write>
+    size_t pipeline(unsigned int workerCount, Read&& read, Process&& process, Write&& write) {
+        workerCount = std::max(1u, workerCount);
+        std::vector<Item> slots(workerCount + 2);
+
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::deque<size_t> freeSlots;
+        std::deque<std::pair<size_t, size_t>> pending;   // (номер элемента, слот) для обработки
+        std::map<size_t, size_t> processed;              // номер элемента -> слот, ждут записи
+        bool inputFinished = false;
+        size_t itemCount = 0;
+        for (size_t slot = 0; slot < slots.size(); slot++) freeSlots.push_back(slot);
+
+        std::vector<std::thread> workers;
+        for (unsigned int w = 0; w < workerCount; w++) {
+            workers.emplace_back([&, w]() {
+                Trace::nameThread("frame worker " + std::to_string(w));
+                for (;;) {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    changed.wait(lock, [&]() { return !pending.empty() || inputFinished; });
+                    if (pending.empty()) return;
+                    auto [index, slot] = pending.front();
+                    pending.pop_front();
+                    lock.unlock();
+
+                    {
+                        Trace::Span span("process frame");
+                        process(index, slots[slot]);
+                    }
+
+                    lock.lock();
+                    processed.emplace(index, slot);
+                    changed.notify_all();
+                }
+            });
+        }
+
+        std::thread writer([&]() {
+            Trace::nameThread("frame writer");
+            for (size_t next = 0;; next++) {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&]() { return processed.count(next) || (inputFinished && next == itemCount); });
+                if (!processed.count(next)) return;
+                size_t slot = processed[next];
+                processed.erase(next);
+                lock.unlock();
+
+                {
+                    Trace::Span span("write frame");
+                    write(next, slots[slot]);
+                }
+
+                lock.lock();
+                freeSlots.push_back(slot);
+                changed.notify_all();
+            }
+        });
+
+        for (;;) {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&]() { return !freeSlots.empty(); });
+            size_t slot = freeSlots.front();
+            freeSlots.pop_front();
+            lock.unlock();
+
+            bool more = false;
+            {
+                Trace::Span span("read frame");
+                more = read(slots[slot]);
+            }
+
+            lock.lock();
+            if (!more) {
+                freeSlots.push_back(slot);
+                inputFinished = true;
+                changed.notify_all();
+                break;
+            }
+            pending.emplace_back(itemCount++, slot);
+            changed.notify_all();
+        }
+
+        for (auto& worker : workers) worker.join();
+        writer.join();
+        return itemCount;
+    }
+
+} // namespace Parallel
+
+#endif // FRAME_PIPELINE_H
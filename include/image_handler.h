@@ -4,10 +4,27 @@
 #include <string>
 #include <vector>
 #include <cstdint>
+#include <optional>
 #include "external/logger.h"
 
 namespace ImageHandler {
 
+    /**
+     * @brief Path value that stands for the standard input (when loading) or the standard output (when saving).
+     */
+    constexpr const char* STDIO_PATH = "-";
+
+    /**
+     * @brief Image container formats supported by the handler.
+     */
+    enum class ImageFormat {
+        Unknown, ///< Format could not be recognized.
+        PNG,     ///< Portable Network Graphics.
+        BMP,     ///< Windows bitmap.
+        PNM,     ///< Binary Netpbm image (PGM, PPM or PAM).
+        QOI      ///< Quite OK Image (lossless, RGB or RGBA).
+    };
+
     /**
      * @brief Structure for storing image data.
      * 
@@ -21,6 +38,24 @@ namespace ImageHandler {
         std::vector<uint8_t> data; ///< Raw pixel data.
     };
 
+    /**
+     * @brief Image dimensions read from the file header, without decoding the pixels.
+     */
+    struct ImageInfo {
+        int width = 0;              ///< Image width.
+        int height = 0;             ///< Image height.
+        int channels = 0;           ///< Number of color channels in the decoded image.
+        uint64_t encodedBytes = 0;  ///< Size of the file.
+    };
+
+    /**
+     * @brief Checks whether a path refers to the standard input/output stream ("-").
+     * 
+     * @param filename Path to check.
+     * @return true if the path is "-", false otherwise.
+     */
+    bool isStdStream(const std::string& filename);
+
     /**
      * @brief Checks whether a file exists.
      * 
@@ -30,35 +65,101 @@ namespace ImageHandler {
     bool fileExists(const std::string& filename);
 
     /**
-     * @brief Checks if the file format is supported (only BMP and PNG).
+     * @brief Checks if the file format is supported (PNG, BMP, QOI and binary PGM/PPM/PAM).
      * 
      * @param filename Path to the file.
      * @return true if the format is supported, false otherwise.
      */
     bool isSupportedFormat(const std::string& filename);
 
+    /**
+     * @brief Determines the image format from the file extension.
+     * 
+     * @param filename Path to the file.
+     * @return ImageFormat The format, or ImageFormat::Unknown if the extension is not supported.
+     */
+    ImageFormat formatFromExtension(const std::string& filename);
+
+    /**
+     * @brief Determines the image format from the leading magic bytes of an encoded image.
+     * 
+     * @param buffer Pointer to the encoded image bytes.
+     * @param size Number of bytes available in the buffer.
+     * @return ImageFormat The format, or ImageFormat::Unknown if the signature is not recognized.
+     */
+    ImageFormat formatFromMagic(const uint8_t* buffer, size_t size);
+
+    /**
+     * @brief Parses a format name such as "png", "bmp" or "qoi" (case-insensitive).
+     * 
+     * @param name The format name.
+     * @return ImageFormat The format, or ImageFormat::Unknown if the name is not supported.
+     */
+    ImageFormat formatFromName(const std::string& name);
+
+    /**
+     * @brief Reads the dimensions of an image from its header (used to estimate memory before decoding).
+     * 
+     * @param filename Path to a PNG, BMP, QOI or Netpbm file.
+     * @return std::optional<ImageInfo> The dimensions, or std::nullopt for the standard input or an unreadable header.
+     */
+    std::optional<ImageInfo> probeImage(const std::string& filename);
+
     /**
      * @brief Loads an image from a file.
      * 
      * This function verifies the file existence and format before loading the image
-     * and returning it as an `Image` structure.
+     * and returning it as an `Image` structure. If the path is "-", the encoded image
+     * is read from the standard input and its format is recognized by the magic bytes.
      * 
-     * @param filename Path to the image file.
+     * @param filename Path to the image file, or "-" for the standard input.
      * @return Image Loaded image.
      * @throws std::runtime_error If the file does not exist, the format is unsupported, or an error occurs while loading.
      */
     Image loadImage(const std::string& filename);
 
+    /**
+     * @brief Loads an image file like `loadImage`, but reports failures instead of terminating the program.
+     *
+     * Used where one bad file must not stop the process (the --watch mode). The reason is logged.
+     *
+     * @param filename Path to the image file (not the standard input).
+     * @return std::optional<Image> The image, or std::nullopt if the file is missing, unsupported or cannot be decoded.
+     */
+    std::optional<Image> tryLoadImage(const std::string& filename);
+
+    /**
+     * @brief Decodes an image from an in-memory buffer.
+     * 
+     * The format is recognized by the magic bytes, so no file name is needed.
+     * 
+     * @param buffer The encoded image bytes (PNG, BMP or QOI).
+     * @return Image Decoded image.
+     * @throws std::runtime_error If the format is unsupported or the data cannot be decoded.
+     */
+    Image loadImageFromMemory(const std::vector<uint8_t>& buffer);
+
     /**
      * @brief Saves an image to a file.
      * 
-     * The function determines the save format (PNG or BMP) based on the file extension.
+     * The function determines the save format (PNG, BMP, QOI or Netpbm) based on the file extension.
+     * If the path is "-", the image is encoded directly to the standard output in `streamFormat`.
      * 
-     * @param filename Path to the output file.
+     * @param filename Path to the output file, or "-" for the standard output.
      * @param image The `Image` structure containing image data.
+     * @param streamFormat Format used when writing to the standard output.
      * @throws std::runtime_error If the file format is unsupported or an error occurs while saving.
      */
-    void saveImage(const std::string& filename, const Image& image);
+    void saveImage(const std::string& filename, const Image& image, ImageFormat streamFormat = ImageFormat::PNG);
+
+    /**
+     * @brief Saves an image file like `saveImage`, but reports failures instead of terminating the program.
+     *
+     * @param filename Path to the output file (not the standard output).
+     * @param image The `Image` structure containing image data.
+     * @return true on success, false if the extension is unsupported or the file cannot be written (the reason is logged).
+     */
+    bool trySaveImage(const std::string& filename, const Image& image);
 
 } // namespace ImageHandler
 
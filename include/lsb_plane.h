@@ -0,0 +1,114 @@
+#ifndef LSB_PLANE_H
+#define LSB_PLANE_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace Stegano {
+
+    /**
+     * @brief Scattered reads of at least `size / PLANE_READ_DIVISOR` positions go through an `LsbPlane`.
+     *
+     * Building the plane streams the whole carrier once (size / 64 cache lines, prefetched); beyond
+     * that many positions the scattered byte reads would touch more lines than the sequential pass.
+     */
+    constexpr size_t PLANE_READ_DIVISOR = 64;
+
+    /**
+     * @brief Packed bit-plane of the least significant bits of a carrier buffer (bit i = LSB of byte i).
+     *
+     * Embedding, LSB-only noise and extraction only need bit 0 of every byte, so they run on the
+     * plane (1/8 of the carrier, 64 positions per word) instead of loading and storing whole bytes.
+     * The plane is extracted once with `extract` and written back with `merge`, both with SSE2 where
+     * available. The same class serves as a plain bitset of positions (e.g. the payload positions
+     * that the cover noise must skip).
+     */
+    class LsbPlane {
+    public:
+        /**
+         * @brief Creates a plane of `size` zero bits.
+         */
+        explicit LsbPlane(size_t size = 0) : n(size), words((size + 63) / 64, 0) {}
+
+        /**
+         * @brief Packs the LSBs of `size` carrier bytes.
+         *
+         * Large buffers are split into ranges processed by `Parallel::defaultThreadCount()` threads.
+         *
+         * @param data Carrier bytes.
+         * @param size Number of carrier bytes.
+         * @return LsbPlane The packed LSBs.
+         */
+        static LsbPlane extract(const uint8_t* data, size_t size);
+
+        /**
+         * @brief Writes the plane back into bit 0 of the carrier bytes; bits 1..7 are kept.
+         *
+         * @param data Carrier bytes (`size()` of them), modified in place.
+         */
+        void merge(uint8_t* data) const;
+
+        /**
+         * @brief Writes the plane back and applies ±1 cover noise to [begin, end) in one pass.
+         *
+         * `noise[i - begin]` is the noise byte of carrier byte i: the byte is changed when its bits 7..1
+         * are below `threshold` and the position is not set in `skip`; bit 0 chooses +1 or -1 (0 and 255
+         * always move inwards). Changed bytes get their higher bits from the carrier, all others get
+         * bit 0 from the plane.
+         *
+         * @param data Carrier bytes, modified in place.
+         * @param begin First carrier byte, a multiple of 64.
+         * @param end End of the range (at most `size()`).
+         * @param noise Noise bytes for [begin, end).
+         * @param threshold Change threshold in [0, 128] (128 changes every byte).
+         * @param skip Positions that never receive noise (e.g. the payload).
+         */
+        void mergeNoisy(uint8_t* data, size_t begin, size_t end, const uint8_t* noise, unsigned int threshold,
+                        const LsbPlane& skip) const;
+
+        size_t size() const { return n; }                                        ///< Number of bits.
+        size_t wordCount() const { return words.size(); }                        ///< Number of 64-bit words.
+        uint64_t word(size_t index) const { return words[index]; }               ///< Bits [64 * index, 64 * index + 64).
+
+        bool test(size_t position) const { return (words[position >> 6] >> (position & 63)) & 1; }
+        void set(size_t position) { words[position >> 6] |= uint64_t{1} << (position & 63); }
+        void flip(size_t position) { words[position >> 6] ^= uint64_t{1} << (position & 63); }
+
+        /**
+         * @brief `test` that may run while other threads flip other bits of the same word.
+         */
+        bool testShared(size_t position) const {
+#if defined(__GNUC__) || defined(__clang__)
+            return (__atomic_load_n(&words[position >> 6], __ATOMIC_RELAXED) >> (position & 63)) & 1;
+#else
+            return test(position);
+#endif
+        }
+
+        /**
+         * @brief `flip` that may run while other threads flip other bits of the same word.
+         */
+        void flipShared(size_t position) {
+#if defined(__GNUC__) || defined(__clang__)
+            __atomic_fetch_xor(&words[position >> 6], uint64_t{1} << (position & 63), __ATOMIC_RELAXED);
+#elif defined(_MSC_VER)
+            _InterlockedXor64(reinterpret_cast<volatile long long*>(&words[position >> 6]),
+                              static_cast<long long>(uint64_t{1} << (position & 63)));
+#else
+            flip(position);
+#endif
+        }
+
+    private:
+        size_t n;
+        std::vector<uint64_t> words;
+    };
+
+} // namespace Stegano
+
+#endif // LSB_PLANE_H
@@ -0,0 +1,140 @@
+#ifndef MAPPED_IMAGE_H
+#define MAPPED_IMAGE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+#include "image_handler.h"
+
+namespace ImageHandler {
+
+    /**
+     * @brief Uncompressed carrier file (24-bit BMP, binary PGM/PPM or PAM) mapped into memory.
+     *
+     * The pixels are addressed by the same byte positions as the decoded `Image::data`
+     * (top-down rows, RGB channel order), and every position is translated to its offset in the file,
+     * taking the BMP row padding, bottom-up row order and BGR channel order into account. Only the pages
+     * that hold the requested positions are read, so extracting a short payload from a huge
+     * bitmap costs a few megabytes of I/O. A writable mapping modifies the file in place.
+     */
+    class MappedImage {
+    public:
+        /**
+         * @brief Maps a carrier file if its layout is supported.
+         *
+         * @param filename Path to a .bmp, .pgm, .ppm or .pam file.
+         * @param writable Map the file for writing (changes go straight to the file).
+         * @return std::optional<MappedImage> The mapping, or std::nullopt if the file is compressed,
+         * uses an unsupported pixel layout or cannot be mapped.
+         */
+        static std::optional<MappedImage> open(const std::string& filename, bool writable);
+
+        MappedImage(MappedImage&& other) noexcept;
+        MappedImage& operator=(MappedImage&& other) noexcept;
+        MappedImage(const MappedImage&) = delete;
+        MappedImage& operator=(const MappedImage&) = delete;
+        ~MappedImage();
+
+        int width() const { return imageWidth; }
+        int height() const { return imageHeight; }
+        int channels() const { return imageChannels; }
+        int maxValue() const { return sampleMax; }   ///< Largest sample value (Netpbm maxval; 255 for BMP).
+
+        /// Number of carrier bytes, equal to `Image::data.size()` of the decoded image.
+        size_t size() const { return static_cast<size_t>(imageWidth) * imageHeight * imageChannels; }
+
+        /**
+         * @brief Returns the file offset of a carrier byte.
+         *
+         * @param position Index into the decoded pixel data.
+         * @return size_t Offset of the byte in the mapping (`bytes()`).
+         */
+        size_t offsetOf(size_t position) const;
+
+        /**
+         * @brief Replaces every carrier position with its file offset.
+         *
+         * @param positions Indices into the decoded pixel data, converted in place.
+         */
+        void mapPositions(std::vector<size_t>& positions) const;
+
+        const uint8_t* bytes() const { return mapping; }   ///< Start of the mapped file.
+        uint8_t* bytes() { return mapping; }               ///< Start of the mapped file (writable mappings only).
+
+        size_t rowCount() const { return static_cast<size_t>(imageHeight); }                    ///< Pixel rows in the file.
+        size_t rowBytes() const { return static_cast<size_t>(imageWidth) * imageChannels; }     ///< Pixel bytes per row, without padding.
+        size_t fileRowOffset(size_t fileRow) const { return pixelOffset + fileRow * stride; }   ///< Offset of a row in file order.
+        size_t imageRowOffset(size_t y) const { return fileRowOffset(bottomUp ? rowCount() - 1 - y : y); } ///< Offset of a row in image order (top row first).
+
+        /**
+         * @brief Writes back a range of a writable mapping and drops its pages from the resident set.
+         *
+         * Used to keep the memory of long sequential passes bounded: the data stays in the file
+         * (and the page cache), but no longer counts towards the process memory.
+         *
+         * @param offset Start of the range in the mapping.
+         * @param length Length of the range in bytes.
+         */
+        void evict(size_t offset, size_t length);
+
+        /**
+         * @brief Copies the pixels into a decoded image (used where the whole carrier is needed anyway).
+         *
+         * Netpbm samples with a maxval below 255 are scaled to 0..255.
+         *
+         * @return Image The decoded image.
+         */
+        Image toImage() const;
+
+    private:
+        MappedImage() = default;
+        void release();
+
+        int fd = -1;
+        uint8_t* mapping = nullptr;
+        size_t mappingSize = 0;
+        int imageWidth = 0;
+        int imageHeight = 0;
+        int imageChannels = 0;
+        size_t pixelOffset = 0; ///< Offset of the first pixel row in the file.
+        size_t stride = 0;      ///< Bytes per row in the file, including padding.
+        bool bottomUp = false;  ///< Rows are stored from the bottom up (BMP with positive height).
+        bool bgr = false;       ///< Channels are stored as BGR (BMP).
+        int sampleMax = 255;    ///< Netpbm maxval; `toImage` scales smaller ranges to 0..255.
+    };
+
+    /**
+     * @brief Checks whether the file is a Netpbm image (.pgm, .ppm or .pam).
+     *
+     * @param filename Path to the file.
+     * @return true for Netpbm extensions, false otherwise.
+     */
+    bool isNetpbmFile(const std::string& filename);
+
+    /**
+     * @brief Checks whether an embedding can modify a copy of the input in place.
+     *
+     * This is the case when both paths are files with the same extension and the input has a layout
+     * supported by `MappedImage`, so no re-encoding is needed. Netpbm files with a maxval below 255 are
+     * decoded instead, because the noise and the payload write samples up to 255.
+     *
+     * @param inFile Path to the input image.
+     * @param outFile Path to the output image.
+     * @return true if the raw in-place path can be used.
+     */
+    bool canEmbedInPlace(const std::string& inFile, const std::string& outFile);
+
+    /**
+     * @brief Writes an image as binary PGM (1 channel), PPM (3 channels) or PAM (any channel count).
+     *
+     * @param filename Path to the output file; the extension selects the variant.
+     * @param image The image to write.
+     * @return true on success, false if the file cannot be written or the variant cannot hold the channels.
+     */
+    bool writeNetpbm(const std::string& filename, const Image& image);
+
+} // namespace ImageHandler
+
+#endif // MAPPED_IMAGE_H
@@ -0,0 +1,95 @@
+#ifndef MATRIX_EMBEDDING_H
+#define MATRIX_EMBEDDING_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "lsb_plane.h"
+
+namespace Stegano {
+
+    /**
+     * @brief Largest supported Hamming parameter: groups of 2^6 - 1 = 63 positions carry 6 bits.
+     */
+    constexpr uint8_t MAX_MATRIX_K = 6;
+
+    /**
+     * @brief Number of carrier positions needed to carry `messageBits` bits with the (1, 2^k - 1, k) Hamming code.
+     *
+     * @param messageBits Number of payload bits.
+     * @param k Hamming parameter; k = 1 is plain LSB embedding (one bit per position).
+     * @return size_t ceil(messageBits / k) * (2^k - 1).
+     */
+    size_t matrixPositionsNeeded(size_t messageBits, uint8_t k);
+
+    /**
+     * @brief Picks the largest k whose groups still fit into the available positions.
+     *
+     * A larger k changes fewer carrier bytes per payload bit (at most one of 2^k - 1 bytes per group)
+     * but needs more positions, so k follows the payload to capacity ratio.
+     *
+     * @param messageBits Number of payload bits.
+     * @param availablePositions Number of carrier positions left for the payload.
+     * @return uint8_t k in [1, MAX_MATRIX_K]; 1 if no code larger than plain embedding fits.
+     */
+    uint8_t chooseMatrixK(size_t messageBits, size_t availablePositions);
+
+    /**
+     * @brief Embeds a message with matrix embedding (syndrome coding).
+     *
+     * Every group of 2^k - 1 consecutive positions carries k message bits (MSB first) as the syndrome
+     * of its LSBs, so at most one LSB per group is flipped. The syndrome is computed bit-parallel from
+     * the group's LSBs packed into one 64-bit word. Payloads of at least `Parallel::PAYLOAD_CUTOFF_BYTES`
+     * are split into contiguous group ranges processed by `Parallel::defaultThreadCount()` threads.
+     *
+     * @param data Carrier bytes, modified in place.
+     * @param positions Carrier positions, at least `matrixPositionsNeeded(message.size() * 8, k)`.
+     * @param message The payload bytes.
+     * @param k Hamming parameter in [1, MAX_MATRIX_K].
+     * @return size_t Number of carrier bytes that were changed.
+     */
+    size_t matrixEmbed(uint8_t* data, const size_t* positions, const std::vector<uint8_t>& message, uint8_t k);
+
+    /**
+     * @brief `matrixEmbed` on a packed LSB plane: the flips go to the plane bits, the carrier is written by `LsbPlane::merge`.
+     *
+     * When the group ranges run on several threads the flips are atomic word operations.
+     */
+    size_t matrixEmbed(LsbPlane& plane, const size_t* positions, const std::vector<uint8_t>& message, uint8_t k);
+
+    /**
+     * @brief Extracts a message embedded with `matrixEmbed`.
+     *
+     * Large payloads are split like in `matrixEmbed`; every thread writes its own whole output bytes.
+     *
+     * @param data Carrier bytes.
+     * @param positions Carrier positions in the order used when embedding.
+     * @param messageLength Number of payload bytes.
+     * @param k Hamming parameter in [1, MAX_MATRIX_K].
+     * @return std::vector<uint8_t> The payload bytes.
+     */
+    std::vector<uint8_t> matrixExtract(const uint8_t* data, const size_t* positions, size_t messageLength, uint8_t k);
+
+    /**
+     * @brief `matrixExtract` on a packed LSB plane (see `LsbPlane::extract`).
+     */
+    std::vector<uint8_t> matrixExtract(const LsbPlane& plane, const size_t* positions, size_t messageLength, uint8_t k);
+
+    /**
+     * @brief `matrixExtract` over a carrier buffer of known size, choosing how to read the LSBs.
+     *
+     * Sparse positions are read from the bytes directly; once they cover at least
+     * `size / PLANE_READ_DIVISOR` of the carrier, the LSBs are first packed into an `LsbPlane`.
+     *
+     * @param data Carrier bytes.
+     * @param size Number of carrier bytes.
+     * @param positions Carrier positions in the order used when embedding.
+     * @param messageLength Number of payload bytes.
+     * @param k Hamming parameter in [1, MAX_MATRIX_K].
+     * @return std::vector<uint8_t> The payload bytes.
+     */
+    std::vector<uint8_t> matrixExtract(const uint8_t* data, size_t size, const size_t* positions, size_t messageLength, uint8_t k);
+
+} // namespace Stegano
+
+#endif // MATRIX_EMBEDDING_H
@@ -0,0 +1,122 @@
+#ifndef MEMORY_BUDGET_H
+#define MEMORY_BUDGET_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+
+namespace MemoryBudget {
+
+    /**
+     * @brief Sets the memory budget of the process in bytes (the --max-memory option); 0 removes the limit.
+     *
+     * The budget is checked against estimates computed from the carrier header before anything large
+     * is allocated, so a job that cannot fit fails early with a clear error instead of being killed
+     * by the OOM killer halfway through. Every check adds the memory the process already uses
+     * (`residentBytes`), so a budget below the idle footprint of the program (about 10 MiB) refuses every job.
+     */
+    void setLimit(size_t bytes);
+
+    /**
+     * @brief Returns the memory budget in bytes, or 0 if there is no limit.
+     */
+    size_t limit();
+
+    /**
+     * @brief Checks whether an estimated peak fits into the budget on top of the memory in use
+     * (always true without a limit).
+     */
+    bool fits(size_t bytes);
+
+    /**
+     * @brief Terminates the program if an estimated peak does not fit into the budget.
+     *
+     * @param bytes The estimated peak memory.
+     * @param what Short description of the step, used in the error message.
+     * @throws Terminates the program if `bytes` exceeds the budget.
+     */
+    void require(size_t bytes, const std::string& what);
+
+    /**
+     * @brief Returns how many workers fit into the budget.
+     *
+     * @param shared Memory used regardless of the number of workers, besides the memory already in use.
+     * @param perWorker Memory used by every worker.
+     * @param wanted Requested number of workers.
+     * @return unsigned int Between 1 and `wanted`, or 0 if not even one worker fits.
+     */
+    unsigned int fitWorkers(size_t shared, size_t perWorker, unsigned int wanted);
+
+    /**
+     * @brief Parses a size such as "1048576", "512K", "256M" or "2G" (binary units, case-insensitive).
+     *
+     * @param text The size text.
+     * @return std::optional<size_t> The size in bytes, or std::nullopt if the text is not a size.
+     */
+    std::optional<size_t> parseSize(const std::string& text);
+
+    /**
+     * @brief Formats a byte count in MiB for messages.
+     */
+    std::string formatSize(size_t bytes);
+
+    /**
+     * @brief Returns the peak resident set size of the process in bytes (0 if the platform does not report it).
+     */
+    size_t peakResidentBytes();
+
+    /**
+     * @brief Returns the current resident set size of the process in bytes (the peak where the platform
+     * reports no current value).
+     */
+    size_t residentBytes();
+
+    /**
+     * @brief Logs the peak resident set size when the scope ends (put at the top of main).
+     */
+    class PeakReport {
+    public:
+        PeakReport() = default;
+        PeakReport(const PeakReport&) = delete;
+        PeakReport& operator=(const PeakReport&) = delete;
+        ~PeakReport();
+    };
+
+    /**
+     * @brief Estimated peak of decoding an image: the encoded bytes, the decoder's buffers and the
+     * decoded pixels with their copy in `ImageHandler::Image`.
+     *
+     * @param encodedBytes Size of the encoded file.
+     * @param carrierBytes Number of decoded bytes (width * height * channels).
+     */
+    size_t decodeBytes(uint64_t encodedBytes, uint64_t carrierBytes);
+
+    /**
+     * @brief Estimated peak of encoding a decoded image (the pixels, the filtered rows and the compressed output).
+     *
+     * @param carrierBytes Number of decoded bytes.
+     */
+    size_t encodeBytes(uint64_t carrierBytes);
+
+    /**
+     * @brief Estimated peak of embedding into an image carrier without adaptive mode.
+     *
+     * @param encodedBytes Size of the encoded file.
+     * @param carrierBytes Number of decoded bytes.
+     * @param positions Number of payload positions that are generated.
+     * @param inPlace Whether the carrier is modified through a writable mapping instead of being decoded.
+     */
+    size_t embedBytes(uint64_t encodedBytes, uint64_t carrierBytes, size_t positions, bool inPlace);
+
+    /**
+     * @brief Estimated memory of adaptive mode: the cost map and the candidate list of the widest level.
+     *
+     * @param carrierBytes Number of carrier bytes.
+     * @param decoded Whether the carrier is already decoded (otherwise a decoded copy is made for the cost map).
+     */
+    size_t adaptiveBytes(uint64_t carrierBytes, bool decoded);
+
+} // namespace MemoryBudget
+
+#endif // MEMORY_BUDGET_H
@@ -0,0 +1,72 @@
+#ifndef NOISE_MASK_H
+#define NOISE_MASK_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include "stegano.h"
+
+namespace Stegano {
+
+    /**
+     * @brief Keyed cover-noise mask: decides for every carrier position in order whether it is changed and in which direction.
+     *
+     * Every position takes 8 bits of the engine output: the 7 high bits select the position with
+     * probability density / 100, the low bit gives the direction. The mask is a pure function of the key,
+     * the stream and the position order, so carriers processed in independent blocks use one stream per block.
+     */
+    template <typename Engine>
+    class NoiseMask {
+    public:
+        NoiseMask(const std::vector<uint8_t>& key, uint64_t stream, unsigned int density)
+            : rng(key, stream), threshold(std::min(density, MAX_NOISE_DENSITY) * 128 / MAX_NOISE_DENSITY) {}
+
+        // 0 - байт не меняется, иначе направление +1 или -1
+        int next() {
+            if (bytesLeft == 0) {
+                word = rng.next();
+                bytesLeft = 8;
+            }
+            unsigned int bits = static_cast<unsigned int>(word & 0xFF);
+            word >>= 8;
+            bytesLeft--;
+            if ((bits >> 1) >= threshold) return 0;
+            return (bits & 1) ? 1 : -1;
+        }
+
+        // Те же байты движка, что читает next(), подряд для count байтов носителя (см. LsbPlane::mergeNoisy)
+        void fill(uint8_t* out, size_t count) {
+            size_t i = 0;
+            while (i < count) {
+                if (bytesLeft == 0 && count - i >= 8) {
+                    // Целое слово движка - восемь байтов, младший первым
+                    uint64_t value = rng.next();
+                    for (int b = 0; b < 8; b++) {
+                        out[i + b] = static_cast<uint8_t>(value >> (8 * b));
+                    }
+                    i += 8;
+                    continue;
+                }
+                if (bytesLeft == 0) {
+                    word = rng.next();
+                    bytesLeft = 8;
+                }
+                out[i++] = static_cast<uint8_t>(word & 0xFF);
+                word >>= 8;
+                bytesLeft--;
+            }
+        }
+
+        unsigned int changeThreshold() const { return threshold; }
+
+    private:
+        Engine rng;
+        unsigned int threshold;
+        uint64_t word = 0;
+        int bytesLeft = 0;
+    };
+
+} // namespace Stegano
+
+#endif // NOISE_MASK_H
@@ -0,0 +1,110 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+#include <string>
+#include "trace.h"
+
+namespace Parallel {
+
+    /**
+     * @brief Payloads smaller than this many bytes are embedded and extracted on one thread:
+     * below it, starting the workers costs more than the loop itself.
+     */
+    constexpr size_t PAYLOAD_CUTOFF_BYTES = size_t{1} << 16;
+
+    namespace detail {
+        inline unsigned int& configuredThreadCount() {
+            static unsigned int count = 0;
+            return count;
+        }
+    }
+
+    /**
+     * @brief Overrides the number of worker threads returned by `defaultThreadCount` (0 restores the hardware default).
+     */
+    inline void setDefaultThreadCount(unsigned int count) {
+        detail::configuredThreadCount() = count;
+    }
+
+    /**
+     * @brief Returns the number of worker threads to use by default (at least 1).
+     *
+     * This is the value set with `setDefaultThreadCount` (the --threads option), or the number of
+     * hardware threads.
+     */
+    inline unsigned int defaultThreadCount() {
+        if (detail::configuredThreadCount() > 0) return detail::configuredThreadCount();
+        unsigned int count = std::thread::hardware_concurrency();
+        return count == 0 ? 1 : count;
+    }
+
+    /**
+     * @brief Runs `worker(threadIndex)` on `threadCount` threads and waits for all of them.
+     *
+     * The calling thread executes worker 0 itself, so `threadCount == 1` spawns no threads.
+     *
+     * @param threadCount Number of workers (values below 1 are treated as 1).
+     * @param worker Callable taking the worker index in [0, threadCount).
+     */
+    template <typename Worker>
+    void run(unsigned int threadCount, Worker&& worker) {
+        threadCount = std::max(1u, threadCount);
+        std::vector<std::thread> threads;
+        threads.reserve(threadCount - 1);
+        for (unsigned int t = 1; t < threadCount; t++) {
+            threads.emplace_back([&worker, t]() {
+                Trace::nameThread("worker " + std::to_string(t));
+                worker(t);
+            });
+        }
+        worker(0u);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    /**
+     * @brief Returns how many threads `forRanges` uses for the same arguments.
+     *
+     * Lets callers pick a thread-safe variant of the per-range work only when the ranges really run concurrently.
+     */
+    inline size_t rangeThreadCount(size_t count, size_t cutoff, size_t granularity) {
+        granularity = std::max<size_t>(1, granularity);
+        return count < cutoff ? 1 : std::max<size_t>(1, std::min<size_t>(defaultThreadCount(), (count + granularity - 1) / granularity));
+    }
+
+    /**
+     * @brief Splits [0, count) into contiguous ranges and runs `fn(begin, end)` for each on its own thread.
+     *
+     * Range boundaries are multiples of `granularity`, so workers that write packed output (e.g. bits
+     * into bytes) never share an output byte. Below `cutoff` items everything runs on the calling thread.
+     *
+     * @param count Number of items.
+     * @param cutoff Smallest count that is split across threads.
+     * @param granularity Range boundaries are multiples of this value (at least 1).
+     * @param fn Callable taking the half-open item range [begin, end).
+     */
+    template <typename Fn>
+    void forRanges(size_t count, size_t cutoff, size_t granularity, Fn&& fn) {
+        granularity = std::max<size_t>(1, granularity);
+        size_t threadCount = rangeThreadCount(count, cutoff, granularity);
+        if (threadCount <= 1) {
+            if (count > 0) fn(size_t{0}, count);
+            return;
+        }
+        size_t chunk = (count + threadCount - 1) / threadCount;
+        chunk = (chunk + granularity - 1) / granularity * granularity;
+        run(static_cast<unsigned int>(threadCount), [&](unsigned int t) {
+            size_t begin = std::min(count, t * chunk);
+            size_t end = std::min(count, begin + chunk);
+            if (begin < end) fn(begin, end);
+        });
+    }
+
+} // namespace Parallel
+
+#endif // PARALLEL_H
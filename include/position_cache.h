@@ -0,0 +1,112 @@
+#ifndef POSITION_CACHE_H
+#define POSITION_CACHE_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <shared_mutex>
+#include <unordered_map>
+#include "rng_engines.h"
+
+namespace Stegano {
+
+    /**
+     * @brief Counters of the position cache of this process.
+     */
+    struct PositionCacheStats {
+        uint64_t memoryHits = 0;   ///< Lookups answered from memory.
+        uint64_t fileHits = 0;     ///< Lookups answered by a mapped entry of the cache directory.
+        uint64_t misses = 0;       ///< Lookups that generated the positions.
+        uint64_t evictions = 0;    ///< Entries dropped from memory to stay within the limit.
+        size_t entries = 0;        ///< Entries held in memory.
+        uint64_t bytes = 0;        ///< Bytes of the positions held in memory.
+
+        uint64_t lookups() const { return memoryHits + fileHits + misses; }
+        double hitRate() const { return lookups() ? static_cast<double>(memoryHits + fileHits) / lookups() : 0.0; }
+    };
+
+    /**
+     * @brief Process-wide cache of position-stream prefixes (the --position-cache options).
+     *
+     * The first `count` positions of `PositionStream(n, key, engine, stream)` depend on nothing else, so
+     * a batch that embeds with one key into many carriers of the same size shuffles the same prefix for
+     * every file. The cache keeps the longest prefix generated so far under SHA-256 of these values (the
+     * key itself is not kept) and answers every request that is not longer by copying it. Positions are
+     * stored as 32-bit values when n fits, as 64-bit values otherwise. The entries in memory are bounded
+     * by a byte limit with least-recently-used eviction. Lookups hold a shared lock only to find the entry
+     * and copy outside of it, so the workers of a pool query the cache concurrently (two workers that
+     * miss the same prefix both generate it).
+     *
+     * With a directory every generated prefix is also written there and later lookups map the file, so
+     * separate processes share the entries; the directory has the same byte limit and follows
+     * `CacheDirectory`. A cached prefix reveals the embedding positions of its key: the directory must
+     * be kept as private as the key.
+     */
+    class PositionCache {
+    public:
+        /**
+         * @brief Returns the cache of the process (disabled until `configure` is called).
+         */
+        static PositionCache& instance();
+
+        /**
+         * @brief Enables the cache; the entries already in memory are dropped.
+         *
+         * @param limit Maximum bytes of positions in memory and in the directory (0 disables the cache).
+         * @param directory Directory of the mapped entries (empty - memory only).
+         */
+        void configure(uint64_t limit, const std::string& directory);
+
+        bool enabled() const { return limit > 0; }
+
+        /**
+         * @brief Returns the first `count` positions of `PositionStream(n, key, engine, stream)`.
+         *
+         * Without the cache the positions are generated directly.
+         *
+         * @param n Number of carrier positions.
+         * @param key A binary key used to seed the engine.
+         * @param engine The generator engine.
+         * @param stream Seed stream selector (see `deriveEngineSeed`).
+         * @param count Number of positions.
+         * @return std::vector<size_t> The positions, identical to `PositionStream::take(count)`.
+         * @throws Terminates the program if count is greater than n.
+         */
+        std::vector<size_t> take(size_t n, const std::vector<uint8_t>& key, EngineId engine, uint64_t stream, size_t count);
+
+        /**
+         * @brief Returns the counters of this process.
+         */
+        PositionCacheStats stats() const;
+
+        /**
+         * @brief Logs the counters and the hit rate (nothing if the cache is disabled or unused).
+         */
+        void logStats() const;
+
+    private:
+        struct Prefix;
+
+        PositionCache() = default;
+        std::shared_ptr<Prefix> loadFile(const std::string& name, size_t n, EngineId engine, uint64_t stream);
+        void storeFile(const std::string& name, const Prefix& prefix, EngineId engine, uint64_t stream);
+        void insert(const std::string& name, std::shared_ptr<Prefix> prefix);
+
+        uint64_t limit = 0;
+        std::string directory;
+        mutable std::shared_mutex mutex;
+        std::unordered_map<std::string, std::shared_ptr<Prefix>> entries;
+        uint64_t bytes = 0;                     ///< Bytes of `entries`, guarded by `mutex`.
+        std::atomic<uint64_t> clock{0};         ///< Lookup counter that orders the entries by last use.
+        std::atomic<uint64_t> memoryHits{0};
+        std::atomic<uint64_t> fileHits{0};
+        std::atomic<uint64_t> misses{0};
+        std::atomic<uint64_t> evictions{0};
+    };
+
+} // namespace Stegano
+
+#endif // POSITION_CACHE_H
@@ -0,0 +1,301 @@
+#ifndef POSITION_STREAM_H
+#define POSITION_STREAM_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <variant>
+#include <cstdlib>
+#include <unordered_map>
+#include "rng_engines.h"
+#include "external/logger.h"
+
+namespace Stegano {
+
+    /**
+     * @brief Lazy key-driven permutation of the carrier positions [0, n), templated on the engine.
+     *
+     * Positions are produced by a forward Fisher-Yates shuffle with `uniformBelow` as the range
+     * reduction, so the sequence is fully specified and identical on every platform, and the i-th
+     * position is final as soon as it is produced: a prefix of the permutation can be read without
+     * shuffling the whole carrier. While only a small prefix is requested the swaps are kept in a
+     * sparse map; once the map grows large the stream switches to a dense index vector. Both
+     * representations produce the same sequence.
+     */
+    template <typename Engine>
+    class BasicPositionStream {
+    public:
+        /**
+         * @brief Creates a position stream over [0, n) seeded by the key.
+         *
+         * @param n Number of carrier positions (bytes).
+         * @param key A binary key used to seed the engine.
+         * @param stream Seed stream selector (see `deriveEngineSeed`).
+         */
+        BasicPositionStream(size_t n, const std::vector<uint8_t>& key, uint64_t stream = POSITION_STREAM)
+            : n(n), engine(key, stream) {}
+
+        /**
+         * @brief Returns the next position of the permutation.
+         *
+         * Must not be called when `remaining()` is zero.
+         *
+         * @return size_t The next position.
+         */
+        size_t next() {
+            // Прямой Фишер-Йейтс: позиция cursor меняется местами со случайной из [cursor, n)
+            size_t j = cursor + static_cast<size_t>(uniformBelow(engine, n - cursor));
+
+            size_t result;
+            if (dense) {
+                std::swap(indices[cursor], indices[j]);
+                result = indices[cursor];
+            } else {
+                result = valueAt(j);
+                if (j != cursor) {
+                    swapped[j] = valueAt(cursor);
+                }
+                swapped.erase(cursor); // позиция cursor больше не читается
+                if (swapped.size() > n / DENSE_SWITCH_DIVISOR) {
+                    switchToDense();
+                    indices[cursor] = result;
+                }
+            }
+            cursor++;
+            return result;
+        }
+
+        /**
+         * @brief Returns the next `count` positions of the permutation.
+         *
+         * @param count Number of positions to produce.
+         * @return std::vector<size_t> The produced positions.
+         * @throws Terminates the program if fewer than `count` positions remain.
+         */
+        std::vector<size_t> take(size_t count) {
+            if (count > remaining()) {
+                LOG_ERROR("Not enough carrier positions left in the stream: {} requested, {} remain", count, remaining());
+                exit(EXIT_FAILURE);
+            }
+            if (!dense && count > n / DENSE_SWITCH_DIVISOR) {
+                switchToDense();
+            }
+            std::vector<size_t> positions(count);
+            for (size_t i = 0; i < count; i++) {
+                positions[i] = next();
+            }
+            return positions;
+        }
+
+        /**
+         * @brief Returns all positions that have not been produced yet.
+         *
+         * @return std::vector<size_t> The remaining positions, in stream order.
+         */
+        std::vector<size_t> takeRest() { return take(remaining()); }
+
+        size_t size() const { return n; }                 ///< Total number of positions.
+        size_t produced() const { return cursor; }        ///< Number of positions already produced.
+        size_t remaining() const { return n - cursor; }   ///< Number of positions not produced yet.
+
+        /**
+         * @brief Estimates the peak heap use of the stream state while producing `count` of `n` positions.
+         *
+         * @param n Number of carrier positions.
+         * @param count Number of positions to produce.
+         * @return size_t Bytes held by the sparse map or the dense index vector.
+         */
+        static size_t memoryEstimate(size_t n, size_t count) {
+            if (count <= n / DENSE_SWITCH_DIVISOR) return count * SPARSE_ENTRY_BYTES;
+            return n * sizeof(size_t) + (n / DENSE_SWITCH_DIVISOR) * SPARSE_ENTRY_BYTES;
+        }
+
+    private:
+        // Когда разреженная карта становится больше этой доли от n, выгоднее плотный массив
+        static constexpr size_t DENSE_SWITCH_DIVISOR = 16;
+        // Узел unordered_map<size_t, size_t> с указателем корзины
+        static constexpr size_t SPARSE_ENTRY_BYTES = 48;
+
+        size_t valueAt(size_t index) const {
+            if (dense) return indices[index];
+            auto it = swapped.find(index);
+            return it == swapped.end() ? index : it->second;
+        }
+
+        void switchToDense() {
+            indices.resize(n);
+            for (size_t i = 0; i < n; i++) {
+                indices[i] = i;
+            }
+            for (const auto& [index, value] : swapped) {
+                indices[index] = value;
+            }
+            swapped.clear();
+            dense = true;
+        }
+
+        size_t n;
+        size_t cursor = 0;
+        Engine engine;
+        bool dense = false;
+        std::unordered_map<size_t, size_t> swapped; ///< Sparse form: entries that differ from identity.
+        std::vector<size_t> indices;                ///< Dense form: the full index array.
+    };
+
+    /**
+     * @brief Position stream whose engine is chosen at run time (e.g. from the container header).
+     *
+     * The stream either permutes all carrier bytes [0, n) or, for adaptive embedding, a list of
+     * candidate bytes: then the permutation runs over [0, candidates.size()) and every produced
+     * index is mapped through the list. Positions registered with `exclude` (e.g. the header
+     * positions taken from another stream) are skipped.
+     */
+    class PositionStream {
+    public:
+        /**
+         * @brief Creates a position stream over [0, n) seeded by the key.
+         *
+         * @param n Number of carrier positions (bytes).
+         * @param key A binary key used to seed the engine.
+         * @param engine The generator engine.
+         * @param stream Seed stream selector (see `deriveEngineSeed`).
+         */
+        PositionStream(size_t n, const std::vector<uint8_t>& key, EngineId engine = DEFAULT_ENGINE, uint64_t stream = POSITION_STREAM);
+
+        /**
+         * @brief Creates a position stream over a list of candidate carrier bytes.
+         *
+         * @param candidates The carrier bytes that may be used, shared read-only with the caller.
+         * @param key A binary key used to seed the engine.
+         * @param engine The generator engine.
+         * @param stream Seed stream selector (see `deriveEngineSeed`).
+         */
+        PositionStream(std::shared_ptr<const std::vector<size_t>> candidates, const std::vector<uint8_t>& key,
+                       EngineId engine = DEFAULT_ENGINE, uint64_t stream = ADAPTIVE_STREAM);
+
+        /**
+         * @brief Makes the stream skip the given carrier positions from now on.
+         *
+         * @param positions Carrier positions that are already used elsewhere.
+         */
+        void exclude(std::vector<size_t> positions);
+
+        size_t next();
+        std::vector<size_t> take(size_t count);
+        std::vector<size_t> takeRest();
+
+        size_t size() const { return std::visit([](const auto& s) { return s.size(); }, impl); }
+        size_t produced() const { return std::visit([](const auto& s) { return s.produced(); }, impl); }
+        /// Number of positions that can still be produced (excluded positions are subtracted conservatively).
+        size_t remaining() const {
+            size_t left = std::visit([](const auto& s) { return s.remaining(); }, impl);
+            return left > excluded.size() ? left - excluded.size() : 0;
+        }
+        EngineId engine() const { return engineId; } ///< Engine that generates the positions.
+
+        /**
+         * @brief Estimates the heap use of taking `count` positions out of `n`: the stream state plus
+         * the returned position vector.
+         */
+        static size_t memoryEstimate(size_t n, size_t count) {
+            return BasicPositionStream<Xoshiro256StarStar>::memoryEstimate(n, count) + count * sizeof(size_t);
+        }
+
+    private:
+        size_t map(size_t index) const { return candidates ? (*candidates)[index] : index; }
+        bool isExcluded(size_t position) const;
+        size_t rawRemaining() const { return std::visit([](const auto& s) { return s.remaining(); }, impl); }
+
+        EngineId engineId;
+        std::shared_ptr<const std::vector<size_t>> candidates; ///< Null when all bytes are candidates.
+        std::vector<size_t> excluded;                          ///< Sorted positions to skip.
+        std::variant<BasicPositionStream<Xoshiro256StarStar>, BasicPositionStream<ChaCha20Engine>> impl;
+    };
+
+    /**
+     * @brief Random-access keyed permutation of the carrier positions [0, n).
+     *
+     * The counterpart of `PositionStream` for payloads that are read piecewise: the i-th position is
+     * computed directly, without producing the ones before it, so the positions of any part of a large
+     * message cost as much as the part itself. The permutation is a balanced Feistel network over the
+     * smallest even power of two that covers n, with cycle walking back into [0, n); the engine only
+     * draws the round keys. Like `PositionStream`, it can also permute a list of candidate bytes.
+     */
+    class IndexedPositions {
+    public:
+        /**
+         * @brief Creates a permutation of [0, n) keyed by `key`.
+         *
+         * @param n Number of carrier positions (bytes).
+         * @param key A binary key used to seed the engine.
+         * @param engine The generator engine that draws the round keys.
+         * @param stream Seed stream selector (see `deriveEngineSeed`).
+         */
+        IndexedPositions(size_t n, const std::vector<uint8_t>& key, EngineId engine = DEFAULT_ENGINE, uint64_t stream = INDEXED_STREAM);
+
+        /**
+         * @brief Creates a permutation of a list of candidate carrier bytes.
+         *
+         * @param candidates The carrier bytes that may be used, shared read-only with the caller.
+         * @param key A binary key used to seed the engine.
+         * @param engine The generator engine that draws the round keys.
+         * @param stream Seed stream selector (see `deriveEngineSeed`).
+         */
+        IndexedPositions(std::shared_ptr<const std::vector<size_t>> candidates, const std::vector<uint8_t>& key,
+                         EngineId engine = DEFAULT_ENGINE, uint64_t stream = INDEXED_ADAPTIVE_STREAM);
+
+        /**
+         * @brief Returns the carrier position with permutation index `index` (must be below `size()`).
+         */
+        size_t at(size_t index) const {
+            // Циклический обход: выход за [0, n) шифруется ещё раз, пока не попадёт в диапазон
+            uint64_t value = index;
+            do {
+                value = permute(value);
+            } while (value >= n);
+            return candidates ? (*candidates)[value] : static_cast<size_t>(value);
+        }
+
+        /**
+         * @brief Returns the positions with indices [begin, begin + count); large ranges are computed in parallel.
+         *
+         * @throws Terminates the program if the range does not fit into the permutation.
+         */
+        std::vector<size_t> range(size_t begin, size_t count) const;
+
+        size_t size() const { return n; } ///< Number of permuted positions.
+        EngineId engine() const { return engineId; } ///< Engine that drew the round keys.
+
+    private:
+        static constexpr int ROUNDS = 6;
+
+        uint64_t permute(uint64_t value) const {
+            uint64_t left = value >> halfBits;
+            uint64_t right = value & halfMask;
+            for (int round = 0; round < ROUNDS; round++) {
+                uint64_t mixed = left ^ (mix(right ^ roundKeys[round]) & halfMask);
+                left = right;
+                right = mixed;
+            }
+            return (left << halfBits) | right;
+        }
+
+        // Финализатор splitmix64: каждый бит входа влияет на все биты выхода
+        static uint64_t mix(uint64_t x) {
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+            return x ^ (x >> 31);
+        }
+
+        size_t n;
+        EngineId engineId;
+        std::shared_ptr<const std::vector<size_t>> candidates; ///< Null when all bytes are candidates.
+        unsigned int halfBits = 0;
+        uint64_t halfMask = 0;
+        uint64_t roundKeys[ROUNDS] = {};
+    };
+
+} // namespace Stegano
+
+#endif // POSITION_STREAM_H
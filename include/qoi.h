@@ -0,0 +1,79 @@
+#ifndef QOI_H
+#define QOI_H
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+#include "image_handler.h"
+
+namespace ImageHandler {
+
+    /**
+     * @brief Size of the QOI file header ("qoif", width, height, channels, colorspace).
+     */
+    constexpr size_t QOI_HEADER_SIZE = 14;
+
+    /**
+     * @brief Checks whether the file has the .qoi extension.
+     *
+     * @param filename Path to the file.
+     * @return true for .qoi files, false otherwise.
+     */
+    bool isQoiFile(const std::string& filename);
+
+    /**
+     * @brief Parses a QOI header.
+     *
+     * @param header The first bytes of the file.
+     * @param size Number of bytes available (at least QOI_HEADER_SIZE are needed).
+     * @return std::optional<ImageInfo> The dimensions (`encodedBytes` is left 0), or std::nullopt if the
+     * magic, the channel count (3 or 4) or the dimensions are invalid.
+     */
+    std::optional<ImageInfo> parseQoiHeader(const uint8_t* header, size_t size);
+
+    /**
+     * @brief Decodes a QOI image from a stream, reading it in fixed-size chunks.
+     *
+     * Only the decoded pixels are held in memory, never the whole encoded file. When the stream is
+     * seekable, a header that declares more pixels than the rest of the file can encode is rejected
+     * before the pixel buffer is allocated, and so is one whose pixels exceed the memory budget.
+     *
+     * @param in The input stream, positioned at the header.
+     * @return std::optional<Image> The image, or std::nullopt if the data is invalid or truncated.
+     */
+    std::optional<Image> readQoi(FILE* in);
+
+    /**
+     * @brief Decodes a QOI image from an in-memory buffer.
+     *
+     * @param buffer Pointer to the encoded image.
+     * @param size Number of bytes in the buffer.
+     * @return std::optional<Image> The image, or std::nullopt if the data is invalid or truncated, or if
+     * the header declares more pixels than `size` bytes can encode or than the memory budget allows.
+     */
+    std::optional<Image> decodeQoi(const uint8_t* buffer, size_t size);
+
+    /**
+     * @brief Encodes an RGB or RGBA image as QOI into a stream through a fixed-size output buffer.
+     *
+     * @param out The output stream.
+     * @param image The image to write (3 or 4 channels).
+     * @return true on success, false if the channel count is not supported or the stream fails.
+     */
+    bool writeQoi(FILE* out, const Image& image);
+
+    /**
+     * @brief Encodes an RGB or RGBA image as a QOI file.
+     *
+     * @param filename Path to the output file.
+     * @param image The image to write (3 or 4 channels).
+     * @return true on success, false if the channel count is not supported or the file cannot be written.
+     */
+    bool writeQoi(const std::string& filename, const Image& image);
+
+} // namespace ImageHandler
+
+#endif // QOI_H
@@ -0,0 +1,238 @@
+#ifndef RNG_ENGINES_H
+#define RNG_ENGINES_H
+
+#include <array>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+
+namespace Stegano {
+
+    /**
+     * @brief Identifiers of the position-generator engines, as stored in the container header.
+     *
+     * The values are part of the embedded format and must never be renumbered.
+     */
+    enum class EngineId : uint8_t {
+        Xoshiro256StarStar = 1, ///< xoshiro256** (fast, 32 bytes of state).
+        ChaCha20           = 2  ///< ChaCha20 keystream (cryptographic strength).
+    };
+
+    /**
+     * @brief All engines known to this build, in the order the extractor tries them.
+     */
+    constexpr EngineId ALL_ENGINES[] = { EngineId::Xoshiro256StarStar, EngineId::ChaCha20 };
+
+    /**
+     * @brief Engine used for embedding when none is specified.
+     */
+    constexpr EngineId DEFAULT_ENGINE = EngineId::Xoshiro256StarStar;
+
+    /**
+     * @brief Returns the command-line name of an engine ("xoshiro" or "chacha").
+     */
+    const char* engineName(EngineId engine);
+
+    /**
+     * @brief Parses an engine name as accepted by `--engine`.
+     *
+     * @param name "xoshiro" or "chacha" (case-insensitive).
+     * @return std::optional<EngineId> The engine, or std::nullopt if the name is unknown.
+     */
+    std::optional<EngineId> engineFromName(const std::string& name);
+
+    /**
+     * @brief Derives the 32-byte engine seed as SHA-256(stream as 8 little-endian bytes || key).
+     *
+     * Different `stream` values give independent generators for the same key
+     * (0 - positions, 1 - cover noise, 2 - adaptive positions, 3 and 4 - round keys of the indexed
+     * permutations, 2^32 and above - video frames, 2^48 and above - noise of audio blocks).
+     *
+     * @param key The steganographic key.
+     * @param stream Stream selector.
+     * @return std::array<uint8_t, 32> The seed.
+     */
+    std::array<uint8_t, 32> deriveEngineSeed(const std::vector<uint8_t>& key, uint64_t stream);
+
+    /**
+     * @brief Stream selectors for `deriveEngineSeed`.
+     */
+    constexpr uint64_t POSITION_STREAM = 0;
+    constexpr uint64_t NOISE_STREAM    = 1;
+    constexpr uint64_t ADAPTIVE_STREAM = 2;
+    constexpr uint64_t INDEXED_STREAM  = 3;
+    constexpr uint64_t INDEXED_ADAPTIVE_STREAM = 4;
+
+    /**
+     * @brief Video frames use their own pair of streams: positions at FRAME_STREAM_BASE + 2 * frame,
+     * noise right after it, so every frame is shuffled independently of the others.
+     */
+    constexpr uint64_t FRAME_STREAM_BASE = uint64_t{1} << 32;
+    constexpr uint64_t framePositionStream(uint64_t frame) { return FRAME_STREAM_BASE + 2 * frame; }
+    constexpr uint64_t frameNoiseStream(uint64_t frame) { return FRAME_STREAM_BASE + 2 * frame + 1; }
+
+    /**
+     * @brief Blocks of a streamed audio carrier get their own noise stream at AUDIO_NOISE_STREAM_BASE + block,
+     * so the blocks can be processed in parallel; the positions stay on the usual streams.
+     */
+    constexpr uint64_t AUDIO_NOISE_STREAM_BASE = uint64_t{1} << 48;
+    constexpr uint64_t audioNoiseStream(uint64_t block) { return AUDIO_NOISE_STREAM_BASE + block; }
+
+    namespace detail {
+        inline uint64_t loadLE64(const uint8_t* bytes) {
+            uint64_t value = 0;
+            for (int i = 7; i >= 0; i--) value = (value << 8) | bytes[i];
+            return value;
+        }
+
+        inline uint32_t loadLE32(const uint8_t* bytes) {
+            return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+                   (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+        }
+
+        inline uint64_t rotl64(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+        inline uint32_t rotl32(uint32_t x, int k) { return (x << k) | (x >> (32 - k)); }
+
+        // Полное 128-битное произведение a*b: возвращает старшие 64 бита, младшие - в low
+        inline uint64_t mulWide(uint64_t a, uint64_t b, uint64_t& low) {
+#if defined(__SIZEOF_INT128__)
+            unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+            low = static_cast<uint64_t>(product);
+            return static_cast<uint64_t>(product >> 64);
+#else
+            uint64_t aLo = a & 0xFFFFFFFFu, aHi = a >> 32;
+            uint64_t bLo = b & 0xFFFFFFFFu, bHi = b >> 32;
+            uint64_t ll = aLo * bLo, lh = aLo * bHi, hl = aHi * bLo, hh = aHi * bHi;
+            uint64_t middle = (ll >> 32) + (lh & 0xFFFFFFFFu) + (hl & 0xFFFFFFFFu);
+            low = (middle << 32) | (ll & 0xFFFFFFFFu);
+            return hh + (lh >> 32) + (hl >> 32) + (middle >> 32);
+#endif
+        }
+    } // namespace detail
+
+    /**
+     * @brief xoshiro256** 1.0 by Blackman and Vigna, seeded with four little-endian words of the seed.
+     */
+    class Xoshiro256StarStar {
+    public:
+        static constexpr EngineId ID = EngineId::Xoshiro256StarStar;
+
+        Xoshiro256StarStar(const std::vector<uint8_t>& key, uint64_t stream)
+            : Xoshiro256StarStar(deriveEngineSeed(key, stream)) {}
+
+        explicit Xoshiro256StarStar(const std::array<uint8_t, 32>& seed) {
+            for (int i = 0; i < 4; i++) state[i] = detail::loadLE64(seed.data() + 8 * i);
+            if ((state[0] | state[1] | state[2] | state[3]) == 0) state[0] = 1; // нулевое состояние запрещено
+        }
+
+        uint64_t next() {
+            const uint64_t result = detail::rotl64(state[1] * 5, 7) * 9;
+            const uint64_t t = state[1] << 17;
+            state[2] ^= state[0];
+            state[3] ^= state[1];
+            state[1] ^= state[2];
+            state[0] ^= state[3];
+            state[2] ^= t;
+            state[3] = detail::rotl64(state[3], 45);
+            return result;
+        }
+
+    private:
+        uint64_t state[4];
+    };
+
+    /**
+     * @brief ChaCha20 (RFC 8439 block function, 64-bit counter, zero nonce) used as a keystream generator.
+     *
+     * The seed is the 256-bit ChaCha key; each 64-byte block yields eight little-endian 64-bit outputs.
+     */
+    class ChaCha20Engine {
+    public:
+        static constexpr EngineId ID = EngineId::ChaCha20;
+
+        ChaCha20Engine(const std::vector<uint8_t>& key, uint64_t stream)
+            : ChaCha20Engine(deriveEngineSeed(key, stream)) {}
+
+        explicit ChaCha20Engine(const std::array<uint8_t, 32>& seed) {
+            input[0] = 0x61707865; input[1] = 0x3320646e; input[2] = 0x79622d32; input[3] = 0x6b206574;
+            for (int i = 0; i < 8; i++) input[4 + i] = detail::loadLE32(seed.data() + 4 * i);
+            input[12] = input[13] = input[14] = input[15] = 0;
+        }
+
+        uint64_t next() {
+            if (available == 0) refill();
+            const size_t word = 2 * (8 - available--);
+            return static_cast<uint64_t>(block[word]) | (static_cast<uint64_t>(block[word + 1]) << 32);
+        }
+
+    private:
+        void refill() {
+            uint32_t x[16];
+            for (int i = 0; i < 16; i++) x[i] = input[i];
+            for (int round = 0; round < 10; round++) {
+                quarterRound(x, 0, 4, 8, 12); quarterRound(x, 1, 5, 9, 13);
+                quarterRound(x, 2, 6, 10, 14); quarterRound(x, 3, 7, 11, 15);
+                quarterRound(x, 0, 5, 10, 15); quarterRound(x, 1, 6, 11, 12);
+                quarterRound(x, 2, 7, 8, 13); quarterRound(x, 3, 4, 9, 14);
+            }
+            for (int i = 0; i < 16; i++) block[i] = x[i] + input[i];
+            if (++input[12] == 0) ++input[13];
+            available = 8;
+        }
+
+        static void quarterRound(uint32_t* x, int a, int b, int c, int d) {
+            x[a] += x[b]; x[d] = detail::rotl32(x[d] ^ x[a], 16);
+            x[c] += x[d]; x[b] = detail::rotl32(x[b] ^ x[c], 12);
+            x[a] += x[b]; x[d] = detail::rotl32(x[d] ^ x[a], 8);
+            x[c] += x[d]; x[b] = detail::rotl32(x[b] ^ x[c], 7);
+        }
+
+        uint32_t input[16];
+        uint32_t block[16];
+        size_t available = 0;
+    };
+
+    /**
+     * @brief Returns a uniform value in [0, bound) using Lemire's multiply-and-reject method.
+     *
+     * Unlike std::uniform_int_distribution the algorithm is fully specified, so every standard
+     * library produces the same sequence for the same engine output.
+     *
+     * @param engine Engine providing 64-bit outputs.
+     * @param bound Exclusive upper bound, must be greater than zero.
+     */
+    template <typename Engine>
+    uint64_t uniformBelow(Engine& engine, uint64_t bound) {
+        uint64_t low;
+        uint64_t high = detail::mulWide(engine.next(), bound, low);
+        if (low < bound) {
+            const uint64_t threshold = (0 - bound) % bound;
+            while (low < threshold) {
+                high = detail::mulWide(engine.next(), bound, low);
+            }
+        }
+        return high;
+    }
+
+    /**
+     * @brief Calls `fn` with a null `Engine*` tag for the engine type selected at run time.
+     *
+     * Lets code templated on the engine be dispatched from an `EngineId` read from a header:
+     * `withEngine(id, [&](auto* tag) { using Engine = std::remove_pointer_t<decltype(tag)>; ... })`.
+     */
+    template <typename Fn>
+    decltype(auto) withEngine(EngineId engine, Fn&& fn) {
+        switch (engine) {
+            case EngineId::ChaCha20:
+                return fn(static_cast<ChaCha20Engine*>(nullptr));
+            case EngineId::Xoshiro256StarStar:
+            default:
+                return fn(static_cast<Xoshiro256StarStar*>(nullptr));
+        }
+    }
+
+} // namespace Stegano
+
+#endif // RNG_ENGINES_H
@@ -0,0 +1,64 @@
+#ifndef STEGANALYSIS_H
+#define STEGANALYSIS_H
+
+#include <cstdint>
+#include <cstddef>
+#include "image_handler.h"
+#include "mapped_image.h"
+
+namespace Stegano {
+
+    /**
+     * @brief Results of the LSB steganalysis self-check.
+     *
+     * The rates are estimated fractions of carrier bytes whose LSB carries a message (0 - clean,
+     * 1 - every byte). They target LSB replacement, which is how payload bits are written; the ±1
+     * cover noise is LSB matching and barely moves them.
+     */
+    struct SteganalysisReport {
+        double chiSquareP = 0.0; ///< Chi-square pair-of-values test: probability that the LSBs are randomized (close to 1 is suspicious).
+        double rsRate = 0.0;     ///< RS analysis estimate of the embedding rate.
+        double spaRate = 0.0;    ///< Sample pair analysis estimate of the embedding rate.
+        size_t samples = 0;      ///< Number of analysed carrier bytes.
+
+        /// Combined estimate: the mean of the RS and SPA estimates.
+        double embeddingRate() const { return (rsRate + spaRate) / 2.0; }
+    };
+
+    /**
+     * @brief Runs the chi-square, RS and sample pair analyses over a decoded image in one pass.
+     *
+     * Rows are split into bands processed by `threadCount` threads. Within a band the byte histogram,
+     * the sample-pair classes of horizontally adjacent samples of the same channel and the RS groups
+     * (four adjacent samples of one channel, mask 0110) are counted; the pair and group kernels use
+     * SSE2 where available. The pass reads the image once and allocates only per-row scratch buffers.
+     *
+     * @param image The decoded image.
+     * @param threadCount Number of worker threads.
+     * @return SteganalysisReport The test results.
+     */
+    SteganalysisReport analyzeImage(const ImageHandler::Image& image, unsigned int threadCount);
+
+    /**
+     * @brief Runs the same analyses over a mapped raw carrier without copying it.
+     *
+     * The statistics use only horizontal neighbours within one channel, so the file row order
+     * and the BGR channel order of BMP files do not change the results.
+     *
+     * @param image The mapped carrier.
+     * @param threadCount Number of worker threads.
+     * @return SteganalysisReport The test results.
+     */
+    SteganalysisReport analyzeImage(const ImageHandler::MappedImage& image, unsigned int threadCount);
+
+    /**
+     * @brief Writes a human-readable report to the standard error stream.
+     *
+     * @param report The analysis results.
+     * @param what Short description of the analysed image, e.g. "the output image".
+     */
+    void printSteganalysisReport(const SteganalysisReport& report, const char* what);
+
+} // namespace Stegano
+
+#endif // STEGANALYSIS_H
@@ -4,23 +4,219 @@
 #include <vector>
 #include <cstdint>
 #include "image_handler.h"
+#include "mapped_image.h"
+#include "position_stream.h"
+#include "cost_map.h"
+#include "lsb_plane.h"
 #include "external/logger.h"
 
 namespace Stegano {
 
+    /**
+     * @brief Highest cover noise density in percent: every unused carrier byte is changed.
+     */
+    constexpr unsigned int MAX_NOISE_DENSITY = 100;
+
+    /**
+     * @brief Parameters of an embedding that the extractor recovers from the header.
+     */
+    struct EmbedOptions {
+        EngineId engine = DEFAULT_ENGINE;  ///< Generator engine for positions and noise.
+        uint8_t adaptiveLevel = 0;         ///< 0 - uniform positions, 1..MAX_ADAPTIVE_LEVEL - textured bytes only.
+        uint8_t matrixK = 1;               ///< Hamming parameter for the bytes after the header (1 - plain LSB embedding).
+        size_t headerBytes = 0;            ///< Leading message bytes embedded plainly (and on the uniform stream in adaptive mode).
+        const std::vector<uint8_t>* costMap = nullptr; ///< Precomputed cost map for adaptive mode (computed if null).
+        unsigned int noiseDensity = MAX_NOISE_DENSITY; ///< Share of unused bytes (in percent) that receive cover noise.
+        bool indexed = false;              ///< Place the message by `IndexedPositions` instead of the shuffled stream (chunked containers).
+    };
+
+    /**
+     * @brief Removes the given positions from a sorted list of candidate bytes.
+     *
+     * Indexed adaptive embeddings permute the candidates without the header positions, so that every
+     * index maps to a usable byte and the body can be read at any offset.
+     *
+     * @param candidates Sorted candidate bytes.
+     * @param positions Positions to remove (in any order).
+     * @return std::vector<size_t> The remaining candidates, sorted.
+     */
+    std::vector<size_t> excludePositions(const std::vector<size_t>& candidates, std::vector<size_t> positions);
+
+    /**
+     * @brief Chooses the adaptive level and the Hamming parameter for a container, as `--crypt` does.
+     *
+     * With a cost map the narrowest adaptive level whose candidates hold the container at most half full
+     * is used (uniform positions if none does). With `matrix` the parameter k follows the ratio of the
+     * container size to the positions available after the header.
+     *
+     * @param carrierSize Number of carrier bytes.
+     * @param containerBytes Size of the container (without the header).
+     * @param headerBytes Size of the header and key check embedded before it.
+     * @param engine Generator engine for positions and noise.
+     * @param costMap Cost map of the carrier for adaptive embedding, or nullptr for uniform positions.
+     * @param matrix Whether matrix embedding is requested.
+     * @param noiseDensity Share of unused bytes (in percent) that receive cover noise.
+     * @return EmbedOptions The options (`costMap` points to the given map when the adaptive level is not 0).
+     */
+    EmbedOptions chooseEmbedOptions(size_t carrierSize, size_t containerBytes, size_t headerBytes, EngineId engine,
+                                    const std::vector<uint8_t>* costMap, bool matrix, unsigned int noiseDensity);
+
     /**
      * @brief Embeds data into an image using a key to generate random positions.
      * 
      * The function modifies the image in place by setting the least significant bit (LSB)
      * of selected pixels according to the message bits. For additional obfuscation,
-     * non-essential pixels undergo random LSB modification (±1).
+     * non-essential pixels undergo random LSB modification (±1): a keyed mask selects
+     * `options.noiseDensity` percent of them in memory order, and payload positions are never touched,
+     * so the cost of the noise is one sequential pass and does not depend on the permutation.
+     * The payload is written into a packed LSB plane (`LsbPlane`), which is merged back into the
+     * pixels in the same pass that applies the noise.
+     * 
+     * The first `options.headerBytes` bytes are always embedded one bit per position; with
+     * `options.matrixK > 1` the rest is matrix-embedded (k bits per 2^k - 1 positions, at most one
+     * change per group). In adaptive mode the first `options.headerBytes` bytes are placed on the uniform stream,
+     * the rest only on the textured bytes selected by the cost map, and the noise replaces the LSB
+     * instead of adding ±1, so the higher bits (and thus the cost map) stay intact.
      * 
      * @param image The image where the data will be embedded.
      * @param message A byte array representing the data to be embedded.
      * @param key A binary key used to initialize the random number generator.
-     * @throws std::runtime_error If the message is too large for the given image.
+     * @param options Engine and position selection (must match the values stored in the header).
+     * @throws Terminates the program if the message is too large for the given image.
+     */
+    void embedData(ImageHandler::Image& image, const std::vector<uint8_t>& message, const std::vector<uint8_t>& key,
+                   const EmbedOptions& options = {});
+
+    /**
+     * @brief `embedData` that reports a message too large for the image instead of terminating.
+     *
+     * @return true on success, false if the message does not fit (the image is left unchanged).
+     */
+    bool tryEmbedData(ImageHandler::Image& image, const std::vector<uint8_t>& message, const std::vector<uint8_t>& key,
+                      const EmbedOptions& options = {});
+
+    /**
+     * @brief Embeds data directly into a writable mapping of an uncompressed carrier file.
+     *
+     * Produces the same payload positions as `embedData` (so both paths extract identically), but only
+     * the positions of the message are generated and translated to file offsets; the cover noise is
+     * applied in file order. Nothing is decoded unless the adaptive cost map is needed.
+     *
+     * @param carrier Writable mapping of the output file.
+     * @param message A byte array representing the data to be embedded.
+     * @param key A binary key used to initialize the random number generator.
+     * @param options Engine and position selection (must match the values stored in the header).
+     * @throws Terminates the program if the message does not fit.
+     */
+    void embedDataInPlace(ImageHandler::MappedImage& carrier, const std::vector<uint8_t>& message, const std::vector<uint8_t>& key,
+                          const EmbedOptions& options = {});
+
+    /**
+     * @brief `embedDataInPlace` that reports a message too large for the carrier instead of terminating.
+     *
+     * @return true on success, false if the message does not fit (the mapping is left unchanged).
+     */
+    bool tryEmbedDataInPlace(ImageHandler::MappedImage& carrier, const std::vector<uint8_t>& message, const std::vector<uint8_t>& key,
+                             const EmbedOptions& options = {});
+
+    /**
+     * @brief Replaces the payload of an existing embedding made with the same key and options.
+     *
+     * The positions are generated exactly as in `embedData`; the positions of the previous message are a
+     * prefix of them, so only the LSBs whose bits differ are changed and a longer message continues into
+     * the next keyed positions. No cover noise is added (the carrier already has it), so the work depends
+     * on the message length only (plus the cost map in adaptive mode) and repeated updates do not add
+     * distortion outside the payload positions.
+     *
+     * @param image The stego image, modified in place.
+     * @param message The new message, with a header that keeps the engine, adaptive level and k of the old one.
+     * @param key A binary key used to initialize the random number generator.
+     * @param options Engine and position selection read from the existing header.
+     * @return size_t Number of carrier bytes that were changed.
+     */
+    size_t updateData(ImageHandler::Image& image, const std::vector<uint8_t>& message, const std::vector<uint8_t>& key,
+                      const EmbedOptions& options);
+
+    /**
+     * @brief `updateData` on a writable mapping of an uncompressed carrier file; only the pages of the payload are touched.
+     */
+    size_t updateDataInPlace(ImageHandler::MappedImage& carrier, const std::vector<uint8_t>& message, const std::vector<uint8_t>& key,
+                             const EmbedOptions& options);
+
+    /**
+     * @brief Returns the keyed payload positions of a message in message bit order, as `embedData` generates them.
+     *
+     * This is the position half of the engine for carriers that are streamed instead of held in memory
+     * (PCM audio): the caller gathers the LSBs of these positions (or of the whole carrier), sets them
+     * with `embedIntoLsbs` and writes them back while the carrier passes through.
+     *
+     * @param carrierSize Number of carrier positions.
+     * @param message The header, the key check and the container.
+     * @param key A binary key used to initialize the random number generator.
+     * @param options Engine and position selection; adaptive levels need `options.costMap`.
+     * @return std::vector<size_t> The positions, one per embedded bit (or per matrix group position).
+     * @throws Terminates the program if the message does not fit.
+     */
+    std::vector<size_t> planPayloadPositions(size_t carrierSize, const std::vector<uint8_t>& message, const std::vector<uint8_t>& key,
+                                             const EmbedOptions& options);
+
+    /**
+     * @brief Embeds a message into the LSBs of its payload positions, gathered in the order of `planPayloadPositions`.
+     *
+     * The header is written one bit per position and the rest with the Hamming code of `options.matrixK`,
+     * exactly as `embedData` writes them into the carrier.
+     *
+     * @param lsbs One value (0 or 1) per payload position, updated in place; the previous values matter only for k > 1.
+     * @param message The header, the key check and the container.
+     * @param options The options passed to `planPayloadPositions`.
+     * @return size_t Number of positions whose LSB changed.
+     */
+    size_t embedIntoLsbs(std::vector<uint8_t>& lsbs, const std::vector<uint8_t>& message, const EmbedOptions& options);
+
+    /**
+     * @brief `embedIntoLsbs` on a plane of all carrier LSBs, for payloads dense enough that the plane is smaller
+     * than a gathered copy (see `PLANE_READ_DIVISOR`).
+     *
+     * @param plane LSBs of the carrier, updated in place; the previous values matter only for k > 1.
+     * @param positions The positions returned by `planPayloadPositions`.
+     * @param message The header, the key check and the container.
+     * @param options The options passed to `planPayloadPositions`.
+     * @return size_t Number of positions whose LSB changed.
+     */
+    size_t embedIntoLsbs(LsbPlane& plane, const std::vector<size_t>& positions, const std::vector<uint8_t>& message,
+                         const EmbedOptions& options);
+
+    /**
+     * @brief Embeds bytes into one raw frame of a video (or any byte buffer), one bit per position.
+     *
+     * The positions come from the key stream `positionStream` over [0, size), so every frame gets its
+     * own keyed positions; the other bytes receive ±1 cover noise in memory order from `noiseStream`.
+     *
+     * @param data The frame bytes, modified in place.
+     * @param size Number of bytes in the frame.
+     * @param bytes The bytes to embed (at most size / 8).
+     * @param key A binary key used to seed the engine.
+     * @param engine The generator engine.
+     * @param positionStream Seed stream of the positions.
+     * @param noiseStream Seed stream of the noise.
+     * @param noiseDensity Share of the other bytes (in percent) that receive noise.
      */
-    void embedData(ImageHandler::Image& image, const std::vector<uint8_t>& message, const std::vector<uint8_t>& key);
+    void embedFrame(uint8_t* data, size_t size, const std::vector<uint8_t>& bytes, const std::vector<uint8_t>& key,
+                    EngineId engine, uint64_t positionStream, uint64_t noiseStream, unsigned int noiseDensity);
+
+    /**
+     * @brief Extracts bytes embedded by `embedFrame`.
+     *
+     * @param data The frame bytes.
+     * @param size Number of bytes in the frame.
+     * @param length Number of bytes to extract (at most size / 8).
+     * @param key A binary key used to seed the engine.
+     * @param engine The generator engine.
+     * @param positionStream Seed stream of the positions.
+     * @return std::vector<uint8_t> The extracted bytes.
+     */
+    std::vector<uint8_t> extractFrame(const uint8_t* data, size_t size, size_t length, const std::vector<uint8_t>& key,
+                                      EngineId engine, uint64_t positionStream);
 
     /**
      * @brief Extracts data from an image using a key to generate the sequence of positions.
@@ -31,10 +227,35 @@ namespace Stegano {
      * @param image The image from which the message will be extracted.
      * @param messageLength The length of the extracted message in bytes.
      * @param key A binary key used to initialize the random number generator.
+     * @param engine The generator engine used when embedding.
      * @return std::vector<uint8_t> The extracted message.
      * @throws std::runtime_error If the specified message length exceeds the image's capacity.
      */
-    std::vector<uint8_t> extractData(const ImageHandler::Image& image, size_t messageLength, const std::vector<uint8_t>& key);
+    std::vector<uint8_t> extractData(const ImageHandler::Image& image, size_t messageLength, const std::vector<uint8_t>& key,
+                                     EngineId engine = DEFAULT_ENGINE);
+
+    /**
+     * @brief Extracts the next bytes of a message, continuing an existing position stream.
+     * 
+     * Only the positions needed for `messageLength` bytes are generated, so a short prefix
+     * (e.g. the header) can be read without shuffling the whole image.
+     * 
+     * @param image The image from which the message will be extracted.
+     * @param positions The key-driven position stream, advanced by `messageLength * 8` positions.
+     * @param messageLength The number of bytes to extract.
+     * @return std::vector<uint8_t> The extracted bytes.
+     * @throws std::runtime_error If the specified message length exceeds the remaining image capacity.
+     */
+    std::vector<uint8_t> extractData(const ImageHandler::Image& image, PositionStream& positions, size_t messageLength);
+
+    /**
+     * @brief Extracts bytes from an explicit list of positions (8 positions per byte, MSB first).
+     * 
+     * @param image The image from which the message will be extracted.
+     * @param shuffledIndices The carrier positions in message bit order.
+     * @return std::vector<uint8_t> The extracted bytes.
+     */
+    std::vector<uint8_t> extractData(const ImageHandler::Image& image, const std::vector<size_t>& shuffledIndices);
 
 } // namespace Stegano
 
@@ -0,0 +1,49 @@
+#ifndef TILED_STEGANO_H
+#define TILED_STEGANO_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "tiled_tiff.h"
+#include "rng_engines.h"
+
+namespace Stegano {
+
+    /**
+     * @brief Embeds a message into a copy of a tiled TIFF, one bit per keyed position.
+     *
+     * The positions come from the same key stream as for decoded images, over the 64-bit byte count of
+     * the carrier. They are grouped by tile, and the tiles are split between `threadCount` workers: each
+     * worker reads its tiles from the input through its own handle and a small tile cache, and the
+     * changed tiles are written to the output. Tiles without payload positions are neither decoded nor
+     * rewritten, and no cover noise is applied (it would have to rewrite every tile).
+     *
+     * @param inFile Path to the input tiled TIFF.
+     * @param outFile Path to the output TIFF (a copy of the input with the changed tiles rewritten).
+     * @param message The header, the key check and the container.
+     * @param key The steganographic key.
+     * @param engine The generator engine, stored in the header.
+     * @param threadCount Number of tile workers.
+     * @throws Terminates the program if the input is not a supported tiled TIFF or the message does not fit.
+     */
+    void embedTiled(const std::string& inFile, const std::string& outFile, const std::vector<uint8_t>& message,
+                    const std::vector<uint8_t>& key, EngineId engine, unsigned int threadCount);
+
+    /**
+     * @brief Reads the LSBs of carrier positions of a tiled TIFF.
+     *
+     * Every touched tile is decoded once; the tiles are split between `threadCount` workers,
+     * each with its own handle on the file.
+     *
+     * @param carrier The carrier (only its path and geometry are used).
+     * @param positions Carrier positions in message bit order.
+     * @param threadCount Number of tile workers.
+     * @return std::vector<uint8_t> One byte (0 or 1) per position.
+     */
+    std::vector<uint8_t> readTiledLsbs(const ImageHandler::TiledTiff& carrier, const std::vector<size_t>& positions,
+                                       unsigned int threadCount);
+
+} // namespace Stegano
+
+#endif // TILED_STEGANO_H
@@ -0,0 +1,186 @@
+#ifndef TILED_TIFF_H
+#define TILED_TIFF_H
+
+#include <list>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+#include <unordered_map>
+
+namespace ImageHandler {
+
+    /**
+     * @brief Checks whether the path has the .tif or .tiff extension.
+     *
+     * @param filename Path to check.
+     * @return true for TIFF files, false otherwise.
+     */
+    bool isTiffFile(const std::string& filename);
+
+    /**
+     * @brief Checks whether the program was built with libtiff (tiled TIFF carriers are available).
+     */
+    bool tiffSupported();
+
+    /**
+     * @brief Location of a carrier byte inside a tiled TIFF.
+     */
+    struct TileAddress {
+        uint32_t tile = 0;  ///< Tile index as used by libtiff (row of tiles * tiles across + column).
+        size_t offset = 0;  ///< Byte offset inside the decoded tile.
+    };
+
+    /**
+     * @brief Tiled TIFF or BigTIFF carrier accessed one tile at a time through libtiff.
+     *
+     * Carrier bytes are addressed by the same 64-bit positions as a decoded image (top-down rows,
+     * interleaved 8-bit samples), but the pixels are never decoded as a whole: a position is translated
+     * to its tile and the offset inside it, and only those tiles are read and written. Edge tiles are
+     * padded by libtiff; the padding is never addressed. Only 8-bit, chunky (interleaved) images with
+     * lossless compression are supported, because a lossy codec would destroy the LSBs. Palette images
+     * are rejected: their samples are colour indices, so an LSB change would recolour the pixel.
+     *
+     * A handle is not thread-safe (except `writeTile`); parallel readers open their own handles on the same file.
+     */
+    class TiledTiff {
+    public:
+        /**
+         * @brief Opens a tiled TIFF if its layout is supported.
+         *
+         * @param filename Path to a .tif or .tiff file.
+         * @param writable Open for update: rewritten tiles replace the old ones in the file.
+         * @return std::optional<TiledTiff> The handle, or std::nullopt if the file is not a tiled 8-bit
+         * direct-colour TIFF with lossless compression, or the program was built without libtiff.
+         */
+        static std::optional<TiledTiff> open(const std::string& filename, bool writable);
+
+        TiledTiff(TiledTiff&& other) noexcept;
+        TiledTiff& operator=(TiledTiff&& other) noexcept;
+        TiledTiff(const TiledTiff&) = delete;
+        TiledTiff& operator=(const TiledTiff&) = delete;
+        ~TiledTiff();
+
+        uint32_t width() const { return imageWidth; }
+        uint32_t height() const { return imageHeight; }
+        int channels() const { return samplesPerPixel; }
+        const std::string& path() const { return filePath; }
+
+        /// Number of carrier bytes (width * height * channels), 64-bit for gigapixel images.
+        uint64_t size() const { return static_cast<uint64_t>(imageWidth) * imageHeight * samplesPerPixel; }
+
+        size_t tileBytes() const { return tileSize; } ///< Bytes of one decoded tile.
+
+        /**
+         * @brief Returns the tile and the offset inside it of a carrier byte.
+         *
+         * @param position Index into the (virtual) decoded pixel data.
+         */
+        TileAddress locate(uint64_t position) const;
+
+        /**
+         * @brief Decodes a tile.
+         *
+         * @param tile Tile index.
+         * @param buffer Receives `tileBytes()` bytes.
+         * @return true on success, false on a read or decoding error.
+         */
+        bool readTile(uint32_t tile, std::vector<uint8_t>& buffer);
+
+        /**
+         * @brief Encodes a tile and writes it to the file (writable handles only).
+         *
+         * Unlike the other methods this one may be called from several threads; the writes are serialized.
+         *
+         * @param tile Tile index.
+         * @param buffer `tileBytes()` bytes of the tile.
+         * @return true on success, false on a write error.
+         */
+        bool writeTile(uint32_t tile, std::vector<uint8_t>& buffer);
+
+        /**
+         * @brief Flushes the rewritten tiles and the directory and closes the file.
+         *
+         * @return true on success, false if the file could not be updated.
+         */
+        bool close();
+
+    private:
+        TiledTiff() = default;
+
+        void* tiff = nullptr; ///< TIFF* of libtiff (kept opaque so the header does not need tiffio.h).
+        std::string filePath;
+        uint32_t imageWidth = 0;
+        uint32_t imageHeight = 0;
+        int samplesPerPixel = 0;
+        uint32_t tileWidth = 0;
+        uint32_t tileLength = 0;
+        uint32_t tilesAcross = 0;
+        size_t tileSize = 0;
+        bool updating = false;  ///< Opened for update ("r+").
+        std::unique_ptr<std::mutex> writeMutex = std::make_unique<std::mutex>();
+    };
+
+    /**
+     * @brief Small LRU cache of decoded tiles with write-back of modified tiles.
+     *
+     * Tiles are read from `source` on a miss; modified tiles are encoded into `target` when they are
+     * evicted or on `flush`. `target` may be null for read-only use, and may be shared between caches
+     * of several threads when every cache modifies a different set of tiles (writes are serialized).
+     */
+    class TileCache {
+    public:
+        /// Default number of cached tiles: enough for positions visited in tile order.
+        static constexpr size_t DEFAULT_CAPACITY = 4;
+
+        /**
+         * @param source Handle the tiles are read from.
+         * @param target Handle modified tiles are written to (nullptr for read-only use).
+         * @param capacity Maximum number of decoded tiles kept in memory.
+         */
+        TileCache(TiledTiff& source, TiledTiff* target, size_t capacity = DEFAULT_CAPACITY);
+
+        /**
+         * @brief Returns the decoded bytes of a tile, reading it on a miss.
+         *
+         * @param tile Tile index.
+         * @param modify The caller will change the bytes (the tile is written back later).
+         * @return uint8_t* The tile bytes, valid until the next call.
+         * @throws Terminates the program if the tile cannot be read or an evicted tile cannot be written.
+         */
+        uint8_t* tile(uint32_t tile, bool modify);
+
+        /**
+         * @brief Writes every modified tile to the target.
+         *
+         * @throws Terminates the program on a write error.
+         */
+        void flush();
+
+        size_t reads() const { return tileReads; }   ///< Number of tiles decoded so far.
+        size_t writes() const { return tileWrites; } ///< Number of tiles written so far.
+
+    private:
+        struct Entry {
+            uint32_t tile = 0;
+            bool dirty = false;
+            std::vector<uint8_t> data;
+        };
+
+        void writeBack(Entry& entry);
+
+        TiledTiff& source;
+        TiledTiff* target;
+        size_t capacity;
+        std::list<Entry> entries; ///< Most recently used first.
+        std::unordered_map<uint32_t, std::list<Entry>::iterator> index;
+        size_t tileReads = 0;
+        size_t tileWrites = 0;
+    };
+
+} // namespace ImageHandler
+
+#endif // TILED_TIFF_H
@@ -0,0 +1,74 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+namespace Trace {
+
+    namespace detail {
+        inline std::atomic<bool>& enabledFlag() {
+            static std::atomic<bool> enabled{false};
+            return enabled;
+        }
+
+        void record(const char* name, uint64_t beginNs, uint64_t endNs);
+        uint64_t nowNs();
+    }
+
+    /**
+     * @brief Starts recording spans; the trace is written to `path` when the program exits (the --trace option).
+     *
+     * The file uses the Chrome trace-event format (JSON), which chrome://tracing and Perfetto open
+     * directly. Every thread that records a span gets its own track.
+     *
+     * @param path Path to the output JSON file.
+     */
+    void start(const std::string& path);
+
+    /**
+     * @brief Checks whether spans are being recorded.
+     */
+    inline bool enabled() {
+        return detail::enabledFlag().load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Names the track of the calling thread (e.g. "worker 3"); ignored when tracing is off.
+     */
+    void nameThread(const std::string& name);
+
+    /**
+     * @brief Writes the recorded spans to the trace file (called automatically at exit).
+     *
+     * Must not run while other threads are still recording.
+     */
+    void finish();
+
+    /**
+     * @brief Scoped span: records the time between construction and destruction on the calling thread's track.
+     *
+     * Spans go to a buffer owned by the thread, so recording takes no lock; with tracing off a span
+     * costs one relaxed load.
+     */
+    class Span {
+    public:
+        /**
+         * @param name Span name; must be a string literal (only the pointer is stored).
+         */
+        explicit Span(const char* name) : name(enabled() ? name : nullptr), begin(this->name ? detail::nowNs() : 0) {}
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+        ~Span() {
+            if (name) detail::record(name, begin, detail::nowNs());
+        }
+
+    private:
+        const char* name;
+        uint64_t begin;
+    };
+
+} // namespace Trace
+
+#endif // TRACE_H
@@ -0,0 +1,73 @@
+#ifndef VIDEO_STEGANO_H
+#define VIDEO_STEGANO_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "rng_engines.h"
+
+namespace Stegano {
+
+    /**
+     * @brief Size of the video framing prefix: the container header followed by the number of
+     * container bytes stored per frame (4 bytes, big-endian).
+     */
+    size_t videoPrefixSize();
+
+    /**
+     * @brief Outcome of reading the container from a video.
+     */
+    enum class VideoExtractStatus {
+        Ok,              ///< The container was read.
+        KeyMismatch,     ///< The keyed check value in the first frame does not match.
+        CapacityExceeded ///< The clip ends before the whole container was read.
+    };
+
+    /**
+     * @brief Result of `extractVideo`.
+     */
+    struct VideoExtraction {
+        VideoExtractStatus status = VideoExtractStatus::KeyMismatch; ///< Outcome of the extraction.
+        std::vector<uint8_t> container;                              ///< The container (salt + IV + ciphertext) when status is Ok.
+    };
+
+    /**
+     * @brief Embeds a container into a YUV4MPEG2 clip, spreading it over the frames.
+     *
+     * The first frame starts with the container header, the per-frame byte count and the keyed check
+     * value; after that every frame carries the same number of container bytes at positions drawn from
+     * its own key stream (`framePositionStream`), and the other bytes receive cover noise. The per-frame
+     * count spreads the container over the whole clip when its length is known (a regular file) and
+     * fills 1/8 of every frame's capacity otherwise. Frames flow through a bounded pipeline: the next
+     * frame is read while `threadCount` workers embed and the previous frame is written, so memory
+     * stays at a few frames regardless of the clip length.
+     *
+     * @param inFile Path to the input .y4m file, or "-" for the standard input.
+     * @param outFile Path to the output .y4m file, or "-" for the standard output.
+     * @param container The encrypted container (salt + IV + ciphertext).
+     * @param key The steganographic key.
+     * @param engine The generator engine, stored in the header.
+     * @param noiseDensity Share of the unused frame bytes (in percent) that receive cover noise.
+     * @param threadCount Number of embedding workers.
+     * @throws Terminates the program if the clip is too short for the container.
+     */
+    void embedVideo(const std::string& inFile, const std::string& outFile, const std::vector<uint8_t>& container,
+                    const std::vector<uint8_t>& key, EngineId engine, unsigned int noiseDensity, unsigned int threadCount);
+
+    /**
+     * @brief Reads the container embedded by `embedVideo`.
+     *
+     * The first frame is checked against the key (trying every engine) before anything else is read;
+     * only the frames that hold the container are read after that, extracted by `threadCount` workers.
+     *
+     * @param inFile Path to the .y4m file, or "-" for the standard input.
+     * @param key The steganographic key.
+     * @param threadCount Number of extraction workers.
+     * @return VideoExtraction The status and, on success, the container.
+     */
+    VideoExtraction extractVideo(const std::string& inFile, const std::vector<uint8_t>& key, unsigned int threadCount);
+
+} // namespace Stegano
+
+#endif // VIDEO_STEGANO_H
@@ -0,0 +1,62 @@
+#ifndef WATCH_FOLDER_H
+#define WATCH_FOLDER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "CliConfig.h"
+
+namespace WatchFolder {
+
+    /**
+     * @brief Subdirectory of the spool that receives files which could not be embedded.
+     */
+    constexpr const char* FAILED_DIRECTORY = "failed";
+
+    /**
+     * @brief File in the spool directory with the current counters, rewritten every few seconds.
+     */
+    constexpr const char* STATS_FILE = ".watch-stats";
+
+    /**
+     * @brief Counters of a running watch.
+     */
+    struct WatchStats {
+        uint64_t queued = 0;         ///< Files waiting for a worker (queue depth).
+        uint64_t inProgress = 0;     ///< Files being embedded.
+        uint64_t processed = 0;      ///< Files written to the output directory and removed from the spool.
+        uint64_t failed = 0;         ///< Files moved to the failed subdirectory.
+        uint64_t carrierBytes = 0;   ///< Carrier bytes of the processed files.
+        double filesPerSecond = 0.0; ///< Processed files per second over the last reporting interval.
+    };
+
+    /**
+     * @brief Checks whether the --watch mode is available (it needs Linux inotify).
+     */
+    bool supported();
+
+    /**
+     * @brief Runs the --watch mode: embeds `config.textMessage` into every image dropped into `config.watchDir`.
+     *
+     * Files are picked up when they are complete: on close after writing or when they are renamed
+     * into the directory. Names starting with a dot are ignored, so writers can use them for partial
+     * files. Files already in the spool at start (left over from a previous run) are queued once
+     * their size and modification time stay unchanged for a short settle time. A persistent pool of
+     * `Parallel::defaultThreadCount()` workers takes the files in arrival order. Each image is embedded
+     * on one thread, and a worker with a backlog takes several files at once so that their keys are
+     * derived in one `KeyDerivation::deriveKeys` batch. The output keeps the input name. It is written to
+     * a temporary file in `config.outDir` and renamed into place, and only then is the input removed
+     * from the spool, so a restart at any point reprocesses the file instead of losing it. Files that
+     * cannot be embedded are moved to `FAILED_DIRECTORY` and the watch goes on. Queue depth and
+     * throughput are logged and written to `STATS_FILE`. SIGINT or SIGTERM stop the watch after the
+     * files in progress are finished; queued files stay in the spool.
+     *
+     * @param config The CLI configuration (watchDir, outDir, text, key and embedding options).
+     * @param steganoKey The key used to generate the embedding positions.
+     * @return int The process exit status.
+     */
+    int run(const CliConfig& config, const std::vector<uint8_t>& steganoKey);
+
+} // namespace WatchFolder
+
+#endif // WATCH_FOLDER_H
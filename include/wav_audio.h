@@ -0,0 +1,152 @@
+#ifndef WAV_AUDIO_H
+#define WAV_AUDIO_H
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+#include "external/logger.h"
+
+namespace AudioHandler {
+
+    /**
+     * @brief Checks whether the path has the .wav extension.
+     *
+     * @param filename Path to check.
+     * @return true for WAV files, false otherwise.
+     */
+    bool isWavFile(const std::string& filename);
+
+    /**
+     * @brief Sample layout of a PCM WAV file as read from its "fmt " and "data" chunks.
+     */
+    struct WavFormat {
+        uint16_t channels = 0;        ///< Interleaved channels.
+        uint32_t sampleRate = 0;      ///< Frames per second.
+        uint16_t bitsPerSample = 0;   ///< Container bits per sample: 16 or 24.
+        uint64_t dataOffset = 0;      ///< Offset of the first sample in the file.
+        uint64_t dataSize = 0;        ///< Size of the "data" chunk in bytes.
+        uint64_t fileSize = 0;        ///< Size of the whole file.
+
+        unsigned int bytesPerSample() const { return bitsPerSample / 8u; }
+        uint64_t sampleCount() const { return dataSize / bytesPerSample(); } ///< Samples of all channels.
+    };
+
+    /**
+     * @brief Consecutive bytes of a WAV file as returned by `WavFile::readBlock`.
+     *
+     * A block holds either whole samples of the "data" chunk or RIFF bytes outside the samples
+     * (headers, other chunks, a partial last sample), which are written back unchanged.
+     */
+    struct WavBlock {
+        uint64_t offset = 0;        ///< Offset of the block in the file.
+        uint64_t firstSample = 0;   ///< Index of the first sample (sample blocks only).
+        size_t sampleCount = 0;     ///< Number of samples, 0 for bytes outside the samples.
+        std::vector<uint8_t> data;  ///< The bytes of the block.
+    };
+
+    /**
+     * @brief 16- or 24-bit PCM WAV carrier read in bounded blocks.
+     *
+     * Carrier position i is sample i of the "data" chunk (channels interleaved) and its LSB is the
+     * lowest bit of the sample's first byte, so the same keyed positions as for images address the
+     * samples. The file is never loaded as a whole: `readBlock` walks it sequentially in blocks of at
+     * most `BLOCK_SAMPLES` samples, and `readSamples` reads any run of samples. Plain PCM and
+     * WAVE_FORMAT_EXTENSIBLE with a PCM subformat are accepted; chunks other than "data" are not
+     * interpreted. A handle is not thread-safe; parallel readers open their own handles on the same file.
+     */
+    class WavFile {
+    public:
+        /// Samples per block of `readBlock` (and of the parallel embedding).
+        static constexpr size_t BLOCK_SAMPLES = size_t{1} << 16;
+
+        /**
+         * @brief Opens a WAV file if its format is supported.
+         *
+         * @param filename Path to a .wav file.
+         * @return std::optional<WavFile> The handle, or std::nullopt if the file cannot be read, is not a
+         * RIFF/WAVE file or does not hold 16- or 24-bit integer PCM.
+         */
+        static std::optional<WavFile> open(const std::string& filename);
+
+        WavFile(WavFile&& other) noexcept;
+        WavFile& operator=(WavFile&& other) noexcept;
+        WavFile(const WavFile&) = delete;
+        WavFile& operator=(const WavFile&) = delete;
+        ~WavFile();
+
+        const WavFormat& format() const { return wavFormat; }
+        const std::string& path() const { return filePath; }
+
+        /// Number of carrier positions (samples of all channels).
+        uint64_t size() const { return wavFormat.sampleCount(); }
+
+        /**
+         * @brief Reads the next block of the file, from the start to the end of the file.
+         *
+         * @param block Receives the block; its buffer is reused.
+         * @return true if a block was read, false at the end of the file.
+         * @throws Terminates the program on a read error.
+         */
+        bool readBlock(WavBlock& block);
+
+        /**
+         * @brief Reads the samples [firstSample, firstSample + count).
+         *
+         * @param firstSample Index of the first sample.
+         * @param count Number of samples.
+         * @param buffer Receives `count * bytesPerSample()` bytes.
+         * @return true on success, false on a read error or a range past the last sample.
+         */
+        bool readSamples(uint64_t firstSample, size_t count, std::vector<uint8_t>& buffer);
+
+    private:
+        WavFile() = default;
+        bool readAt(uint64_t offset, uint8_t* out, size_t length);
+
+        FILE* file = nullptr;
+        std::string filePath;
+        WavFormat wavFormat;
+        uint64_t cursor = 0; ///< Offset of the next `readBlock`.
+    };
+
+    /**
+     * @brief Sequential writer of the blocks returned by `WavFile::readBlock`.
+     */
+    class WavWriter {
+    public:
+        /**
+         * @brief Creates the output file.
+         *
+         * @param filename Path to the output .wav file.
+         * @throws Terminates the program if the file cannot be created.
+         */
+        explicit WavWriter(const std::string& filename);
+        ~WavWriter();
+        WavWriter(const WavWriter&) = delete;
+        WavWriter& operator=(const WavWriter&) = delete;
+
+        /**
+         * @brief Appends a block.
+         *
+         * @param block The block to write.
+         * @throws Terminates the program on a write error.
+         */
+        void writeBlock(const WavBlock& block);
+
+        /**
+         * @brief Flushes and closes the output.
+         *
+         * @throws Terminates the program if the data cannot be flushed.
+         */
+        void close();
+
+    private:
+        FILE* out = nullptr;
+    };
+
+} // namespace AudioHandler
+
+#endif // WAV_AUDIO_H
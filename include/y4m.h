@@ -0,0 +1,117 @@
+#ifndef Y4M_H
+#define Y4M_H
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+#include "external/logger.h"
+
+namespace VideoHandler {
+
+    /**
+     * @brief One frame of a YUV4MPEG2 stream.
+     */
+    struct Frame {
+        std::string parameters;    ///< Text after "FRAME" on the frame line (usually empty), written back unchanged.
+        std::vector<uint8_t> data; ///< Raw planes of the frame (Y, then the chroma planes, then alpha if any).
+    };
+
+    /**
+     * @brief Checks whether the path has the .y4m extension.
+     *
+     * @param filename Path to check.
+     * @return true for YUV4MPEG2 files, false otherwise.
+     */
+    bool isY4MFile(const std::string& filename);
+
+    /**
+     * @brief Sequential reader of 8-bit YUV4MPEG2 (.y4m) streams.
+     *
+     * Frames are read one at a time into caller-owned buffers, so memory use does not depend on the
+     * clip length. The stream header line is kept verbatim for the writer.
+     */
+    class Y4MReader {
+    public:
+        /**
+         * @brief Opens a stream and parses its header.
+         *
+         * @param filename Path to the .y4m file, or "-" for the standard input.
+         * @throws Terminates the program if the file cannot be opened or the header is not supported.
+         */
+        explicit Y4MReader(const std::string& filename);
+        ~Y4MReader();
+        Y4MReader(const Y4MReader&) = delete;
+        Y4MReader& operator=(const Y4MReader&) = delete;
+
+        /**
+         * @brief Reads the next frame.
+         *
+         * @param frame Receives the frame parameters and planes; its buffer is reused.
+         * @return true if a frame was read, false at the end of the stream.
+         */
+        bool readFrame(Frame& frame);
+
+        int width() const { return frameWidth; }
+        int height() const { return frameHeight; }
+        size_t frameSize() const { return frameBytes; }                      ///< Bytes of plane data per frame.
+        const std::string& streamHeader() const { return header; }           ///< Header line without the newline.
+
+        /**
+         * @brief Estimates the number of frames from the file size, assuming bare "FRAME" lines.
+         *
+         * @return size_t The estimate, or 0 if the input is not a regular file.
+         */
+        size_t estimatedFrameCount() const;
+
+    private:
+        FILE* in = nullptr;
+        bool ownsFile = false;
+        std::string path;
+        std::string header;
+        int frameWidth = 0;
+        int frameHeight = 0;
+        size_t frameBytes = 0;
+    };
+
+    /**
+     * @brief Sequential writer of YUV4MPEG2 streams.
+     */
+    class Y4MWriter {
+    public:
+        /**
+         * @brief Creates the output and writes the stream header line.
+         *
+         * @param filename Path to the output file, or "-" for the standard output.
+         * @param streamHeader Header line to write (as returned by `Y4MReader::streamHeader`).
+         * @throws Terminates the program if the file cannot be created.
+         */
+        Y4MWriter(const std::string& filename, const std::string& streamHeader);
+        ~Y4MWriter();
+        Y4MWriter(const Y4MWriter&) = delete;
+        Y4MWriter& operator=(const Y4MWriter&) = delete;
+
+        /**
+         * @brief Appends a frame.
+         *
+         * @param frame The frame to write.
+         * @throws Terminates the program on a write error.
+         */
+        void writeFrame(const Frame& frame);
+
+        /**
+         * @brief Flushes and closes the output.
+         *
+         * @throws Terminates the program if the data cannot be flushed.
+         */
+        void close();
+
+    private:
+        FILE* out = nullptr;
+        bool ownsFile = false;
+    };
+
+} // namespace VideoHandler
+
+#endif // Y4M_H
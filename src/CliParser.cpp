@@ -2,19 +2,74 @@
 #include "external/logger.h"
 
 #include "encryption/utils.h"
+#include "image_handler.h"
+#include "rng_engines.h"
+#include "y4m.h"
+#include "tiled_tiff.h"
+#include "wav_audio.h"
+#include "memory_budget.h"
+#include "watch_folder.h"
 #include <iostream>
+#include <fstream>
 #include <filesystem>
+#include <algorithm>
 
 std::string CliParser::errorMessage;
 
+namespace {
+    // Целое число процентов в [0, 100]
+    bool parsePercent(const std::string& text, unsigned int& value) {
+        if (text.empty() || text.size() > 3 || !std::all_of(text.begin(), text.end(), ::isdigit)) {
+            return false;
+        }
+        value = static_cast<unsigned int>(std::stoul(text));
+        return value <= 100;
+    }
+
+    // Кэш позиций в режиме спула и с --position-cache-dir, если размер не задан
+    constexpr uint64_t DEFAULT_POSITION_CACHE_SIZE = uint64_t{64} << 20;
+
+    // Число потоков в [0, MAX_THREADS]; 0 - по числу ядер
+    constexpr unsigned long MAX_THREADS = 1024;
+    bool parseThreadCount(const std::string& text, unsigned int& value) {
+        if (text.empty() || text.size() > 4 || !std::all_of(text.begin(), text.end(), ::isdigit)) {
+            return false;
+        }
+        unsigned long parsed = std::stoul(text);
+        if (parsed > MAX_THREADS) return false;
+        value = static_cast<unsigned int>(parsed);
+        return true;
+    }
+
+    // Диапазон сообщения OFFSET:LEN, обе части - размеры с необязательным суффиксом (K, M, G)
+    bool parseRange(const std::string& text, uint64_t& offset, uint64_t& length) {
+        size_t colon = text.find(':');
+        if (colon == std::string::npos) return false;
+        auto parsedOffset = MemoryBudget::parseSize(text.substr(0, colon));
+        auto parsedLength = MemoryBudget::parseSize(text.substr(colon + 1));
+        if (!parsedOffset || !parsedLength || *parsedLength == 0) return false;
+        offset = *parsedOffset;
+        length = *parsedLength;
+        return true;
+    }
+}
+
 void CliParser::getErrorMessage() {
     std::cerr << errorMessage << "\n";
 }
 
 void CliParser::printUsage() {
     std::cout << "Using:\n"
-              << " --crypt --text \"message\" --in input_image_path --out output_image_path [--key \"password\"]\n"
-              << " --encrypt --in input_image_path --key \"password\"\n";
+              << " --crypt --text \"message\" --in input_image_path --out output_image_path [--key \"password\"] [--format png|bmp|qoi] [--engine xoshiro|chacha] [--adaptive] [--matrix] [--noise 0-100] [--analyze] [--threads N] [--max-memory SIZE] [--position-cache SIZE] [--position-cache-dir DIR]\n"
+              << " --crypt --update --text \"new message\" --in stego_image_path --out output_image_path --key \"password\" [--format png|bmp|qoi] [--analyze]\n"
+              << " --crypt --watch spool_dir --out-dir output_dir --text \"message\" --key \"password\" [--engine xoshiro|chacha] [--adaptive] [--matrix] [--noise 0-100] [--threads N] [--position-cache SIZE] [--position-cache-dir DIR]\n"
+              << " --encrypt --in input_image_path --key \"password\" [--range OFFSET:LEN] [--threads N] [--max-memory SIZE] [--cache-dir DIR [--cache-size SIZE]]\n"
+              << " --encrypt --in input_image_path --keys-file candidate_keys.txt\n"
+              << " Raw .y4m video is accepted as input_image_path; the message is spread over its frames\n"
+              << " Tiled .tif/.tiff images (8-bit, lossless) are accepted when built with libtiff; only the touched tiles are rewritten\n"
+              << " 16- and 24-bit PCM .wav audio is accepted as input_image_path; it is streamed in blocks and its other chunks are kept\n"
+              << " Add --trace trace.json to any mode to record a Chrome/Perfetto trace of every phase and worker thread\n"
+              << " Use - as a path to read the image from stdin (--in -) or write it to stdout (--out -)\n";
 }
 
 CliConfig& CliParser::parse(int argc, char** argv){
@@ -25,13 +80,18 @@ CliConfig& CliParser::parse(int argc, char** argv){
         exit(EXIT_FAILURE);
     }
 
+    if(ImageHandler::isStdStream(config.outFile)){
+        // stdout занят закодированным изображением, поэтому логи уходят в stderr
+        use_stderr_logger();
+    }
+
     if(config.passphrase.empty() && config.modeCrypt){
         // Для генерации перестановки в steganography используем ключ, полученный путём преобразования passphrase в байты.
         // Если пароль не задан в режиме шифрования, предложим сгенерировать надёжный.
         generatePassphrase(config.passphrase);
     }
     
-    if(config.modeCrypt){
+    if(config.modeCrypt && config.watchDir.empty() && !ImageHandler::isStdStream(config.outFile)){
         validateOutputPath(config.outFile);
     }
 
@@ -39,6 +99,8 @@ CliConfig& CliParser::parse(int argc, char** argv){
 }
 
 bool CliParser::extractCommandLineArguments(int argc, char** argv, CliConfig& config){
+    bool hasRange = false;
+    bool hasPositionCacheSize = false;
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
         if (arg == "--crypt") {
@@ -73,6 +135,138 @@ bool CliParser::extractCommandLineArguments(int argc, char** argv, CliConfig& co
                 errorMessage = "Error: key was missied";
                 return false;
             }
+        } else if (arg == "--adaptive") {
+            config.adaptive = true;
+        } else if (arg == "--matrix") {
+            config.matrix = true;
+        } else if (arg == "--analyze") {
+            config.analyze = true;
+        } else if (arg == "--update") {
+            config.update = true;
+        } else if (arg == "--keys-file") {
+            if (i + 1 < argc) {
+                config.keysFile = argv[++i];
+            } else {
+                errorMessage = "Error: after the flag --keys-file, the path to the file with keys must be specifed";
+                return false;
+            }
+        } else if (arg == "--engine") {
+            if (i + 1 < argc) {
+                config.engineName = argv[++i];
+            } else {
+                errorMessage = "Error: after the flag --engine, the generator name (xoshiro or chacha) must be specifed";
+                return false;
+            }
+        } else if (arg == "--noise") {
+            if (i + 1 < argc) {
+                if (!parsePercent(argv[++i], config.noiseDensity)) {
+                    errorMessage = "The parametr --noise must be a percentage from 0 to 100";
+                    return false;
+                }
+            } else {
+                errorMessage = "Error: after the flag --noise, the noise density in percent must be specifed";
+                return false;
+            }
+        } else if (arg == "--threads") {
+            if (i + 1 < argc) {
+                if (!parseThreadCount(argv[++i], config.threadCount)) {
+                    errorMessage = "The parametr --threads must be a number from 0 (all cores) to 1024";
+                    return false;
+                }
+            } else {
+                errorMessage = "Error: after the flag --threads, the number of worker threads must be specifed";
+                return false;
+            }
+        } else if (arg == "--max-memory") {
+            if (i + 1 < argc) {
+                auto size = MemoryBudget::parseSize(argv[++i]);
+                if (!size || *size == 0) {
+                    errorMessage = "The parametr --max-memory must be a size such as 512M or 2G";
+                    return false;
+                }
+                config.maxMemory = *size;
+            } else {
+                errorMessage = "Error: after the flag --max-memory, the memory budget must be specifed";
+                return false;
+            }
+        } else if (arg == "--cache-dir") {
+            if (i + 1 < argc) {
+                config.cacheDir = argv[++i];
+            } else {
+                errorMessage = "Error: after the flag --cache-dir, the path to the cache directory must be specifed";
+                return false;
+            }
+        } else if (arg == "--cache-size") {
+            if (i + 1 < argc) {
+                auto size = MemoryBudget::parseSize(argv[++i]);
+                if (!size || *size == 0) {
+                    errorMessage = "The parametr --cache-size must be a size such as 512M or 2G";
+                    return false;
+                }
+                config.cacheSize = *size;
+            } else {
+                errorMessage = "Error: after the flag --cache-size, the cache size limit must be specifed";
+                return false;
+            }
+        } else if (arg == "--position-cache") {
+            if (i + 1 < argc) {
+                auto size = MemoryBudget::parseSize(argv[++i]);
+                if (!size) {
+                    errorMessage = "The parametr --position-cache must be a size such as 64M or 1G (0 disables the cache)";
+                    return false;
+                }
+                config.positionCacheSize = *size;
+                hasPositionCacheSize = true;
+            } else {
+                errorMessage = "Error: after the flag --position-cache, the cache size limit must be specifed";
+                return false;
+            }
+        } else if (arg == "--position-cache-dir") {
+            if (i + 1 < argc) {
+                config.positionCacheDir = argv[++i];
+            } else {
+                errorMessage = "Error: after the flag --position-cache-dir, the path to the cache directory must be specifed";
+                return false;
+            }
+        } else if (arg == "--range") {
+            if (i + 1 < argc) {
+                if (!parseRange(argv[++i], config.rangeOffset, config.rangeLength)) {
+                    errorMessage = "The parametr --range must be OFFSET:LEN, for example 0:4K";
+                    return false;
+                }
+                hasRange = true;
+            } else {
+                errorMessage = "Error: after the flag --range, the message range OFFSET:LEN must be specifed";
+                return false;
+            }
+        } else if (arg == "--watch") {
+            if (i + 1 < argc) {
+                config.watchDir = argv[++i];
+            } else {
+                errorMessage = "Error: after the flag --watch, the path to the spool directory must be specifed";
+                return false;
+            }
+        } else if (arg == "--out-dir") {
+            if (i + 1 < argc) {
+                config.outDir = argv[++i];
+            } else {
+                errorMessage = "Error: after the flag --out-dir, the path to the output directory must be specifed";
+                return false;
+            }
+        } else if (arg == "--trace") {
+            if (i + 1 < argc) {
+                config.tracePath = argv[++i];
+            } else {
+                errorMessage = "Error: after the flag --trace, the path to the trace file must be specifed";
+                return false;
+            }
+        } else if (arg == "--format") {
+            if (i + 1 < argc) {
+                config.outFormat = argv[++i];
+            } else {
+                errorMessage = "Error: after the flag --format, the output format (png, bmp or qoi) must be specifed";
+                return false;
+            }
         } else if(arg == "--help") {
             errorMessage = "Action: The user requsted instuction";
             return false;
@@ -88,8 +282,45 @@ bool CliParser::extractCommandLineArguments(int argc, char** argv, CliConfig& co
         return false;
     }
 
+    if (!config.watchDir.empty()) {
+        // Режим спула: входы и выходы задаются каталогами, а не файлами
+        if (!config.modeCrypt || config.passphrase.empty() || config.textMessage.empty()) {
+            errorMessage = "The parametr --watch is used only in --crypt mode with --text and --key";
+            return false;
+        }
+        if (!config.inFile.empty() || !config.outFile.empty() || config.update || config.analyze) {
+            errorMessage = "The parametr --watch cannot be combined with --in, --out, --update or --analyze";
+            return false;
+        }
+        if (!WatchFolder::supported()) {
+            errorMessage = "The parametr --watch is available only on Linux";
+            return false;
+        }
+        std::error_code ec;
+        if (!std::filesystem::is_directory(config.watchDir, ec)) {
+            errorMessage = "The spool directory " + config.watchDir + " does not exist";
+            return false;
+        }
+        if (config.outDir.empty()) {
+            errorMessage = "The parametr --out-dir [output directory] is required with --watch";
+            return false;
+        }
+        std::filesystem::create_directories(config.outDir, ec);
+        if (!std::filesystem::is_directory(config.outDir, ec)) {
+            errorMessage = "The output directory " + config.outDir + " cannot be created";
+            return false;
+        }
+        if (std::filesystem::equivalent(config.watchDir, config.outDir, ec)) {
+            errorMessage = "The output directory must differ from the spool directory";
+            return false;
+        }
+    } else if (!config.outDir.empty()) {
+        errorMessage = "The parametr --out-dir is used only with --watch";
+        return false;
+    }
+
     // Проверка обязательных параметров
-    if (config.inFile.empty()) {
+    if (config.inFile.empty() && config.watchDir.empty()) {
         errorMessage = "The parametr --in [input image path] is required";
         return false;
     }
@@ -98,11 +329,101 @@ bool CliParser::extractCommandLineArguments(int argc, char** argv, CliConfig& co
             return false;
         }
 
-    if (config.modeEncrypt && config.passphrase.empty()) {
+    if (!config.keysFile.empty()) {
+        if (!config.modeEncrypt || !config.passphrase.empty()) {
+            errorMessage = "The parametr --keys-file is used only in --encrypt mode instead of --key";
+            return false;
+        }
+        if (VideoHandler::isY4MFile(config.inFile)) {
+            errorMessage = "The parametr --keys-file is not supported for video carriers";
+            return false;
+        }
+        if (ImageHandler::isTiffFile(config.inFile)) {
+            errorMessage = "The parametr --keys-file is not supported for tiled TIFF carriers";
+            return false;
+        }
+        if (AudioHandler::isWavFile(config.inFile)) {
+            errorMessage = "The parametr --keys-file is not supported for audio carriers";
+            return false;
+        }
+        if (!readKeysFile(config.keysFile, config.candidateKeys, config.candidateKeyLines)) {
+            errorMessage = "The keys file " + config.keysFile + " cannot be read or contains no keys";
+            return false;
+        }
+    }
+
+    if (config.analyze && !config.modeCrypt) {
+        errorMessage = "The parametr --analyze is used only in --crypt mode";
+        return false;
+    }
+
+    if (config.update) {
+        if (!config.modeCrypt || config.passphrase.empty()) {
+            errorMessage = "The parametr --update is used only in --crypt mode with the --key of the existing message";
+            return false;
+        }
+        if (VideoHandler::isY4MFile(config.inFile) || ImageHandler::isTiffFile(config.inFile) ||
+            AudioHandler::isWavFile(config.inFile)) {
+            errorMessage = "The parametr --update is supported only for image carriers";
+            return false;
+        }
+    }
+
+    if (hasRange && (!config.modeEncrypt || !config.candidateKeys.empty())) {
+        errorMessage = "The parametr --range is used only in --encrypt mode with --key";
+        return false;
+    }
+
+    if (!config.cacheDir.empty() && !config.modeEncrypt) {
+        errorMessage = "The parametr --cache-dir is used only in --encrypt mode";
+        return false;
+    }
+
+    // Кэш позиций окупается, когда один ключ встраивается во многие носители: в режиме спула
+    // или в общем каталоге для нескольких процессов
+    if ((hasPositionCacheSize || !config.positionCacheDir.empty()) && !config.modeCrypt) {
+        errorMessage = "The parametrs --position-cache and --position-cache-dir are used only in --crypt mode";
+        return false;
+    }
+    if (!hasPositionCacheSize && (!config.watchDir.empty() || !config.positionCacheDir.empty())) {
+        config.positionCacheSize = DEFAULT_POSITION_CACHE_SIZE;
+    }
+    if (!config.positionCacheDir.empty() && config.positionCacheSize == 0) {
+        errorMessage = "The parametr --position-cache-dir needs a nonzero --position-cache size";
+        return false;
+    }
+
+    if (config.modeEncrypt && config.passphrase.empty() && config.candidateKeys.empty()) {
         errorMessage = "In --encrypt the --key is required argument";
         return false;
     }
 
+    if (ImageHandler::formatFromName(config.outFormat) == ImageHandler::ImageFormat::Unknown) {
+        errorMessage = "The parametr --format supports only png, bmp and qoi";
+        return false;
+    }
+
+    if (ImageHandler::isTiffFile(config.inFile)) {
+        if (!ImageHandler::tiffSupported()) {
+            errorMessage = "TIFF carriers are not available: the program was built without libtiff";
+            return false;
+        }
+        if (config.modeCrypt && !ImageHandler::isTiffFile(config.outFile)) {
+            errorMessage = "A tiled TIFF carrier can only be saved as a TIFF file (--out *.tif)";
+            return false;
+        }
+    }
+
+    if (AudioHandler::isWavFile(config.inFile) && config.modeCrypt && !AudioHandler::isWavFile(config.outFile)) {
+        errorMessage = "A WAV carrier can only be saved as a WAV file (--out *.wav)";
+        return false;
+    }
+
+    if (!Stegano::engineFromName(config.engineName)) {
+        errorMessage = "The parametr --engine supports only xoshiro and chacha";
+        return false;
+    }
+
     return true;
 }
 
@@ -110,6 +431,13 @@ void CliParser::generatePassphrase(std::string& passphrase){
     // Предлагаем сгенерировать случайный пароль
     std::vector<uint8_t> randomKey = Utils::getRandomBytes(16); // например, 16 байт
     passphrase = Utils::bytesToHex(randomKey);
+
+    const CliConfig& config = CliConfig::getInstance();
+    if(ImageHandler::isStdStream(config.inFile) || ImageHandler::isStdStream(config.outFile)){
+        // В потоковом режиме stdin/stdout заняты изображением: сообщаем ключ в stderr и не ждём ввода
+        std::cerr << "The key was not specifed. A new key was generated: " << passphrase << "\n";
+        return;
+    }
     std::cout << "The key was not specifed. A new key was generated: " << passphrase << "\n"
                 << "Store it to encrypt text in the future. If you don't agree, terminate the program\n";
     std::cout << "Press Enter to continue...";
@@ -142,7 +470,18 @@ void CliParser::validateOutputPath(std::string& outputPath){
         } else if(fileName.extension().empty()){
             fileName += ".bmp";
         }
-        outputPath = promtSaveFileInCurrentDirectory(fileName.string());
+        const CliConfig& config = CliConfig::getInstance();
+        if(ImageHandler::isStdStream(config.inFile)){
+            // Изображение читается из stdin: вопрос пользователю съел бы первые байты носителя
+            if(!parrentPath.empty()){
+                LOG_ERROR("The output directory {} does not exist", parrentPath.string());
+                exit(EXIT_FAILURE);
+            }
+            outputPath = (std::filesystem::current_path() / fileName).string();
+        } else {
+            outputPath = promtSaveFileInCurrentDirectory(fileName.string());
+        }
+        output = std::filesystem::path(outputPath);
     } else if(fileName.extension().empty()) {
         outputPath += ".bmp";
         output = std::filesystem::path(outputPath);
@@ -156,4 +495,25 @@ void CliParser::validateOutputPath(std::string& outputPath){
     }
 
     LOG_INFO("The output path after validation {}", outputPath);
+}
+
+bool CliParser::readKeysFile(const std::string& path, std::vector<std::string>& keys, std::vector<size_t>& lines){
+    std::ifstream file(path);
+    if(!file){
+        return false;
+    }
+    std::string line;
+    size_t lineNumber = 0;
+    while(std::getline(file, line)){
+        ++lineNumber;
+        if(!line.empty() && line.back() == '\r'){
+            line.pop_back();
+        }
+        if(!line.empty()){
+            keys.push_back(line);
+            lines.push_back(lineNumber);
+        }
+    }
+    LOG_INFO("{} candidate keys were read from {}", keys.size(), path);
+    return !keys.empty();
 }
\ No newline at end of file
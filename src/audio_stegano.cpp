@@ -0,0 +1,312 @@
+#include "audio_stegano.h"
+#include "noise_mask.h"
+#include "frame_pipeline.h"
+#include "parallel.h"
+#include "memory_budget.h"
+#include "lsb_plane.h"
+#include "trace.h"
+#include "external/logger.h"
+
+#include <algorithm>
+
+namespace Stegano {
+
+namespace {
+
+// Меньше позиций на поток не окупает отдельный дескриптор файла
+constexpr size_t MIN_POSITIONS_PER_WORKER = 4096;
+
+// Участок блока читается целиком, если позиций в нём не меньше 1/SPARSE_READ_DIVISOR его отсчётов
+constexpr size_t SPARSE_READ_DIVISOR = 64;
+
+// Бит нагрузки хранится в старшем бите номера отсчёта: позиции сортируются на месте, без второго массива
+constexpr size_t PAYLOAD_BIT = size_t{1} << (sizeof(size_t) * 8 - 1);
+
+// Позиция для чтения: номер отсчёта и номер бита сообщения
+struct SampleEntry {
+    uint64_t sample = 0;
+    size_t bit = 0;
+};
+
+uint64_t blockOf(uint64_t sample) {
+    return sample / AudioHandler::WavFile::BLOCK_SAMPLES;
+}
+
+AudioHandler::WavFile openWav(const std::string& filename) {
+    auto wav = AudioHandler::WavFile::open(filename);
+    if (!wav) {
+        LOG_ERROR("{} is not a WAV file with 16- or 24-bit integer PCM samples", filename);
+        exit(EXIT_FAILURE);
+    }
+    return std::move(*wav);
+}
+
+// Позиций не меньше 1/PLANE_READ_DIVISOR отсчётов: их LSB и биты нагрузки хранятся битовыми плоскостями
+// по всем отсчётам, без сортировки позиций
+bool isDense(uint64_t sampleCount, size_t positionCount) {
+    return positionCount >= sampleCount / PLANE_READ_DIVISOR;
+}
+
+// Число потоков, чьи блоки помещаются в бюджет памяти вместе с позициями сообщения и их LSB;
+// у конвейера на два блока больше, чем потоков (чтение и запись)
+unsigned int budgetWorkers(const AudioHandler::WavFile& carrier, size_t positionCount, const EmbedOptions& options,
+                           unsigned int threadCount) {
+    const size_t sampleCount = static_cast<size_t>(carrier.size());
+    size_t blockBytes = AudioHandler::WavFile::BLOCK_SAMPLES * carrier.format().bytesPerSample();
+    // Индексная перестановка не хранит состояния, ленивый поток держит карту или плотный массив
+    size_t positions = options.indexed ? positionCount * sizeof(size_t)
+                                       : PositionStream::memoryEstimate(sampleCount, positionCount);
+    // Плотная нагрузка - две плоскости по всем отсчётам (биты и занятость); редкая - собранные LSB,
+    // порядок для их записи и при k > 1 позиции, отсортированные для чтения
+    size_t index = isDense(sampleCount, positionCount)
+                       ? 2 * ((sampleCount + 63) / 64) * sizeof(uint64_t)
+                       : positionCount * (1 + sizeof(size_t) + (options.matrixK > 1 ? sizeof(SampleEntry) : 0));
+    size_t shared = positions + index + 2 * blockBytes;
+    size_t perWorker = blockBytes + AudioHandler::WavFile::BLOCK_SAMPLES;
+    unsigned int workers = MemoryBudget::fitWorkers(shared, perWorker, threadCount);
+    if (workers == 0) {
+        LOG_ERROR("The message positions and the audio blocks need about {}, but --max-memory is {}",
+                  MemoryBudget::formatSize(shared + perWorker), MemoryBudget::formatSize(MemoryBudget::limit()));
+        exit(EXIT_FAILURE);
+    }
+    return workers;
+}
+
+// Отсчёты нагрузки и их биты: плотная нагрузка - плоскости used/bits по всем отсчётам, редкая - номера
+// отсчётов по возрастанию с битом в PAYLOAD_BIT
+struct SamplePayload {
+    bool dense = false;
+    size_t count = 0;
+    LsbPlane used;
+    LsbPlane bits;
+    std::vector<size_t> sorted;
+};
+
+// Разметка отсчётов блока: 0 - свободный отсчёт, 1 + бит нагрузки - отсчёт нагрузки
+void markBlock(const SamplePayload& payload, uint64_t firstSample, size_t sampleCount, std::vector<uint8_t>& marks) {
+    marks.assign(sampleCount, 0);
+    if (payload.dense) {
+        for (size_t i = 0; i < sampleCount; i++) {
+            const size_t sample = static_cast<size_t>(firstSample + i);
+            if (payload.used.test(sample)) marks[i] = static_cast<uint8_t>(1 + payload.bits.test(sample));
+        }
+        return;
+    }
+    auto byFirst = [](size_t entry, uint64_t sample) { return (entry & ~PAYLOAD_BIT) < sample; };
+    auto first = std::lower_bound(payload.sorted.begin(), payload.sorted.end(), firstSample, byFirst);
+    auto last = std::lower_bound(first, payload.sorted.end(), firstSample + sampleCount, byFirst);
+    for (auto it = first; it != last; ++it) {
+        marks[(*it & ~PAYLOAD_BIT) - firstSample] = (*it & PAYLOAD_BIT) ? 2 : 1;
+    }
+}
+
+// ±1 к знаковому отсчёту (little-endian), без выхода за его диапазон
+void nudgeSample(uint8_t* sample, unsigned int bytesPerSample, int direction) {
+    const int bits = static_cast<int>(bytesPerSample) * 8;
+    const int32_t maxValue = (int32_t{1} << (bits - 1)) - 1;
+    const int32_t minValue = -maxValue - 1;
+    uint32_t raw = 0;
+    for (unsigned int b = 0; b < bytesPerSample; b++) {
+        raw |= static_cast<uint32_t>(sample[b]) << (8 * b);
+    }
+    int32_t value = static_cast<int32_t>(raw << (32 - bits)) >> (32 - bits);
+    if (value == maxValue) {
+        direction = -1;
+    } else if (value == minValue) {
+        direction = 1;
+    }
+    raw = static_cast<uint32_t>(value + direction);
+    for (unsigned int b = 0; b < bytesPerSample; b++) {
+        sample[b] = static_cast<uint8_t>(raw >> (8 * b));
+    }
+}
+
+// Нагрузка и шум одного блока отсчётов
+void embedBlock(AudioHandler::WavBlock& block, unsigned int bytesPerSample, const SamplePayload& payload,
+                const std::vector<uint8_t>& key, EngineId engine, unsigned int noiseDensity) {
+    std::vector<uint8_t> marks;
+    markBlock(payload, block.firstSample, block.sampleCount, marks);
+    uint8_t* data = block.data.data();
+
+    // Маска шума своя у каждого блока, поэтому блоки обрабатываются в любом порядке
+    withEngine(engine, [&](auto* tag) {
+        using Engine = std::remove_pointer_t<decltype(tag)>;
+        NoiseMask<Engine> mask(key, audioNoiseStream(blockOf(block.firstSample)), noiseDensity);
+        const bool noisy = mask.changeThreshold() != 0;
+        for (size_t i = 0; i < block.sampleCount; i++) {
+            const int direction = noisy ? mask.next() : 0;
+            uint8_t* sample = data + i * bytesPerSample;
+            if (marks[i]) {
+                sample[0] = static_cast<uint8_t>((sample[0] & 0xFE) | (marks[i] - 1));
+            } else if (direction != 0) {
+                nudgeSample(sample, bytesPerSample, direction);
+            }
+        }
+    });
+}
+
+// LSB всех отсчётов; потоки читают свои диапазоны блоков, а блок кратен 64 отсчётам,
+// поэтому слова плоскости не делятся между потоками
+LsbPlane readSamplePlane(const AudioHandler::WavFile& carrier, unsigned int threadCount) {
+    constexpr size_t BLOCK = AudioHandler::WavFile::BLOCK_SAMPLES;
+    const uint64_t sampleCount = carrier.size();
+    const uint64_t blocks = (sampleCount + BLOCK - 1) / BLOCK;
+    LsbPlane plane(static_cast<size_t>(sampleCount));
+    threadCount = static_cast<unsigned int>(std::max<uint64_t>(1, std::min<uint64_t>(threadCount, blocks)));
+    const unsigned int bytesPerSample = carrier.format().bytesPerSample();
+    Parallel::run(threadCount, [&](unsigned int t) {
+        Trace::Span span("sample plane");
+        const uint64_t firstBlock = blocks * t / threadCount;
+        const uint64_t lastBlock = blocks * (t + 1) / threadCount;
+        if (firstBlock >= lastBlock) return;
+        AudioHandler::WavFile reader = openWav(carrier.path());
+        std::vector<uint8_t> buffer;
+        for (uint64_t b = firstBlock; b < lastBlock; b++) {
+            const uint64_t first = b * BLOCK;
+            const size_t count = static_cast<size_t>(std::min<uint64_t>(BLOCK, sampleCount - first));
+            if (!reader.readSamples(first, count, buffer)) {
+                LOG_ERROR("Failed to read the samples of {}", carrier.path());
+                exit(EXIT_FAILURE);
+            }
+            for (size_t i = 0; i < count; i++) {
+                if (buffer[i * bytesPerSample] & 0x01) plane.set(static_cast<size_t>(first + i));
+            }
+        }
+    });
+    return plane;
+}
+
+// Плотная нагрузка пишется прямо в плоскость LSB всех отсчётов; при k = 1 их прежние значения не нужны
+SamplePayload densePayload(const AudioHandler::WavFile& carrier, std::vector<size_t>& positions,
+                           const std::vector<uint8_t>& message, const EmbedOptions& options, unsigned int threadCount) {
+    const size_t sampleCount = static_cast<size_t>(carrier.size());
+    SamplePayload payload;
+    payload.dense = true;
+    payload.count = positions.size();
+    payload.bits = options.matrixK > 1 ? readSamplePlane(carrier, threadCount) : LsbPlane(sampleCount);
+    embedIntoLsbs(payload.bits, positions, message, options);
+    payload.used = LsbPlane(sampleCount);
+    for (size_t position : positions) {
+        payload.used.set(position);
+    }
+    std::vector<size_t>().swap(positions);
+    return payload;
+}
+
+// Редкая нагрузка: LSB собираются по позициям, а сами позиции сортируются по отсчётам вместе с битами
+SamplePayload sparsePayload(const AudioHandler::WavFile& carrier, std::vector<size_t>& positions,
+                            const std::vector<uint8_t>& message, const EmbedOptions& options, unsigned int threadCount) {
+    std::vector<uint8_t> lsbs = options.matrixK > 1 ? readSampleLsbs(carrier, positions, threadCount)
+                                                    : std::vector<uint8_t>(positions.size());
+    embedIntoLsbs(lsbs, message, options);
+    Trace::Span span("sort by sample");
+    for (size_t i = 0; i < positions.size(); i++) {
+        if (lsbs[i]) positions[i] |= PAYLOAD_BIT;
+    }
+    std::sort(positions.begin(), positions.end(), [](size_t a, size_t b) { return (a & ~PAYLOAD_BIT) < (b & ~PAYLOAD_BIT); });
+    SamplePayload payload;
+    payload.count = positions.size();
+    payload.sorted = std::move(positions);
+    return payload;
+}
+
+} // namespace
+
+void embedAudio(const std::string& inFile, const std::string& outFile, const std::vector<uint8_t>& message,
+                const std::vector<uint8_t>& key, const EmbedOptions& options, unsigned int threadCount) {
+    AudioHandler::WavFile input = openWav(inFile);
+    const AudioHandler::WavFormat& format = input.format();
+    LOG_INFO("{}: {}-bit PCM, {} channels, {} Hz, {} samples", inFile, format.bitsPerSample, format.channels,
+             format.sampleRate, format.sampleCount());
+
+    // Нужны только позиции сообщения; при k > 1 код Хэмминга учитывает текущие LSB этих позиций
+    std::vector<size_t> positions = planPayloadPositions(static_cast<size_t>(input.size()), message, key, options);
+    threadCount = budgetWorkers(input, positions.size(), options, threadCount);
+    const SamplePayload payload = isDense(input.size(), positions.size())
+                                      ? densePayload(input, positions, message, options, threadCount)
+                                      : sparsePayload(input, positions, message, options, threadCount);
+
+    // Файл проходит блоками: следующий блок читается, пока потоки встраивают и пишется предыдущий
+    const unsigned int bytesPerSample = format.bytesPerSample();
+    AudioHandler::WavWriter writer(outFile);
+    size_t blocks = Parallel::pipeline<AudioHandler::WavBlock>(threadCount,
+        [&](AudioHandler::WavBlock& block) { return input.readBlock(block); },
+        [&](size_t, AudioHandler::WavBlock& block) {
+            if (block.sampleCount > 0) embedBlock(block, bytesPerSample, payload, key, options.engine, options.noiseDensity);
+        },
+        [&](size_t, AudioHandler::WavBlock& block) { writer.writeBlock(block); });
+    writer.close();
+    LOG_INFO("The message was embedded into {} of {} samples, {} blocks were streamed", payload.count, input.size(), blocks);
+}
+
+std::vector<uint8_t> readSampleLsbs(const AudioHandler::WavFile& carrier, const std::vector<size_t>& positions,
+                                    unsigned int threadCount) {
+    std::vector<uint8_t> lsbs(positions.size());
+    if (isDense(carrier.size(), positions.size())) {
+        const LsbPlane plane = readSamplePlane(carrier, threadCount);
+        for (size_t bit = 0; bit < positions.size(); bit++) {
+            lsbs[bit] = plane.test(positions[bit]);
+        }
+        return lsbs;
+    }
+
+    // Редкие позиции сортируются по отсчётам и читаются по блокам
+    std::vector<SampleEntry> entries(positions.size());
+    {
+        Trace::Span span("sort by sample");
+        for (size_t bit = 0; bit < positions.size(); bit++) {
+            entries[bit] = SampleEntry{ positions[bit], bit };
+        }
+        std::sort(entries.begin(), entries.end(), [](const SampleEntry& a, const SampleEntry& b) { return a.sample < b.sample; });
+    }
+
+    // Потоки делят позиции по границам блоков: каждый блок читает один поток
+    const size_t count = entries.size();
+    threadCount = static_cast<unsigned int>(std::min<size_t>(std::max(1u, threadCount),
+                                                             (count + MIN_POSITIONS_PER_WORKER - 1) / MIN_POSITIONS_PER_WORKER));
+    threadCount = std::max(1u, threadCount);
+    std::vector<size_t> bounds(threadCount + 1, count);
+    bounds[0] = 0;
+    for (unsigned int t = 1; t < threadCount; t++) {
+        size_t bound = std::max(bounds[t - 1], count * t / threadCount);
+        while (bound > 0 && bound < count && blockOf(entries[bound].sample) == blockOf(entries[bound - 1].sample)) bound++;
+        bounds[t] = bound;
+    }
+
+    const unsigned int bytesPerSample = carrier.format().bytesPerSample();
+    Parallel::run(threadCount, [&](unsigned int t) {
+        Trace::Span span("samples");
+        if (bounds[t] >= bounds[t + 1]) return;
+        AudioHandler::WavFile reader = openWav(carrier.path());
+        std::vector<uint8_t> buffer;
+        for (size_t begin = bounds[t]; begin < bounds[t + 1];) {
+            size_t end = begin + 1;
+            while (end < bounds[t + 1] && blockOf(entries[end].sample) == blockOf(entries[begin].sample)) end++;
+
+            // Плотный участок блока читается одним вызовом, редкие позиции - по одному отсчёту
+            const uint64_t first = entries[begin].sample;
+            const uint64_t span = entries[end - 1].sample - first + 1;
+            const bool dense = (end - begin) * SPARSE_READ_DIVISOR >= span;
+            if (dense && !reader.readSamples(first, static_cast<size_t>(span), buffer)) {
+                LOG_ERROR("Failed to read the samples of {}", carrier.path());
+                exit(EXIT_FAILURE);
+            }
+            for (size_t i = begin; i < end; i++) {
+                const SampleEntry& entry = entries[i];
+                if (dense) {
+                    lsbs[entry.bit] = buffer[(entry.sample - first) * bytesPerSample] & 0x01;
+                    continue;
+                }
+                if (!reader.readSamples(entry.sample, 1, buffer)) {
+                    LOG_ERROR("Failed to read the samples of {}", carrier.path());
+                    exit(EXIT_FAILURE);
+                }
+                lsbs[entry.bit] = buffer[0] & 0x01;
+            }
+            begin = end;
+        }
+    });
+    return lsbs;
+}
+
+} // namespace Stegano
@@ -0,0 +1,167 @@
+#include "cache_directory.h"
+#include "encryption/utils.h"
+#include "external/logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#define STEGANO_HAVE_FLOCK 1
+#endif
+
+namespace fs = std::filesystem;
+
+namespace CacheDirectory {
+
+namespace {
+
+constexpr const char* LOCK_FILE = ".lock";
+constexpr const char* STATS_FILE = "stats";
+constexpr const char* TEMP_PREFIX = ".tmp-";
+// Временные файлы старше часа остались от прерванных процессов
+constexpr auto STALE_TEMP_AGE = std::chrono::hours(1);
+
+// Счётчики хранятся строками "имя значение"; вызывается под Lock
+Stats readStats(const std::string& directory) {
+    Stats stats;
+    std::ifstream file(fs::path(directory) / STATS_FILE);
+    std::string name;
+    uint64_t value = 0;
+    while (file >> name >> value) {
+        if (name == "hits") stats.hits = value;
+        else if (name == "misses") stats.misses = value;
+        else if (name == "evictions") stats.evictions = value;
+    }
+    return stats;
+}
+
+void writeStats(const std::string& directory, const Stats& stats) {
+    std::ofstream file(fs::path(directory) / STATS_FILE, std::ios::trunc);
+    file << "hits " << stats.hits << "\nmisses " << stats.misses << "\nevictions " << stats.evictions << "\n";
+}
+
+bool isEntryName(const std::string& name, const std::string& extension) {
+    return name.size() > extension.size() && name[0] != '.' &&
+           name.compare(name.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+} // namespace
+
+Lock::Lock(const std::string& directory) {
+#ifdef STEGANO_HAVE_FLOCK
+    fd = ::open((fs::path(directory) / LOCK_FILE).string().c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd >= 0 && flock(fd, LOCK_EX) != 0) {
+        ::close(fd);
+        fd = -1;
+    }
+#else
+    (void)directory;
+#endif
+}
+
+Lock::~Lock() {
+#ifdef STEGANO_HAVE_FLOCK
+    if (fd >= 0) {
+        flock(fd, LOCK_UN);
+        ::close(fd);
+    }
+#endif
+}
+
+bool prepare(const std::string& directory) {
+    std::error_code ec;
+    fs::create_directories(directory, ec);
+    return fs::is_directory(directory, ec);
+}
+
+std::string entryPath(const std::string& directory, const std::string& key, const std::string& extension) {
+    return (fs::path(directory) / (key + extension)).string();
+}
+
+std::string temporaryPath(const std::string& directory, const std::string& key, const std::string& extension) {
+    return (fs::path(directory) / (TEMP_PREFIX + key + "-" + Utils::bytesToHex(Utils::getRandomBytes(8)) + extension)).string();
+}
+
+bool publish(const std::string& temporary, const std::string& path) {
+    std::error_code ec;
+    fs::rename(temporary, path, ec);
+    if (ec) {
+        LOG_WARN("Failed to add the cache entry {}: {}", path, ec.message());
+        fs::remove(temporary, ec);
+        return false;
+    }
+    return true;
+}
+
+void touch(const std::string& path) {
+    // Время изменения записи служит временем последнего использования для LRU
+    std::error_code ec;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+}
+
+Stats record(const std::string& directory, uint64_t hits, uint64_t misses) {
+    Lock lock(directory);
+    Stats stats = readStats(directory);
+    stats.hits += hits;
+    stats.misses += misses;
+    writeStats(directory, stats);
+    return stats;
+}
+
+Stats stats(const std::string& directory) {
+    Lock lock(directory);
+    return readStats(directory);
+}
+
+void evict(const std::string& directory, uint64_t limit, const std::string& extension) {
+    struct Entry {
+        fs::path path;
+        uint64_t size = 0;
+        fs::file_time_type used;
+    };
+
+    Lock lock(directory);
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+    const auto now = fs::file_time_type::clock::now();
+    std::error_code ec;
+    for (const auto& item : fs::directory_iterator(directory, ec)) {
+        std::error_code itemError;
+        if (!item.is_regular_file(itemError)) continue;
+        const std::string name = item.path().filename().string();
+        auto used = item.last_write_time(itemError);
+        if (itemError) continue;
+        if (name.rfind(TEMP_PREFIX, 0) == 0) {
+            if (now - used > STALE_TEMP_AGE) fs::remove(item.path(), itemError);
+            continue;
+        }
+        if (!isEntryName(name, extension)) continue;
+        uint64_t size = item.file_size(itemError);
+        if (itemError) continue;
+        entries.push_back(Entry{ item.path(), size, used });
+        total += size;
+    }
+    if (total <= limit) return;
+
+    // Сначала удаляются давно не использованные записи; отображённые другими процессами файлы
+    // остаются доступны им до закрытия
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.used < b.used; });
+    Stats stats = readStats(directory);
+    for (const Entry& entry : entries) {
+        if (total <= limit) break;
+        if (fs::remove(entry.path, ec)) {
+            total -= entry.size;
+            stats.evictions++;
+        }
+    }
+    writeStats(directory, stats);
+    LOG_INFO("The cache {} was trimmed to {} bytes ({} evictions in total)", directory, total, stats.evictions);
+}
+
+} // namespace CacheDirectory
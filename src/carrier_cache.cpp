@@ -0,0 +1,130 @@
+#include "carrier_cache.h"
+#include "encryption/utils.h"
+#include "external/logger.h"
+#include "trace.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <openssl/evp.h>
+
+namespace fs = std::filesystem;
+
+namespace ImageHandler {
+
+namespace {
+
+constexpr const char* ENTRY_EXTENSION = ".pam";
+
+// SHA-256 содержимого файла, читаемого блоками
+std::optional<std::vector<uint8_t>> hashFile(const std::string& filename) {
+    FILE* in = std::fopen(filename.c_str(), "rb");
+    if (!in) return std::nullopt;
+    EVP_MD_CTX* context = EVP_MD_CTX_new();
+    bool success = context && EVP_DigestInit_ex(context, EVP_sha256(), nullptr) == 1;
+    std::vector<uint8_t> chunk(1 << 20);
+    size_t readBytes = 0;
+    while (success && (readBytes = std::fread(chunk.data(), 1, chunk.size(), in)) > 0) {
+        success = EVP_DigestUpdate(context, chunk.data(), readBytes) == 1;
+    }
+    success = success && !std::ferror(in);
+    std::vector<uint8_t> digest(EVP_MAX_MD_SIZE);
+    unsigned int digestLength = 0;
+    success = success && EVP_DigestFinal_ex(context, digest.data(), &digestLength) == 1;
+    EVP_MD_CTX_free(context);
+    std::fclose(in);
+    if (!success) return std::nullopt;
+    digest.resize(digestLength);
+    return digest;
+}
+
+} // namespace
+
+CarrierCache::CarrierCache(std::string directory, uint64_t limit)
+    : directory(std::move(directory)), limit(limit) {
+    usable = CacheDirectory::prepare(this->directory);
+    if (!usable) {
+        LOG_WARN("The cache directory {} cannot be created, images are decoded without the cache", this->directory);
+    }
+}
+
+std::optional<std::string> CarrierCache::entryKey(const std::string& filename) {
+    std::error_code ec;
+    fs::path canonical = fs::canonical(filename, ec);
+    if (ec) return std::nullopt;
+    uint64_t size = fs::file_size(canonical, ec);
+    if (ec) return std::nullopt;
+    auto modified = fs::last_write_time(canonical, ec).time_since_epoch().count();
+    if (ec) return std::nullopt;
+    auto content = hashFile(canonical.string());
+    if (!content) return std::nullopt;
+
+    // Ключ = SHA-256(путь || размер || время изменения || SHA-256 содержимого)
+    std::string material = canonical.string() + '\0' + std::to_string(size) + '\0' + std::to_string(modified) + '\0';
+    material.append(content->begin(), content->end());
+    std::vector<uint8_t> key(EVP_MAX_MD_SIZE);
+    unsigned int keyLength = 0;
+    if (EVP_Digest(material.data(), material.size(), key.data(), &keyLength, EVP_sha256(), nullptr) != 1) {
+        return std::nullopt;
+    }
+    key.resize(keyLength);
+    return Utils::bytesToHex(key);
+}
+
+std::optional<MappedImage> CarrierCache::load(const std::string& filename) {
+    Trace::Span span("cache lookup");
+    if (!usable || isStdStream(filename) || !fileExists(filename)) return std::nullopt;
+    auto key = entryKey(filename);
+    if (!key) return std::nullopt;
+    keys[filename] = *key;
+
+    const std::string path = CacheDirectory::entryPath(directory, *key, ENTRY_EXTENSION);
+    std::error_code ec;
+    std::optional<MappedImage> entry;
+    if (fs::exists(path, ec)) {
+        entry = MappedImage::open(path, false);
+        if (!entry) {
+            // Повреждённая запись (например, после сбоя питания) пересоздаётся
+            fs::remove(path, ec);
+        }
+    }
+    if (entry) {
+        CacheDirectory::touch(path);
+    }
+    record(entry ? 1 : 0, entry ? 0 : 1);
+    return entry;
+}
+
+void CarrierCache::store(const std::string& filename, const Image& image) {
+    auto found = keys.find(filename);
+    if (!usable || found == keys.end()) return;
+    Trace::Span span("cache store");
+    if (image.data.size() > limit) {
+        LOG_DEBUG("{} is larger than the cache limit and is not cached", filename);
+        return;
+    }
+
+    // Запись появляется атомарным переименованием: другие процессы видят либо целый файл, либо ничего
+    const std::string path = CacheDirectory::entryPath(directory, found->second, ENTRY_EXTENSION);
+    const std::string temporary = CacheDirectory::temporaryPath(directory, found->second, ENTRY_EXTENSION);
+    if (!writeNetpbm(temporary, image)) {
+        LOG_WARN("Failed to write the cache entry for {}", filename);
+        std::error_code ec;
+        fs::remove(temporary, ec);
+        return;
+    }
+    if (!CacheDirectory::publish(temporary, path)) return;
+    LOG_INFO("The decoded pixels of {} were added to the cache {}", filename, directory);
+    CacheDirectory::evict(directory, limit, ENTRY_EXTENSION);
+}
+
+CarrierCacheStats CarrierCache::stats() const {
+    return CacheDirectory::stats(directory);
+}
+
+void CarrierCache::record(uint64_t hits, uint64_t misses) {
+    CarrierCacheStats stats = CacheDirectory::record(directory, hits, misses);
+    LOG_INFO("Carrier cache {}: {} hits, {} misses, {} evictions in {}", hits > 0 ? "hit" : "miss",
+             stats.hits, stats.misses, stats.evictions, directory);
+}
+
+} // namespace ImageHandler
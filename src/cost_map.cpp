@@ -0,0 +1,153 @@
+#include "cost_map.h"
+#include "parallel.h"
+#include "trace.h"
+#include "external/logger.h"
+
+#include <algorithm>
+#include <array>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define STEGANO_COST_MAP_SSE2 1
+#endif
+
+namespace Stegano {
+
+namespace {
+
+// Модуль разности по битам 1..7 (бит 0 меняется при встраивании и не учитывается)
+inline int texelDiff(uint8_t a, uint8_t b) {
+    int diff = static_cast<int>(a >> 1) - static_cast<int>(b >> 1);
+    return diff < 0 ? -diff : diff;
+}
+
+inline uint8_t scalarCost(const uint8_t* up, const uint8_t* row, const uint8_t* down, size_t j, size_t rowBytes, size_t channels) {
+    uint8_t center = row[j];
+    uint8_t left = j >= channels ? row[j - channels] : center;
+    uint8_t right = j + channels < rowBytes ? row[j + channels] : center;
+    int sum = texelDiff(center, left) + texelDiff(center, right) + texelDiff(center, up[j]) + texelDiff(center, down[j]);
+    return static_cast<uint8_t>(std::min(sum, 255));
+}
+
+#ifdef STEGANO_COST_MAP_SSE2
+inline __m128i texels(__m128i v) {
+    return _mm_and_si128(_mm_srli_epi16(v, 1), _mm_set1_epi8(0x7F));
+}
+
+inline __m128i absDiff(__m128i a, __m128i b) {
+    return _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+}
+#endif
+
+// Стоимость одной строки; up/down указывают на соседние строки (на границе - на саму строку)
+void costRow(const uint8_t* up, const uint8_t* row, const uint8_t* down, uint8_t* out, size_t rowBytes, size_t channels) {
+    size_t j = 0;
+    // Левая граница (нет левого соседа) - скалярно
+    for (; j < std::min(channels, rowBytes); j++) {
+        out[j] = scalarCost(up, row, down, j, rowBytes, channels);
+    }
+#ifdef STEGANO_COST_MAP_SSE2
+    // Внутренняя часть: 16 байт за итерацию, насыщающее сложение совпадает с min(sum, 255)
+    for (; j + channels + 16 <= rowBytes; j += 16) {
+        __m128i center = texels(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + j)));
+        __m128i left   = texels(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + j - channels)));
+        __m128i right  = texels(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + j + channels)));
+        __m128i above  = texels(_mm_loadu_si128(reinterpret_cast<const __m128i*>(up + j)));
+        __m128i below  = texels(_mm_loadu_si128(reinterpret_cast<const __m128i*>(down + j)));
+        __m128i cost = _mm_adds_epu8(_mm_adds_epu8(absDiff(center, left), absDiff(center, right)),
+                                     _mm_adds_epu8(absDiff(center, above), absDiff(center, below)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + j), cost);
+    }
+#endif
+    for (; j < rowBytes; j++) {
+        out[j] = scalarCost(up, row, down, j, rowBytes, channels);
+    }
+}
+
+std::array<size_t, 256> costHistogram(const std::vector<uint8_t>& costMap) {
+    std::array<size_t, 256> histogram{};
+    for (uint8_t cost : costMap) {
+        histogram[cost]++;
+    }
+    return histogram;
+}
+
+// Наибольший порог T, при котором не меньше target байт имеют стоимость >= T
+uint8_t levelThreshold(const std::array<size_t, 256>& histogram, size_t target) {
+    size_t accumulated = 0;
+    for (int threshold = 255; threshold > 0; threshold--) {
+        accumulated += histogram[threshold];
+        if (accumulated >= target) return static_cast<uint8_t>(threshold);
+    }
+    return 0;
+}
+
+size_t levelTarget(size_t n, uint8_t level) {
+    return std::max<size_t>(1, n >> level);
+}
+
+size_t countAtLevel(const std::array<size_t, 256>& histogram, size_t n, uint8_t level) {
+    uint8_t threshold = levelThreshold(histogram, levelTarget(n, level));
+    size_t count = 0;
+    for (int cost = threshold; cost < 256; cost++) {
+        count += histogram[cost];
+    }
+    return count;
+}
+
+} // namespace
+
+std::vector<uint8_t> computeCostMap(const ImageHandler::Image& image, unsigned int threadCount) {
+    const size_t rowBytes = static_cast<size_t>(image.width) * image.channels;
+    const size_t rows = static_cast<size_t>(image.height);
+    std::vector<uint8_t> costMap(image.data.size());
+    if (rowBytes == 0 || rows == 0) return costMap;
+
+    const uint8_t* data = image.data.data();
+    threadCount = static_cast<unsigned int>(std::min<size_t>(std::max(1u, threadCount), rows));
+    const size_t bandRows = (rows + threadCount - 1) / threadCount;
+
+    Parallel::run(threadCount, [&](unsigned int band) {
+        Trace::Span span("cost map");
+        size_t firstRow = band * bandRows;
+        size_t lastRow = std::min(rows, firstRow + bandRows);
+        for (size_t y = firstRow; y < lastRow; y++) {
+            const uint8_t* row = data + y * rowBytes;
+            const uint8_t* up = y > 0 ? row - rowBytes : row;
+            const uint8_t* down = y + 1 < rows ? row + rowBytes : row;
+            costRow(up, row, down, costMap.data() + y * rowBytes, rowBytes, static_cast<size_t>(image.channels));
+        }
+    });
+
+    LOG_INFO("Cost map was computed for {}x{} image in {} bands", image.width, image.height, threadCount);
+    return costMap;
+}
+
+std::vector<size_t> selectTexturedPositions(const std::vector<uint8_t>& costMap, uint8_t level) {
+    Trace::Span span("select candidates");
+    std::array<size_t, 256> histogram = costHistogram(costMap);
+    uint8_t threshold = levelThreshold(histogram, levelTarget(costMap.size(), level));
+
+    std::vector<size_t> positions;
+    positions.reserve(countAtLevel(histogram, costMap.size(), level));
+    for (size_t i = 0; i < costMap.size(); i++) {
+        if (costMap[i] >= threshold) positions.push_back(i);
+    }
+    return positions;
+}
+
+size_t countTexturedPositions(const std::vector<uint8_t>& costMap, uint8_t level) {
+    return countAtLevel(costHistogram(costMap), costMap.size(), level);
+}
+
+uint8_t chooseAdaptiveLevel(const std::vector<uint8_t>& costMap, size_t requiredPositions) {
+    std::array<size_t, 256> histogram = costHistogram(costMap);
+    for (uint8_t level = MAX_ADAPTIVE_LEVEL; level >= 1; level--) {
+        if (countAtLevel(histogram, costMap.size(), level) / 2 >= requiredPositions) {
+            return level;
+        }
+    }
+    return 0;
+}
+
+} // namespace Stegano
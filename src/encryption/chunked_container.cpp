@@ -0,0 +1,163 @@
+#include "encryption/chunked_container.h"
+#include "external/logger.h"
+#include "trace.h"
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <algorithm>
+#include <memory>
+
+namespace ChunkedContainer {
+
+namespace {
+    using CipherContext = std::unique_ptr<EVP_CIPHER_CTX, decltype(&EVP_CIPHER_CTX_free)>;
+
+    uint64_t chunkCount(uint64_t messageLength) {
+        return std::max<uint64_t>(1, (messageLength + DataConversion::CHUNK_SIZE - 1) / DataConversion::CHUNK_SIZE);
+    }
+
+    // Одноразовый номер блока: к последним 8 байтам базового номера прибавляется индекс
+    void chunkNonce(const uint8_t* base, uint64_t index, uint8_t* out) {
+        std::copy(base, base + DataConversion::CHUNK_NONCE_SIZE, out);
+        const size_t counterOffset = DataConversion::CHUNK_NONCE_SIZE - 8;
+        std::vector<uint8_t> counterBytes(out + counterOffset, out + DataConversion::CHUNK_NONCE_SIZE);
+        std::vector<uint8_t> sum = DataConversion::uint64ToBytes(DataConversion::bytesToUint64(counterBytes) + index);
+        std::copy(sum.begin(), sum.end(), out + counterOffset);
+    }
+
+    // Дополнительные данные блока: индекс и полная длина сообщения
+    std::vector<uint8_t> chunkAad(const Layout& layout, uint64_t index) {
+        std::vector<uint8_t> aad = DataConversion::uint64ToBytes(index);
+        std::vector<uint8_t> length = DataConversion::uint64ToBytes(layout.messageLength);
+        aad.insert(aad.end(), length.begin(), length.end());
+        return aad;
+    }
+
+    CipherContext newContext() {
+        CipherContext ctx(EVP_CIPHER_CTX_new(), EVP_CIPHER_CTX_free);
+        if (!ctx) {
+            LOG_ERROR("Failed to create EVP_CIPHER_CTX");
+            exit(EXIT_FAILURE);
+        }
+        return ctx;
+    }
+
+    void checkKey(const std::vector<uint8_t>& key) {
+        // Проверка: ключ должен быть ровно 32 байта для AES-256
+        if (key.size() != 32) {
+            LOG_ERROR("Key size must be 32 bytes for AES-256");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+uint64_t containerSize(uint64_t messageLength) {
+    return PREFIX_SIZE + messageLength + chunkCount(messageLength) * DataConversion::CHUNK_TAG_SIZE;
+}
+
+std::optional<Layout> layoutFromLength(uint64_t containerLength) {
+    if (containerLength < PREFIX_SIZE + DataConversion::CHUNK_TAG_SIZE) return std::nullopt;
+    const uint64_t body = containerLength - PREFIX_SIZE;
+    const uint64_t stride = DataConversion::CHUNK_SIZE + DataConversion::CHUNK_TAG_SIZE;
+    Layout layout;
+    layout.chunkCount = (body + stride - 1) / stride;
+    layout.messageLength = body - layout.chunkCount * DataConversion::CHUNK_TAG_SIZE;
+    // Длина из заголовка должна быть длиной контейнера какого-то сообщения
+    if (containerSize(layout.messageLength) != containerLength) return std::nullopt;
+    return layout;
+}
+
+ChunkSpan chunkSpan(const Layout& layout, uint64_t index) {
+    ChunkSpan span;
+    span.offset = PREFIX_SIZE + index * (DataConversion::CHUNK_SIZE + DataConversion::CHUNK_TAG_SIZE);
+    uint64_t plainOffset = index * DataConversion::CHUNK_SIZE;
+    uint64_t plainLength = std::min<uint64_t>(DataConversion::CHUNK_SIZE, layout.messageLength - std::min(layout.messageLength, plainOffset));
+    span.length = plainLength + DataConversion::CHUNK_TAG_SIZE;
+    return span;
+}
+
+std::vector<uint8_t> seal(const std::vector<uint8_t>& plaintext, const std::vector<uint8_t>& salt,
+                          const std::vector<uint8_t>& key) {
+    std::optional<std::vector<uint8_t>> container = trySeal(plaintext, salt, key);
+    if (!container) {
+        exit(EXIT_FAILURE);
+    }
+    return std::move(*container);
+}
+
+std::optional<std::vector<uint8_t>> trySeal(const std::vector<uint8_t>& plaintext, const std::vector<uint8_t>& salt,
+                                            const std::vector<uint8_t>& key) {
+    Trace::Span span("encrypt chunks");
+    if (key.size() != 32) {
+        LOG_ERROR("Key size must be 32 bytes for AES-256");
+        return std::nullopt;
+    }
+    Layout layout{ plaintext.size(), chunkCount(plaintext.size()) };
+    std::vector<uint8_t> container(containerSize(plaintext.size()));
+    std::copy(salt.begin(), salt.end(), container.begin());
+    uint8_t* baseNonce = container.data() + DataConversion::SALT_SIZE;
+    if (RAND_bytes(baseNonce, DataConversion::CHUNK_NONCE_SIZE) != 1) {
+        LOG_ERROR("Failed to generate random nonce");
+        return std::nullopt;
+    }
+
+    CipherContext ctx(EVP_CIPHER_CTX_new(), EVP_CIPHER_CTX_free);
+    if (!ctx || EVP_EncryptInit_ex(ctx.get(), EVP_aes_256_gcm(), nullptr, nullptr, nullptr) != 1 ||
+        EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_SET_IVLEN, DataConversion::CHUNK_NONCE_SIZE, nullptr) != 1) {
+        LOG_ERROR("EVP_EncryptInit_ex failed");
+        return std::nullopt;
+    }
+    for (uint64_t index = 0; index < layout.chunkCount; index++) {
+        ChunkSpan chunk = chunkSpan(layout, index);
+        const size_t plainLength = static_cast<size_t>(chunk.length - DataConversion::CHUNK_TAG_SIZE);
+        const uint8_t* in = plaintext.data() + index * DataConversion::CHUNK_SIZE;
+        uint8_t* out = container.data() + chunk.offset;
+        uint8_t nonce[DataConversion::CHUNK_NONCE_SIZE];
+        chunkNonce(baseNonce, index, nonce);
+        std::vector<uint8_t> aad = chunkAad(layout, index);
+
+        int len = 0;
+        if (EVP_EncryptInit_ex(ctx.get(), nullptr, nullptr, key.data(), nonce) != 1 ||
+            EVP_EncryptUpdate(ctx.get(), nullptr, &len, aad.data(), static_cast<int>(aad.size())) != 1 ||
+            (plainLength > 0 && EVP_EncryptUpdate(ctx.get(), out, &len, in, static_cast<int>(plainLength)) != 1) ||
+            EVP_EncryptFinal_ex(ctx.get(), out + plainLength, &len) != 1 ||
+            EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_GET_TAG, DataConversion::CHUNK_TAG_SIZE, out + plainLength) != 1) {
+            LOG_ERROR("Chunk encryption failed");
+            return std::nullopt;
+        }
+    }
+
+    LOG_INFO("Cryption went successful: {} chunks of up to {} bytes", layout.chunkCount, DataConversion::CHUNK_SIZE);
+    return container;
+}
+
+std::optional<std::vector<uint8_t>> openChunk(const std::vector<uint8_t>& chunk, const uint8_t* nonce,
+                                              const std::vector<uint8_t>& key, const Layout& layout, uint64_t index) {
+    checkKey(key);
+    if (chunk.size() < DataConversion::CHUNK_TAG_SIZE) return std::nullopt;
+    const size_t cipherLength = chunk.size() - DataConversion::CHUNK_TAG_SIZE;
+    uint8_t chunkIv[DataConversion::CHUNK_NONCE_SIZE];
+    chunkNonce(nonce, index, chunkIv);
+    std::vector<uint8_t> aad = chunkAad(layout, index);
+    std::vector<uint8_t> tag(chunk.end() - DataConversion::CHUNK_TAG_SIZE, chunk.end());
+
+    CipherContext ctx = newContext();
+    std::vector<uint8_t> plaintext(cipherLength);
+    int len = 0;
+    if (EVP_DecryptInit_ex(ctx.get(), EVP_aes_256_gcm(), nullptr, nullptr, nullptr) != 1 ||
+        EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_SET_IVLEN, DataConversion::CHUNK_NONCE_SIZE, nullptr) != 1 ||
+        EVP_DecryptInit_ex(ctx.get(), nullptr, nullptr, key.data(), chunkIv) != 1 ||
+        EVP_DecryptUpdate(ctx.get(), nullptr, &len, aad.data(), static_cast<int>(aad.size())) != 1 ||
+        (cipherLength > 0 && EVP_DecryptUpdate(ctx.get(), plaintext.data(), &len, chunk.data(), static_cast<int>(cipherLength)) != 1) ||
+        EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_SET_TAG, DataConversion::CHUNK_TAG_SIZE, tag.data()) != 1) {
+        LOG_ERROR("Chunk decryption could not be initialized");
+        exit(EXIT_FAILURE);
+    }
+    // Тег проверяется при завершении: чужой ключ или испорченные данные
+    if (EVP_DecryptFinal_ex(ctx.get(), plaintext.data() + cipherLength, &len) != 1) {
+        LOG_DEBUG("Chunk {} failed authentication", index);
+        return std::nullopt;
+    }
+    return plaintext;
+}
+
+} // namespace ChunkedContainer
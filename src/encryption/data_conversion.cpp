@@ -27,4 +27,48 @@ namespace DataConversion {
         value |= (static_cast<uint32_t>(bytes[3]));
         return value;
     }
+
+    std::vector<uint8_t> uint64ToBytes(uint64_t value) {
+        std::vector<uint8_t> bytes = uint32ToBytes(static_cast<uint32_t>(value >> 32));
+        std::vector<uint8_t> low = uint32ToBytes(static_cast<uint32_t>(value));
+        bytes.insert(bytes.end(), low.begin(), low.end());
+        return bytes;
+    }
+
+    uint64_t bytesToUint64(const std::vector<uint8_t>& bytes) {
+        if (bytes.size() != 8) {
+            LOG_ERROR("Unright size of a head for uint64_t");
+            exit(EXIT_FAILURE);
+        }
+        uint64_t high = bytesToUint32(std::vector<uint8_t>(bytes.begin(), bytes.begin() + 4));
+        uint64_t low = bytesToUint32(std::vector<uint8_t>(bytes.begin() + 4, bytes.end()));
+        return (high << 32) | low;
+    }
+
+    std::vector<uint8_t> headerToBytes(const ContainerHeader& header) {
+        std::vector<uint8_t> bytes = uint64ToBytes(header.containerLength);
+        bytes.push_back(header.engine);
+        bytes.push_back(header.adaptiveLevel);
+        bytes.push_back(header.matrixK);
+        bytes.push_back(static_cast<uint8_t>(header.layout));
+        return bytes;
+    }
+
+    ContainerHeader bytesToHeader(const std::vector<uint8_t>& bytes) {
+        if (bytes.size() != HEADER_SIZE) {
+            LOG_ERROR("Unright size of a container header");
+            exit(EXIT_FAILURE);
+        }
+        ContainerHeader header;
+        header.containerLength = bytesToUint64(std::vector<uint8_t>(bytes.begin(), bytes.begin() + LENGTH_SIZE));
+        header.engine = bytes[LENGTH_SIZE];
+        header.adaptiveLevel = bytes[LENGTH_SIZE + 1];
+        header.matrixK = bytes[LENGTH_SIZE + 2];
+        header.layout = static_cast<ContainerLayout>(bytes[LENGTH_SIZE + 3]);
+        return header;
+    }
+
+    ContainerLayout layoutForMessage(size_t messageLength) {
+        return messageLength > CHUNK_SIZE ? ContainerLayout::Chunked : ContainerLayout::Single;
+    }
 }
\ No newline at end of file
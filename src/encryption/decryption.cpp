@@ -4,51 +4,485 @@
 #include <openssl/rand.h>
 #include <cstdint>
 #include <vector>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <memory>
+#include "parallel.h"
+#include "tiled_stegano.h"
+#include "audio_stegano.h"
+#include "memory_budget.h"
+#include "trace.h"
+#include "encryption/chunked_container.h"
 
-namespace Decryption{
-    
-    std::string getDecryptedMessage(const CliConfig& config, ImageHandler::Image& image, std::vector<uint8_t>& steganoKey){
-    // Сначала извлекаем заголовок (4 байта) из изображения
-    std::vector<uint8_t> header = Stegano::extractData(image, DataConversion::HEADER_SIZE, steganoKey);
-    uint32_t containerLength = DataConversion::bytesToUint32(header);
+namespace {
+    // Доступ к байтам носителя: декодированное изображение или отображённый файл
+    struct DecodedCarrier {
+        const ImageHandler::Image& image;
+
+        size_t size() const { return image.data.size(); }
+        const uint8_t* bytes() const { return image.data.data(); }
+        void mapPositions(std::vector<size_t>&) const {}
+        std::vector<uint8_t> costMap() const {
+            MemoryBudget::require(MemoryBudget::adaptiveBytes(size(), true), "The adaptive cost map");
+            return Stegano::computeCostMap(image, Parallel::defaultThreadCount());
+        }
+    };
+
+    struct MappedCarrier {
+        const ImageHandler::MappedImage& mapped;
+
+        size_t size() const { return mapped.size(); }
+        const uint8_t* bytes() const { return mapped.bytes(); }
+        void mapPositions(std::vector<size_t>& positions) const { mapped.mapPositions(positions); }
+        std::vector<uint8_t> costMap() const {
+            MemoryBudget::require(MemoryBudget::adaptiveBytes(size(), false), "The adaptive cost map");
+            return Stegano::computeCostMap(mapped.toImage(), Parallel::defaultThreadCount());
+        }
+    };
+
+    // Плиточный TIFF: байты не лежат подряд, поэтому читаются LSB нужных позиций (только их плитки)
+    struct TiledCarrier {
+        const ImageHandler::TiledTiff& tiff;
+
+        size_t size() const { return static_cast<size_t>(tiff.size()); }
+        std::vector<uint8_t> costMap() const {
+            // Адаптивный режим не используется при встраивании в плиточные носители
+            return {};
+        }
+    };
+
+    // PCM WAV: позиции - отсчёты, их LSB читаются через дескриптор файла (только нужные участки)
+    struct SampleCarrier {
+        const AudioHandler::WavFile& audio;
+
+        size_t size() const { return static_cast<size_t>(audio.size()); }
+        std::vector<uint8_t> costMap() const {
+            // Адаптивный режим не используется при встраивании в аудио
+            return {};
+        }
+    };
+
+    Decryption::ExtractResult decryptContainer(const std::string& passphrase, const std::vector<uint8_t>& container);
+
+    // Оставляет в расшифрованном сообщении только байты [offset, offset + length), обрезая по концу
+    void sliceMessage(Decryption::ExtractResult& result, uint64_t offset, uint64_t length) {
+        if (result.status != Decryption::ExtractStatus::Ok) return;
+        size_t begin = static_cast<size_t>(std::min<uint64_t>(offset, result.message.size()));
+        size_t count = static_cast<size_t>(std::min<uint64_t>(length, result.message.size() - begin));
+        result.message = result.message.substr(begin, count);
+    }
+
+    // Позиции переводятся в смещения носителя и читаются как k = 1 (бит на позицию) или кодом Хэмминга
+    template <typename Carrier>
+    std::vector<uint8_t> readBytes(const Carrier& carrier, std::vector<size_t> positions, size_t length, uint8_t matrixK) {
+        carrier.mapPositions(positions);
+        return Stegano::matrixExtract(carrier.bytes(), positions.data(), length, matrixK);
+    }
+
+    // Декодированный буфер: плотные позиции читаются через упакованную плоскость LSB
+    std::vector<uint8_t> readBytes(const DecodedCarrier& carrier, const std::vector<size_t>& positions, size_t length, uint8_t matrixK) {
+        return Stegano::matrixExtract(carrier.bytes(), carrier.size(), positions.data(), length, matrixK);
+    }
+
+    std::vector<uint8_t> readBytes(const TiledCarrier& carrier, const std::vector<size_t>& positions, size_t length, uint8_t matrixK) {
+        std::vector<uint8_t> lsbs = Stegano::readTiledLsbs(carrier.tiff, positions, Parallel::defaultThreadCount());
+        std::vector<size_t> order(lsbs.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        return Stegano::matrixExtract(lsbs.data(), order.data(), length, matrixK);
+    }
+
+    std::vector<uint8_t> readBytes(const SampleCarrier& carrier, const std::vector<size_t>& positions, size_t length, uint8_t matrixK) {
+        std::vector<uint8_t> lsbs = Stegano::readSampleLsbs(carrier.audio, positions, Parallel::defaultThreadCount());
+        std::vector<size_t> order(lsbs.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        return Stegano::matrixExtract(lsbs.data(), order.data(), length, matrixK);
+    }
+
+    // Найденный заголовок и позиции байтов контейнера: продолжение перемешанного потока (один шифртекст)
+    // или индексная перестановка (блочный контейнер), в которой тело начинается с индекса bodyBase
+    struct LocatedContainer {
+        Decryption::ExtractStatus status = Decryption::ExtractStatus::KeyMismatch;
+        DataConversion::ContainerHeader header;
+        std::optional<Stegano::PositionStream> stream;
+        std::optional<Stegano::IndexedPositions> indexed;
+        size_t bodyBase = 0;
+    };
+
+    constexpr DataConversion::ContainerLayout ALL_LAYOUTS[] = { DataConversion::ContainerLayout::Single,
+                                                                DataConversion::ContainerLayout::Chunked };
+
+    template <typename Carrier>
+    LocatedContainer locateContainer(const Carrier& carrier, const std::vector<uint8_t>& steganoKey) {
+    using Decryption::ExtractStatus;
+    using DataConversion::ContainerLayout;
+    LocatedContainer located;
+
+    const size_t prefixSize = DataConversion::HEADER_SIZE + DataConversion::KEY_CHECK_SIZE;
+    if (prefixSize > carrier.size() / 8) {
+        located.status = ExtractStatus::CapacityExceeded;
+        return located;
+    }
+
+    // Идентификатор движка и раскладка лежат в самом заголовке, поэтому пробуем каждую пару:
+    // позиции генерируются лениво, и на чужой паре проверочное значение не сойдётся после 128 бит
+    std::vector<size_t> prefixPositions;
+    bool found = false;
+    for (Stegano::EngineId engine : Stegano::ALL_ENGINES) {
+        for (ContainerLayout layout : ALL_LAYOUTS) {
+            std::optional<Stegano::PositionStream> candidate;
+            std::optional<Stegano::IndexedPositions> candidateIndexed;
+            std::vector<size_t> candidatePositions;
+            if (layout == ContainerLayout::Single) {
+                candidate.emplace(carrier.size(), steganoKey, engine);
+                candidatePositions = candidate->take(prefixSize * 8);
+            } else {
+                candidateIndexed.emplace(carrier.size(), steganoKey, engine);
+                candidatePositions = candidateIndexed->range(0, prefixSize * 8);
+            }
+
+            // Сначала извлекаем заголовок и проверочное значение ключа
+            std::vector<uint8_t> prefix = readBytes(carrier, candidatePositions, prefixSize, 1);
+            std::vector<uint8_t> headerBytes(prefix.begin(), prefix.begin() + DataConversion::HEADER_SIZE);
+            std::vector<uint8_t> keyCheck(prefix.begin() + DataConversion::HEADER_SIZE, prefix.end());
+
+            // Неверный ключ отбрасываем до KDF и до извлечения всего контейнера
+            if (keyCheck != Utils::computeKeyCheck(headerBytes, steganoKey, DataConversion::KEY_CHECK_SIZE)) continue;
+            DataConversion::ContainerHeader header = DataConversion::bytesToHeader(headerBytes);
+            if (header.engine != static_cast<uint8_t>(engine) || header.layout != layout) continue;
+            located.header = header;
+            located.stream = std::move(candidate);
+            located.indexed = std::move(candidateIndexed);
+            prefixPositions = std::move(candidatePositions);
+            found = true;
+            break;
+        }
+        if (found) break;
+    }
+    const DataConversion::ContainerHeader& header = located.header;
+    if (!found || header.adaptiveLevel > Stegano::MAX_ADAPTIVE_LEVEL ||
+        header.matrixK < 1 || header.matrixK > Stegano::MAX_MATRIX_K) {
+        located.status = ExtractStatus::KeyMismatch;
+        return located;
+    }
+
+    size_t available = 0;
+    if (header.layout == ContainerLayout::Single) {
+        if (header.adaptiveLevel > 0) {
+            // Адаптивный режим: контейнер лежит на текстурных байтах; карта стоимости не зависит от LSB,
+            // поэтому совпадает с картой, построенной при встраивании
+            std::vector<uint8_t> costMap = carrier.costMap();
+            auto candidates = std::make_shared<const std::vector<size_t>>(Stegano::selectTexturedPositions(costMap, header.adaptiveLevel));
+            located.stream.emplace(candidates, steganoKey, located.stream->engine());
+            located.stream->exclude(prefixPositions);
+        }
+        available = located.stream->remaining();
+    } else {
+        if (!ChunkedContainer::layoutFromLength(header.containerLength)) {
+            located.status = ExtractStatus::ContainerTooSmall;
+            return located;
+        }
+        if (header.adaptiveLevel > 0) {
+            // Кандидаты без позиций заголовка, как при встраивании: каждый индекс тела - годный байт
+            std::vector<uint8_t> costMap = carrier.costMap();
+            auto candidates = std::make_shared<const std::vector<size_t>>(
+                Stegano::excludePositions(Stegano::selectTexturedPositions(costMap, header.adaptiveLevel), prefixPositions));
+            located.indexed.emplace(candidates, steganoKey, located.indexed->engine());
+            located.bodyBase = 0;
+        } else {
+            located.bodyBase = prefixPositions.size();
+        }
+        available = located.indexed->size() - located.bodyBase;
+    }
+
+    // Длина 64-битная: сначала грубая проверка, чтобы длина * 8 не переполнилась
+    if (header.containerLength > available ||
+        Stegano::matrixPositionsNeeded(static_cast<size_t>(header.containerLength) * 8, header.matrixK) > available) {
+        located.status = ExtractStatus::CapacityExceeded;
+        return located;
+    }
+    located.status = ExtractStatus::Ok;
+    return located;
+    }
+
+    // Байты [begin, end) блочного контейнера. Читаются только группы позиций, покрывающие диапазон:
+    // при k > 1 диапазон может начинаться внутри группы, тогда лишние биты в начале отбрасываются
+    template <typename Carrier>
+    std::vector<uint8_t> readContainerRange(const Carrier& carrier, const LocatedContainer& located, uint64_t begin, uint64_t end) {
+    const uint8_t k = located.header.matrixK;
+    const size_t groupSize = (size_t{1} << k) - 1;
+    const size_t firstGroup = static_cast<size_t>(begin * 8 / k);
+    const size_t skipBits = static_cast<size_t>(begin * 8 - firstGroup * k);
+    const size_t length = static_cast<size_t>(end - begin);
+    const size_t readLength = (skipBits + length * 8 + 7) / 8;
+
+    // Последняя группа может выходить за конец контейнера и перестановки: её хвост дополняется повтором
+    size_t firstIndex = located.bodyBase + firstGroup * groupSize;
+    size_t count = Stegano::matrixPositionsNeeded(readLength * 8, k);
+    size_t present = std::min(count, located.indexed->size() - firstIndex);
+    std::vector<size_t> positions = located.indexed->range(firstIndex, present);
+    positions.resize(count, positions.empty() ? 0 : positions.back());
+    std::vector<uint8_t> raw = readBytes(carrier, positions, readLength, k);
+    if (skipBits == 0) {
+        raw.resize(length);
+        return raw;
+    }
+
+    std::vector<uint8_t> bytes(length);
+    for (size_t i = 0; i < length; i++) {
+        size_t bit = skipBits + i * 8;
+        uint8_t high = static_cast<uint8_t>(raw[bit / 8] << (bit % 8));
+        uint8_t low = bit / 8 + 1 < raw.size() ? static_cast<uint8_t>(raw[bit / 8 + 1] >> (8 - bit % 8)) : 0;
+        bytes[i] = high | low;
+    }
+    return bytes;
+    }
+
+    // Диапазон сообщения из блочного контейнера: расшифровываются только блоки, которые его покрывают
+    template <typename Carrier>
+    Decryption::ExtractResult decryptChunkedRange(const std::string& passphrase, const Carrier& carrier, const LocatedContainer& located,
+                                                  uint64_t offset, uint64_t length) {
+    using Decryption::ExtractStatus;
+    Decryption::ExtractResult result;
+    result.header = located.header;
+    ChunkedContainer::Layout layout = *ChunkedContainer::layoutFromLength(located.header.containerLength);
+    result.messageLength = layout.messageLength;
+
+    std::vector<uint8_t> prefix = readContainerRange(carrier, located, 0, ChunkedContainer::PREFIX_SIZE);
+    std::vector<uint8_t> salt(prefix.begin(), prefix.begin() + DataConversion::SALT_SIZE);
+    const uint8_t* nonce = prefix.data() + DataConversion::SALT_SIZE;
+    std::vector<uint8_t> derivedKey = KeyDerivation::deriveKey(passphrase, salt, DataConversion::KDF_ITERATIONS, 32);
+
+    // Диапазон обрезается по концу сообщения; хотя бы один блок проверяется всегда, чтобы чужой пароль
+    // не давал пустой успешный результат
+    uint64_t begin = std::min(offset, layout.messageLength);
+    uint64_t end = begin + std::min(length, layout.messageLength - begin);
+    uint64_t firstChunk = std::min(begin / DataConversion::CHUNK_SIZE, layout.chunkCount - 1);
+    uint64_t lastChunk = end > begin ? (end - 1) / DataConversion::CHUNK_SIZE : firstChunk;
+
+    // Блоки лежат в контейнере подряд, поэтому их позиции читаются одним диапазоном
+    ChunkedContainer::ChunkSpan first = ChunkedContainer::chunkSpan(layout, firstChunk);
+    ChunkedContainer::ChunkSpan last = ChunkedContainer::chunkSpan(layout, lastChunk);
+    std::vector<uint8_t> sealed = readContainerRange(carrier, located, first.offset, last.offset + last.length);
+
+    for (uint64_t index = firstChunk; index <= lastChunk; index++) {
+        ChunkedContainer::ChunkSpan span = ChunkedContainer::chunkSpan(layout, index);
+        auto chunkBegin = sealed.begin() + static_cast<std::ptrdiff_t>(span.offset - first.offset);
+        std::vector<uint8_t> chunk(chunkBegin, chunkBegin + static_cast<std::ptrdiff_t>(span.length));
+        std::optional<std::vector<uint8_t>> plain = ChunkedContainer::openChunk(chunk, nonce, derivedKey, layout, index);
+        if (!plain) {
+            result.status = ExtractStatus::DecryptionFailed;
+            result.message.clear();
+            return result;
+        }
+        uint64_t chunkStart = index * DataConversion::CHUNK_SIZE;
+        uint64_t from = std::max(begin, chunkStart) - chunkStart;
+        uint64_t to = std::min(end, chunkStart + plain->size()) - chunkStart;
+        if (from < to) result.message.append(plain->begin() + from, plain->begin() + to);
+    }
+    LOG_INFO("{} of {} chunks were extracted and decrypted", lastChunk - firstChunk + 1, layout.chunkCount);
+    result.status = ExtractStatus::Ok;
+    return result;
+    }
 
-    // Теперь извлекаем полный контейнер (заголовок уже извлечён, поэтому общее количество байтов: HEADER_SIZE + containerLength)
-    size_t totalMessageLength = DataConversion::HEADER_SIZE + containerLength;
-    std::vector<uint8_t> fullMessage = Stegano::extractData(image, totalMessageLength, steganoKey);
+    // Сообщение целиком или его диапазон [offset, offset + length); из одного шифртекста CBC диапазон
+    // вырезается после расшифровки всего контейнера
+    template <typename Carrier>
+    Decryption::ExtractResult tryDecryptCarrier(const std::string& passphrase, const Carrier& carrier, const std::vector<uint8_t>& steganoKey,
+                                                uint64_t offset = 0, uint64_t length = UINT64_MAX) {
+    Decryption::ExtractResult result;
+    LocatedContainer located = locateContainer(carrier, steganoKey);
+    if (located.status != Decryption::ExtractStatus::Ok) {
+        result.status = located.status;
+        return result;
+    }
+    if (located.header.layout == DataConversion::ContainerLayout::Chunked) {
+        return decryptChunkedRange(passphrase, carrier, located, offset, length);
+    }
 
-    // Проверяем, что извлечённый заголовок совпадает с тем, что мы уже прочитали
-    std::vector<uint8_t> extractedHeader(fullMessage.begin(), fullMessage.begin() + DataConversion::HEADER_SIZE);
-    if (extractedHeader != header) {
-        LOG_ERROR("Extracting error: the title does not match");
-        exit(EXIT_FAILURE);
+    // Продолжаем поток позиций: извлекаем контейнер сразу после проверочного значения
+    // (при k > 1 каждая группа из 2^k - 1 позиций даёт k бит синдрома)
+    const DataConversion::ContainerHeader& header = located.header;
+    size_t containerPositions = Stegano::matrixPositionsNeeded(static_cast<size_t>(header.containerLength) * 8, header.matrixK);
+    std::vector<uint8_t> container = readBytes(carrier, located.stream->take(containerPositions), header.containerLength, header.matrixK);
+    result = decryptContainer(passphrase, container);
+    result.header = header;
+    sliceMessage(result, offset, length);
+    return result;
     }
 
-    // Извлекаем контейнер (оставшиеся байты)
-    std::vector<uint8_t> container(fullMessage.begin() + DataConversion::HEADER_SIZE, fullMessage.end());
+    // Соль + IV + шифртекст -> расшифрованное сообщение
+    Decryption::ExtractResult decryptContainer(const std::string& passphrase, const std::vector<uint8_t>& container) {
+    using Decryption::ExtractStatus;
+    Decryption::ExtractResult result;
     if (container.size() < DataConversion::SALT_SIZE) {
-        LOG_ERROR("Extacted container is too small");
-        exit(EXIT_FAILURE);
+        result.status = ExtractStatus::ContainerTooSmall;
+        return result;
     }
 
     // Первая SALT_SIZE байт – это соль, остальное – зашифрованные данные
     std::vector<uint8_t> salt(container.begin(), container.begin() + DataConversion::SALT_SIZE);
     std::vector<uint8_t> encryptedData(container.begin() + DataConversion::SALT_SIZE, container.end());
 
-
     // Вычисляем бинарный ключ для шифрования с использованием извлечённой соли
-    std::vector<uint8_t> derivedKey = KeyDerivation::deriveKey(config.passphrase, salt, DataConversion::KDF_ITERATIONS, 32);
+    std::vector<uint8_t> derivedKey = KeyDerivation::deriveKey(passphrase, salt, DataConversion::KDF_ITERATIONS, 32);
 
     // Дешифруем сообщение
-    std::vector<uint8_t> decryptedData = decryptData(encryptedData, derivedKey);
-    std::string decryptedMessage(decryptedData.begin(), decryptedData.end());
-    
+    std::optional<std::vector<uint8_t>> decryptedData = decryptData(encryptedData, derivedKey);
+    if (!decryptedData) {
+        result.status = ExtractStatus::DecryptionFailed;
+        return result;
+    }
+    result.status = ExtractStatus::Ok;
+    result.message.assign(decryptedData->begin(), decryptedData->end());
+    result.messageLength = result.message.size();
+    return result;
+    }
+
+    std::string reportExtractResult(Decryption::ExtractResult result) {
+    using Decryption::ExtractStatus;
+    switch (result.status) {
+        case ExtractStatus::Ok:
+            break;
+        case ExtractStatus::KeyMismatch:
+            LOG_ERROR("Extracting error: the key does not match the image");
+            exit(EXIT_FAILURE);
+        case ExtractStatus::CapacityExceeded:
+            LOG_ERROR("The specified message length exceeds the image capacity");
+            exit(EXIT_FAILURE);
+        case ExtractStatus::ContainerTooSmall:
+            LOG_ERROR("Extacted container is too small");
+            exit(EXIT_FAILURE);
+        case ExtractStatus::DecryptionFailed:
+            LOG_ERROR("Decryption failed. Data may be corrupted or wrong key");
+            exit(EXIT_FAILURE);
+    }
+
     LOG_INFO("Message was successfuly extracted and decrypted from the image");
-    return decryptedMessage;
+    return result.message;
+    }
+}
+
+namespace Decryption{
+
+    ExtractResult tryDecryptMessage(const std::string& passphrase, const ImageHandler::Image& image, const std::vector<uint8_t>& steganoKey){
+    return tryDecryptCarrier(passphrase, DecodedCarrier{image}, steganoKey);
+    }
+
+    ExtractResult tryDecryptMessage(const std::string& passphrase, const ImageHandler::MappedImage& image, const std::vector<uint8_t>& steganoKey){
+    return tryDecryptCarrier(passphrase, MappedCarrier{image}, steganoKey);
+    }
+
+    ExtractResult tryDecryptMessage(const std::string& passphrase, const ImageHandler::TiledTiff& image, const std::vector<uint8_t>& steganoKey){
+    return tryDecryptCarrier(passphrase, TiledCarrier{image}, steganoKey);
+    }
+
+    ExtractResult tryDecryptMessage(const std::string& passphrase, const AudioHandler::WavFile& audio, const std::vector<uint8_t>& steganoKey){
+    return tryDecryptCarrier(passphrase, SampleCarrier{audio}, steganoKey);
+    }
+
+    ExtractResult tryDecryptRange(const std::string& passphrase, const ImageHandler::Image& image, const std::vector<uint8_t>& steganoKey,
+                                  uint64_t offset, uint64_t length){
+    return tryDecryptCarrier(passphrase, DecodedCarrier{image}, steganoKey, offset, length);
+    }
+
+    ExtractResult tryDecryptRange(const std::string& passphrase, const ImageHandler::MappedImage& image, const std::vector<uint8_t>& steganoKey,
+                                  uint64_t offset, uint64_t length){
+    return tryDecryptCarrier(passphrase, MappedCarrier{image}, steganoKey, offset, length);
+    }
+
+    ExtractResult tryDecryptRange(const std::string& passphrase, const ImageHandler::TiledTiff& image, const std::vector<uint8_t>& steganoKey,
+                                  uint64_t offset, uint64_t length){
+    return tryDecryptCarrier(passphrase, TiledCarrier{image}, steganoKey, offset, length);
+    }
+
+    ExtractResult tryDecryptRange(const std::string& passphrase, const AudioHandler::WavFile& audio, const std::vector<uint8_t>& steganoKey,
+                                  uint64_t offset, uint64_t length){
+    return tryDecryptCarrier(passphrase, SampleCarrier{audio}, steganoKey, offset, length);
+    }
+
+    ExtractResult tryDecryptVideo(const std::string& passphrase, const std::string& inFile, const std::vector<uint8_t>& steganoKey){
+    Stegano::VideoExtraction extraction = Stegano::extractVideo(inFile, steganoKey, Parallel::defaultThreadCount());
+    ExtractResult result;
+    switch (extraction.status) {
+        case Stegano::VideoExtractStatus::Ok:
+            return decryptContainer(passphrase, extraction.container);
+        case Stegano::VideoExtractStatus::KeyMismatch:
+            result.status = ExtractStatus::KeyMismatch;
+            break;
+        case Stegano::VideoExtractStatus::CapacityExceeded:
+            result.status = ExtractStatus::CapacityExceeded;
+            break;
+    }
+    return result;
+    }
+
+    std::string getDecryptedMessage(const CliConfig& config, ImageHandler::Image& image, std::vector<uint8_t>& steganoKey){
+    return reportExtractResult(tryDecryptRange(config.passphrase, image, steganoKey, config.rangeOffset, config.rangeLength));
+    }
+
+    std::string getDecryptedMessage(const CliConfig& config, const ImageHandler::MappedImage& image, std::vector<uint8_t>& steganoKey){
+    return reportExtractResult(tryDecryptRange(config.passphrase, image, steganoKey, config.rangeOffset, config.rangeLength));
+    }
+
+    std::string getDecryptedMessage(const CliConfig& config, const ImageHandler::TiledTiff& image, std::vector<uint8_t>& steganoKey){
+    return reportExtractResult(tryDecryptRange(config.passphrase, image, steganoKey, config.rangeOffset, config.rangeLength));
+    }
+
+    std::string getDecryptedMessage(const CliConfig& config, const AudioHandler::WavFile& audio, std::vector<uint8_t>& steganoKey){
+    return reportExtractResult(tryDecryptRange(config.passphrase, audio, steganoKey, config.rangeOffset, config.rangeLength));
+    }
+
+    std::string getDecryptedVideoMessage(const CliConfig& config, std::vector<uint8_t>& steganoKey){
+    // Видео хранит один шифртекст, поэтому диапазон вырезается из расшифрованного сообщения
+    ExtractResult result = tryDecryptVideo(config.passphrase, config.inFile, steganoKey);
+    sliceMessage(result, config.rangeOffset, config.rangeLength);
+    return reportExtractResult(result);
+    }
+
+    KeyTrialResult findMessageWithKeys(const std::vector<std::string>& passphrases, const ImageHandler::Image& image, unsigned int threadCount){
+    KeyTrialResult trial;
+    std::atomic<size_t> nextKey{0};
+    std::atomic<size_t> foundKey{passphrases.size()};
+    std::mutex resultMutex;
+
+    threadCount = static_cast<unsigned int>(std::min<size_t>(std::max(1u, threadCount), std::max<size_t>(1, passphrases.size())));
+    Parallel::run(threadCount, [&](unsigned int){
+        // Ключи раздаются по порядку; ключи после уже найденного не проверяются
+        for (size_t i = nextKey++; i < passphrases.size() && i < foundKey.load(); i = nextKey++) {
+            Trace::Span span("key trial");
+            std::vector<uint8_t> steganoKey = DataConversion::stringToBytes(passphrases[i]);
+            ExtractResult result = tryDecryptMessage(passphrases[i], image, steganoKey);
+            if (result.status != ExtractStatus::Ok) {
+                continue;
+            }
+
+            std::lock_guard<std::mutex> lock(resultMutex);
+            if (i < foundKey.load()) {
+                foundKey.store(i);
+                trial.found = true;
+                trial.keyIndex = i;
+                trial.message = std::move(result.message);
+            }
+        }
+    });
+
+    if (trial.found) {
+        LOG_INFO("Key #{} of {} authenticated the container", trial.keyIndex + 1, passphrases.size());
+    } else {
+        LOG_INFO("None of the {} candidate keys matched the image", passphrases.size());
+    }
+    return trial;
     }
 }
 
 namespace {
-    std::vector<uint8_t> decryptData(const std::vector<uint8_t>& ciphertext, const std::vector<uint8_t>& key) {
+    std::optional<std::vector<uint8_t>> decryptData(const std::vector<uint8_t>& ciphertext, const std::vector<uint8_t>& key) {
+        Trace::Span span("decrypt");
         // Проверка: ключ должен быть ровно 32 байта для AES-256
         if (key.size() != 32) {
             LOG_ERROR("Key size must be 32 bytes for AES-256");
@@ -57,8 +491,8 @@ namespace {
 
         // Проверка: зашифрованные данные должны содержать как минимум IV (16 байт)
         if (ciphertext.size() < 16) {
-            LOG_ERROR("Ciphertext is too short, missing IV");
-            exit(EXIT_FAILURE);
+            LOG_DEBUG("Ciphertext is too short, missing IV");
+            return std::nullopt;
         }
 
         // Извлекаем IV из первых 16 байт
@@ -94,8 +528,8 @@ namespace {
         // Завершаем расшифрование
         if (EVP_DecryptFinal_ex(ctx, plaintext.data() + len, &len) != 1) {
             EVP_CIPHER_CTX_free(ctx);
-            LOG_ERROR("EVP_DecryptFinal_ex failed. Data may be corrupted or wrong key");
-            exit(EXIT_FAILURE);
+            LOG_DEBUG("EVP_DecryptFinal_ex failed. Data may be corrupted or wrong key");
+            return std::nullopt;
         }
         plaintextLen += len;
         plaintext.resize(plaintextLen);
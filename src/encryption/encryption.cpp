@@ -1,12 +1,32 @@
 #include "encryption/encryption.h"
+#include "encryption/chunked_container.h"
 #include "external/logger.h"
+#include "trace.h"
 #include <openssl/evp.h>
 #include <openssl/rand.h>
 #include <stdexcept>
+#include <optional>
 #include <vector>
 
+namespace {
+    // Контейнер: соль, затем один шифртекст CBC с IV или блоки GCM с одноразовым номером;
+    // std::nullopt, если шифрование не удалось (ошибка уже залогирована)
+    std::optional<std::vector<uint8_t>> buildContainer(const std::vector<uint8_t>& plainText, const std::vector<uint8_t>& salt,
+                                                       const std::vector<uint8_t>& derivedKey, DataConversion::ContainerLayout layout) {
+        if (layout == DataConversion::ContainerLayout::Chunked) {
+            return ChunkedContainer::trySeal(plainText, salt, derivedKey);
+        }
+        std::optional<std::vector<uint8_t>> encryptedData = encryptData(plainText, derivedKey);
+        if (!encryptedData) return std::nullopt;
+        std::vector<uint8_t> container;
+        container.insert(container.end(), salt.begin(), salt.end());
+        container.insert(container.end(), encryptedData->begin(), encryptedData->end());
+        return container;
+    }
+}
+
 namespace Encryption {
-    std::vector<uint8_t> getReadyToEmbedText(CliConfig& config){    
+    std::vector<uint8_t> getEncryptedContainer(CliConfig& config, DataConversion::ContainerLayout layout){
         // Генерируем соль и выводим её (соль не скрывается для расшифровки, она будет включена в контейнер)
         std::vector<uint8_t> salt = KeyDerivation::generateSalt(DataConversion::SALT_SIZE);
 
@@ -15,20 +35,64 @@ namespace Encryption {
 
         // Шифруем сообщение (преобразуем текст в вектор байтов)
         std::vector<uint8_t> plainText(config.textMessage.begin(), config.textMessage.end());
-        std::vector<uint8_t> encryptedData = encryptData(plainText, derivedKey);
+        std::optional<std::vector<uint8_t>> container = buildContainer(plainText, salt, derivedKey, layout);
+        if (!container) {
+            exit(EXIT_FAILURE);
+        }
+        return std::move(*container);
+    }
 
-        // Формируем контейнер: сначала соль, затем зашифрованные данные
-        std::vector<uint8_t> container;
-        container.insert(container.end(), salt.begin(), salt.end());
-        container.insert(container.end(), encryptedData.begin(), encryptedData.end());
+    std::vector<std::optional<std::vector<uint8_t>>> getEncryptedContainers(const CliConfig& config, size_t count,
+                                                             DataConversion::ContainerLayout layout){
+        std::vector<std::vector<uint8_t>> salts;
+        for (size_t i = 0; i < count; i++) {
+            salts.push_back(KeyDerivation::generateSalt(DataConversion::SALT_SIZE));
+        }
+        std::vector<std::string> passphrases(count, config.passphrase);
+        std::vector<std::vector<uint8_t>> derivedKeys =
+            KeyDerivation::deriveKeys(passphrases, salts, DataConversion::KDF_ITERATIONS, 32);
 
-        // Формируем заголовок: 4 байта, содержащие длину контейнера
-        uint32_t containerLength = static_cast<uint32_t>(container.size());
-        std::vector<uint8_t> header = DataConversion::uint32ToBytes(containerLength);
+        std::vector<uint8_t> plainText(config.textMessage.begin(), config.textMessage.end());
+        std::vector<std::optional<std::vector<uint8_t>>> containers(count);
+        for (size_t i = 0; i < count; i++) {
+            containers[i] = buildContainer(plainText, salts[i], derivedKeys[i], layout);
+        }
+        return containers;
+    }
 
-        // Итоговое сообщение для внедрения: заголовок + контейнер
+    size_t containerSize(size_t messageLength, DataConversion::ContainerLayout layout){
+        if (layout == DataConversion::ContainerLayout::Chunked) {
+            return static_cast<size_t>(ChunkedContainer::containerSize(messageLength));
+        }
+        // Соль, IV и шифртекст CBC, дополненный до целого блока (полный блок, если длина кратна 16)
+        const size_t block = 16;
+        return DataConversion::SALT_SIZE + block + (messageLength / block + 1) * block;
+    }
+
+    std::vector<uint8_t> getReadyToEmbedText(const std::vector<uint8_t>& container, DataConversion::ContainerHeader header,
+                                             const std::vector<uint8_t>& steganoKey){
+        std::optional<std::vector<uint8_t>> text = tryGetReadyToEmbedText(container, header, steganoKey);
+        if (!text) {
+            exit(EXIT_FAILURE);
+        }
+        return std::move(*text);
+    }
+
+    std::optional<std::vector<uint8_t>> tryGetReadyToEmbedText(const std::vector<uint8_t>& container,
+                                                               DataConversion::ContainerHeader header,
+                                                               const std::vector<uint8_t>& steganoKey){
+        // Формируем заголовок: длина контейнера, идентификатор генератора позиций и адаптивный уровень
+        header.containerLength = container.size();
+        std::vector<uint8_t> headerBytes = DataConversion::headerToBytes(header);
+
+        // Проверочное значение под стего-ключом: позволяет быстро отбросить неверный ключ при извлечении
+        std::optional<std::vector<uint8_t>> keyCheck = Utils::tryComputeKeyCheck(headerBytes, steganoKey, DataConversion::KEY_CHECK_SIZE);
+        if (!keyCheck) return std::nullopt;
+
+        // Итоговое сообщение для внедрения: заголовок + проверочное значение + контейнер
         std::vector<uint8_t> finalMessage;
-        finalMessage.insert(finalMessage.end(), header.begin(), header.end());
+        finalMessage.insert(finalMessage.end(), headerBytes.begin(), headerBytes.end());
+        finalMessage.insert(finalMessage.end(), keyCheck->begin(), keyCheck->end());
         finalMessage.insert(finalMessage.end(), container.begin(), container.end());
         
         LOG_INFO("String to embed was comiled successfuly");
@@ -37,18 +101,19 @@ namespace Encryption {
 }
 
 namespace {
-    std::vector<uint8_t> encryptData(const std::vector<uint8_t>& plaintext, const std::vector<uint8_t>& key) {
+    std::optional<std::vector<uint8_t>> encryptData(const std::vector<uint8_t>& plaintext, const std::vector<uint8_t>& key) {
+        Trace::Span span("encrypt");
         // Проверка: ключ должен быть ровно 32 байта для AES-256
         if (key.size() != 32) {
             LOG_ERROR("Key size must be 32 bytes for AES-256");
-            exit(EXIT_FAILURE);
+            return std::nullopt;
         }
 
         // Создаём контекст для шифрования
         EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
         if (!ctx) {
             LOG_ERROR("Failed to create EVP_CIPHER_CTX");
-            exit(EXIT_FAILURE);
+            return std::nullopt;
         }
 
         // Генерируем случайный IV длиной 16 байт
@@ -56,14 +121,14 @@ namespace {
         if (RAND_bytes(iv, sizeof(iv)) != 1) {
             EVP_CIPHER_CTX_free(ctx);
             LOG_ERROR("Failed to generate random IV");
-            exit(EXIT_FAILURE);
+            return std::nullopt;
         }
 
         // Инициализируем контекст шифрования с алгоритмом AES-256-CBC
         if (EVP_EncryptInit_ex(ctx, EVP_aes_256_cbc(), nullptr, key.data(), iv) != 1) {
             EVP_CIPHER_CTX_free(ctx);
             LOG_ERROR("EVP_EncryptInit_ex failed");
-            exit(EXIT_FAILURE);
+            return std::nullopt;
         }
 
         // Выделяем буфер для зашифрованных данных (с запасом на возможный рост размера)
@@ -76,7 +141,7 @@ namespace {
         if (EVP_EncryptUpdate(ctx, ciphertext.data(), &len, plaintext.data(), plaintext.size()) != 1) {
             EVP_CIPHER_CTX_free(ctx);
             LOG_ERROR("EVP_EncryptUpdate failed");
-            exit(EXIT_FAILURE);
+            return std::nullopt;
         }
         int ciphertextLen = len;
 
@@ -84,7 +149,7 @@ namespace {
         if (EVP_EncryptFinal_ex(ctx, ciphertext.data() + len, &len) != 1) {
             EVP_CIPHER_CTX_free(ctx);
             LOG_ERROR("EVP_EncryptFinal_ex failed");
-            exit(EXIT_FAILURE);
+            return std::nullopt;
         }
         ciphertextLen += len;
         ciphertext.resize(ciphertextLen);
@@ -1,15 +1,234 @@
 #include "encryption/key_derivation.h"
+#include "encryption/sha256_lanes.h"
 #include <openssl/evp.h>
+#include <openssl/hmac.h>
 #include <openssl/rand.h>
 #include <stdexcept>
+#include <algorithm>
+#include <array>
 #include "external/logger.h"
+#include "trace.h"
+
+#ifdef STEGANO_KDF_SSE2
+#include <emmintrin.h>
+#endif
 
 namespace KeyDerivation {
 
+namespace {
+
+// Одна дорожка без SIMD: подготовка состояний HMAC для ядер
+struct Scalar {
+    using Vec = uint32_t;
+    static constexpr size_t LANES = 1;
+
+    static Vec set1(uint32_t value) { return value; }
+    static Vec add(Vec a, Vec b) { return a + b; }
+    static Vec bxor(Vec a, Vec b) { return a ^ b; }
+    static Vec band(Vec a, Vec b) { return a & b; }
+    static Vec bor(Vec a, Vec b) { return a | b; }
+    static Vec bandnot(Vec a, Vec b) { return ~a & b; }
+    template <int N> static Vec shr(Vec v) { return v >> N; }
+    template <int N> static Vec rotr(Vec v) { return (v >> N) | (v << (32 - N)); }
+};
+
+#ifdef STEGANO_KDF_SSE2
+struct Sse2 {
+    using Vec = __m128i;
+    static constexpr size_t LANES = SSE2_LANES;
+
+    static Vec load(const uint32_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+    static void store(uint32_t* p, Vec v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+    static Vec set1(uint32_t value) { return _mm_set1_epi32(static_cast<int>(value)); }
+    static Vec add(Vec a, Vec b) { return _mm_add_epi32(a, b); }
+    static Vec bxor(Vec a, Vec b) { return _mm_xor_si128(a, b); }
+    static Vec band(Vec a, Vec b) { return _mm_and_si128(a, b); }
+    static Vec bor(Vec a, Vec b) { return _mm_or_si128(a, b); }
+    static Vec bandnot(Vec a, Vec b) { return _mm_andnot_si128(a, b); }
+    template <int N> static Vec shr(Vec v) { return _mm_srli_epi32(v, N); }
+    template <int N> static Vec rotr(Vec v) { return _mm_or_si128(_mm_srli_epi32(v, N), _mm_slli_epi32(v, 32 - N)); }
+};
+#endif
+
+constexpr size_t SHA256_BLOCK = 64;
+constexpr size_t SHA256_DIGEST = 32;
+
+// Ядро, считающее итерации PBKDF2 сразу для lanes экземпляров
+struct BatchKernel {
+    unsigned int lanes;
+    void (*iterate)(const uint32_t*, const uint32_t*, uint32_t*, uint32_t*, int);
+    const char* name;
+};
+
+// Состояния SHA-256 после блоков ключа HMAC XOR ipad и XOR opad
+struct HmacStates {
+    std::array<uint32_t, 8> inner;
+    std::array<uint32_t, 8> outer;
+};
+
+uint32_t readBE32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+std::array<uint32_t, 8> compressKeyBlock(const uint8_t* key, uint8_t pad) {
+    uint32_t state[8], block[16];
+    std::copy(Lanes::SHA256_IV, Lanes::SHA256_IV + 8, state);
+    uint8_t bytes[SHA256_BLOCK];
+    for (size_t i = 0; i < SHA256_BLOCK; i++) bytes[i] = static_cast<uint8_t>(key[i] ^ pad);
+    for (int j = 0; j < 16; j++) block[j] = readBE32(bytes + j * 4);
+    Lanes::compress<Scalar>(state, block);
+    std::array<uint32_t, 8> result;
+    std::copy(state, state + 8, result.begin());
+    return result;
+}
+
+HmacStates hmacStates(const std::string& passphrase) {
+    // Ключ HMAC длиннее блока заменяется своим хэшем, короче - дополняется нулями
+    uint8_t key[SHA256_BLOCK] = {};
+    if (passphrase.size() > SHA256_BLOCK) {
+        unsigned int length = 0;
+        if (EVP_Digest(passphrase.data(), passphrase.size(), key, &length, EVP_sha256(), nullptr) != 1) {
+            LOG_ERROR("Key derivation failed: SHA-256 of the passphrase");
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        std::copy(passphrase.begin(), passphrase.end(), key);
+    }
+    return HmacStates{ compressKeyBlock(key, 0x36), compressKeyBlock(key, 0x5c) };
+}
+
+// U_1 = HMAC(P, salt || INT(block + 1)) считается OpenSSL: длина соли у каждого экземпляра своя
+std::array<uint8_t, SHA256_DIGEST> firstBlock(const std::string& passphrase, const std::vector<uint8_t>& salt, size_t block) {
+    std::vector<uint8_t> data(salt);
+    uint32_t index = static_cast<uint32_t>(block + 1);
+    for (int shift = 24; shift >= 0; shift -= 8) data.push_back(static_cast<uint8_t>(index >> shift));
+    std::array<uint8_t, SHA256_DIGEST> u;
+    unsigned int length = 0;
+    if (HMAC(EVP_sha256(), passphrase.data(), static_cast<int>(passphrase.size()), data.data(), data.size(),
+             u.data(), &length) == nullptr) {
+        LOG_ERROR("Key derivation failed: HMAC-SHA256");
+        exit(EXIT_FAILURE);
+    }
+    return u;
+}
+
+// Экземпляры делятся на группы по kernel.lanes блоков вывода; последняя группа дополняется повтором
+// последнего блока, лишние дорожки отбрасываются
+void deriveWithKernel(const BatchKernel& kernel, const std::vector<std::string>& passphrases,
+                      const std::vector<std::vector<uint8_t>>& salts, int iterations, size_t keyLength,
+                      std::vector<std::vector<uint8_t>>& keys) {
+    const size_t blocksPerKey = (keyLength + SHA256_DIGEST - 1) / SHA256_DIGEST;
+    const size_t taskCount = passphrases.size() * blocksPerKey;
+    const size_t lanes = kernel.lanes;
+
+    std::vector<HmacStates> states;
+    states.reserve(passphrases.size());
+    for (const std::string& passphrase : passphrases) {
+        states.push_back(hmacStates(passphrase));
+    }
+
+    std::vector<uint32_t> inner(8 * lanes), outer(8 * lanes), u(8 * lanes), t(8 * lanes);
+    for (size_t first = 0; first < taskCount; first += lanes) {
+        for (size_t lane = 0; lane < lanes; lane++) {
+            size_t task = std::min(first + lane, taskCount - 1);
+            size_t instance = task / blocksPerKey;
+            auto u1 = firstBlock(passphrases[instance], salts[instance], task % blocksPerKey);
+            for (size_t j = 0; j < 8; j++) {
+                inner[j * lanes + lane] = states[instance].inner[j];
+                outer[j * lanes + lane] = states[instance].outer[j];
+                u[j * lanes + lane] = t[j * lanes + lane] = readBE32(u1.data() + j * 4);
+            }
+        }
+        kernel.iterate(inner.data(), outer.data(), u.data(), t.data(), iterations);
+        for (size_t lane = 0; lane < lanes && first + lane < taskCount; lane++) {
+            size_t task = first + lane;
+            std::vector<uint8_t>& key = keys[task / blocksPerKey];
+            size_t offset = (task % blocksPerKey) * SHA256_DIGEST;
+            for (size_t i = 0; offset + i < keyLength && i < SHA256_DIGEST; i++) {
+                key[offset + i] = static_cast<uint8_t>(t[(i / 4) * lanes + lane] >> (24 - 8 * (i % 4)));
+            }
+        }
+    }
+}
+
+// Самопроверка ядра против PKCS5_PBKDF2_HMAC: короткий, блочный и длинный пароль, соли разной длины,
+// вывод из двух блоков и число экземпляров, не кратное числу дорожек
+bool kernelMatchesOpenSsl(const BatchKernel& kernel) {
+    std::vector<std::string> passphrases = { "password", "", std::string(64, 'k'), std::string(100, 'p'), "key" };
+    std::vector<std::vector<uint8_t>> salts = { { 's', 'a', 'l', 't' }, std::vector<uint8_t>(16, 0xA5), {},
+                                                std::vector<uint8_t>(70, 0x01), { 0x00 } };
+    for (size_t i = 0; i < kernel.lanes; i++) {
+        passphrases.push_back("lane" + std::to_string(i));
+        salts.push_back(std::vector<uint8_t>(i + 1, static_cast<uint8_t>(i)));
+    }
+    const int iterations = 3;
+    const size_t keyLength = 40;
+    std::vector<std::vector<uint8_t>> keys(passphrases.size(), std::vector<uint8_t>(keyLength));
+    deriveWithKernel(kernel, passphrases, salts, iterations, keyLength, keys);
+    for (size_t i = 0; i < passphrases.size(); i++) {
+        std::vector<uint8_t> expected(keyLength);
+        if (PKCS5_PBKDF2_HMAC(passphrases[i].data(), static_cast<int>(passphrases[i].size()), salts[i].data(),
+                              static_cast<int>(salts[i].size()), iterations, EVP_sha256(),
+                              static_cast<int>(keyLength), expected.data()) != 1 || expected != keys[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Ядра, которые поддерживают сборка и CPU, от широкого к узкому
+std::vector<BatchKernel> candidateKernels() {
+    std::vector<BatchKernel> candidates;
+#ifdef STEGANO_KDF_AVX
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) candidates.push_back({ AVX512_LANES, iterateAvx512, "AVX-512" });
+    if (__builtin_cpu_supports("avx2")) candidates.push_back({ AVX2_LANES, iterateAvx2, "AVX2" });
+#endif
+#ifdef STEGANO_KDF_SSE2
+    candidates.push_back({ SSE2_LANES, iterateSse2, "SSE2" });
+#endif
+    return candidates;
+}
+
+// Доступные ядра от широкого к узкому; ядро, не прошедшее самопроверку, не используется
+std::vector<BatchKernel> verifiedKernels() {
+    std::vector<BatchKernel> kernels;
+    for (const BatchKernel& kernel : candidateKernels()) {
+        if (kernelMatchesOpenSsl(kernel)) {
+            kernels.push_back(kernel);
+        } else {
+            LOG_WARN("The {} PBKDF2 kernel does not match OpenSSL and is disabled", kernel.name);
+        }
+    }
+    return kernels;
+}
+
+const std::vector<BatchKernel>& batchKernels() {
+    static const std::vector<BatchKernel> kernels = verifiedKernels();
+    return kernels;
+}
+
+const BatchKernel* selectKernel(unsigned int maxLanes) {
+    for (const BatchKernel& kernel : batchKernels()) {
+        if (maxLanes == 0 || kernel.lanes <= maxLanes) return &kernel;
+    }
+    return nullptr;
+}
+
+} // namespace
+
+#ifdef STEGANO_KDF_SSE2
+void iterateSse2(const uint32_t* inner, const uint32_t* outer, uint32_t* u, uint32_t* t, int iterations) {
+    Lanes::iterate<Sse2>(inner, outer, u, t, iterations);
+}
+#endif
+
 std::vector<uint8_t> deriveKey(const std::string& passphrase, 
                                const std::vector<uint8_t>& salt, 
                                int iterations, 
                                size_t keyLength) {
+    Trace::Span span("kdf");
     std::vector<uint8_t> key(keyLength);
     const EVP_MD* digest = EVP_sha256(); // Используем HMAC-SHA256
 
@@ -31,6 +250,41 @@ std::vector<uint8_t> deriveKey(const std::string& passphrase,
     return key;
 }
 
+std::vector<std::vector<uint8_t>> deriveKeys(const std::vector<std::string>& passphrases,
+                                            const std::vector<std::vector<uint8_t>>& salts,
+                                            int iterations,
+                                            size_t keyLength,
+                                            unsigned int maxLanes) {
+    if (passphrases.size() != salts.size()) {
+        LOG_ERROR("Key derivation failed: {} passphrases for {} salts", passphrases.size(), salts.size());
+        exit(EXIT_FAILURE);
+    }
+    Trace::Span span("kdf batch");
+    std::vector<std::vector<uint8_t>> keys(passphrases.size(), std::vector<uint8_t>(keyLength));
+    const BatchKernel* kernel = selectKernel(maxLanes);
+    if (!kernel || passphrases.size() < 2 || iterations < 1 || keyLength == 0) {
+        // Один экземпляр SIMD не ускоряет: остаётся OpenSSL
+        for (size_t i = 0; i < passphrases.size(); i++) {
+            keys[i] = deriveKey(passphrases[i], salts[i], iterations, keyLength);
+        }
+        return keys;
+    }
+    deriveWithKernel(*kernel, passphrases, salts, iterations, keyLength, keys);
+    LOG_INFO("{} keys were derived with the {} PBKDF2 kernel", passphrases.size(), kernel->name);
+    return keys;
+}
+
+unsigned int batchLanes(unsigned int maxLanes) {
+    const BatchKernel* kernel = selectKernel(maxLanes);
+    return kernel ? kernel->lanes : 1;
+}
+
+std::vector<unsigned int> supportedLanes() {
+    std::vector<unsigned int> lanes;
+    for (const BatchKernel& kernel : candidateKernels()) lanes.push_back(kernel.lanes);
+    return lanes;
+}
+
 std::vector<uint8_t> generateSalt(size_t saltLength) {
     std::vector<uint8_t> salt(saltLength);
     if (RAND_bytes(salt.data(), static_cast<int>(saltLength)) != 1) {
@@ -0,0 +1,51 @@
+// Весь файл, включая шаблоны из sha256_lanes.h, компилируется для AVX-512F; ядро вызывается только
+// после проверки CPU. Условие совпадает с STEGANO_KDF_AVX, который задаёт заголовок.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx512f"))), apply_to = function)
+#else
+// Векторы передаются только между функциями этого файла, предупреждение об ABI к ним не относится
+#pragma GCC diagnostic ignored "-Wpsabi"
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#endif
+
+#include <immintrin.h>
+#include "encryption/sha256_lanes.h"
+
+namespace KeyDerivation {
+
+namespace {
+
+struct Avx512 {
+    using Vec = __m512i;
+    static constexpr size_t LANES = AVX512_LANES;
+
+    static Vec load(const uint32_t* p) { return _mm512_loadu_si512(p); }
+    static void store(uint32_t* p, Vec v) { _mm512_storeu_si512(p, v); }
+    static Vec set1(uint32_t value) { return _mm512_set1_epi32(static_cast<int>(value)); }
+    static Vec add(Vec a, Vec b) { return _mm512_add_epi32(a, b); }
+    static Vec bxor(Vec a, Vec b) { return _mm512_xor_si512(a, b); }
+    static Vec band(Vec a, Vec b) { return _mm512_and_si512(a, b); }
+    static Vec bor(Vec a, Vec b) { return _mm512_or_si512(a, b); }
+    static Vec bandnot(Vec a, Vec b) { return _mm512_andnot_si512(a, b); }
+    template <int N> static Vec shr(Vec v) { return _mm512_srli_epi32(v, N); }
+    template <int N> static Vec rotr(Vec v) { return _mm512_ror_epi32(v, N); }
+};
+
+} // namespace
+
+void iterateAvx512(const uint32_t* inner, const uint32_t* outer, uint32_t* u, uint32_t* t, int iterations) {
+    Lanes::iterate<Avx512>(inner, outer, u, t, iterations);
+}
+
+} // namespace KeyDerivation
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#endif
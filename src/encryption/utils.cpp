@@ -9,6 +9,14 @@
 namespace Utils {
 
     std::vector<uint8_t> computeHMAC(const std::vector<uint8_t>& data, const std::vector<uint8_t>& key) {
+        std::optional<std::vector<uint8_t>> mac = tryComputeHMAC(data, key);
+        if (!mac) {
+            exit(EXIT_FAILURE);
+        }
+        return std::move(*mac);
+    }
+
+    std::optional<std::vector<uint8_t>> tryComputeHMAC(const std::vector<uint8_t>& data, const std::vector<uint8_t>& key) {
         unsigned int len = EVP_MAX_MD_SIZE;
         unsigned char hmacResult[EVP_MAX_MD_SIZE];
 
@@ -18,12 +26,32 @@ namespace Utils {
                  data.data(), data.size(),
                  hmacResult, &len) == nullptr) {
             LOG_ERROR("HMAC calculation failed");
-            exit(EXIT_FAILURE);
+            return std::nullopt;
         }
 
         return std::vector<uint8_t>(hmacResult, hmacResult + len);
     }
 
+    std::vector<uint8_t> computeKeyCheck(const std::vector<uint8_t>& header, const std::vector<uint8_t>& key, size_t length) {
+        std::optional<std::vector<uint8_t>> check = tryComputeKeyCheck(header, key, length);
+        if (!check) {
+            exit(EXIT_FAILURE);
+        }
+        return std::move(*check);
+    }
+
+    std::optional<std::vector<uint8_t>> tryComputeKeyCheck(const std::vector<uint8_t>& header, const std::vector<uint8_t>& key,
+                                                           size_t length) {
+        // Доменная метка отделяет проверочное значение от других HMAC под тем же ключом
+        static const std::string label = "SteganoEncrypt key check";
+        std::vector<uint8_t> data(label.begin(), label.end());
+        data.insert(data.end(), header.begin(), header.end());
+
+        std::optional<std::vector<uint8_t>> mac = tryComputeHMAC(data, key);
+        if (mac) mac->resize(length);
+        return mac;
+    }
+
     std::string bytesToHex(const std::vector<uint8_t>& data) {
         std::ostringstream oss;
         for (auto byte : data) {
@@ -1,8 +1,20 @@
 #include "image_handler.h"
+#include "mapped_image.h"
+#include "qoi.h"
+#include "memory_budget.h"
+#include "trace.h"
 
 #include <stdexcept>
-#include <fstream>
+#include <filesystem>
 #include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <climits>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
 
 // Подключаем реализации stb_image и stb_image_write
 #define STB_IMAGE_IMPLEMENTATION
@@ -11,11 +23,46 @@
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "external/stb_image_write.h"
 
+namespace {
+
+// Callback для stbi_write_*_to_func: пишет закодированные байты в FILE* (stdout)
+void writeToFile(void* context, void* data, int size) {
+    FILE* out = static_cast<FILE*>(context);
+    if (std::fwrite(data, 1, static_cast<size_t>(size), out) != static_cast<size_t>(size)) {
+        LOG_ERROR("Failed to write the encoded image to the output stream");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Считываем весь поток (stdin) в память, без временных файлов
+std::vector<uint8_t> readWholeStream(FILE* in) {
+#ifdef _WIN32
+    _setmode(_fileno(in), _O_BINARY);
+#endif
+    std::vector<uint8_t> buffer;
+    uint8_t chunk[1 << 16];
+    size_t readBytes = 0;
+    while ((readBytes = std::fread(chunk, 1, sizeof(chunk), in)) > 0) {
+        buffer.insert(buffer.end(), chunk, chunk + readBytes);
+    }
+    if (std::ferror(in)) {
+        LOG_ERROR("Failed to read the image from the input stream");
+        exit(EXIT_FAILURE);
+    }
+    return buffer;
+}
+
+} // namespace
+
 namespace ImageHandler {
 
+bool isStdStream(const std::string& filename) {
+    return filename == STDIO_PATH;
+}
+
 bool fileExists(const std::string& filename) {
-    std::ifstream file(filename);
-    return file.good();
+    std::error_code ec;
+    return std::filesystem::is_regular_file(filename, ec);
 }
 
 bool isSupportedFormat(const std::string& filename) {
@@ -24,17 +71,116 @@ bool isSupportedFormat(const std::string& filename) {
     // Проверяем последние 4 символа (например, ".png" или ".bmp")
     if (lowerFilename.size() < 4) return false;
     std::string ext = lowerFilename.substr(lowerFilename.size() - 4);
-    return (ext == ".png" || ext == ".bmp");
+    return (ext == ".png" || ext == ".bmp" || ext == ".qoi" || isNetpbmFile(lowerFilename));
+}
+
+ImageFormat formatFromExtension(const std::string& filename) {
+    if (!isSupportedFormat(filename)) return ImageFormat::Unknown;
+    std::string ext = filename.substr(filename.size() - 4);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    if (ext == ".png") return ImageFormat::PNG;
+    if (ext == ".qoi") return ImageFormat::QOI;
+    return ext == ".bmp" ? ImageFormat::BMP : ImageFormat::PNM;
+}
+
+ImageFormat formatFromMagic(const uint8_t* buffer, size_t size) {
+    static const uint8_t pngSignature[8] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+    if (size >= sizeof(pngSignature) && std::memcmp(buffer, pngSignature, sizeof(pngSignature)) == 0) {
+        return ImageFormat::PNG;
+    }
+    if (size >= 2 && buffer[0] == 'B' && buffer[1] == 'M') {
+        return ImageFormat::BMP;
+    }
+    if (size >= 4 && std::memcmp(buffer, "qoif", 4) == 0) {
+        return ImageFormat::QOI;
+    }
+    return ImageFormat::Unknown;
+}
+
+ImageFormat formatFromName(const std::string& name) {
+    std::string lowerName = name;
+    std::transform(lowerName.begin(), lowerName.end(), lowerName.begin(), ::tolower);
+    if (lowerName == "png") return ImageFormat::PNG;
+    if (lowerName == "bmp") return ImageFormat::BMP;
+    if (lowerName == "qoi") return ImageFormat::QOI;
+    return ImageFormat::Unknown;
+}
+
+std::optional<ImageInfo> probeImage(const std::string& filename) {
+    if (isStdStream(filename) || !fileExists(filename) || !isSupportedFormat(filename)) return std::nullopt;
+    ImageInfo info;
+    std::error_code ec;
+    info.encodedBytes = static_cast<uint64_t>(std::filesystem::file_size(filename, ec));
+    if (ec) return std::nullopt;
+    if (isNetpbmFile(filename)) {
+        auto mapped = MappedImage::open(filename, false);
+        if (!mapped) return std::nullopt;
+        info.width = mapped->width();
+        info.height = mapped->height();
+        info.channels = mapped->channels();
+        return info;
+    }
+    if (isQoiFile(filename)) {
+        uint8_t header[QOI_HEADER_SIZE];
+        FILE* in = std::fopen(filename.c_str(), "rb");
+        if (!in) return std::nullopt;
+        size_t readBytes = std::fread(header, 1, sizeof(header), in);
+        std::fclose(in);
+        auto qoi = parseQoiHeader(header, readBytes);
+        if (!qoi) return std::nullopt;
+        info.width = qoi->width;
+        info.height = qoi->height;
+        info.channels = qoi->channels;
+        return info;
+    }
+    // stbi_info читает только заголовок
+    if (!stbi_info(filename.c_str(), &info.width, &info.height, &info.channels)) return std::nullopt;
+    return info;
 }
 
 Image loadImage(const std::string& filename) {
+    if (isStdStream(filename)) {
+        Trace::Span span("load image");
+        LOG_INFO("Reading the image from the standard input");
+        return loadImageFromMemory(readWholeStream(stdin));
+    }
+    std::optional<Image> image = tryLoadImage(filename);
+    if (!image) {
+        exit(EXIT_FAILURE);
+    }
+    return std::move(*image);
+}
+
+std::optional<Image> tryLoadImage(const std::string& filename) {
+    Trace::Span span("load image");
     if (!fileExists(filename)) {
         LOG_ERROR("The file: {} does not exist", filename);
-        exit(EXIT_FAILURE);
+        return std::nullopt;
     }
     if (!isSupportedFormat(filename)) {
         LOG_ERROR("Unsupported file format: {}", filename);
-        exit(EXIT_FAILURE);
+        return std::nullopt;
+    }
+    if (isNetpbmFile(filename)) {
+        // Netpbm (включая PAM, который stb не читает) копируется из отображения файла
+        auto mapped = MappedImage::open(filename, false);
+        if (!mapped) {
+            LOG_ERROR("Failed to load the image: {}", filename);
+            return std::nullopt;
+        }
+        return mapped->toImage();
+    }
+    if (isQoiFile(filename)) {
+        // QOI декодируется потоком, блоками, без копии закодированного файла в памяти
+        FILE* in = std::fopen(filename.c_str(), "rb");
+        std::optional<Image> image = in ? readQoi(in) : std::nullopt;
+        if (in) std::fclose(in);
+        if (!image) {
+            LOG_ERROR("Failed to load the image: {}", filename);
+            return std::nullopt;
+        }
+        LOG_INFO("Image information was loaded from the image succesfully");
+        return image;
     }
 
     int width, height, channels;
@@ -42,7 +188,7 @@ Image loadImage(const std::string& filename) {
     unsigned char* imgData = stbi_load(filename.c_str(), &width, &height, &channels, 0);
     if (!imgData) {
         LOG_ERROR("Failed to load the image: {}", filename);
-        exit(EXIT_FAILURE);
+        return std::nullopt;
     }
 
     size_t dataSize = static_cast<size_t>(width) * height * channels;
@@ -55,10 +201,86 @@ Image loadImage(const std::string& filename) {
     return Image{ width, height, channels, data };
 }
 
-void saveImage(const std::string& filename, const Image& image) {
+Image loadImageFromMemory(const std::vector<uint8_t>& buffer) {
+    Trace::Span span("decode image");
+    ImageFormat format = formatFromMagic(buffer.data(), buffer.size());
+    if (format == ImageFormat::Unknown) {
+        LOG_ERROR("Unsupported image format in the input buffer ({} bytes)", buffer.size());
+        exit(EXIT_FAILURE);
+    }
+    if (format == ImageFormat::QOI) {
+        if (auto info = parseQoiHeader(buffer.data(), buffer.size())) {
+            uint64_t carrierBytes = static_cast<uint64_t>(info->width) * info->height * info->channels;
+            MemoryBudget::require(carrierBytes + buffer.size(), "Decoding the image");
+        }
+        std::optional<Image> image = decodeQoi(buffer.data(), buffer.size());
+        if (!image) {
+            LOG_ERROR("Failed to decode the QOI image from memory");
+            exit(EXIT_FAILURE);
+        }
+        LOG_INFO("Image information was decoded from memory succesfully");
+        return std::move(*image);
+    }
+    if (buffer.size() > static_cast<size_t>(INT_MAX)) {
+        LOG_ERROR("The input buffer is too large to decode: {} bytes", buffer.size());
+        exit(EXIT_FAILURE);
+    }
+
+    int width, height, channels;
+    // Размеры из заголовка: поток уже прочитан, но декодирование ещё можно не начинать
+    if (stbi_info_from_memory(buffer.data(), static_cast<int>(buffer.size()), &width, &height, &channels)) {
+        uint64_t carrierBytes = static_cast<uint64_t>(width) * height * channels;
+        MemoryBudget::require(MemoryBudget::decodeBytes(buffer.size(), carrierBytes), "Decoding the image");
+    }
+    unsigned char* imgData = stbi_load_from_memory(buffer.data(), static_cast<int>(buffer.size()),
+                                                   &width, &height, &channels, 0);
+    if (!imgData) {
+        LOG_ERROR("Failed to decode the image from memory: {}", stbi_failure_reason());
+        exit(EXIT_FAILURE);
+    }
+
+    size_t dataSize = static_cast<size_t>(width) * height * channels;
+    std::vector<uint8_t> data(imgData, imgData + dataSize);
+    stbi_image_free(imgData);
+
+    LOG_INFO("Image information was decoded from memory succesfully");
+    return Image{ width, height, channels, data };
+}
+
+void saveImage(const std::string& filename, const Image& image, ImageFormat streamFormat) {
+    if (isStdStream(filename)) {
+        Trace::Span span("encode image");
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        int success = 0;
+        if (streamFormat == ImageFormat::PNG) {
+            success = stbi_write_png_to_func(writeToFile, stdout, image.width, image.height, image.channels,
+                                             image.data.data(), image.width * image.channels);
+        } else if (streamFormat == ImageFormat::BMP) {
+            success = stbi_write_bmp_to_func(writeToFile, stdout, image.width, image.height, image.channels,
+                                             image.data.data());
+        } else if (streamFormat == ImageFormat::QOI) {
+            success = writeQoi(stdout, image);
+        }
+        if (!success || std::fflush(stdout) != 0) {
+            LOG_ERROR("Failed to write the image to the standard output");
+            exit(EXIT_FAILURE);
+        }
+        LOG_INFO("The picture was written to the standard output");
+        return;
+    }
+
+    if (!trySaveImage(filename, image)) {
+        exit(EXIT_FAILURE);
+    }
+}
+
+bool trySaveImage(const std::string& filename, const Image& image) {
+    Trace::Span span("encode image");
     if (!isSupportedFormat(filename)) {
         LOG_ERROR("Unsuported file format {}", filename);
-        exit(EXIT_FAILURE);
+        return false;
     }
 
     std::string lowerFilename = filename;
@@ -72,13 +294,18 @@ void saveImage(const std::string& filename, const Image& image) {
     } else if (lowerFilename.substr(lowerFilename.size() - 4) == ".bmp") {
         success = stbi_write_bmp(filename.c_str(), image.width, image.height, image.channels,
                                  image.data.data());
+    } else if (lowerFilename.substr(lowerFilename.size() - 4) == ".qoi") {
+        success = writeQoi(filename, image);
+    } else if (isNetpbmFile(lowerFilename)) {
+        success = writeNetpbm(filename, image);
     }
 
     if (!success) {
         LOG_ERROR("Failed to save image");
-        exit(EXIT_FAILURE);
+        return false;
     }
     LOG_INFO("The picture was saved in {}", filename);
+    return true;
 }
 
 } // namespace ImageHandler
@@ -0,0 +1,146 @@
+#include "lsb_plane.h"
+#include "parallel.h"
+#include "trace.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define STEGANO_LSB_PLANE_SSE2 1
+#endif
+
+namespace Stegano {
+
+namespace {
+
+// Смена направления шума у краёв диапазона, как у побайтового шума
+inline uint8_t noisyByte(uint8_t value, uint8_t noise) {
+    if (value == 0) return 1;
+    if (value == 255) return 254;
+    return static_cast<uint8_t>((noise & 1) ? value + 1 : value - 1);
+}
+
+inline uint64_t packScalar(const uint8_t* data, size_t count) {
+    uint64_t word = 0;
+    for (size_t i = 0; i < count; i++) {
+        word |= static_cast<uint64_t>(data[i] & 0x01) << i;
+    }
+    return word;
+}
+
+#ifdef STEGANO_LSB_PLANE_SSE2
+// Бит 0 каждого байта сдвигается в бит 7 того же байта и собирается movemask
+inline uint64_t packWord(const uint8_t* data) {
+    uint64_t word = 0;
+    for (int part = 0; part < 4; part++) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + part * 16));
+        uint64_t bits = static_cast<uint16_t>(_mm_movemask_epi8(_mm_slli_epi16(bytes, 7)));
+        word |= bits << (part * 16);
+    }
+    return word;
+}
+
+// 16 бит -> 16 байт 0x00/0xFF
+inline __m128i expandBits(unsigned int bits) {
+    __m128i v = _mm_cvtsi32_si128(static_cast<int>(bits));
+    v = _mm_unpacklo_epi8(v, v);
+    v = _mm_unpacklo_epi16(v, v);
+    v = _mm_unpacklo_epi32(v, v);
+    const __m128i selectors = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    return _mm_cmpeq_epi8(_mm_and_si128(v, selectors), selectors);
+}
+
+inline __m128i withLsbs(__m128i bytes, __m128i lsbMask) {
+    return _mm_or_si128(_mm_andnot_si128(_mm_set1_epi8(0x01), bytes), _mm_and_si128(lsbMask, _mm_set1_epi8(0x01)));
+}
+#else
+inline uint64_t packWord(const uint8_t* data) {
+    return packScalar(data, 64);
+}
+#endif
+
+} // namespace
+
+LsbPlane LsbPlane::extract(const uint8_t* data, size_t size) {
+    Trace::Span span("extract lsb plane");
+    LsbPlane plane(size);
+    const size_t fullWords = size / 64;
+    // Слова независимы, диапазоны слов делятся между потоками
+    Parallel::forRanges(fullWords, Parallel::PAYLOAD_CUTOFF_BYTES, 1, [&](size_t first, size_t last) {
+        for (size_t w = first; w < last; w++) {
+            plane.words[w] = packWord(data + w * 64);
+        }
+    });
+    if (fullWords < plane.words.size()) {
+        plane.words[fullWords] = packScalar(data + fullWords * 64, size - fullWords * 64);
+    }
+    return plane;
+}
+
+void LsbPlane::merge(uint8_t* data) const {
+    Trace::Span span("merge lsb plane");
+    const size_t fullWords = n / 64;
+    Parallel::forRanges(fullWords, Parallel::PAYLOAD_CUTOFF_BYTES, 1, [&](size_t first, size_t last) {
+        for (size_t w = first; w < last; w++) {
+            uint8_t* bytes = data + w * 64;
+#ifdef STEGANO_LSB_PLANE_SSE2
+            for (int part = 0; part < 4; part++) {
+                __m128i* chunk = reinterpret_cast<__m128i*>(bytes + part * 16);
+                __m128i lsbs = expandBits(static_cast<unsigned int>(words[w] >> (part * 16)) & 0xFFFF);
+                _mm_storeu_si128(chunk, withLsbs(_mm_loadu_si128(chunk), lsbs));
+            }
+#else
+            for (size_t i = 0; i < 64; i++) {
+                bytes[i] = static_cast<uint8_t>((bytes[i] & 0xFE) | ((words[w] >> i) & 0x01));
+            }
+#endif
+        }
+    });
+    for (size_t i = fullWords * 64; i < n; i++) {
+        data[i] = static_cast<uint8_t>((data[i] & 0xFE) | (test(i) ? 1 : 0));
+    }
+}
+
+void LsbPlane::mergeNoisy(uint8_t* data, size_t begin, size_t end, const uint8_t* noise, unsigned int threshold,
+                          const LsbPlane& skip) const {
+    // Байт меняется, если (noise >> 1) < threshold, то есть noise <= 2 * threshold - 1
+    const unsigned int limit = std::min(threshold, 128u) * 2;
+    size_t i = begin;
+#ifdef STEGANO_LSB_PLANE_SSE2
+    const __m128i one = _mm_set1_epi8(0x01);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i full = _mm_set1_epi8(-1);
+    const __m128i highest = _mm_set1_epi8(static_cast<char>(limit == 0 ? 0 : limit - 1));
+    for (; i + 16 <= end; i += 16) {
+        const unsigned int shift = static_cast<unsigned int>(i & 63);
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i noiseBytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(noise + (i - begin)));
+        __m128i lsbs = expandBits(static_cast<unsigned int>(words[i >> 6] >> shift) & 0xFFFF);
+        __m128i skipped = expandBits(static_cast<unsigned int>(skip.words[i >> 6] >> shift) & 0xFFFF);
+
+        __m128i change = limit == 0 ? zero : _mm_cmpeq_epi8(_mm_max_epu8(noiseBytes, highest), highest);
+        change = _mm_andnot_si128(skipped, change);
+        __m128i up = _mm_cmpeq_epi8(_mm_and_si128(noiseBytes, one), one);
+        __m128i atZero = _mm_cmpeq_epi8(bytes, zero);
+        __m128i atFull = _mm_cmpeq_epi8(bytes, full);
+        // +1 там, где направление вверх и байт не 255, либо байт равен 0; остальные изменяемые -1
+        __m128i plus = _mm_and_si128(change, _mm_or_si128(_mm_andnot_si128(atFull, up), atZero));
+        __m128i minus = _mm_andnot_si128(plus, change);
+
+        // Изменяемые байты не входят в skip, поэтому их бит в плоскости совпадает с исходным
+        __m128i merged = withLsbs(bytes, lsbs);
+        merged = _mm_add_epi8(_mm_sub_epi8(merged, plus), minus);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), merged);
+    }
+#endif
+    for (; i < end; i++) {
+        const uint8_t noiseByte = noise[i - begin];
+        if (static_cast<unsigned int>(noiseByte) < limit && !skip.test(i)) {
+            data[i] = noisyByte(data[i], noiseByte);
+        } else {
+            data[i] = static_cast<uint8_t>((data[i] & 0xFE) | (test(i) ? 1 : 0));
+        }
+    }
+}
+
+} // namespace Stegano
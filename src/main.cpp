@@ -5,39 +5,344 @@
 #include <sstream>
 #include <cstdint>
 #include <cstring>
+#include <optional>
+#include <algorithm>
+#include <filesystem>
 
 #include "encryption/encryption.h"
 #include "encryption/decrytpion.h"
 #include "external/logger.h"
 #include "external/stb_image_write.h"
 #include "stegano.h"
+#include "steganalysis.h"
+#include "matrix_embedding.h"
+#include "parallel.h"
+#include "video_stegano.h"
+#include "tiled_stegano.h"
+#include "audio_stegano.h"
+#include "memory_budget.h"
+#include "carrier_cache.h"
+#include "position_cache.h"
+#include "trace.h"
+#include "y4m.h"
+#include "watch_folder.h"
 #include "CliParser.h"
 
+namespace {
+
+// Оценка пика памяти по заголовку изображения до декодирования; при нехватке бюджета
+// адаптивный режим отключается, а если не помещается и без него - программа завершается
+void checkImageBudget(CliConfig& config, bool inPlace, size_t payloadBytes) {
+    if (MemoryBudget::limit() == 0) return;
+    auto info = ImageHandler::probeImage(config.inFile);
+    if (!info) {
+        LOG_WARN("The memory use of {} cannot be estimated before reading it", config.inFile);
+        return;
+    }
+    const uint64_t carrierBytes = static_cast<uint64_t>(info->width) * info->height * info->channels;
+    const size_t carrierSize = static_cast<size_t>(carrierBytes);
+    // Матричное встраивание может занять до всех байт носителя
+    size_t positions = config.matrix ? carrierSize : std::min(carrierSize, payloadBytes * 8);
+    size_t peak = MemoryBudget::embedBytes(info->encodedBytes, carrierBytes, positions, inPlace);
+    size_t adaptivePeak = peak + MemoryBudget::adaptiveBytes(carrierBytes, !inPlace);
+    if (config.adaptive && !MemoryBudget::fits(adaptivePeak) && MemoryBudget::fits(peak)) {
+        LOG_WARN("The adaptive cost map does not fit into --max-memory, uniform positions are used");
+        config.adaptive = false;
+    }
+    MemoryBudget::require(config.adaptive ? adaptivePeak : peak,
+                          inPlace ? "In-place embedding" : "Decoding and re-encoding the image");
+}
+
+// Оценка декодирования изображения при извлечении (отображённые файлы не декодируются)
+void checkDecodeBudget(const CliConfig& config) {
+    if (MemoryBudget::limit() == 0) return;
+    auto info = ImageHandler::probeImage(config.inFile);
+    if (!info) {
+        LOG_WARN("The memory use of {} cannot be estimated before reading it", config.inFile);
+        return;
+    }
+    const uint64_t carrierBytes = static_cast<uint64_t>(info->width) * info->height * info->channels;
+    MemoryBudget::require(MemoryBudget::decodeBytes(info->encodedBytes, carrierBytes), "Decoding the image");
+}
+
+// Несжатые BMP/PGM/PPM/PAM не перекодируются: копия входного файла открывается для изменения на месте
+std::optional<ImageHandler::MappedImage> prepareInPlaceOutput(const CliConfig& config) {
+    std::optional<ImageHandler::MappedImage> mapped;
+    std::error_code ec;
+    std::filesystem::copy_file(config.inFile, config.outFile, ec);
+    if (!ec) {
+        mapped = ImageHandler::MappedImage::open(config.outFile, true);
+    }
+    if (!mapped) {
+        LOG_ERROR("Failed to prepare the output file {} for in-place embedding", config.outFile);
+        exit(EXIT_FAILURE);
+    }
+    return mapped;
+}
+
+// --update: прежний контейнер проверяется ключом, новый ложится на те же позиции с параметрами из
+// его заголовка; меняются только отличающиеся биты, шум не добавляется
+void updateImage(CliConfig& config, const std::vector<uint8_t>& steganoKey) {
+    if (config.adaptive || config.matrix || config.noiseDensity != Stegano::MAX_NOISE_DENSITY) {
+        LOG_WARN("--adaptive, --matrix and --noise are taken from the existing message with --update and are ignored");
+        config.adaptive = false;
+    }
+    std::optional<ImageHandler::MappedImage> mapped;
+    ImageHandler::Image image;
+    bool inPlace = ImageHandler::canEmbedInPlace(config.inFile, config.outFile);
+    checkImageBudget(config, inPlace, DataConversion::HEADER_SIZE + DataConversion::KEY_CHECK_SIZE +
+                                      Encryption::containerSize(config.textMessage.size(), DataConversion::ContainerLayout::Chunked));
+    if (inPlace) {
+        mapped = prepareInPlaceOutput(config);
+    } else {
+        image = ImageHandler::loadImage(config.inFile);
+    }
+
+    Decryption::ExtractResult previous = mapped ? Decryption::tryDecryptMessage(config.passphrase, *mapped, steganoKey)
+                                                : Decryption::tryDecryptMessage(config.passphrase, image, steganoKey);
+    if (previous.status != Decryption::ExtractStatus::Ok) {
+        LOG_ERROR("The key does not open a message in {}: nothing to update", config.inFile);
+        if (mapped) {
+            mapped.reset();
+            std::error_code ec;
+            std::filesystem::remove(config.outFile, ec);
+        }
+        exit(EXIT_FAILURE);
+    }
+    LOG_INFO("The existing message ({} bytes) was authenticated and will be replaced", previous.message.size());
+
+    // Раскладка сохраняется: иначе новый заголовок лёг бы на другие позиции, а прежний остался бы читаемым
+    auto container = Encryption::getEncryptedContainer(config, previous.header.layout);
+    Stegano::EmbedOptions options;
+    options.engine = static_cast<Stegano::EngineId>(previous.header.engine);
+    options.adaptiveLevel = previous.header.adaptiveLevel;
+    options.matrixK = previous.header.matrixK;
+    options.indexed = previous.header.layout == DataConversion::ContainerLayout::Chunked;
+    options.headerBytes = DataConversion::HEADER_SIZE + DataConversion::KEY_CHECK_SIZE;
+
+    DataConversion::ContainerHeader header = previous.header;
+    auto embededText = Encryption::getReadyToEmbedText(container, header, steganoKey);
+    if (mapped) {
+        Stegano::updateDataInPlace(*mapped, embededText, steganoKey, options);
+        if (config.analyze) {
+            Stegano::printSteganalysisReport(Stegano::analyzeImage(*mapped, Parallel::defaultThreadCount()), "the output image");
+        }
+        LOG_INFO("The picture was saved in {}", config.outFile);
+    } else {
+        Stegano::updateData(image, embededText, steganoKey, options);
+        if (config.analyze) {
+            Stegano::printSteganalysisReport(Stegano::analyzeImage(image, Parallel::defaultThreadCount()), "the output image");
+        }
+        ImageHandler::saveImage(config.outFile, image, ImageHandler::formatFromName(config.outFormat));
+    }
+}
+
+} // namespace
+
 int main(int argc, char* argv[]) {
+    MemoryBudget::PeakReport peakReport;
 
     auto& config = CliParser::parse(argc, argv);
+    if (!config.tracePath.empty()) {
+        Trace::start(config.tracePath);
+    }
+    Parallel::setDefaultThreadCount(config.threadCount);
+    MemoryBudget::setLimit(config.maxMemory);
+    Stegano::PositionCache::instance().configure(config.positionCacheSize, config.positionCacheDir);
     
     // Конвертируем passphrase в вектор байтов для стеганографии (используем ASCII представление)
     std::vector<uint8_t> steganoKey = DataConversion::stringToBytes(config.passphrase);
     
     if (config.modeCrypt) {
         LOG_INFO("--------------Crypt mode start---------------");
-        // Загрузка исходного изображения
-        ImageHandler::Image image = ImageHandler::loadImage(config.inFile);
+        if (!config.watchDir.empty()) {
+            // Режим спула работает до сигнала остановки, контейнер шифруется для каждого файла
+            return WatchFolder::run(config, steganoKey);
+        }
+        if (config.update) {
+            updateImage(config, steganoKey);
+            Stegano::PositionCache::instance().logStats();
+            LOG_INFO("-----------crypto mode end ----------");
+            return 0;
+        }
+
+        // Видео и плиточный TIFF хранят один шифртекст; изображения с длинным сообщением - блочный контейнер
+        bool singleOnly = VideoHandler::isY4MFile(config.inFile) || ImageHandler::isTiffFile(config.inFile);
+        DataConversion::ContainerLayout layout = singleOnly ? DataConversion::ContainerLayout::Single
+                                                            : DataConversion::layoutForMessage(config.textMessage.size());
+        auto container = Encryption::getEncryptedContainer(config, layout);
+
+        if (VideoHandler::isY4MFile(config.inFile)) {
+            // Видео: контейнер распределяется по кадрам, кадры проходят через конвейер чтение-встраивание-запись
+            if (config.adaptive || config.matrix || config.analyze) {
+                LOG_WARN("--adaptive, --matrix and --analyze are not supported for video carriers and are ignored");
+            }
+            Stegano::embedVideo(config.inFile, config.outFile, container, steganoKey,
+                                *Stegano::engineFromName(config.engineName), config.noiseDensity,
+                                Parallel::defaultThreadCount());
+            Stegano::PositionCache::instance().logStats();
+            LOG_INFO("-----------crypto mode end ----------");
+            return 0;
+        }
+
+        if (ImageHandler::isTiffFile(config.inFile)) {
+            // Плиточный TIFF: перезаписываются только плитки с позициями сообщения
+            // Шум покрытия не пишется: он затронул бы все плитки, а не только плитки сообщения
+            if (config.adaptive || config.matrix || config.analyze || config.noiseDensity != Stegano::MAX_NOISE_DENSITY) {
+                LOG_WARN("--adaptive, --matrix, --noise and --analyze are not supported for tiled TIFF carriers and are ignored");
+            }
+            Stegano::EngineId engine = *Stegano::engineFromName(config.engineName);
+            DataConversion::ContainerHeader header;
+            header.engine = static_cast<uint8_t>(engine);
+            auto embededText = Encryption::getReadyToEmbedText(container, header, steganoKey);
+            Stegano::embedTiled(config.inFile, config.outFile, embededText, steganoKey, engine, Parallel::defaultThreadCount());
+            LOG_INFO("The picture was saved in {}", config.outFile);
+            Stegano::PositionCache::instance().logStats();
+            LOG_INFO("-----------crypto mode end ----------");
+            return 0;
+        }
 
-        auto embededText = Encryption::getReadyToEmbedText(config);
+        if (AudioHandler::isWavFile(config.inFile)) {
+            // PCM WAV: файл проходит блоками, меняются только LSB отсчётов, остальные чанки копируются как есть
+            if (config.adaptive || config.analyze) {
+                LOG_WARN("--adaptive and --analyze are not supported for audio carriers and are ignored");
+            }
+            auto audio = AudioHandler::WavFile::open(config.inFile);
+            if (!audio) {
+                LOG_ERROR("{} is not a WAV file with 16- or 24-bit integer PCM samples", config.inFile);
+                return EXIT_FAILURE;
+            }
+            Stegano::EmbedOptions options = Stegano::chooseEmbedOptions(
+                static_cast<size_t>(audio->size()), container.size(), DataConversion::HEADER_SIZE + DataConversion::KEY_CHECK_SIZE,
+                *Stegano::engineFromName(config.engineName), nullptr, config.matrix, config.noiseDensity);
+            options.indexed = layout == DataConversion::ContainerLayout::Chunked;
 
-        // Встраиваем данные в изображение
-        Stegano::embedData(image, embededText, steganoKey);
+            DataConversion::ContainerHeader header;
+            header.engine = static_cast<uint8_t>(options.engine);
+            header.matrixK = options.matrixK;
+            header.layout = layout;
+            auto embededText = Encryption::getReadyToEmbedText(container, header, steganoKey);
+            Stegano::embedAudio(config.inFile, config.outFile, embededText, steganoKey, options, Parallel::defaultThreadCount());
+            LOG_INFO("The audio was saved in {}", config.outFile);
+            Stegano::PositionCache::instance().logStats();
+            LOG_INFO("-----------crypto mode end ----------");
+            return 0;
+        }
 
-        // Сохраняем изменённое изображение
-        ImageHandler::saveImage(config.outFile, image);
+        std::optional<ImageHandler::MappedImage> mapped;
+        ImageHandler::Image image;
+        bool inPlace = ImageHandler::canEmbedInPlace(config.inFile, config.outFile);
+        checkImageBudget(config, inPlace,
+                         DataConversion::HEADER_SIZE + DataConversion::KEY_CHECK_SIZE + container.size());
+        if (inPlace) {
+            mapped = prepareInPlaceOutput(config);
+        } else {
+            // Загрузка исходного изображения
+            image = ImageHandler::loadImage(config.inFile);
+        }
+        size_t carrierSize = mapped ? mapped->size() : image.data.size();
+
+        std::vector<uint8_t> costMap;
+        if (config.adaptive) {
+            costMap = Stegano::computeCostMap(mapped ? mapped->toImage() : image, Parallel::defaultThreadCount());
+        }
+        Stegano::EmbedOptions options = Stegano::chooseEmbedOptions(
+            carrierSize, container.size(), DataConversion::HEADER_SIZE + DataConversion::KEY_CHECK_SIZE,
+            *Stegano::engineFromName(config.engineName), config.adaptive ? &costMap : nullptr, config.matrix,
+            config.noiseDensity);
+        options.indexed = layout == DataConversion::ContainerLayout::Chunked;
+
+        DataConversion::ContainerHeader header;
+        header.engine = static_cast<uint8_t>(options.engine);
+        header.adaptiveLevel = options.adaptiveLevel;
+        header.matrixK = options.matrixK;
+        header.layout = layout;
+        auto embededText = Encryption::getReadyToEmbedText(container, header, steganoKey);
+
+        if (mapped) {
+            Stegano::embedDataInPlace(*mapped, embededText, steganoKey, options);
+            if (config.analyze) {
+                Stegano::printSteganalysisReport(Stegano::analyzeImage(*mapped, Parallel::defaultThreadCount()), "the output image");
+            }
+            LOG_INFO("The picture was saved in {}", config.outFile);
+        } else {
+            // Встраиваем данные в изображение
+            Stegano::embedData(image, embededText, steganoKey, options);
+            if (config.analyze) {
+                // Самопроверка на буфере изображения до кодирования
+                Stegano::printSteganalysisReport(Stegano::analyzeImage(image, Parallel::defaultThreadCount()), "the output image");
+            }
+
+            // Сохраняем изменённое изображение
+            ImageHandler::saveImage(config.outFile, image, ImageHandler::formatFromName(config.outFormat));
+        }
+        Stegano::PositionCache::instance().logStats();
         LOG_INFO("-----------crypto mode end ----------");
     } 
     else if (config.modeEncrypt) {
         LOG_INFO("-----------encrypto mode start-------");
-        // Режим извлечения
-        ImageHandler::Image image = ImageHandler::loadImage(config.inFile);
+        if (VideoHandler::isY4MFile(config.inFile) && config.candidateKeys.empty()) {
+            std::cout << Decryption::getDecryptedVideoMessage(config, steganoKey) << std::endl;
+            LOG_INFO("----------encrypto mode finish--------");
+            return 0;
+        }
+
+        if (AudioHandler::isWavFile(config.inFile)) {
+            auto audio = AudioHandler::WavFile::open(config.inFile);
+            if (!audio) {
+                LOG_ERROR("{} is not a WAV file with 16- or 24-bit integer PCM samples", config.inFile);
+                return EXIT_FAILURE;
+            }
+            std::cout << Decryption::getDecryptedMessage(config, *audio, steganoKey) << std::endl;
+            LOG_INFO("----------encrypto mode finish--------");
+            return 0;
+        }
+
+        if (ImageHandler::isTiffFile(config.inFile)) {
+            auto tiff = ImageHandler::TiledTiff::open(config.inFile, false);
+            if (!tiff) {
+                LOG_ERROR("{} is not a tiled TIFF with 8-bit interleaved samples and lossless compression", config.inFile);
+                return EXIT_FAILURE;
+            }
+            std::cout << Decryption::getDecryptedMessage(config, *tiff, steganoKey) << std::endl;
+            LOG_INFO("----------encrypto mode finish--------");
+            return 0;
+        }
+
+        // Режим извлечения: несжатый файл читается через отображение, только нужные страницы
+        auto mapped = ImageHandler::MappedImage::open(config.inFile, false);
+        std::optional<ImageHandler::CarrierCache> cache;
+        if (!mapped && !config.cacheDir.empty()) {
+            // Сжатое изображение: декодированные пиксели могут уже лежать в кэше
+            cache.emplace(config.cacheDir, config.cacheSize);
+            mapped = cache->load(config.inFile);
+        }
+        if (mapped && config.candidateKeys.empty()) {
+            std::cout << Decryption::getDecryptedMessage(config, *mapped, steganoKey) << std::endl;
+            LOG_INFO("----------encrypto mode finish--------");
+            return 0;
+        }
+        if (!mapped) {
+            checkDecodeBudget(config);
+        }
+        ImageHandler::Image image = mapped ? mapped->toImage() : ImageHandler::loadImage(config.inFile);
+        if (cache && !mapped) {
+            cache->store(config.inFile, image);
+        }
+
+        if (!config.candidateKeys.empty()) {
+            // Изображение декодируется один раз, ключи перебираются параллельно
+            auto trial = Decryption::findMessageWithKeys(config.candidateKeys, image, Parallel::defaultThreadCount());
+            if (!trial.found) {
+                LOG_ERROR("None of the candidate keys matches the image");
+                return EXIT_FAILURE;
+            }
+            std::cerr << "Matching key (line " << config.candidateKeyLines[trial.keyIndex] << " of the keys file): "
+                      << config.candidateKeys[trial.keyIndex] << "\n";
+            std::cout << trial.message << std::endl;
+            LOG_INFO("----------encrypto mode finish--------");
+            return 0;
+        }
         
         std::string decryptedMessage = Decryption::getDecryptedMessage(config, image, steganoKey);
         std::cout << decryptedMessage << std::endl;
@@ -0,0 +1,357 @@
+#include "mapped_image.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <climits>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define STEGANO_HAVE_MMAP 1
+#endif
+
+namespace ImageHandler {
+
+namespace {
+
+// Параметры раскладки пикселей в файле
+struct RawLayout {
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    size_t pixelOffset = 0;
+    size_t stride = 0;
+    bool bottomUp = false;
+    bool bgr = false;
+    int maxValue = 255;
+};
+
+uint32_t readLE32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint16_t readLE16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+std::string lowerExtension(const std::string& filename) {
+    if (filename.size() < 4) return "";
+    std::string ext = filename.substr(filename.size() - 4);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext;
+}
+
+// Несжатый BMP (BI_RGB) с 24 битами на пиксель; stb отдаёт такие файлы как RGB сверху вниз
+bool parseBmp(const uint8_t* file, size_t size, RawLayout& layout) {
+    if (size < 54 || file[0] != 'B' || file[1] != 'M') return false;
+    uint32_t pixelOffset = readLE32(file + 10);
+    uint32_t infoSize = readLE32(file + 14);
+    int32_t width = static_cast<int32_t>(readLE32(file + 18));
+    int32_t height = static_cast<int32_t>(readLE32(file + 22));
+    uint16_t bitsPerPixel = readLE16(file + 28);
+    uint32_t compression = readLE32(file + 30);
+
+    // 32-битные и палитровые файлы stb преобразует при декодировании, их позиции не совпадают с файлом
+    if (infoSize < 40 || bitsPerPixel != 24 || compression != 0) return false;
+    if (width <= 0 || height == 0 || height == INT32_MIN) return false;
+
+    layout.width = width;
+    layout.height = height > 0 ? height : -height;
+    layout.channels = 3;
+    layout.pixelOffset = pixelOffset;
+    layout.stride = (static_cast<size_t>(width) * 3 + 3) / 4 * 4;
+    layout.bottomUp = height > 0;
+    layout.bgr = true;
+    return true;
+}
+
+void skipNetpbmSpace(const uint8_t* file, size_t size, size_t& pos) {
+    while (pos < size) {
+        if (file[pos] == '#') {
+            while (pos < size && file[pos] != '\n') pos++;
+        } else if (std::isspace(file[pos])) {
+            pos++;
+        } else {
+            break;
+        }
+    }
+}
+
+bool readNetpbmNumber(const uint8_t* file, size_t size, size_t& pos, long& value) {
+    skipNetpbmSpace(file, size, pos);
+    if (pos >= size || !std::isdigit(file[pos])) return false;
+    value = 0;
+    while (pos < size && std::isdigit(file[pos])) {
+        value = value * 10 + (file[pos++] - '0');
+        if (value > INT_MAX) return false;
+    }
+    return true;
+}
+
+// Бинарные P5 (PGM) и P6 (PPM) с maxval <= 255: пиксели идут подряд сразу после заголовка
+bool parsePnm(const uint8_t* file, size_t size, RawLayout& layout) {
+    if (size < 3 || file[0] != 'P' || (file[1] != '5' && file[1] != '6')) return false;
+    size_t pos = 2;
+    long width, height, maxValue;
+    if (!readNetpbmNumber(file, size, pos, width) || !readNetpbmNumber(file, size, pos, height) ||
+        !readNetpbmNumber(file, size, pos, maxValue)) {
+        return false;
+    }
+    if (pos >= size || !std::isspace(file[pos]) || maxValue < 1 || maxValue > 255) return false;
+
+    layout.width = static_cast<int>(width);
+    layout.height = static_cast<int>(height);
+    layout.channels = file[1] == '5' ? 1 : 3;
+    layout.pixelOffset = pos + 1;
+    layout.stride = static_cast<size_t>(width) * layout.channels;
+    layout.maxValue = static_cast<int>(maxValue);
+    return true;
+}
+
+// P7 (PAM): строки "ключ значение" до ENDHDR
+bool parsePam(const uint8_t* file, size_t size, RawLayout& layout) {
+    if (size < 3 || std::memcmp(file, "P7\n", 3) != 0) return false;
+    size_t pos = 3;
+    long width = 0, height = 0, depth = 0, maxValue = 0;
+    while (pos < size) {
+        size_t lineEnd = pos;
+        while (lineEnd < size && file[lineEnd] != '\n') lineEnd++;
+        std::string line(reinterpret_cast<const char*>(file + pos), lineEnd - pos);
+        pos = lineEnd + 1;
+
+        if (line == "ENDHDR") {
+            // Размеры ограничены как у P5/P6: иначе приведение к int обрезало бы их, а шаг строки - нет
+            if (width <= 0 || width > INT_MAX || height <= 0 || height > INT_MAX) return false;
+            if (depth < 1 || depth > 4 || maxValue < 1 || maxValue > 255) return false;
+            layout.width = static_cast<int>(width);
+            layout.height = static_cast<int>(height);
+            layout.channels = static_cast<int>(depth);
+            layout.pixelOffset = pos;
+            layout.stride = static_cast<size_t>(width) * depth;
+            layout.maxValue = static_cast<int>(maxValue);
+            return true;
+        }
+        long value = 0;
+        if (std::sscanf(line.c_str(), "WIDTH %ld", &value) == 1) width = value;
+        else if (std::sscanf(line.c_str(), "HEIGHT %ld", &value) == 1) height = value;
+        else if (std::sscanf(line.c_str(), "DEPTH %ld", &value) == 1) depth = value;
+        else if (std::sscanf(line.c_str(), "MAXVAL %ld", &value) == 1) maxValue = value;
+    }
+    return false;
+}
+
+bool parseLayout(const uint8_t* file, size_t size, RawLayout& layout) {
+    if (!parseBmp(file, size, layout) && !parsePnm(file, size, layout) && !parsePam(file, size, layout)) {
+        return false;
+    }
+    if (layout.width <= 0 || layout.height <= 0) return false;
+    // Последняя строка BMP может быть без выравнивания; проверка без умножения, которое могло бы переполниться
+    size_t lastRow = static_cast<size_t>(layout.width) * layout.channels;
+    if (layout.pixelOffset > size || lastRow > size - layout.pixelOffset) return false;
+    return static_cast<size_t>(layout.height - 1) <= (size - layout.pixelOffset - lastRow) / layout.stride;
+}
+
+bool isRawExtension(const std::string& ext) {
+    return ext == ".bmp" || ext == ".pgm" || ext == ".ppm" || ext == ".pam";
+}
+
+} // namespace
+
+std::optional<MappedImage> MappedImage::open(const std::string& filename, bool writable) {
+#ifdef STEGANO_HAVE_MMAP
+    if (isStdStream(filename) || !isRawExtension(lowerExtension(filename))) return std::nullopt;
+
+    MappedImage image;
+    image.fd = ::open(filename.c_str(), writable ? O_RDWR : O_RDONLY);
+    if (image.fd < 0) {
+        LOG_DEBUG("Failed to open {} for mapping", filename);
+        return std::nullopt;
+    }
+    struct stat status;
+    if (fstat(image.fd, &status) != 0 || status.st_size <= 0) {
+        return std::nullopt;
+    }
+    image.mappingSize = static_cast<size_t>(status.st_size);
+    void* address = mmap(nullptr, image.mappingSize, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, image.fd, 0);
+    if (address == MAP_FAILED) {
+        LOG_DEBUG("Failed to map {}", filename);
+        image.mappingSize = 0;
+        return std::nullopt;
+    }
+    image.mapping = static_cast<uint8_t*>(address);
+
+    RawLayout layout;
+    if (!parseLayout(image.mapping, image.mappingSize, layout)) {
+        LOG_DEBUG("{} has no raw pixel layout, it will be decoded", filename);
+        return std::nullopt;
+    }
+    // Позиции ключа разбросаны по всему файлу: упреждающее чтение только увеличило бы ввод-вывод
+    madvise(image.mapping, image.mappingSize, MADV_RANDOM);
+
+    image.imageWidth = layout.width;
+    image.imageHeight = layout.height;
+    image.imageChannels = layout.channels;
+    image.pixelOffset = layout.pixelOffset;
+    image.stride = layout.stride;
+    image.bottomUp = layout.bottomUp;
+    image.bgr = layout.bgr;
+    image.sampleMax = layout.maxValue;
+    LOG_INFO("{} was mapped: {}x{}, {} channels", filename, layout.width, layout.height, layout.channels);
+    return image;
+#else
+    (void)filename;
+    (void)writable;
+    return std::nullopt;
+#endif
+}
+
+MappedImage::MappedImage(MappedImage&& other) noexcept {
+    *this = std::move(other);
+}
+
+MappedImage& MappedImage::operator=(MappedImage&& other) noexcept {
+    if (this != &other) {
+        release();
+        fd = other.fd;
+        mapping = other.mapping;
+        mappingSize = other.mappingSize;
+        imageWidth = other.imageWidth;
+        imageHeight = other.imageHeight;
+        imageChannels = other.imageChannels;
+        pixelOffset = other.pixelOffset;
+        stride = other.stride;
+        bottomUp = other.bottomUp;
+        bgr = other.bgr;
+        sampleMax = other.sampleMax;
+        other.fd = -1;
+        other.mapping = nullptr;
+        other.mappingSize = 0;
+    }
+    return *this;
+}
+
+MappedImage::~MappedImage() {
+    release();
+}
+
+void MappedImage::release() {
+#ifdef STEGANO_HAVE_MMAP
+    if (mapping) {
+        munmap(mapping, mappingSize);
+        mapping = nullptr;
+    }
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+#endif
+}
+
+size_t MappedImage::offsetOf(size_t position) const {
+    const size_t bytesPerRow = rowBytes();
+    size_t y = position / bytesPerRow;
+    size_t inRow = position % bytesPerRow;
+    if (bgr) {
+        // RGB -> BGR внутри пикселя
+        size_t channel = inRow % 3;
+        inRow += 2 - 2 * channel;
+    }
+    return imageRowOffset(y) + inRow;
+}
+
+void MappedImage::mapPositions(std::vector<size_t>& positions) const {
+    for (size_t& position : positions) {
+        position = offsetOf(position);
+    }
+}
+
+void MappedImage::evict(size_t offset, size_t length) {
+#ifdef STEGANO_HAVE_MMAP
+    // Границы выравниваются по страницам внутрь диапазона, соседние данные не затрагиваются
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t begin = (offset + page - 1) / page * page;
+    size_t end = std::min(offset + length, mappingSize) / page * page;
+    if (!mapping || begin >= end) return;
+    msync(mapping + begin, end - begin, MS_SYNC);
+    madvise(mapping + begin, end - begin, MADV_DONTNEED);
+#else
+    (void)offset;
+    (void)length;
+#endif
+}
+
+Image MappedImage::toImage() const {
+    Trace::Span span("copy mapped pixels");
+#ifdef STEGANO_HAVE_MMAP
+    madvise(mapping, mappingSize, MADV_SEQUENTIAL);
+#endif
+    Image image{ imageWidth, imageHeight, imageChannels, std::vector<uint8_t>(size()) };
+    const size_t bytesPerRow = rowBytes();
+    for (size_t y = 0; y < rowCount(); y++) {
+        const uint8_t* source = mapping + imageRowOffset(y);
+        uint8_t* target = image.data.data() + y * bytesPerRow;
+        if (!bgr) {
+            std::memcpy(target, source, bytesPerRow);
+            continue;
+        }
+        for (size_t x = 0; x < bytesPerRow; x += 3) {
+            target[x] = source[x + 2];
+            target[x + 1] = source[x + 1];
+            target[x + 2] = source[x];
+        }
+    }
+    if (sampleMax != 255) {
+        // Netpbm с maxval < 255 приводится к полному диапазону, как и при сохранении с maxval 255
+        for (uint8_t& sample : image.data) {
+            unsigned int value = std::min<unsigned int>(sample, sampleMax);
+            sample = static_cast<uint8_t>((value * 255 + sampleMax / 2) / sampleMax);
+        }
+    }
+    return image;
+}
+
+bool isNetpbmFile(const std::string& filename) {
+    std::string ext = lowerExtension(filename);
+    return ext == ".pgm" || ext == ".ppm" || ext == ".pam";
+}
+
+bool canEmbedInPlace(const std::string& inFile, const std::string& outFile) {
+    if (isStdStream(inFile) || isStdStream(outFile)) return false;
+    std::string ext = lowerExtension(inFile);
+    if (!isRawExtension(ext) || ext != lowerExtension(outFile)) return false;
+    // Шум и полезная нагрузка пишут значения 0..255, поэтому на месте меняются только файлы с maxval 255
+    auto mapped = MappedImage::open(inFile, false);
+    return mapped && mapped->maxValue() == 255;
+}
+
+bool writeNetpbm(const std::string& filename, const Image& image) {
+    std::string ext = lowerExtension(filename);
+    std::string header;
+    if (ext == ".pgm" && image.channels == 1) {
+        header = "P5\n" + std::to_string(image.width) + " " + std::to_string(image.height) + "\n255\n";
+    } else if (ext == ".ppm" && image.channels == 3) {
+        header = "P6\n" + std::to_string(image.width) + " " + std::to_string(image.height) + "\n255\n";
+    } else if (ext == ".pam") {
+        static const char* tupleTypes[] = { "GRAYSCALE", "GRAYSCALE_ALPHA", "RGB", "RGB_ALPHA" };
+        header = "P7\nWIDTH " + std::to_string(image.width) + "\nHEIGHT " + std::to_string(image.height) +
+                 "\nDEPTH " + std::to_string(image.channels) + "\nMAXVAL 255\nTUPLTYPE " +
+                 tupleTypes[std::clamp(image.channels, 1, 4) - 1] + "\nENDHDR\n";
+    } else {
+        LOG_ERROR("{} cannot store an image with {} channels", filename, image.channels);
+        return false;
+    }
+
+    FILE* out = std::fopen(filename.c_str(), "wb");
+    if (!out) return false;
+    bool success = std::fwrite(header.data(), 1, header.size(), out) == header.size() &&
+                   std::fwrite(image.data.data(), 1, image.data.size(), out) == image.data.size();
+    return std::fclose(out) == 0 && success;
+}
+
+} // namespace ImageHandler
@@ -0,0 +1,186 @@
+#include "matrix_embedding.h"
+#include "parallel.h"
+#include "trace.h"
+
+#include <array>
+#include <atomic>
+#include <bitset>
+
+namespace Stegano {
+
+namespace {
+
+inline unsigned int parity64(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned int>(__builtin_parityll(value));
+#else
+    return static_cast<unsigned int>(std::bitset<64>(value).count() & 1);
+#endif
+}
+
+// SYNDROME_MASKS[j]: биты группы (бит i соответствует столбцу i + 1 проверочной матрицы),
+// у номера которых установлен бит j. Бит j синдрома = чётность (LSB-слово & маска j).
+constexpr std::array<uint64_t, MAX_MATRIX_K> makeSyndromeMasks() {
+    std::array<uint64_t, MAX_MATRIX_K> masks{};
+    for (size_t j = 0; j < MAX_MATRIX_K; j++) {
+        for (size_t i = 0; i < 63; i++) {
+            if (((i + 1) >> j) & 1) masks[j] |= uint64_t{1} << i;
+        }
+    }
+    return masks;
+}
+
+constexpr std::array<uint64_t, MAX_MATRIX_K> SYNDROME_MASKS = makeSyndromeMasks();
+
+inline unsigned int syndrome(uint64_t lsbWord, uint8_t k) {
+    unsigned int value = 0;
+    for (uint8_t j = 0; j < k; j++) {
+        value |= parity64(lsbWord & SYNDROME_MASKS[j]) << j;
+    }
+    return value;
+}
+
+// Доступ к LSB носителя: байты (бит 0 каждого байта) или упакованная битовая плоскость
+struct ByteLsbs {
+    uint8_t* data;
+    unsigned int bit(size_t position) const { return data[position] & 0x01; }
+    void flip(size_t position) const { data[position] ^= 0x01; }
+};
+
+struct ConstByteLsbs {
+    const uint8_t* data;
+    unsigned int bit(size_t position) const { return data[position] & 0x01; }
+};
+
+// Shared = true: несколько потоков меняют разные биты одних и тех же 64-битных слов
+template <bool Shared>
+struct PlaneLsbs {
+    LsbPlane& plane;
+    unsigned int bit(size_t position) const { return Shared ? plane.testShared(position) : plane.test(position); }
+    void flip(size_t position) const {
+        if (Shared) plane.flipShared(position);
+        else plane.flip(position);
+    }
+};
+
+struct ConstPlaneLsbs {
+    const LsbPlane& plane;
+    unsigned int bit(size_t position) const { return plane.test(position); }
+};
+
+template <typename Lsbs>
+inline uint64_t gatherLsbs(const Lsbs& lsbs, const size_t* positions, size_t groupSize) {
+    uint64_t word = 0;
+    for (size_t i = 0; i < groupSize; i++) {
+        word |= static_cast<uint64_t>(lsbs.bit(positions[i])) << i;
+    }
+    return word;
+}
+
+// k бит сообщения начиная с bitIndex (старший бит первым); за концом сообщения - нули
+inline unsigned int readBits(const std::vector<uint8_t>& message, size_t bitIndex, uint8_t k) {
+    unsigned int value = 0;
+    for (uint8_t b = 0; b < k; b++, bitIndex++) {
+        unsigned int bit = 0;
+        if (bitIndex / 8 < message.size()) {
+            bit = (message[bitIndex / 8] >> (7 - bitIndex % 8)) & 0x01;
+        }
+        value = (value << 1) | bit;
+    }
+    return value;
+}
+
+template <typename Lsbs>
+size_t embedGroups(const Lsbs& lsbs, const size_t* positions, const std::vector<uint8_t>& message, uint8_t k) {
+    const size_t groupSize = (size_t{1} << k) - 1;
+    const size_t messageBits = message.size() * 8;
+    const size_t groups = (messageBits + k - 1) / k;
+    std::atomic<size_t> changed{0};
+
+    // Группы используют разные позиции, поэтому диапазоны групп обрабатываются независимо
+    Parallel::forRanges(groups, Parallel::PAYLOAD_CUTOFF_BYTES * 8 / k, 1, [&](size_t firstGroup, size_t lastGroup) {
+        Trace::Span span("embed");
+        size_t rangeChanged = 0;
+        for (size_t group = firstGroup; group < lastGroup; group++) {
+            const size_t* groupPositions = positions + group * groupSize;
+            unsigned int target = readBits(message, group * k, k);
+            unsigned int difference = syndrome(gatherLsbs(lsbs, groupPositions, groupSize), k) ^ target;
+            if (difference != 0) {
+                // Переворот LSB в столбце difference меняет синдром ровно на difference
+                lsbs.flip(groupPositions[difference - 1]);
+                rangeChanged++;
+            }
+        }
+        changed += rangeChanged;
+    });
+    return changed.load();
+}
+
+template <typename Lsbs>
+std::vector<uint8_t> extractGroups(const Lsbs& lsbs, const size_t* positions, size_t messageLength, uint8_t k) {
+    const size_t groupSize = (size_t{1} << k) - 1;
+    const size_t messageBits = messageLength * 8;
+    const size_t groups = (messageBits + k - 1) / k;
+    std::vector<uint8_t> message(messageLength, 0);
+
+    // Диапазоны по 8 групп (ровно k байт сообщения), чтобы потоки не писали в общий байт
+    Parallel::forRanges(groups, Parallel::PAYLOAD_CUTOFF_BYTES * 8 / k, 8, [&](size_t firstGroup, size_t lastGroup) {
+        Trace::Span span("extract");
+        for (size_t group = firstGroup; group < lastGroup; group++) {
+            size_t bitIndex = group * k;
+            unsigned int value = syndrome(gatherLsbs(lsbs, positions + group * groupSize, groupSize), k);
+            for (int b = k - 1; b >= 0; b--) {
+                size_t index = bitIndex + (k - 1 - b);
+                if (index < messageBits) {
+                    message[index / 8] |= static_cast<uint8_t>(((value >> b) & 0x01) << (7 - index % 8));
+                }
+            }
+        }
+    });
+    return message;
+}
+
+} // namespace
+
+size_t matrixPositionsNeeded(size_t messageBits, uint8_t k) {
+    size_t groups = (messageBits + k - 1) / k;
+    return groups * ((size_t{1} << k) - 1);
+}
+
+uint8_t chooseMatrixK(size_t messageBits, size_t availablePositions) {
+    for (uint8_t k = MAX_MATRIX_K; k > 1; k--) {
+        if (matrixPositionsNeeded(messageBits, k) <= availablePositions) return k;
+    }
+    return 1;
+}
+
+size_t matrixEmbed(uint8_t* data, const size_t* positions, const std::vector<uint8_t>& message, uint8_t k) {
+    return embedGroups(ByteLsbs{ data }, positions, message, k);
+}
+
+size_t matrixEmbed(LsbPlane& plane, const size_t* positions, const std::vector<uint8_t>& message, uint8_t k) {
+    // Атомарные перевороты нужны, только если диапазоны групп действительно идут в нескольких потоках
+    const size_t groups = (message.size() * 8 + k - 1) / k;
+    if (Parallel::rangeThreadCount(groups, Parallel::PAYLOAD_CUTOFF_BYTES * 8 / k, 1) > 1) {
+        return embedGroups(PlaneLsbs<true>{ plane }, positions, message, k);
+    }
+    return embedGroups(PlaneLsbs<false>{ plane }, positions, message, k);
+}
+
+std::vector<uint8_t> matrixExtract(const uint8_t* data, const size_t* positions, size_t messageLength, uint8_t k) {
+    return extractGroups(ConstByteLsbs{ data }, positions, messageLength, k);
+}
+
+std::vector<uint8_t> matrixExtract(const LsbPlane& plane, const size_t* positions, size_t messageLength, uint8_t k) {
+    return extractGroups(ConstPlaneLsbs{ plane }, positions, messageLength, k);
+}
+
+std::vector<uint8_t> matrixExtract(const uint8_t* data, size_t size, const size_t* positions, size_t messageLength, uint8_t k) {
+    const size_t positionCount = matrixPositionsNeeded(messageLength * 8, k);
+    if (positionCount < size / PLANE_READ_DIVISOR) {
+        return matrixExtract(data, positions, messageLength, k);
+    }
+    return matrixExtract(LsbPlane::extract(data, size), positions, messageLength, k);
+}
+
+} // namespace Stegano
@@ -0,0 +1,160 @@
+#include "memory_budget.h"
+#include "position_stream.h"
+#include "external/logger.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <limits>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#include <unistd.h>
+#define STEGANO_HAVE_RUSAGE 1
+#endif
+
+namespace MemoryBudget {
+
+namespace {
+
+size_t& budget() {
+    static size_t bytes = 0;
+    return bytes;
+}
+
+// Насыщающее приведение 64-битных оценок к size_t
+size_t clampSize(uint64_t bytes) {
+    return static_cast<size_t>(std::min<uint64_t>(bytes, std::numeric_limits<size_t>::max()));
+}
+
+} // namespace
+
+void setLimit(size_t bytes) {
+    budget() = bytes;
+}
+
+size_t limit() {
+    return budget();
+}
+
+// Оценки считают только новые структуры, поэтому к ним добавляется уже занятая процессом память
+bool fits(size_t bytes) {
+    if (budget() == 0) return true;
+    size_t resident = residentBytes();
+    return resident <= budget() && bytes <= budget() - resident;
+}
+
+void require(size_t bytes, const std::string& what) {
+    if (!fits(bytes)) {
+        LOG_ERROR("{} needs about {} of memory on top of {} in use, but --max-memory is {}", what, formatSize(bytes),
+                  formatSize(residentBytes()), formatSize(budget()));
+        exit(EXIT_FAILURE);
+    }
+    if (budget() != 0) {
+        LOG_INFO("{}: estimated peak {} on top of {} in use, of {} budget", what, formatSize(bytes),
+                 formatSize(residentBytes()), formatSize(budget()));
+    }
+}
+
+unsigned int fitWorkers(size_t shared, size_t perWorker, unsigned int wanted) {
+    wanted = std::max(1u, wanted);
+    if (budget() == 0) return wanted;
+    size_t resident = residentBytes();
+    if (resident > budget() || shared > budget() - resident) return 0;
+    shared += resident;
+    if (perWorker > budget() - shared) return 0;
+    size_t workers = perWorker == 0 ? wanted : (budget() - shared) / perWorker;
+    return static_cast<unsigned int>(std::min<size_t>(wanted, workers));
+}
+
+std::optional<size_t> parseSize(const std::string& text) {
+    if (text.empty() || !std::isdigit(static_cast<unsigned char>(text[0]))) return std::nullopt;
+    size_t digits = 0;
+    uint64_t value = 0;
+    while (digits < text.size() && std::isdigit(static_cast<unsigned char>(text[digits]))) {
+        value = value * 10 + static_cast<uint64_t>(text[digits++] - '0');
+        if (value > (uint64_t{1} << 50)) return std::nullopt;
+    }
+    std::string suffix = text.substr(digits);
+    std::transform(suffix.begin(), suffix.end(), suffix.begin(), ::toupper);
+    if (suffix.size() == 2 && suffix[1] == 'B') suffix.pop_back(); // "512MB"
+    int shift = 0;
+    if (suffix.empty() || suffix == "B") shift = 0;
+    else if (suffix == "K") shift = 10;
+    else if (suffix == "M") shift = 20;
+    else if (suffix == "G") shift = 30;
+    else return std::nullopt;
+    return clampSize(value << shift);
+}
+
+std::string formatSize(size_t bytes) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.1f MiB", static_cast<double>(bytes) / (1024.0 * 1024.0));
+    return text;
+}
+
+size_t peakResidentBytes() {
+#ifdef STEGANO_HAVE_RUSAGE
+    struct rusage usage {};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);        // байты
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024; // килобайты
+#endif
+#else
+    return 0;
+#endif
+}
+
+size_t residentBytes() {
+#if defined(__linux__)
+    // Второе поле /proc/self/statm - резидентные страницы
+    FILE* statm = std::fopen("/proc/self/statm", "r");
+    if (statm) {
+        unsigned long long size = 0, resident = 0;
+        int fields = std::fscanf(statm, "%llu %llu", &size, &resident);
+        std::fclose(statm);
+        if (fields == 2) return clampSize(resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE)));
+    }
+#endif
+    // Без текущего значения пик - верхняя граница
+    return peakResidentBytes();
+}
+
+PeakReport::~PeakReport() {
+    size_t peak = peakResidentBytes();
+    if (peak > 0) {
+        LOG_INFO("Peak resident memory: {}", formatSize(peak));
+    }
+}
+
+size_t decodeBytes(uint64_t encodedBytes, uint64_t carrierBytes) {
+    // Сжатые данные + распакованные строки с байтом фильтра + результат декодера + копия в Image
+    return clampSize(encodedBytes + 3 * carrierBytes);
+}
+
+size_t encodeBytes(uint64_t carrierBytes) {
+    // Пиксели + отфильтрованные строки + растущий буфер deflate (до 2x входа) + итоговый файл PNG
+    return clampSize(5 * carrierBytes);
+}
+
+size_t embedBytes(uint64_t encodedBytes, uint64_t carrierBytes, size_t positions, bool inPlace) {
+    const size_t carrierSize = clampSize(carrierBytes);
+    size_t streamBytes = Stegano::PositionStream::memoryEstimate(carrierSize, positions);
+    if (inPlace) {
+        // Страницы файла выгружаются окнами по четверти бюджета (см. MappedImage::evict)
+        return streamBytes + positions * sizeof(size_t) + budget() / 4;
+    }
+    // Декодированный буфер: плоскость LSB и множество позиций нагрузки - по биту на байт носителя
+    size_t planeBytes = carrierSize / 4;
+    return std::max({ decodeBytes(encodedBytes, carrierBytes), carrierSize + planeBytes + streamBytes, encodeBytes(carrierBytes) });
+}
+
+size_t adaptiveBytes(uint64_t carrierBytes, bool decoded) {
+    // Карта стоимости + кандидаты уровня 1 (половина байт, по 8 байт на позицию) + декодированная копия
+    uint64_t bytes = carrierBytes + carrierBytes / 2 * sizeof(size_t);
+    return clampSize(decoded ? bytes : bytes + carrierBytes);
+}
+
+} // namespace MemoryBudget
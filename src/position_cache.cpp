@@ -0,0 +1,314 @@
+#include "position_cache.h"
+#include "position_stream.h"
+#include "cache_directory.h"
+#include "memory_budget.h"
+#include "encryption/utils.h"
+#include "external/logger.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <openssl/evp.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define STEGANO_HAVE_MMAP 1
+#endif
+
+namespace Stegano {
+
+namespace {
+
+constexpr const char* ENTRY_EXTENSION = ".pos";
+constexpr char FILE_MAGIC[8] = { 'S', 'T', 'G', 'P', 'O', 'S', '1', '\0' };
+// Отдельная метка, чтобы имя записи не совпадало с SHA-256(stream || key) - зерном генератора
+constexpr const char* DIGEST_LABEL = "position cache";
+
+// Заголовок файла записи; поля в порядке байтов машины: на другой платформе ширина не сойдётся,
+// и запись будет создана заново
+struct FileHeader {
+    char magic[8];
+    uint32_t width;
+    uint32_t engine;
+    uint64_t stream;
+    uint64_t n;
+    uint64_t count;
+};
+static_assert(sizeof(FileHeader) % 8 == 0, "positions after the header must stay 8-byte aligned");
+
+// Имя записи = SHA-256(метка || движок || stream || n || key), 64 hex-символа
+std::string entryName(size_t n, const std::vector<uint8_t>& key, EngineId engine, uint64_t stream) {
+    std::vector<uint8_t> material(DIGEST_LABEL, DIGEST_LABEL + std::strlen(DIGEST_LABEL) + 1);
+    material.push_back(static_cast<uint8_t>(engine));
+    for (int i = 0; i < 8; i++) material.push_back(static_cast<uint8_t>(stream >> (8 * i)));
+    for (int i = 0; i < 8; i++) material.push_back(static_cast<uint8_t>(static_cast<uint64_t>(n) >> (8 * i)));
+    material.insert(material.end(), key.begin(), key.end());
+
+    std::vector<uint8_t> digest(EVP_MAX_MD_SIZE);
+    unsigned int digestLength = 0;
+    if (EVP_Digest(material.data(), material.size(), digest.data(), &digestLength, EVP_sha256(), nullptr) != 1) {
+        LOG_ERROR("Failed to hash the position cache key");
+        exit(EXIT_FAILURE);
+    }
+    digest.resize(digestLength);
+    return Utils::bytesToHex(digest);
+}
+
+unsigned int widthFor(size_t n) {
+    return static_cast<uint64_t>(n) <= uint64_t{UINT32_MAX} + 1 ? 4 : 8;
+}
+
+} // namespace
+
+// Префикс перестановки: свой буфер или отображённый файл записи
+struct PositionCache::Prefix {
+    size_t n = 0;
+    size_t count = 0;
+    unsigned int width = 4;
+    const uint8_t* data = nullptr;
+    std::vector<uint64_t> storage;       ///< Собственные позиции (выравнивание под 64-битные значения).
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+    std::atomic<uint64_t> lastUse{0};
+
+    Prefix() = default;
+    Prefix(const Prefix&) = delete;
+    Prefix& operator=(const Prefix&) = delete;
+    ~Prefix() {
+#ifdef STEGANO_HAVE_MMAP
+        if (mapping) munmap(mapping, mappingSize);
+#endif
+    }
+
+    uint64_t bytes() const { return static_cast<uint64_t>(count) * width; }
+
+    void copyTo(std::vector<size_t>& out, size_t length) const {
+        out.resize(length);
+        if (width == 4) {
+            const uint32_t* values = reinterpret_cast<const uint32_t*>(data);
+            for (size_t i = 0; i < length; i++) out[i] = values[i];
+        } else {
+            const uint64_t* values = reinterpret_cast<const uint64_t*>(data);
+            for (size_t i = 0; i < length; i++) out[i] = static_cast<size_t>(values[i]);
+        }
+    }
+
+    static std::shared_ptr<Prefix> pack(size_t n, const std::vector<size_t>& positions) {
+        auto prefix = std::make_shared<Prefix>();
+        prefix->n = n;
+        prefix->count = positions.size();
+        prefix->width = widthFor(n);
+        prefix->storage.resize((prefix->bytes() + 7) / 8);
+        prefix->data = reinterpret_cast<const uint8_t*>(prefix->storage.data());
+        if (prefix->width == 4) {
+            uint32_t* values = reinterpret_cast<uint32_t*>(prefix->storage.data());
+            for (size_t i = 0; i < positions.size(); i++) values[i] = static_cast<uint32_t>(positions[i]);
+        } else {
+            std::copy(positions.begin(), positions.end(), prefix->storage.begin());
+        }
+        return prefix;
+    }
+};
+
+PositionCache& PositionCache::instance() {
+    static PositionCache cache;
+    return cache;
+}
+
+void PositionCache::configure(uint64_t limit, const std::string& directory) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    this->limit = limit;
+    this->directory.clear();
+    entries.clear();
+    bytes = 0;
+    if (limit > 0 && !directory.empty()) {
+        if (CacheDirectory::prepare(directory)) {
+            // Записи раскрывают позиции ключа: каталог доступен только владельцу
+            std::error_code ec;
+            std::filesystem::permissions(directory, std::filesystem::perms::owner_all, ec);
+            this->directory = directory;
+        } else {
+            LOG_WARN("The position cache directory {} cannot be created, positions are cached in memory only", directory);
+        }
+    }
+}
+
+std::vector<size_t> PositionCache::take(size_t n, const std::vector<uint8_t>& key, EngineId engine, uint64_t stream,
+                                        size_t count) {
+    if (!enabled()) {
+        PositionStream positions(n, key, engine, stream);
+        return positions.take(count);
+    }
+    Trace::Span span("position cache");
+    const std::string name = entryName(n, key, engine, stream);
+    std::vector<size_t> positions;
+
+    std::shared_ptr<Prefix> prefix;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        auto found = entries.find(name);
+        if (found != entries.end()) prefix = found->second;
+    }
+    if (prefix && prefix->count >= count) {
+        prefix->lastUse = ++clock;
+        prefix->copyTo(positions, count);
+        memoryHits++;
+        return positions;
+    }
+
+    if (!directory.empty()) {
+        std::shared_ptr<Prefix> mapped = loadFile(name, n, engine, stream);
+        if (mapped && mapped->count >= count) {
+            mapped->copyTo(positions, count);
+            insert(name, std::move(mapped));
+            fileHits++;
+            CacheDirectory::record(directory, 1, 0);
+            return positions;
+        }
+    }
+
+    // Промах: префикс генерируется целиком и заменяет более короткую запись
+    misses++;
+    PositionStream generator(n, key, engine, stream);
+    positions = generator.take(count);
+    if (!directory.empty()) CacheDirectory::record(directory, 0, 1);
+    if (static_cast<uint64_t>(count) * widthFor(n) > limit) return positions;
+    std::shared_ptr<Prefix> generated = Prefix::pack(n, positions);
+    if (!directory.empty()) storeFile(name, *generated, engine, stream);
+    insert(name, std::move(generated));
+    return positions;
+}
+
+void PositionCache::insert(const std::string& name, std::shared_ptr<Prefix> prefix) {
+    if (prefix->bytes() > limit) return;
+    prefix->lastUse = ++clock;
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    auto found = entries.find(name);
+    if (found != entries.end()) {
+        // Параллельный промах мог уже положить префикс не короче этого
+        if (found->second->count >= prefix->count) return;
+        bytes -= found->second->bytes();
+        entries.erase(found);
+    }
+    while (bytes + prefix->bytes() > limit && !entries.empty()) {
+        auto oldest = std::min_element(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+            return a.second->lastUse < b.second->lastUse;
+        });
+        bytes -= oldest->second->bytes();
+        entries.erase(oldest);
+        evictions++;
+    }
+    bytes += prefix->bytes();
+    entries.emplace(name, std::move(prefix));
+}
+
+std::shared_ptr<PositionCache::Prefix> PositionCache::loadFile(const std::string& name, size_t n, EngineId engine,
+                                                               uint64_t stream) {
+#ifdef STEGANO_HAVE_MMAP
+    const std::string path = CacheDirectory::entryPath(directory, name, ENTRY_EXTENSION);
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+    struct stat status;
+    void* address = MAP_FAILED;
+    size_t size = 0;
+    if (fstat(fd, &status) == 0 && static_cast<size_t>(status.st_size) >= sizeof(FileHeader)) {
+        size = static_cast<size_t>(status.st_size);
+        address = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (address == MAP_FAILED) return nullptr;
+
+    auto prefix = std::make_shared<Prefix>();
+    prefix->mapping = address;
+    prefix->mappingSize = size;
+    FileHeader header;
+    std::memcpy(&header, address, sizeof(header));
+    const uint64_t payload = size - sizeof(FileHeader);
+    if (std::memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 || header.width != widthFor(n) ||
+        header.engine != static_cast<uint32_t>(engine) || header.stream != stream || header.n != n ||
+        header.count > n || payload != header.count * header.width) {
+        // Повреждённая или чужая запись пересоздаётся при следующем промахе
+        LOG_DEBUG("The position cache entry {} is invalid and is ignored", path);
+        return nullptr;
+    }
+    prefix->n = n;
+    prefix->count = static_cast<size_t>(header.count);
+    prefix->width = header.width;
+    prefix->data = static_cast<const uint8_t*>(address) + sizeof(FileHeader);
+    CacheDirectory::touch(path);
+    return prefix;
+#else
+    (void)name;
+    (void)n;
+    (void)engine;
+    (void)stream;
+    return nullptr;
+#endif
+}
+
+void PositionCache::storeFile(const std::string& name, const Prefix& prefix, EngineId engine, uint64_t stream) {
+#ifdef STEGANO_HAVE_MMAP
+    FileHeader header{};
+    std::memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+    header.width = prefix.width;
+    header.engine = static_cast<uint32_t>(engine);
+    header.stream = stream;
+    header.n = prefix.n;
+    header.count = prefix.count;
+
+    // Запись появляется атомарным переименованием: другие процессы видят либо целый файл, либо ничего
+    const std::string path = CacheDirectory::entryPath(directory, name, ENTRY_EXTENSION);
+    const std::string temporary = CacheDirectory::temporaryPath(directory, name, ENTRY_EXTENSION);
+    FILE* out = std::fopen(temporary.c_str(), "wb");
+    bool written = out && std::fwrite(&header, sizeof(header), 1, out) == 1 &&
+                   std::fwrite(prefix.data, 1, static_cast<size_t>(prefix.bytes()), out) == prefix.bytes();
+    if (out) written = std::fclose(out) == 0 && written;
+    if (!written) {
+        LOG_WARN("Failed to write the position cache entry {}", path);
+        std::error_code ec;
+        std::filesystem::remove(temporary, ec);
+        return;
+    }
+    if (!CacheDirectory::publish(temporary, path)) return;
+    CacheDirectory::evict(directory, limit, ENTRY_EXTENSION);
+#else
+    (void)name;
+    (void)prefix;
+    (void)engine;
+    (void)stream;
+#endif
+}
+
+PositionCacheStats PositionCache::stats() const {
+    PositionCacheStats stats;
+    stats.memoryHits = memoryHits;
+    stats.fileHits = fileHits;
+    stats.misses = misses;
+    stats.evictions = evictions;
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    stats.entries = entries.size();
+    stats.bytes = bytes;
+    return stats;
+}
+
+void PositionCache::logStats() const {
+    PositionCacheStats current = stats();
+    if (!enabled() || current.lookups() == 0) return;
+    LOG_INFO("Position cache: {} hits in memory, {} in the directory, {} misses ({:.1f}% hit rate), {} evictions, {} entries of {}",
+             current.memoryHits, current.fileHits, current.misses, current.hitRate() * 100.0, current.evictions,
+             current.entries, MemoryBudget::formatSize(current.bytes));
+    if (!directory.empty()) {
+        // Счётчики каталога общие для всех процессов пакета
+        CacheDirectory::Stats shared = CacheDirectory::stats(directory);
+        LOG_INFO("Position cache {}: {} hits, {} misses, {} evictions in total", directory, shared.hits, shared.misses,
+                 shared.evictions);
+    }
+}
+
+} // namespace Stegano
@@ -0,0 +1,122 @@
+#include "position_stream.h"
+#include "trace.h"
+#include "parallel.h"
+
+#include <algorithm>
+
+namespace Stegano {
+
+namespace {
+    using StreamVariant = std::variant<BasicPositionStream<Xoshiro256StarStar>, BasicPositionStream<ChaCha20Engine>>;
+
+    StreamVariant makeStream(size_t n, const std::vector<uint8_t>& key, EngineId engine, uint64_t stream) {
+        return withEngine(engine, [&](auto* tag) -> StreamVariant {
+            using Engine = std::remove_pointer_t<decltype(tag)>;
+            return BasicPositionStream<Engine>(n, key, stream);
+        });
+    }
+}
+
+PositionStream::PositionStream(size_t n, const std::vector<uint8_t>& key, EngineId engine, uint64_t stream)
+    : engineId(engine), impl(makeStream(n, key, engine, stream)) {}
+
+PositionStream::PositionStream(std::shared_ptr<const std::vector<size_t>> candidates, const std::vector<uint8_t>& key,
+                               EngineId engine, uint64_t stream)
+    : engineId(engine), candidates(candidates), impl(makeStream(candidates->size(), key, engine, stream)) {}
+
+void PositionStream::exclude(std::vector<size_t> positions) {
+    excluded.insert(excluded.end(), positions.begin(), positions.end());
+    std::sort(excluded.begin(), excluded.end());
+    excluded.erase(std::unique(excluded.begin(), excluded.end()), excluded.end());
+}
+
+bool PositionStream::isExcluded(size_t position) const {
+    return !excluded.empty() && std::binary_search(excluded.begin(), excluded.end(), position);
+}
+
+size_t PositionStream::next() {
+    size_t position;
+    do {
+        position = map(std::visit([](auto& s) { return s.next(); }, impl));
+    } while (isExcluded(position));
+    return position;
+}
+
+std::vector<size_t> PositionStream::take(size_t count) {
+    Trace::Span span("positions");
+    if (count > remaining()) {
+        LOG_ERROR("Not enough carrier positions left in the stream: {} requested, {} remain", count, remaining());
+        exit(EXIT_FAILURE);
+    }
+    std::vector<size_t> positions = std::visit([count](auto& s) { return s.take(count); }, impl);
+    if (!candidates && excluded.empty()) {
+        return positions;
+    }
+
+    // Отображаем индексы на байты-кандидаты и выбрасываем исключённые позиции, добирая недостающие
+    size_t kept = 0;
+    for (size_t i = 0; i < positions.size(); i++) {
+        size_t position = map(positions[i]);
+        if (!isExcluded(position)) positions[kept++] = position;
+    }
+    positions.resize(kept);
+    while (positions.size() < count) {
+        positions.push_back(next());
+    }
+    return positions;
+}
+
+std::vector<size_t> PositionStream::takeRest() {
+    Trace::Span span("positions");
+    // Исключённые позиции могут встретиться в хвосте, поэтому берём всё и фильтруем
+    std::vector<size_t> positions = std::visit([](auto& s) { return s.takeRest(); }, impl);
+    size_t kept = 0;
+    for (size_t i = 0; i < positions.size(); i++) {
+        size_t position = map(positions[i]);
+        if (!isExcluded(position)) positions[kept++] = position;
+    }
+    positions.resize(kept);
+    return positions;
+}
+
+namespace {
+    // Индексы вычисляются независимо, поэтому большие диапазоны делятся между потоками
+    constexpr size_t PARALLEL_INDEX_CUTOFF = size_t{1} << 18;
+}
+
+IndexedPositions::IndexedPositions(size_t n, const std::vector<uint8_t>& key, EngineId engine, uint64_t stream)
+    : n(n), engineId(engine) {
+    // Половина битов наименьшей чётной степени двойки, покрывающей [0, n): выход за n не больше чем в 4 раза
+    unsigned int bits = 0;
+    while (bits < 64 && (uint64_t{1} << bits) < n) bits++;
+    halfBits = (bits + 1) / 2;
+    halfMask = (uint64_t{1} << halfBits) - 1;
+    withEngine(engine, [&](auto* tag) {
+        using Engine = std::remove_pointer_t<decltype(tag)>;
+        Engine rng(key, stream);
+        for (uint64_t& roundKey : roundKeys) roundKey = rng.next();
+    });
+}
+
+IndexedPositions::IndexedPositions(std::shared_ptr<const std::vector<size_t>> candidates, const std::vector<uint8_t>& key,
+                                   EngineId engine, uint64_t stream)
+    : IndexedPositions(candidates->size(), key, engine, stream) {
+    this->candidates = std::move(candidates);
+}
+
+std::vector<size_t> IndexedPositions::range(size_t begin, size_t count) const {
+    Trace::Span span("indexed positions");
+    if (begin > n || count > n - begin) {
+        LOG_ERROR("Positions [{}, {}) do not fit into a permutation of {} positions", begin, begin + count, n);
+        exit(EXIT_FAILURE);
+    }
+    std::vector<size_t> positions(count);
+    Parallel::forRanges(count, PARALLEL_INDEX_CUTOFF, 1, [&](size_t from, size_t to) {
+        for (size_t i = from; i < to; i++) {
+            positions[i] = at(begin + i);
+        }
+    });
+    return positions;
+}
+
+} // namespace Stegano
@@ -0,0 +1,307 @@
+#include "qoi.h"
+#include "memory_budget.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <climits>
+#include <cstring>
+
+namespace ImageHandler {
+
+namespace {
+
+constexpr uint8_t OP_INDEX = 0x00;
+constexpr uint8_t OP_DIFF = 0x40;
+constexpr uint8_t OP_LUMA = 0x80;
+constexpr uint8_t OP_RUN = 0xC0;
+constexpr uint8_t OP_RGB = 0xFE;
+constexpr uint8_t OP_RGBA = 0xFF;
+constexpr uint8_t OP_MASK = 0xC0;
+
+// Длиннее 62 серия не кодируется: значения 63 и 64 заняты кодами RGB и RGBA
+constexpr int MAX_RUN = 62;
+// Предел спецификации, защищает от заголовков с огромными размерами
+constexpr uint64_t MAX_PIXELS = 400000000;
+constexpr uint8_t END_MARKER[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+// Самая длинная серия занимает один байт, поэтому байт данных даёт не больше MAX_RUN пикселей
+constexpr uint64_t MAX_PIXELS_PER_BYTE = MAX_RUN;
+// Потоки читаются и пишутся блоками такого размера
+constexpr size_t IO_CHUNK_BYTES = size_t{1} << 16;
+
+struct Pixel {
+    uint8_t r = 0, g = 0, b = 0, a = 255;
+    bool operator==(const Pixel& other) const { return r == other.r && g == other.g && b == other.b && a == other.a; }
+    bool operator!=(const Pixel& other) const { return !(*this == other); }
+};
+
+inline unsigned int hashIndex(const Pixel& px) {
+    return (px.r * 3u + px.g * 5u + px.b * 7u + px.a * 11u) % 64u;
+}
+
+void writeBE32(uint8_t* p, uint32_t value) {
+    p[0] = static_cast<uint8_t>(value >> 24);
+    p[1] = static_cast<uint8_t>(value >> 16);
+    p[2] = static_cast<uint8_t>(value >> 8);
+    p[3] = static_cast<uint8_t>(value);
+}
+
+uint32_t readBE32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+// Байты закодированного изображения из памяти
+struct MemorySource {
+    const uint8_t* cursor;
+    const uint8_t* end;
+
+    int next() { return cursor < end ? *cursor++ : -1; }
+};
+
+// Байты из потока, блоками по IO_CHUNK_BYTES
+struct StreamSource {
+    FILE* in;
+    std::vector<uint8_t> buffer = std::vector<uint8_t>(IO_CHUNK_BYTES);
+    size_t position = 0;
+    size_t available = 0;
+
+    int next() {
+        if (position == available) {
+            available = std::fread(buffer.data(), 1, buffer.size(), in);
+            position = 0;
+            if (available == 0) return -1;
+        }
+        return buffer[position++];
+    }
+};
+
+template <typename Source>
+bool readExact(Source& source, uint8_t* out, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        int value = source.next();
+        if (value < 0) return false;
+        out[i] = static_cast<uint8_t>(value);
+    }
+    return true;
+}
+
+// Декодер по спецификации QOI 1.0; усечённые данные - ошибка, конечный маркер не проверяется.
+// encodedBytes - размер закодированного файла (0, если неизвестен)
+template <typename Source>
+std::optional<Image> decode(Source& source, uint64_t encodedBytes) {
+    uint8_t header[QOI_HEADER_SIZE];
+    if (!readExact(source, header, QOI_HEADER_SIZE)) return std::nullopt;
+    auto info = parseQoiHeader(header, QOI_HEADER_SIZE);
+    if (!info) return std::nullopt;
+
+    const size_t channels = static_cast<size_t>(info->channels);
+    const size_t pixelCount = static_cast<size_t>(info->width) * static_cast<size_t>(info->height);
+    // Размеры из заголовка не проверены: буфер под пиксели выделяется, только если данных может хватить
+    if (encodedBytes != 0 &&
+        (encodedBytes <= QOI_HEADER_SIZE || pixelCount / MAX_PIXELS_PER_BYTE > encodedBytes - QOI_HEADER_SIZE)) {
+        LOG_ERROR("The QOI header declares {}x{} pixels, but the file has only {} bytes",
+                  info->width, info->height, encodedBytes);
+        return std::nullopt;
+    }
+    if (!MemoryBudget::fits(pixelCount * channels)) {
+        LOG_ERROR("Decoding the QOI image needs {}, the memory budget is {}",
+                  MemoryBudget::formatSize(pixelCount * channels), MemoryBudget::formatSize(MemoryBudget::limit()));
+        return std::nullopt;
+    }
+    Image image{ info->width, info->height, info->channels, std::vector<uint8_t>(pixelCount * channels) };
+    std::array<Pixel, 64> index{};
+    for (Pixel& entry : index) entry.a = 0;
+    Pixel px;
+    int run = 0;
+    uint8_t* out = image.data.data();
+
+    for (size_t i = 0; i < pixelCount; i++, out += channels) {
+        if (run > 0) {
+            run--;
+        } else {
+            int op = source.next();
+            if (op < 0) return std::nullopt;
+            if (op == OP_RGB || op == OP_RGBA) {
+                uint8_t bytes[4];
+                if (!readExact(source, bytes, op == OP_RGB ? 3 : 4)) return std::nullopt;
+                px.r = bytes[0];
+                px.g = bytes[1];
+                px.b = bytes[2];
+                if (op == OP_RGBA) px.a = bytes[3];
+            } else if ((op & OP_MASK) == OP_INDEX) {
+                px = index[static_cast<size_t>(op)];
+            } else if ((op & OP_MASK) == OP_DIFF) {
+                px.r = static_cast<uint8_t>(px.r + ((op >> 4) & 0x03) - 2);
+                px.g = static_cast<uint8_t>(px.g + ((op >> 2) & 0x03) - 2);
+                px.b = static_cast<uint8_t>(px.b + (op & 0x03) - 2);
+            } else if ((op & OP_MASK) == OP_LUMA) {
+                int second = source.next();
+                if (second < 0) return std::nullopt;
+                int greenDiff = (op & 0x3F) - 32;
+                px.r = static_cast<uint8_t>(px.r + greenDiff - 8 + ((second >> 4) & 0x0F));
+                px.g = static_cast<uint8_t>(px.g + greenDiff);
+                px.b = static_cast<uint8_t>(px.b + greenDiff - 8 + (second & 0x0F));
+            } else {
+                run = op & 0x3F;
+            }
+            index[hashIndex(px)] = px;
+        }
+        out[0] = px.r;
+        out[1] = px.g;
+        out[2] = px.b;
+        if (channels == 4) out[3] = px.a;
+    }
+    return image;
+}
+
+// Закодированные байты копятся в буфере и сбрасываются в поток блоками
+class ChunkWriter {
+public:
+    explicit ChunkWriter(FILE* out) : out(out) { buffer.reserve(IO_CHUNK_BYTES); }
+
+    void put(uint8_t value) {
+        buffer.push_back(value);
+        if (buffer.size() == IO_CHUNK_BYTES) flush();
+    }
+
+    void put(const uint8_t* bytes, size_t count) {
+        for (size_t i = 0; i < count; i++) put(bytes[i]);
+    }
+
+    bool flush() {
+        if (!buffer.empty() && std::fwrite(buffer.data(), 1, buffer.size(), out) != buffer.size()) failed = true;
+        buffer.clear();
+        return !failed;
+    }
+
+private:
+    FILE* out;
+    std::vector<uint8_t> buffer;
+    bool failed = false;
+};
+
+} // namespace
+
+bool isQoiFile(const std::string& filename) {
+    if (filename.size() < 4) return false;
+    std::string ext = filename.substr(filename.size() - 4);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == ".qoi";
+}
+
+std::optional<ImageInfo> parseQoiHeader(const uint8_t* header, size_t size) {
+    if (size < QOI_HEADER_SIZE || std::memcmp(header, "qoif", 4) != 0) return std::nullopt;
+    uint32_t width = readBE32(header + 4);
+    uint32_t height = readBE32(header + 8);
+    uint8_t channels = header[12];
+    if (width == 0 || height == 0 || width > INT_MAX || height > INT_MAX || (channels != 3 && channels != 4)) {
+        return std::nullopt;
+    }
+    if (static_cast<uint64_t>(width) * height > MAX_PIXELS) return std::nullopt;
+    ImageInfo info;
+    info.width = static_cast<int>(width);
+    info.height = static_cast<int>(height);
+    info.channels = channels;
+    return info;
+}
+
+std::optional<Image> readQoi(FILE* in) {
+    // Остаток файла ограничивает число пикселей; у канала без позиционирования он неизвестен
+    uint64_t encodedBytes = 0;
+    long start = std::ftell(in);
+    if (start >= 0 && std::fseek(in, 0, SEEK_END) == 0) {
+        long end = std::ftell(in);
+        if (std::fseek(in, start, SEEK_SET) != 0) return std::nullopt;
+        if (end > start) encodedBytes = static_cast<uint64_t>(end - start);
+    }
+    StreamSource source{ in };
+    return decode(source, encodedBytes);
+}
+
+std::optional<Image> decodeQoi(const uint8_t* buffer, size_t size) {
+    MemorySource source{ buffer, buffer + size };
+    return decode(source, size);
+}
+
+bool writeQoi(FILE* out, const Image& image) {
+    if (image.channels != 3 && image.channels != 4) {
+        LOG_ERROR("QOI stores only RGB and RGBA images, the image has {} channels", image.channels);
+        return false;
+    }
+    ChunkWriter writer(out);
+    uint8_t header[QOI_HEADER_SIZE];
+    std::memcpy(header, "qoif", 4);
+    writeBE32(header + 4, static_cast<uint32_t>(image.width));
+    writeBE32(header + 8, static_cast<uint32_t>(image.height));
+    header[12] = static_cast<uint8_t>(image.channels);
+    header[13] = 0; // sRGB с линейной альфой
+    writer.put(header, QOI_HEADER_SIZE);
+
+    const size_t channels = static_cast<size_t>(image.channels);
+    const size_t pixelCount = static_cast<size_t>(image.width) * static_cast<size_t>(image.height);
+    std::array<Pixel, 64> index{};
+    for (Pixel& entry : index) entry.a = 0;
+    Pixel previous;
+    int run = 0;
+    const uint8_t* in = image.data.data();
+
+    for (size_t i = 0; i < pixelCount; i++, in += channels) {
+        Pixel px{ in[0], in[1], in[2], channels == 4 ? in[3] : uint8_t{255} };
+        if (px == previous) {
+            run++;
+            if (run == MAX_RUN || i + 1 == pixelCount) {
+                writer.put(static_cast<uint8_t>(OP_RUN | (run - 1)));
+                run = 0;
+            }
+            continue;
+        }
+        if (run > 0) {
+            writer.put(static_cast<uint8_t>(OP_RUN | (run - 1)));
+            run = 0;
+        }
+
+        unsigned int slot = hashIndex(px);
+        if (index[slot] == px) {
+            writer.put(static_cast<uint8_t>(OP_INDEX | slot));
+        } else {
+            index[slot] = px;
+            if (px.a != previous.a) {
+                const uint8_t bytes[5] = { OP_RGBA, px.r, px.g, px.b, px.a };
+                writer.put(bytes, 5);
+            } else {
+                // Разности по модулю 256, как их восстанавливает декодер
+                int dr = static_cast<int8_t>(static_cast<uint8_t>(px.r - previous.r));
+                int dg = static_cast<int8_t>(static_cast<uint8_t>(px.g - previous.g));
+                int db = static_cast<int8_t>(static_cast<uint8_t>(px.b - previous.b));
+                int drg = dr - dg;
+                int dbg = db - dg;
+                if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                    writer.put(static_cast<uint8_t>(OP_DIFF | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2)));
+                } else if (drg >= -8 && drg <= 7 && dg >= -32 && dg <= 31 && dbg >= -8 && dbg <= 7) {
+                    writer.put(static_cast<uint8_t>(OP_LUMA | (dg + 32)));
+                    writer.put(static_cast<uint8_t>(((drg + 8) << 4) | (dbg + 8)));
+                } else {
+                    const uint8_t bytes[4] = { OP_RGB, px.r, px.g, px.b };
+                    writer.put(bytes, 4);
+                }
+            }
+        }
+        previous = px;
+    }
+    writer.put(END_MARKER, sizeof(END_MARKER));
+    return writer.flush();
+}
+
+bool writeQoi(const std::string& filename, const Image& image) {
+    if (image.channels != 3 && image.channels != 4) {
+        LOG_ERROR("{} cannot store an image with {} channels: QOI holds only RGB and RGBA", filename, image.channels);
+        return false;
+    }
+    FILE* out = std::fopen(filename.c_str(), "wb");
+    if (!out) return false;
+    bool success = writeQoi(out, image);
+    return std::fclose(out) == 0 && success;
+}
+
+} // namespace ImageHandler
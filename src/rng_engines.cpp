@@ -0,0 +1,44 @@
+#include "rng_engines.h"
+#include "external/logger.h"
+
+#include <algorithm>
+#include <openssl/evp.h>
+
+namespace Stegano {
+
+const char* engineName(EngineId engine) {
+    switch (engine) {
+        case EngineId::Xoshiro256StarStar: return "xoshiro";
+        case EngineId::ChaCha20:           return "chacha";
+    }
+    return "unknown";
+}
+
+std::optional<EngineId> engineFromName(const std::string& name) {
+    std::string lowerName = name;
+    std::transform(lowerName.begin(), lowerName.end(), lowerName.begin(), ::tolower);
+    for (EngineId engine : ALL_ENGINES) {
+        if (lowerName == engineName(engine)) return engine;
+    }
+    return std::nullopt;
+}
+
+std::array<uint8_t, 32> deriveEngineSeed(const std::vector<uint8_t>& key, uint64_t stream) {
+    // SHA-256(stream в 8 байтах little-endian || key)
+    std::vector<uint8_t> material(8);
+    for (int i = 0; i < 8; i++) {
+        material[i] = static_cast<uint8_t>(stream >> (8 * i));
+    }
+    material.insert(material.end(), key.begin(), key.end());
+
+    std::array<uint8_t, 32> seed{};
+    unsigned int seedLength = 0;
+    if (EVP_Digest(material.data(), material.size(), seed.data(), &seedLength, EVP_sha256(), nullptr) != 1 ||
+        seedLength != seed.size()) {
+        LOG_ERROR("Failed to derive the generator seed");
+        exit(EXIT_FAILURE);
+    }
+    return seed;
+}
+
+} // namespace Stegano
@@ -0,0 +1,395 @@
+#include "steganalysis.h"
+#include "parallel.h"
+#include "trace.h"
+#include "external/logger.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define STEGANO_ANALYSIS_SSE2 1
+#endif
+
+namespace Stegano {
+
+namespace {
+
+// Строки носителя сверху вниз: декодированное изображение или отображённый файл (строки с шагом stride,
+// отрицательным для BMP, записанного снизу вверх)
+struct Raster {
+    const uint8_t* base = nullptr;
+    size_t rows = 0;
+    size_t rowBytes = 0;
+    std::ptrdiff_t stride = 0;
+    size_t channels = 1;
+    size_t width = 0;
+
+    const uint8_t* row(size_t y) const { return base + static_cast<std::ptrdiff_t>(y) * stride; }
+};
+
+// Счётчики одной полосы строк
+struct Counts {
+    std::array<uint64_t, 256> histogram{};
+    // SPA: пары соседних отсчётов (u, v) одного канала
+    uint64_t spaX = 0;
+    uint64_t spaY = 0;
+    uint64_t spaK = 0;
+    uint64_t pairs = 0;
+    // RS: [0] - исходные отсчёты, [1] - с инвертированными LSB; R/S для маски M и -M
+    std::array<uint64_t, 2> regularM{};
+    std::array<uint64_t, 2> singularM{};
+    std::array<uint64_t, 2> regularN{};
+    std::array<uint64_t, 2> singularN{};
+    uint64_t groups = 0;
+
+    void add(const Counts& other) {
+        for (size_t i = 0; i < histogram.size(); i++) histogram[i] += other.histogram[i];
+        spaX += other.spaX;
+        spaY += other.spaY;
+        spaK += other.spaK;
+        pairs += other.pairs;
+        for (size_t i = 0; i < 2; i++) {
+            regularM[i] += other.regularM[i];
+            singularM[i] += other.singularM[i];
+            regularN[i] += other.regularN[i];
+            singularN[i] += other.singularN[i];
+        }
+        groups += other.groups;
+    }
+};
+
+// Гистограмма строки в четыре таблицы: соседние байты не ждут друг друга на одном счётчике
+void histogramRow(const uint8_t* row, size_t rowBytes, std::array<std::array<uint64_t, 256>, 4>& tables) {
+    size_t j = 0;
+    for (; j + 4 <= rowBytes; j += 4) {
+        tables[0][row[j]]++;
+        tables[1][row[j + 1]]++;
+        tables[2][row[j + 2]]++;
+        tables[3][row[j + 3]]++;
+    }
+    for (; j < rowBytes; j++) {
+        tables[0][row[j]]++;
+    }
+}
+
+// Классы SPA для пары (u, v): x - u и v по разные стороны чётности v, y - наоборот,
+// k - u и v в одной паре {2m - 1, 2m}
+inline void spaPair(uint8_t u, uint8_t v, Counts& counts) {
+    bool odd = v & 1;
+    counts.spaX += (!odd && u < v) || (odd && u > v);
+    counts.spaY += (!odd && u > v) || (odd && u < v);
+    counts.spaK += ((u + 1) >> 1) == ((v + 1) >> 1);
+}
+
+#ifdef STEGANO_ANALYSIS_SSE2
+// Беззнаковое a < b по байтам: маска 0xFF
+inline __m128i lessMask(__m128i a, __m128i b) {
+    return _mm_andnot_si128(_mm_cmpeq_epi8(_mm_subs_epu8(b, a), _mm_setzero_si128()), _mm_set1_epi8(-1));
+}
+
+inline uint64_t sumBytes(__m128i acc) {
+    __m128i sums = _mm_sad_epu8(acc, _mm_setzero_si128());
+    return static_cast<uint64_t>(_mm_cvtsi128_si32(sums)) + static_cast<uint64_t>(_mm_cvtsi128_si32(_mm_srli_si128(sums, 8)));
+}
+#endif
+
+void spaRow(const uint8_t* row, size_t rowBytes, size_t channels, Counts& counts) {
+    if (rowBytes <= channels) return;
+    size_t j = 0;
+#ifdef STEGANO_ANALYSIS_SSE2
+    // 16 пар за итерацию; байтовые счётчики (маска 0xFF = -1) сбрасываются до переполнения
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    __m128i accX = zero, accY = zero, accK = zero;
+    int pending = 0;
+    for (; j + channels + 16 <= rowBytes; j += 16) {
+        __m128i u = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + j));
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + j + channels));
+        __m128i odd = _mm_cmpeq_epi8(_mm_and_si128(v, one), one);
+        __m128i uLess = lessMask(u, v);
+        __m128i uGreater = lessMask(v, u);
+        accX = _mm_sub_epi8(accX, _mm_or_si128(_mm_andnot_si128(odd, uLess), _mm_and_si128(odd, uGreater)));
+        accY = _mm_sub_epi8(accY, _mm_or_si128(_mm_andnot_si128(odd, uGreater), _mm_and_si128(odd, uLess)));
+        // avg(x, 0) = (x + 1) >> 1 без переполнения на 255
+        accK = _mm_sub_epi8(accK, _mm_cmpeq_epi8(_mm_avg_epu8(u, zero), _mm_avg_epu8(v, zero)));
+        if (++pending == 255) {
+            counts.spaX += sumBytes(accX);
+            counts.spaY += sumBytes(accY);
+            counts.spaK += sumBytes(accK);
+            accX = accY = accK = zero;
+            pending = 0;
+        }
+    }
+    counts.spaX += sumBytes(accX);
+    counts.spaY += sumBytes(accY);
+    counts.spaK += sumBytes(accK);
+#endif
+    for (; j + channels < rowBytes; j++) {
+        spaPair(row[j], row[j + channels], counts);
+    }
+    counts.pairs += rowBytes - channels;
+}
+
+// Сдвинутое отражение F-1: 2m - 1 <-> 2m
+inline int flipShifted(int x) {
+    return ((x + 1) ^ 1) - 1;
+}
+
+inline int smoothness(int a, int b, int c, int d) {
+    return std::abs(b - a) + std::abs(c - b) + std::abs(d - c);
+}
+
+inline void rsGroup(int x0, int x1, int x2, int x3, Counts& counts) {
+    // Маска 0110: отражаются два средних отсчёта
+    int f0 = smoothness(x0, x1, x2, x3);
+    int fM = smoothness(x0, x1 ^ 1, x2 ^ 1, x3);
+    int fN = smoothness(x0, flipShifted(x1), flipShifted(x2), x3);
+    int y0 = x0 ^ 1, y1 = x1 ^ 1, y2 = x2 ^ 1, y3 = x3 ^ 1;
+    int g0 = smoothness(y0, y1, y2, y3);
+    int gM = smoothness(y0, x1, x2, y3);
+    int gN = smoothness(y0, flipShifted(y1), flipShifted(y2), y3);
+    counts.regularM[0] += fM > f0;
+    counts.singularM[0] += fM < f0;
+    counts.regularN[0] += fN > f0;
+    counts.singularN[0] += fN < f0;
+    counts.regularM[1] += gM > g0;
+    counts.singularM[1] += gM < g0;
+    counts.regularN[1] += gN > g0;
+    counts.singularN[1] += gN < g0;
+}
+
+#ifdef STEGANO_ANALYSIS_SSE2
+inline __m128i absDiff16(__m128i a, __m128i b) {
+    return _mm_max_epi16(_mm_sub_epi16(a, b), _mm_sub_epi16(b, a));
+}
+
+inline __m128i smoothness16(__m128i a, __m128i b, __m128i c, __m128i d) {
+    return _mm_add_epi16(_mm_add_epi16(absDiff16(b, a), absDiff16(c, b)), absDiff16(d, c));
+}
+
+inline __m128i flipShifted16(__m128i x, __m128i one) {
+    return _mm_sub_epi16(_mm_xor_si128(_mm_add_epi16(x, one), one), one);
+}
+
+inline uint64_t sumWords(__m128i acc) {
+    alignas(16) int32_t lanes[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), _mm_madd_epi16(acc, _mm_set1_epi16(1)));
+    return static_cast<uint64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+}
+#endif
+
+// Группы RS одного канала строки: plane[i][g] - отсчёт i группы g
+void rsGroups(const std::array<std::vector<int16_t>, 4>& plane, size_t groups, Counts& counts) {
+    size_t g = 0;
+#ifdef STEGANO_ANALYSIS_SSE2
+    // 8 групп за итерацию в 16-битных дорожках; счётчики дорожек сбрасываются до переполнения int16
+    constexpr int FLUSH_INTERVAL = 1 << 14;
+    const __m128i one = _mm_set1_epi16(1);
+    __m128i acc[8];
+    std::fill(std::begin(acc), std::end(acc), _mm_setzero_si128());
+    int pending = 0;
+    auto flush = [&]() {
+        for (size_t i = 0; i < 2; i++) {
+            counts.regularM[i] += sumWords(acc[4 * i]);
+            counts.singularM[i] += sumWords(acc[4 * i + 1]);
+            counts.regularN[i] += sumWords(acc[4 * i + 2]);
+            counts.singularN[i] += sumWords(acc[4 * i + 3]);
+        }
+        std::fill(std::begin(acc), std::end(acc), _mm_setzero_si128());
+        pending = 0;
+    };
+    for (; g + 8 <= groups; g += 8) {
+        __m128i x0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(plane[0].data() + g));
+        __m128i x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(plane[1].data() + g));
+        __m128i x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(plane[2].data() + g));
+        __m128i x3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(plane[3].data() + g));
+        __m128i y0 = _mm_xor_si128(x0, one), y1 = _mm_xor_si128(x1, one);
+        __m128i y2 = _mm_xor_si128(x2, one), y3 = _mm_xor_si128(x3, one);
+
+        __m128i f0 = smoothness16(x0, x1, x2, x3);
+        __m128i fM = smoothness16(x0, y1, y2, x3);
+        __m128i fN = smoothness16(x0, flipShifted16(x1, one), flipShifted16(x2, one), x3);
+        __m128i g0 = smoothness16(y0, y1, y2, y3);
+        __m128i gM = smoothness16(y0, x1, x2, y3);
+        __m128i gN = smoothness16(y0, flipShifted16(y1, one), flipShifted16(y2, one), y3);
+
+        acc[0] = _mm_sub_epi16(acc[0], _mm_cmpgt_epi16(fM, f0));
+        acc[1] = _mm_sub_epi16(acc[1], _mm_cmpgt_epi16(f0, fM));
+        acc[2] = _mm_sub_epi16(acc[2], _mm_cmpgt_epi16(fN, f0));
+        acc[3] = _mm_sub_epi16(acc[3], _mm_cmpgt_epi16(f0, fN));
+        acc[4] = _mm_sub_epi16(acc[4], _mm_cmpgt_epi16(gM, g0));
+        acc[5] = _mm_sub_epi16(acc[5], _mm_cmpgt_epi16(g0, gM));
+        acc[6] = _mm_sub_epi16(acc[6], _mm_cmpgt_epi16(gN, g0));
+        acc[7] = _mm_sub_epi16(acc[7], _mm_cmpgt_epi16(g0, gN));
+        if (++pending == FLUSH_INTERVAL) flush();
+    }
+    flush();
+#endif
+    for (; g < groups; g++) {
+        rsGroup(plane[0][g], plane[1][g], plane[2][g], plane[3][g], counts);
+    }
+    counts.groups += groups;
+}
+
+void analyzeBand(const Raster& raster, size_t firstRow, size_t lastRow, Counts& counts) {
+    std::array<std::array<uint64_t, 256>, 4> tables{};
+    // Отсчёты каждой группы раскладываются по четырём плоскостям, чтобы ядро RS работало вертикально
+    const size_t groups = raster.width / 4;
+    std::array<std::vector<int16_t>, 4> plane;
+    for (auto& samples : plane) samples.resize(groups);
+
+    for (size_t y = firstRow; y < lastRow; y++) {
+        const uint8_t* row = raster.row(y);
+        histogramRow(row, raster.rowBytes, tables);
+        spaRow(row, raster.rowBytes, raster.channels, counts);
+        for (size_t channel = 0; channel < raster.channels; channel++) {
+            const uint8_t* sample = row + channel;
+            for (size_t g = 0; g < groups; g++, sample += 4 * raster.channels) {
+                plane[0][g] = sample[0];
+                plane[1][g] = sample[raster.channels];
+                plane[2][g] = sample[2 * raster.channels];
+                plane[3][g] = sample[3 * raster.channels];
+            }
+            rsGroups(plane, groups, counts);
+        }
+    }
+    for (const auto& table : tables) {
+        for (size_t i = 0; i < table.size(); i++) counts.histogram[i] += table[i];
+    }
+}
+
+// Верхний хвост распределения хи-квадрат (приближение Уилсона - Хилферти)
+double chiSquareUpperTail(double chi, double degrees) {
+    if (degrees <= 0) return 0.0;
+    double h = 2.0 / (9.0 * degrees);
+    double z = (std::cbrt(chi / degrees) - (1.0 - h)) / std::sqrt(h);
+    return 0.5 * std::erfc(z / std::sqrt(2.0));
+}
+
+// Атака хи-квадрат по парам значений (2i, 2i + 1): встраивание выравнивает частоты внутри пар
+double chiSquareP(const std::array<uint64_t, 256>& histogram) {
+    constexpr double MIN_PAIR_COUNT = 10.0; // ожидаемая частота не меньше 5
+    double chi = 0.0;
+    int categories = 0;
+    for (size_t i = 0; i < histogram.size(); i += 2) {
+        double sum = static_cast<double>(histogram[i]) + static_cast<double>(histogram[i + 1]);
+        if (sum < MIN_PAIR_COUNT) continue;
+        double expected = sum / 2.0;
+        double difference = static_cast<double>(histogram[i]) - expected;
+        chi += difference * difference / expected;
+        categories++;
+    }
+    return categories > 1 ? chiSquareUpperTail(chi, categories - 1) : 0.0;
+}
+
+// Меньший по модулю корень a z^2 + b z + c = 0 (при отрицательном дискриминанте - вещественная часть)
+double smallerRoot(double a, double b, double c) {
+    if (std::abs(a) < 1e-12) return std::abs(b) < 1e-12 ? 0.0 : -c / b;
+    double discriminant = b * b - 4 * a * c;
+    if (discriminant < 0) return -b / (2 * a);
+    double root = std::sqrt(discriminant);
+    double first = (-b + root) / (2 * a);
+    double second = (-b - root) / (2 * a);
+    return std::abs(first) < std::abs(second) ? first : second;
+}
+
+// RS (Fridrich, Goljan, Du): доля изменённых LSB из R/S для исходных и инвертированных отсчётов
+double rsRate(const Counts& counts) {
+    if (counts.groups == 0) return 0.0;
+    const double n = static_cast<double>(counts.groups);
+    double d0 = (static_cast<double>(counts.regularM[0]) - static_cast<double>(counts.singularM[0])) / n;
+    double d1 = (static_cast<double>(counts.regularM[1]) - static_cast<double>(counts.singularM[1])) / n;
+    double n0 = (static_cast<double>(counts.regularN[0]) - static_cast<double>(counts.singularN[0])) / n;
+    double n1 = (static_cast<double>(counts.regularN[1]) - static_cast<double>(counts.singularN[1])) / n;
+    double z = smallerRoot(2 * (d1 + d0), n0 - n1 - d1 - 3 * d0, d0 - n0);
+    if (std::abs(z - 0.5) < 1e-12) return 1.0;
+    return std::clamp(z / (z - 0.5), 0.0, 1.0);
+}
+
+// SPA (Dumitrescu, Wu, Wang): меньший корень 2k b^2 + 2(2x - n) b + (y - x) = 0 - доля изменённых LSB,
+// при случайном сообщении это половина доли байт с сообщением
+double spaRate(const Counts& counts) {
+    if (counts.spaK == 0) return 0.0;
+    double a = 2.0 * static_cast<double>(counts.spaK);
+    double b = 2.0 * (2.0 * static_cast<double>(counts.spaX) - static_cast<double>(counts.pairs));
+    double c = static_cast<double>(counts.spaY) - static_cast<double>(counts.spaX);
+    double discriminant = b * b - 4 * a * c;
+    double beta = discriminant < 0 ? -b / (2 * a) : std::min((-b + std::sqrt(discriminant)) / (2 * a),
+                                                             (-b - std::sqrt(discriminant)) / (2 * a));
+    return std::clamp(2.0 * beta, 0.0, 1.0);
+}
+
+SteganalysisReport analyzeRaster(const Raster& raster, unsigned int threadCount) {
+    Trace::Span span("analyze");
+    auto start = std::chrono::steady_clock::now();
+    SteganalysisReport report;
+    if (raster.rows == 0 || raster.rowBytes == 0) return report;
+
+    threadCount = static_cast<unsigned int>(std::min<size_t>(std::max(1u, threadCount), raster.rows));
+    const size_t bandRows = (raster.rows + threadCount - 1) / threadCount;
+    std::vector<Counts> bands(threadCount);
+    Parallel::run(threadCount, [&](unsigned int band) {
+        Trace::Span bandSpan("analyze band");
+        size_t firstRow = band * bandRows;
+        size_t lastRow = std::min(raster.rows, firstRow + bandRows);
+        if (firstRow < lastRow) analyzeBand(raster, firstRow, lastRow, bands[band]);
+    });
+    Counts total;
+    for (const Counts& band : bands) total.add(band);
+
+    report.chiSquareP = chiSquareP(total.histogram);
+    report.rsRate = rsRate(total);
+    report.spaRate = spaRate(total);
+    report.samples = raster.rows * raster.rowBytes;
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    LOG_INFO("Steganalysis of {} bytes in {} bands took {:.1f} ms", report.samples, threadCount, ms);
+    return report;
+}
+
+} // namespace
+
+SteganalysisReport analyzeImage(const ImageHandler::Image& image, unsigned int threadCount) {
+    Raster raster;
+    raster.base = image.data.data();
+    raster.rows = static_cast<size_t>(image.height);
+    raster.width = static_cast<size_t>(image.width);
+    raster.channels = static_cast<size_t>(std::max(1, image.channels));
+    raster.rowBytes = raster.width * raster.channels;
+    raster.stride = static_cast<std::ptrdiff_t>(raster.rowBytes);
+    return analyzeRaster(raster, threadCount);
+}
+
+SteganalysisReport analyzeImage(const ImageHandler::MappedImage& image, unsigned int threadCount) {
+    Raster raster;
+    raster.base = image.bytes() + image.imageRowOffset(0);
+    raster.rows = image.rowCount();
+    raster.width = static_cast<size_t>(image.width());
+    raster.channels = static_cast<size_t>(std::max(1, image.channels()));
+    raster.rowBytes = image.rowBytes();
+    raster.stride = raster.rows > 1
+        ? static_cast<std::ptrdiff_t>(image.imageRowOffset(1)) - static_cast<std::ptrdiff_t>(image.imageRowOffset(0))
+        : static_cast<std::ptrdiff_t>(raster.rowBytes);
+    return analyzeRaster(raster, threadCount);
+}
+
+void printSteganalysisReport(const SteganalysisReport& report, const char* what) {
+    char text[512];
+    std::snprintf(text, sizeof(text),
+                  "Steganalysis of %s (%zu bytes):\n"
+                  "  chi-square pair-of-values: p = %.4f\n"
+                  "  RS analysis: estimated embedding rate %.4f\n"
+                  "  sample pair analysis: estimated embedding rate %.4f\n"
+                  "  estimated embedding rate: %.4f (about %.0f bytes carry a message)\n",
+                  what, report.samples, report.chiSquareP, report.rsRate, report.spaRate,
+                  report.embeddingRate(), report.embeddingRate() * static_cast<double>(report.samples));
+    std::cerr << text;
+}
+
+} // namespace Stegano
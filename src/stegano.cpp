@@ -1,110 +1,470 @@
 #include "stegano.h"
+#include "position_stream.h"
+#include "position_cache.h"
 
-#include <random>
 #include <algorithm>
 #include <stdexcept>
 #include <cstdint>
 #include <vector>
-#include <thread>
+#include <memory>
+#include <optional>
+#include <iterator>
+#include "parallel.h"
+#include "matrix_embedding.h"
+#include "lsb_plane.h"
+#include "memory_budget.h"
+#include "trace.h"
+#include "noise_mask.h"
 
 
 namespace Stegano {
 
-// Вспомогательная функция для генерации перестановки индексов [0, n-1] на основе ключа.
-static std::vector<size_t> generateShuffledIndices(size_t n, const std::vector<uint8_t>& key) {
-    std::vector<size_t> indices(n);
-    for (size_t i = 0; i < n; i++) {
-        indices[i] = i;
-    }
-    // Преобразуем ключ в вектор чисел для инициализации seed_seq
-    std::vector<unsigned int> seedData(key.begin(), key.end());
-    std::seed_seq seedSeq(seedData.begin(), seedData.end());
-    std::mt19937 rng(seedSeq);
-    std::shuffle(indices.begin(), indices.end(), rng);
-    
-    LOG_INFO("Shuffled Indices were compiled successfuly");
-    return indices;
+namespace {
+
+// Наименьшее окно, после которого шум на месте выгружает записанные страницы
+constexpr size_t MIN_EVICT_WINDOW = size_t{1} << 20;
+
+// Байты шума генерируются блоками такого размера (кратного 64) и сразу сливаются с плоскостью
+constexpr size_t NOISE_BLOCK_BYTES = 4096;
+
+// Изменение одного байта шумом: ±1, либо (адаптивный режим) замена LSB без изменения старших битов
+inline uint8_t noisyValue(uint8_t currentValue, int direction, bool lsbOnly) {
+    if (lsbOnly) {
+        return direction > 0 ? currentValue ^ 0x01 : currentValue;
+    }
+    // Обеспечиваем, чтобы значение не вышло за пределы [0, 255]
+    if (currentValue == 0) {
+        direction = 1;
+    } else if (currentValue == 255) {
+        direction = -1;
+    }
+    return static_cast<uint8_t>(static_cast<int>(currentValue) + direction);
 }
 
-void embedData(ImageHandler::Image& image, const std::vector<uint8_t>& message, const std::vector<uint8_t>& key) {
-    // Количество доступных байтов (каждый канал - 1 байт)
-    size_t totalBits = image.data.size(); // 1 бит на канал
-    size_t messageBits = message.size() * 8;
+// Шум на непрерывном участке [begin, end) в порядке памяти; payload - курсор по отсортированным
+// смещениям нагрузки, которые никогда не меняются
+template <typename Engine>
+void fillNoiseSpan(uint8_t* bytes, size_t begin, size_t end, std::vector<size_t>::const_iterator& payload,
+                   std::vector<size_t>::const_iterator payloadEnd, NoiseMask<Engine>& mask, bool lsbOnly) {
+    for (size_t offset = begin; offset < end; offset++) {
+        int direction = mask.next();
+        if (direction == 0) continue;
+        while (payload != payloadEnd && *payload < offset) payload++;
+        if (payload != payloadEnd && *payload == offset) continue;
+        bytes[offset] = noisyValue(bytes[offset], direction, lsbOnly);
+    }
+}
 
-    if (messageBits > totalBits) {
-        LOG_ERROR("The message is too big. It is impossible to place the all text into the picture");
-        exit(EXIT_FAILURE);
+// Шум и запись плоскости LSB обратно в буфер. Без кандидатов шум ±1 идёт в порядке памяти в том же
+// проходе, что и запись плоскости; в адаптивном режиме шум только заменяет LSB кандидатов прямо в плоскости.
+template <typename Engine>
+void mergeWithCoverNoise(uint8_t* data, size_t size, LsbPlane& plane, const LsbPlane& payload,
+                         const std::vector<size_t>* candidates, const std::vector<uint8_t>& key,
+                         uint64_t stream, unsigned int density) {
+    Trace::Span span("noise");
+    NoiseMask<Engine> mask(key, stream, density);
+    if (mask.changeThreshold() == 0) {
+        plane.merge(data);
+        return;
+    }
+    if (candidates) {
+        for (size_t position : *candidates) {
+            if (mask.next() > 0 && !payload.test(position)) plane.flip(position);
+        }
+        plane.merge(data);
+        return;
+    }
+    uint8_t noise[NOISE_BLOCK_BYTES];
+    for (size_t begin = 0; begin < size; begin += NOISE_BLOCK_BYTES) {
+        size_t end = std::min(size, begin + NOISE_BLOCK_BYTES);
+        mask.fill(noise, end - begin);
+        plane.mergeNoisy(data, begin, end, noise, mask.changeThreshold(), payload);
+    }
+}
 
+// Битовое множество позиций нагрузки: шум их пропускает (вместо сортировки списка позиций)
+LsbPlane markPositions(size_t size, const std::vector<size_t>& positions) {
+    LsbPlane marked(size);
+    for (size_t position : positions) {
+        marked.set(position);
     }
+    return marked;
+}
 
-    // Генерируем псевдослучайную перестановку индексов на основе ключа.
-    std::vector<size_t> shuffledIndices = generateShuffledIndices(totalBits, key);
+// Шум для отображённого файла: байты обходятся в порядке файла, отсортированные смещения нагрузки пропускаются
+template <typename Engine>
+void fillCoverNoiseInPlace(ImageHandler::MappedImage& carrier, const std::vector<size_t>& payloadOffsets,
+                           const std::vector<size_t>* candidates, const std::vector<uint8_t>& key,
+                           unsigned int density, bool lsbOnly) {
+    Trace::Span span("noise");
+    NoiseMask<Engine> mask(key, NOISE_STREAM, density);
+    uint8_t* bytes = carrier.bytes();
 
-    std::thread fillUnecessaryBits([&](){
-        // Для оставшихся позиций производим случайное изменение LSB для маскировки.
-        // Используем тот же ключ для инициализации генератора.
-        std::vector<unsigned int> seedData(key.begin(), key.end());
-        std::seed_seq seedSeq(seedData.begin(), seedData.end());
-        std::mt19937 rng(seedSeq);
-        std::uniform_int_distribution<int> coinFlip(0, 1);
+    if (candidates) {
+        // Адаптивный режим: шум только на текстурных байтах
+        for (size_t position : *candidates) {
+            int direction = mask.next();
+            if (direction == 0) continue;
+            size_t offset = carrier.offsetOf(position);
+            if (std::binary_search(payloadOffsets.begin(), payloadOffsets.end(), offset)) continue;
+            bytes[offset] = noisyValue(bytes[offset], direction, lsbOnly);
+        }
+        return;
+    }
 
-        for (size_t i = messageBits; i < totalBits; i++) {
-            size_t dataIndex = shuffledIndices[i];
-            uint8_t currentValue = image.data[dataIndex];
-            int direction = (coinFlip(rng) == 0) ? -1 : 1;
+    // С бюджетом памяти (--max-memory) пройденные окна записываются и выгружаются из памяти процесса
+    const size_t window = MemoryBudget::limit() == 0 ? 0 : std::max(MIN_EVICT_WINDOW, MemoryBudget::limit() / 4);
+    size_t windowStart = carrier.fileRowOffset(0);
+    auto payload = payloadOffsets.cbegin();
+    for (size_t row = 0; row < carrier.rowCount(); row++) {
+        size_t offset = carrier.fileRowOffset(row);
+        fillNoiseSpan(bytes, offset, offset + carrier.rowBytes(), payload, payloadOffsets.cend(), mask, lsbOnly);
+        if (window != 0 && offset + carrier.rowBytes() - windowStart >= window) {
+            carrier.evict(windowStart, offset + carrier.rowBytes() - windowStart);
+            windowStart = offset + carrier.rowBytes();
+        }
+    }
+}
 
-            // Обеспечиваем, чтобы значение не вышло за пределы [0, 255]
-            if (currentValue == 0) {
-                direction = 1;
-            } else if (currentValue == 255) {
-                direction = -1;
-            }
-            int newValue = static_cast<int>(currentValue) + direction;
-            image.data[dataIndex] = static_cast<uint8_t>(newValue);
+// Те же правила для индексной перестановки: тело продолжает индексы заголовка или (адаптивный режим)
+// переставляет кандидатов без позиций заголовка, поэтому любой участок тела вычисляется по индексу.
+std::optional<std::vector<size_t>> planIndexedPositions(size_t carrierSize, const std::vector<uint8_t>& key, const EmbedOptions& options,
+                                                        size_t headerBits, size_t bodyPositionCount,
+                                                        std::shared_ptr<const std::vector<size_t>>* candidatesOut) {
+    IndexedPositions uniform(carrierSize, key, options.engine);
+    if (options.adaptiveLevel == 0) {
+        if (headerBits + bodyPositionCount > carrierSize) {
+            LOG_ERROR("The message is too big. It is impossible to place the all text into the picture");
+            return std::nullopt;
         }
+        return uniform.range(0, headerBits + bodyPositionCount);
+    }
+
+    if (headerBits > carrierSize) {
+        LOG_ERROR("The message is too big. It is impossible to place the all text into the picture");
+        return std::nullopt;
+    }
+    std::vector<size_t> positions = uniform.range(0, headerBits);
+    std::vector<size_t> textured = selectTexturedPositions(*options.costMap, options.adaptiveLevel);
+    LOG_INFO("Adaptive level {}: {} of {} bytes are candidates", options.adaptiveLevel, textured.size(), carrierSize);
+    auto candidates = std::make_shared<const std::vector<size_t>>(excludePositions(textured, positions));
+    if (candidatesOut) *candidatesOut = std::make_shared<const std::vector<size_t>>(std::move(textured));
+
+    IndexedPositions body(candidates, key, options.engine);
+    if (bodyPositionCount > body.size()) {
+        LOG_ERROR("The message is too big for the textured part of the picture");
+        return std::nullopt;
+    }
+    std::vector<size_t> rest = body.range(0, bodyPositionCount);
+    positions.insert(positions.end(), rest.begin(), rest.end());
+    return positions;
+}
+
+// Позиции сообщения в порядке бит: заголовок всегда на равномерном потоке, тело - продолжение
+// того же потока или (адаптивный режим) поток по текстурным байтам.
+// Если сообщение не помещается, ошибка логируется и возвращается std::nullopt.
+std::optional<std::vector<size_t>> planPositions(size_t carrierSize, const std::vector<uint8_t>& key, const EmbedOptions& options,
+                                                 size_t headerBits, size_t bodyPositionCount,
+                                                 std::shared_ptr<const std::vector<size_t>>* candidatesOut = nullptr) {
+    std::vector<size_t> positions;
+    if (options.indexed) {
+        return planIndexedPositions(carrierSize, key, options, headerBits, bodyPositionCount, candidatesOut);
+    }
+    if (options.adaptiveLevel == 0) {
+        // Количество доступных байтов (каждый канал - 1 байт)
+        size_t totalBits = carrierSize; // 1 бит на канал
+        if (headerBits + bodyPositionCount > totalBits) {
+            LOG_ERROR("The message is too big. It is impossible to place the all text into the picture");
+            return std::nullopt;
+        }
+        return PositionCache::instance().take(totalBits, key, options.engine, POSITION_STREAM, headerBits + bodyPositionCount);
+    }
+
+    // Заголовок всегда лежит на равномерном потоке, чтобы извлечение могло прочитать его
+    // (и отбросить чужой ключ) без карты стоимости; остальное - только на текстурных байтах.
+    if (headerBits > carrierSize) {
+        LOG_ERROR("The message is too big. It is impossible to place the all text into the picture");
+        return std::nullopt;
+    }
+    positions = PositionCache::instance().take(carrierSize, key, options.engine, POSITION_STREAM, headerBits);
+
+    auto candidates = std::make_shared<const std::vector<size_t>>(selectTexturedPositions(*options.costMap, options.adaptiveLevel));
+    LOG_INFO("Adaptive level {}: {} of {} bytes are candidates", options.adaptiveLevel, candidates->size(), carrierSize);
+    if (candidatesOut) *candidatesOut = candidates;
+
+    PositionStream bodyPositions(candidates, key, options.engine);
+    bodyPositions.exclude(positions);
+    if (bodyPositionCount > bodyPositions.remaining()) {
+        LOG_ERROR("The message is too big for the textured part of the picture");
+        return std::nullopt;
+    }
+    std::vector<size_t> rest = bodyPositions.take(bodyPositionCount);
+    positions.insert(positions.end(), rest.begin(), rest.end());
+    return positions;
+}
+
+// Встраивает биты сообщения: заголовок (или всё сообщение при k = 1) - по биту на позицию, тело - кодом Хэмминга.
+// При k = 1 код Хэмминга сводится к установке LSB, поэтому оба участка идут через matrixEmbed
+// (и для больших сообщений делятся между потоками); data - байты носителя или плоскость LSB.
+// Возвращает число изменённых позиций.
+template <typename Carrier>
+size_t writePayload(Carrier&& data, const size_t* positions, const std::vector<uint8_t>& message,
+                    size_t headerBits, size_t bodyPositionCount, uint8_t matrixK) {
+    if (matrixK <= 1) {
+        return matrixEmbed(data, positions, message, 1);
+    }
+    std::vector<uint8_t> header(message.begin(), message.begin() + headerBits / 8);
+    std::vector<uint8_t> body(message.begin() + headerBits / 8, message.end());
+    size_t headerChanged = matrixEmbed(data, positions, header, 1);
+    size_t changed = matrixEmbed(data, positions + headerBits, body, matrixK);
+    LOG_INFO("Matrix embedding (k = {}): {} of {} positions were changed", matrixK, changed, bodyPositionCount);
+    return headerChanged + changed;
+}
+
+// Нагрузка и шум в буфере носителя. Обычно через упакованную плоскость LSB: байты читаются и записываются
+// по одному последовательному проходу. Без шума редкие позиции дешевле записать прямо в байты.
+void embedIntoBuffer(uint8_t* data, size_t size, const std::vector<size_t>& positions, const std::vector<uint8_t>& message,
+                     size_t headerBits, size_t bodyPositionCount, uint8_t matrixK, const std::vector<size_t>* candidates,
+                     const std::vector<uint8_t>& key, EngineId engine, uint64_t noiseStream, unsigned int noiseDensity) {
+    if (noiseDensity == 0 && positions.size() < size / PLANE_READ_DIVISOR) {
+        writePayload(data, positions.data(), message, headerBits, bodyPositionCount, matrixK);
+        return;
+    }
+    LsbPlane plane = LsbPlane::extract(data, size);
+    LsbPlane payload = markPositions(size, positions);
+    writePayload(plane, positions.data(), message, headerBits, bodyPositionCount, matrixK);
+
+    // Маскирующий шум в порядке памяти с заданной плотностью; байты сообщения не затрагиваются.
+    withEngine(engine, [&](auto* tag) {
+        using Engine = std::remove_pointer_t<decltype(tag)>;
+        mergeWithCoverNoise<Engine>(data, size, plane, payload, candidates, key, noiseStream, noiseDensity);
     });
+}
+
+// Длины заголовка и тела в позициях и позиции сообщения по тем же правилам, что и при встраивании
+struct PayloadPlan {
+    size_t headerBits = 0;
+    size_t bodyPositionCount = 0;
+    uint8_t matrixK = 1;
+    std::vector<size_t> positions;
+    std::shared_ptr<const std::vector<size_t>> candidates;
+};
+
+// std::nullopt, если сообщение не помещается в носитель (ошибка уже залогирована)
+template <typename CostMapSource>
+std::optional<PayloadPlan> planPayload(size_t carrierSize, const std::vector<uint8_t>& message, const std::vector<uint8_t>& key,
+                        const EmbedOptions& options, CostMapSource&& computeOwnCostMap) {
+    PayloadPlan plan;
+    size_t messageBits = message.size() * 8;
+    plan.matrixK = std::max<uint8_t>(1, options.matrixK);
+
+    // Заголовок всегда встраивается по биту на позицию; остальное - по биту на позицию (k = 1)
+    // или кодом Хэмминга: k бит на группу из 2^k - 1 позиций.
+    plan.headerBits = std::min(options.headerBytes * 8, messageBits);
+    plan.bodyPositionCount = matrixPositionsNeeded(messageBits - plan.headerBits, plan.matrixK);
 
-    // Встраиваем биты сообщения в выбранные позиции.
-    for (size_t bitIndex = 0; bitIndex < messageBits; bitIndex++) {
-        size_t dataIndex = shuffledIndices[bitIndex];
-        size_t byteIndex = bitIndex / 8;
-        size_t bitInByte = 7 - (bitIndex % 8); // Берём бит с старшего разряда
+    std::vector<uint8_t> ownCostMap;
+    EmbedOptions resolved = options;
+    if (options.adaptiveLevel > 0 && !options.costMap) {
+        ownCostMap = computeOwnCostMap();
+        resolved.costMap = &ownCostMap;
+    }
+
+    // Генерируем псевдослучайные позиции сообщения на основе ключа; остальные байты перестановка не затрагивает.
+    auto positions = planPositions(carrierSize, key, resolved, plan.headerBits, plan.bodyPositionCount, &plan.candidates);
+    if (!positions) return std::nullopt;
+    plan.positions = std::move(*positions);
+    return plan;
+}
+
+// planPayload для путей, где нехватка места завершает программу
+template <typename CostMapSource>
+PayloadPlan requirePayload(size_t carrierSize, const std::vector<uint8_t>& message, const std::vector<uint8_t>& key,
+                           const EmbedOptions& options, CostMapSource&& computeOwnCostMap) {
+    std::optional<PayloadPlan> plan = planPayload(carrierSize, message, key, options, computeOwnCostMap);
+    if (!plan) {
+        exit(EXIT_FAILURE);
+    }
+    return std::move(*plan);
+}
+
+// writePayload с теми же длинами заголовка и тела, что и в planPayload (LSB потокового носителя)
+template <typename Carrier>
+size_t writePlannedPayload(Carrier&& data, const size_t* positions, const std::vector<uint8_t>& message,
+                           const EmbedOptions& options) {
+    const uint8_t matrixK = std::max<uint8_t>(1, options.matrixK);
+    const size_t messageBits = message.size() * 8;
+    const size_t headerBits = std::min(options.headerBytes * 8, messageBits);
+    const size_t bodyPositionCount = matrixPositionsNeeded(messageBits - headerBits, matrixK);
+    return writePayload(data, positions, message, headerBits, bodyPositionCount, matrixK);
+}
+
+} // namespace
+
+std::vector<size_t> excludePositions(const std::vector<size_t>& candidates, std::vector<size_t> positions) {
+    std::sort(positions.begin(), positions.end());
+    std::vector<size_t> remaining;
+    remaining.reserve(candidates.size());
+    std::set_difference(candidates.begin(), candidates.end(), positions.begin(), positions.end(), std::back_inserter(remaining));
+    return remaining;
+}
+
+EmbedOptions chooseEmbedOptions(size_t carrierSize, size_t containerBytes, size_t headerBytes, EngineId engine,
+                                const std::vector<uint8_t>* costMap, bool matrix, unsigned int noiseDensity) {
+    EmbedOptions options;
+    options.engine = engine;
+    options.headerBytes = headerBytes;
+    options.noiseDensity = noiseDensity;
 
-        uint8_t bitValue = (message[byteIndex] >> bitInByte) & 0x01;
-        // Устанавливаем LSB выбранного байта в значение bitValue.
-        image.data[dataIndex] = (image.data[dataIndex] & 0xFE) | bitValue;
+    if (costMap) {
+        // Выбираем самый узкий адаптивный уровень, в котором сообщение занимает не больше половины кандидатов
+        options.adaptiveLevel = chooseAdaptiveLevel(*costMap, containerBytes * 8);
+        if (options.adaptiveLevel == 0) {
+            LOG_WARN("The message is too big for adaptive embedding, uniform positions are used");
+        } else {
+            options.costMap = costMap;
+        }
     }
 
-    if(fillUnecessaryBits.joinable()){
-        fillUnecessaryBits.join();
-        LOG_INFO("fillUnecessaryBits thread was joined");
+    if (matrix) {
+        // k выбирается по отношению размера сообщения к числу доступных позиций
+        size_t available = options.adaptiveLevel > 0 ? countTexturedPositions(*costMap, options.adaptiveLevel) : carrierSize;
+        size_t headerBits = headerBytes * 8;
+        available = available > headerBits ? available - headerBits : 0;
+        options.matrixK = chooseMatrixK(containerBytes * 8, available);
+        LOG_INFO("Matrix embedding parameter k = {} was chosen", options.matrixK);
     }
+    return options;
+}
+
+void embedData(ImageHandler::Image& image, const std::vector<uint8_t>& message, const std::vector<uint8_t>& key, const EmbedOptions& options) {
+    if (!tryEmbedData(image, message, key, options)) {
+        exit(EXIT_FAILURE);
+    }
+}
+
+bool tryEmbedData(ImageHandler::Image& image, const std::vector<uint8_t>& message, const std::vector<uint8_t>& key,
+                  const EmbedOptions& options) {
+    std::optional<PayloadPlan> plan = planPayload(image.data.size(), message, key, options,
+                                                  [&] { return computeCostMap(image, Parallel::defaultThreadCount()); });
+    if (!plan) return false;
+    LOG_INFO("Shuffled Indices were compiled successfuly");
+
+    embedIntoBuffer(image.data.data(), image.data.size(), plan->positions, message, plan->headerBits, plan->bodyPositionCount,
+                    plan->matrixK, plan->candidates.get(), key, options.engine, NOISE_STREAM, options.noiseDensity);
     LOG_INFO("The data was embeded in the picture");
+    return true;
 }
 
+void embedDataInPlace(ImageHandler::MappedImage& carrier, const std::vector<uint8_t>& message, const std::vector<uint8_t>& key,
+                      const EmbedOptions& options) {
+    if (!tryEmbedDataInPlace(carrier, message, key, options)) {
+        exit(EXIT_FAILURE);
+    }
+}
 
-std::vector<uint8_t> extractData(const ImageHandler::Image& image, size_t messageLength, const std::vector<uint8_t>& key) {
-    size_t totalBits = image.data.size();
-    size_t messageBits = messageLength * 8;
+bool tryEmbedDataInPlace(ImageHandler::MappedImage& carrier, const std::vector<uint8_t>& message, const std::vector<uint8_t>& key,
+                         const EmbedOptions& options) {
+    // Генерируются только позиции сообщения; затем они переводятся в смещения внутри файла
+    std::optional<PayloadPlan> planned = planPayload(carrier.size(), message, key, options,
+                                                     [&] { return computeCostMap(carrier.toImage(), Parallel::defaultThreadCount()); });
+    if (!planned) return false;
+    PayloadPlan& plan = *planned;
+    std::vector<size_t>& offsets = plan.positions;
+    carrier.mapPositions(offsets);
+    writePayload(carrier.bytes(), offsets.data(), message, plan.headerBits, plan.bodyPositionCount, plan.matrixK);
 
-    if (messageBits > totalBits) {
-        LOG_ERROR("The specified message length exceeds the image capacity");
+    std::sort(offsets.begin(), offsets.end());
+    withEngine(options.engine, [&](auto* tag) {
+        using Engine = std::remove_pointer_t<decltype(tag)>;
+        fillCoverNoiseInPlace<Engine>(carrier, offsets, plan.candidates.get(), key, options.noiseDensity,
+                                      options.adaptiveLevel > 0);
+    });
+    LOG_INFO("The data was embeded in place into the mapped file");
+    return true;
+}
+
+size_t updateData(ImageHandler::Image& image, const std::vector<uint8_t>& message, const std::vector<uint8_t>& key,
+                  const EmbedOptions& options) {
+    PayloadPlan plan = requirePayload(image.data.size(), message, key, options,
+                                      [&] { return computeCostMap(image, Parallel::defaultThreadCount()); });
+    // Позиции прежнего сообщения - префикс тех же потоков, поэтому совпадающие биты не меняются,
+    // а сообщение длиннее прежнего продолжает потоки. Шум уже лежит в носителе и не добавляется.
+    size_t changed = writePayload(image.data.data(), plan.positions.data(), message, plan.headerBits,
+                                  plan.bodyPositionCount, plan.matrixK);
+    LOG_INFO("The payload was updated: {} of {} positions were changed", changed, plan.positions.size());
+    return changed;
+}
+
+size_t updateDataInPlace(ImageHandler::MappedImage& carrier, const std::vector<uint8_t>& message, const std::vector<uint8_t>& key,
+                         const EmbedOptions& options) {
+    PayloadPlan plan = requirePayload(carrier.size(), message, key, options,
+                                      [&] { return computeCostMap(carrier.toImage(), Parallel::defaultThreadCount()); });
+    carrier.mapPositions(plan.positions);
+    size_t changed = writePayload(carrier.bytes(), plan.positions.data(), message, plan.headerBits,
+                                  plan.bodyPositionCount, plan.matrixK);
+    LOG_INFO("The payload was updated in place: {} of {} positions were changed", changed, plan.positions.size());
+    return changed;
+}
+
+std::vector<size_t> planPayloadPositions(size_t carrierSize, const std::vector<uint8_t>& message, const std::vector<uint8_t>& key,
+                                         const EmbedOptions& options) {
+    PayloadPlan plan = requirePayload(carrierSize, message, key, options, []() -> std::vector<uint8_t> {
+        LOG_ERROR("Adaptive embedding into a streamed carrier needs its cost map");
         exit(EXIT_FAILURE);
+    });
+    return std::move(plan.positions);
+}
+
+size_t embedIntoLsbs(std::vector<uint8_t>& lsbs, const std::vector<uint8_t>& message, const EmbedOptions& options) {
+    // Позиции - порядковые номера собранных LSB
+    std::vector<size_t> order(lsbs.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
     }
+    return writePlannedPayload(lsbs.data(), order.data(), message, options);
+}
 
-    // Генерируем ту же последовательность перестановки.
-    std::vector<size_t> shuffledIndices = generateShuffledIndices(totalBits, key);
+size_t embedIntoLsbs(LsbPlane& plane, const std::vector<size_t>& positions, const std::vector<uint8_t>& message,
+                     const EmbedOptions& options) {
+    return writePlannedPayload(plane, positions.data(), message, options);
+}
 
-    std::vector<uint8_t> message(messageLength, 0);
-    for (size_t bitIndex = 0; bitIndex < messageBits; bitIndex++) {
-        size_t dataIndex = shuffledIndices[bitIndex];
-        uint8_t bitValue = image.data[dataIndex] & 0x01;
+void embedFrame(uint8_t* data, size_t size, const std::vector<uint8_t>& bytes, const std::vector<uint8_t>& key,
+                EngineId engine, uint64_t positionStream, uint64_t noiseStream, unsigned int noiseDensity) {
+    std::vector<size_t> positions = PositionCache::instance().take(size, key, engine, positionStream, bytes.size() * 8);
+    embedIntoBuffer(data, size, positions, bytes, 0, 0, 1, nullptr, key, engine, noiseStream, noiseDensity);
+}
+
+std::vector<uint8_t> extractFrame(const uint8_t* data, size_t size, size_t length, const std::vector<uint8_t>& key,
+                                  EngineId engine, uint64_t positionStream) {
+    PositionStream stream(size, key, engine, positionStream);
+    std::vector<size_t> positions = stream.take(length * 8);
+    return matrixExtract(data, size, positions.data(), length, 1);
+}
+
+std::vector<uint8_t> extractData(const ImageHandler::Image& image, size_t messageLength, const std::vector<uint8_t>& key, EngineId engine) {
+    PositionStream positions(image.data.size(), key, engine);
+    return extractData(image, positions, messageLength);
+}
+
+std::vector<uint8_t> extractData(const ImageHandler::Image& image, PositionStream& positions, size_t messageLength) {
+    size_t messageBits = messageLength * 8;
 
-        size_t byteIndex = bitIndex / 8;
-        size_t bitInByte = 7 - (bitIndex % 8);
-        message[byteIndex] |= (bitValue << bitInByte);
+    if (messageLength > positions.remaining() / 8) {
+        LOG_ERROR("The specified message length exceeds the image capacity");
+        exit(EXIT_FAILURE);
     }
 
+    // Берём из перестановки ровно столько позиций, сколько нужно бит сообщения.
+    return extractData(image, positions.take(messageBits));
+}
+
+std::vector<uint8_t> extractData(const ImageHandler::Image& image, const std::vector<size_t>& shuffledIndices) {
+    // Бит на позицию - частный случай кода Хэмминга с k = 1; большие сообщения читаются параллельно
+    std::vector<uint8_t> message = matrixExtract(image.data.data(), image.data.size(), shuffledIndices.data(),
+                                                 shuffledIndices.size() / 8, 1);
+
     LOG_INFO("The data was extracted from the file");
     return message;
 }
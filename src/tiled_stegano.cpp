@@ -0,0 +1,143 @@
+#include "tiled_stegano.h"
+#include "position_stream.h"
+#include "position_cache.h"
+#include "parallel.h"
+#include "memory_budget.h"
+#include "trace.h"
+#include "external/logger.h"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+
+namespace Stegano {
+
+namespace {
+
+// Позиция сообщения, переведённая в (плитка, смещение)
+struct TileEntry {
+    uint32_t tile = 0;
+    size_t offset = 0;
+    size_t bit = 0; ///< Номер бита сообщения
+};
+
+// Позиции упорядочиваются по плиткам, чтобы каждая плитка декодировалась один раз
+std::vector<TileEntry> sortByTile(const ImageHandler::TiledTiff& carrier, const std::vector<size_t>& positions) {
+    Trace::Span span("sort by tile");
+    std::vector<TileEntry> entries(positions.size());
+    for (size_t bit = 0; bit < positions.size(); bit++) {
+        ImageHandler::TileAddress address = carrier.locate(positions[bit]);
+        entries[bit] = TileEntry{ address.tile, address.offset, bit };
+    }
+    std::sort(entries.begin(), entries.end(), [](const TileEntry& a, const TileEntry& b) {
+        return a.tile != b.tile ? a.tile < b.tile : a.offset < b.offset;
+    });
+    return entries;
+}
+
+// Делит отсортированные позиции между потоками по границам плиток: одна плитка - один поток
+template <typename Fn>
+void forTileRanges(const std::vector<TileEntry>& entries, unsigned int threadCount, Fn&& fn) {
+    const size_t count = entries.size();
+    threadCount = static_cast<unsigned int>(std::min<size_t>(std::max(1u, threadCount), std::max<size_t>(1, count)));
+    std::vector<size_t> bounds(threadCount + 1, count);
+    bounds[0] = 0;
+    for (unsigned int t = 1; t < threadCount; t++) {
+        size_t bound = std::max(bounds[t - 1], count * t / threadCount);
+        while (bound > 0 && bound < count && entries[bound].tile == entries[bound - 1].tile) bound++;
+        bounds[t] = bound;
+    }
+    Parallel::run(threadCount, [&](unsigned int t) {
+        Trace::Span span("tiles");
+        if (bounds[t] < bounds[t + 1]) fn(bounds[t], bounds[t + 1]);
+    });
+}
+
+// Число потоков, чьи кэши плиток помещаются в бюджет памяти вместе с позициями сообщения
+unsigned int budgetWorkers(const ImageHandler::TiledTiff& carrier, size_t positionCount, unsigned int threadCount) {
+    size_t shared = PositionStream::memoryEstimate(static_cast<size_t>(carrier.size()), positionCount) +
+                    positionCount * (sizeof(TileEntry) + 1);
+    size_t perWorker = ImageHandler::TileCache::DEFAULT_CAPACITY * carrier.tileBytes();
+    unsigned int workers = MemoryBudget::fitWorkers(shared, perWorker, threadCount);
+    if (workers == 0) {
+        LOG_ERROR("The message positions and a tile cache need about {}, but --max-memory is {}",
+                  MemoryBudget::formatSize(shared + perWorker), MemoryBudget::formatSize(MemoryBudget::limit()));
+        exit(EXIT_FAILURE);
+    }
+    return workers;
+}
+
+ImageHandler::TiledTiff openTiled(const std::string& filename, bool writable) {
+    auto tiff = ImageHandler::TiledTiff::open(filename, writable);
+    if (!tiff) {
+        LOG_ERROR("{} is not a tiled TIFF with 8-bit interleaved samples and lossless compression", filename);
+        exit(EXIT_FAILURE);
+    }
+    return std::move(*tiff);
+}
+
+} // namespace
+
+void embedTiled(const std::string& inFile, const std::string& outFile, const std::vector<uint8_t>& message,
+                const std::vector<uint8_t>& key, EngineId engine, unsigned int threadCount) {
+    ImageHandler::TiledTiff input = openTiled(inFile, false);
+    const uint64_t carrierSize = input.size();
+    if (static_cast<uint64_t>(message.size()) * 8 > carrierSize) {
+        LOG_ERROR("The message is too big. It is impossible to place the all text into the picture");
+        exit(EXIT_FAILURE);
+    }
+
+    threadCount = budgetWorkers(input, message.size() * 8, threadCount);
+
+    // Нужны только позиции сообщения: ленивый поток не перемешивает все 64-битные позиции носителя
+    std::vector<TileEntry> entries = sortByTile(
+        input, PositionCache::instance().take(static_cast<size_t>(carrierSize), key, engine, POSITION_STREAM, message.size() * 8));
+
+    // Выход - копия входа, в которой перезаписываются только плитки с позициями сообщения
+    std::error_code ec;
+    std::filesystem::copy_file(inFile, outFile, std::filesystem::copy_options::overwrite_existing, ec);
+    if (ec) {
+        LOG_ERROR("Failed to create the output file {}", outFile);
+        exit(EXIT_FAILURE);
+    }
+    ImageHandler::TiledTiff output = openTiled(outFile, true);
+
+    std::atomic<size_t> tilesWritten{0};
+    forTileRanges(entries, threadCount, [&](size_t begin, size_t end) {
+        ImageHandler::TiledTiff reader = openTiled(inFile, false);
+        ImageHandler::TileCache cache(reader, &output);
+        for (size_t i = begin; i < end; i++) {
+            const TileEntry& entry = entries[i];
+            uint8_t bitValue = (message[entry.bit / 8] >> (7 - entry.bit % 8)) & 0x01;
+            uint8_t* tile = cache.tile(entry.tile, true);
+            tile[entry.offset] = static_cast<uint8_t>((tile[entry.offset] & 0xFE) | bitValue);
+        }
+        cache.flush();
+        tilesWritten += cache.writes();
+    });
+
+    if (!output.close()) {
+        LOG_ERROR("Failed to update the tiles of {}", outFile);
+        exit(EXIT_FAILURE);
+    }
+    LOG_INFO("The message was embedded into {} tiles of a {}x{} TIFF", tilesWritten.load(), input.width(), input.height());
+}
+
+std::vector<uint8_t> readTiledLsbs(const ImageHandler::TiledTiff& carrier, const std::vector<size_t>& positions,
+                                   unsigned int threadCount) {
+    threadCount = budgetWorkers(carrier, positions.size(), threadCount);
+    std::vector<uint8_t> lsbs(positions.size());
+    std::vector<TileEntry> entries = sortByTile(carrier, positions);
+
+    // Каждый поток пишет только в свои биты сообщения
+    forTileRanges(entries, threadCount, [&](size_t begin, size_t end) {
+        ImageHandler::TiledTiff reader = openTiled(carrier.path(), false);
+        ImageHandler::TileCache cache(reader, nullptr);
+        for (size_t i = begin; i < end; i++) {
+            lsbs[entries[i].bit] = cache.tile(entries[i].tile, false)[entries[i].offset] & 0x01;
+        }
+    });
+    return lsbs;
+}
+
+} // namespace Stegano
@@ -0,0 +1,266 @@
+#include "tiled_tiff.h"
+#include "external/logger.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdarg>
+
+#ifdef STEGANO_HAVE_TIFF
+#include <tiffio.h>
+#endif
+
+namespace ImageHandler {
+
+namespace {
+
+#ifdef STEGANO_HAVE_TIFF
+// Сообщения libtiff идут в общий лог вместо stderr
+void logTiffMessage(const char* module, const char* format, va_list args) {
+    char text[512];
+    std::vsnprintf(text, sizeof(text), format, args);
+    LOG_DEBUG("libtiff ({}): {}", module ? module : "", text);
+}
+
+void installTiffHandlers() {
+    static bool installed = false;
+    if (!installed) {
+        TIFFSetErrorHandler(logTiffMessage);
+        TIFFSetWarningHandler(logTiffMessage);
+        installed = true;
+    }
+}
+
+// Сжатие без потерь: сохраняет младшие биты при перезаписи плиток
+bool isLosslessCompression(uint16_t compression) {
+    switch (compression) {
+        case COMPRESSION_NONE:
+        case COMPRESSION_LZW:
+        case COMPRESSION_ADOBE_DEFLATE:
+        case COMPRESSION_DEFLATE:
+        case COMPRESSION_PACKBITS:
+        case COMPRESSION_LZMA:
+        case COMPRESSION_ZSTD:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Отсчёты - сами значения цвета; в палитровом изображении это индексы, и смена младшего бита меняет цвет
+bool isDirectColour(uint16_t photometric) {
+    switch (photometric) {
+        case PHOTOMETRIC_MINISWHITE:
+        case PHOTOMETRIC_MINISBLACK:
+        case PHOTOMETRIC_RGB:
+        case PHOTOMETRIC_SEPARATED:
+            return true;
+        default:
+            return false;
+    }
+}
+
+TIFF* asTiff(void* handle) {
+    return static_cast<TIFF*>(handle);
+}
+#endif
+
+} // namespace
+
+bool isTiffFile(const std::string& filename) {
+    std::string lower = filename;
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    auto endsWith = [&](const std::string& ext) {
+        return lower.size() >= ext.size() && lower.compare(lower.size() - ext.size(), ext.size(), ext) == 0;
+    };
+    return endsWith(".tif") || endsWith(".tiff");
+}
+
+bool tiffSupported() {
+#ifdef STEGANO_HAVE_TIFF
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::optional<TiledTiff> TiledTiff::open(const std::string& filename, bool writable) {
+#ifdef STEGANO_HAVE_TIFF
+    installTiffHandlers();
+    TiledTiff image;
+    // "m": без отображения всего файла в память - читаются только нужные плитки
+    image.tiff = TIFFOpen(filename.c_str(), writable ? "r+m" : "rm");
+    if (!image.tiff) return std::nullopt;
+    image.filePath = filename;
+    image.updating = writable;
+    TIFF* tif = asTiff(image.tiff);
+
+    uint32_t width = 0, height = 0, tileWidth = 0, tileLength = 0;
+    uint16_t bitsPerSample = 0, samplesPerPixel = 0, planar = 0, sampleFormat = 0, compression = 0;
+    if (!TIFFIsTiled(tif) ||
+        !TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &width) || !TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &height) ||
+        !TIFFGetField(tif, TIFFTAG_TILEWIDTH, &tileWidth) || !TIFFGetField(tif, TIFFTAG_TILELENGTH, &tileLength)) {
+        return std::nullopt;
+    }
+    TIFFGetFieldDefaulted(tif, TIFFTAG_BITSPERSAMPLE, &bitsPerSample);
+    TIFFGetFieldDefaulted(tif, TIFFTAG_SAMPLESPERPIXEL, &samplesPerPixel);
+    TIFFGetFieldDefaulted(tif, TIFFTAG_PLANARCONFIG, &planar);
+    TIFFGetFieldDefaulted(tif, TIFFTAG_SAMPLEFORMAT, &sampleFormat);
+    TIFFGetFieldDefaulted(tif, TIFFTAG_COMPRESSION, &compression);
+
+    if (bitsPerSample != 8 || samplesPerPixel < 1 || planar != PLANARCONFIG_CONTIG ||
+        sampleFormat != SAMPLEFORMAT_UINT || !isLosslessCompression(compression)) {
+        LOG_DEBUG("{}: only tiled 8-bit interleaved TIFF with lossless compression is supported", filename);
+        return std::nullopt;
+    }
+    uint16_t photometric = 0;
+    if (!TIFFGetField(tif, TIFFTAG_PHOTOMETRIC, &photometric) || !isDirectColour(photometric)) {
+        LOG_ERROR("{}: palette and other non-direct-colour TIFF images are not supported (photometric {})",
+                  filename, photometric);
+        return std::nullopt;
+    }
+    tmsize_t tileSize = TIFFTileSize(tif);
+    if (width == 0 || height == 0 || tileWidth == 0 || tileLength == 0 || tileSize <= 0 ||
+        static_cast<uint64_t>(tileSize) != static_cast<uint64_t>(tileWidth) * tileLength * samplesPerPixel) {
+        return std::nullopt;
+    }
+
+    image.imageWidth = width;
+    image.imageHeight = height;
+    image.samplesPerPixel = samplesPerPixel;
+    image.tileWidth = tileWidth;
+    image.tileLength = tileLength;
+    image.tilesAcross = (width + tileWidth - 1) / tileWidth;
+    image.tileSize = static_cast<size_t>(tileSize);
+    return image;
+#else
+    (void)filename;
+    (void)writable;
+    return std::nullopt;
+#endif
+}
+
+TiledTiff::TiledTiff(TiledTiff&& other) noexcept {
+    *this = std::move(other);
+}
+
+TiledTiff& TiledTiff::operator=(TiledTiff&& other) noexcept {
+    if (this != &other) {
+        close();
+        tiff = other.tiff;
+        filePath = std::move(other.filePath);
+        imageWidth = other.imageWidth;
+        imageHeight = other.imageHeight;
+        samplesPerPixel = other.samplesPerPixel;
+        tileWidth = other.tileWidth;
+        tileLength = other.tileLength;
+        tilesAcross = other.tilesAcross;
+        tileSize = other.tileSize;
+        updating = other.updating;
+        writeMutex = std::move(other.writeMutex);
+        other.tiff = nullptr;
+    }
+    return *this;
+}
+
+TiledTiff::~TiledTiff() {
+    close();
+}
+
+TileAddress TiledTiff::locate(uint64_t position) const {
+    const uint64_t rowBytes = static_cast<uint64_t>(imageWidth) * samplesPerPixel;
+    uint64_t row = position / rowBytes;
+    uint64_t column = (position % rowBytes) / samplesPerPixel;
+    uint64_t sample = position % samplesPerPixel;
+
+    TileAddress address;
+    address.tile = static_cast<uint32_t>((row / tileLength) * tilesAcross + column / tileWidth);
+    address.offset = static_cast<size_t>(((row % tileLength) * tileWidth + column % tileWidth) * samplesPerPixel + sample);
+    return address;
+}
+
+bool TiledTiff::readTile(uint32_t tile, std::vector<uint8_t>& buffer) {
+#ifdef STEGANO_HAVE_TIFF
+    buffer.resize(tileSize);
+    return TIFFReadEncodedTile(asTiff(tiff), tile, buffer.data(), static_cast<tmsize_t>(tileSize)) >= 0;
+#else
+    (void)tile;
+    (void)buffer;
+    return false;
+#endif
+}
+
+bool TiledTiff::writeTile(uint32_t tile, std::vector<uint8_t>& buffer) {
+#ifdef STEGANO_HAVE_TIFF
+    std::lock_guard<std::mutex> lock(*writeMutex);
+    return TIFFWriteEncodedTile(asTiff(tiff), tile, buffer.data(), static_cast<tmsize_t>(tileSize)) >= 0;
+#else
+    (void)tile;
+    (void)buffer;
+    return false;
+#endif
+}
+
+bool TiledTiff::close() {
+    bool success = true;
+#ifdef STEGANO_HAVE_TIFF
+    if (tiff) {
+        // В режиме r+ TIFFFlush дописывает каталог с новыми смещениями плиток
+        TIFF* tif = asTiff(tiff);
+        if (updating) {
+            success = TIFFFlush(tif) == 1;
+        }
+        TIFFClose(tif);
+    }
+#endif
+    tiff = nullptr;
+    return success;
+}
+
+TileCache::TileCache(TiledTiff& source, TiledTiff* target, size_t capacity)
+    : source(source), target(target), capacity(std::max<size_t>(1, capacity)) {}
+
+uint8_t* TileCache::tile(uint32_t tile, bool modify) {
+    auto found = index.find(tile);
+    if (found != index.end()) {
+        entries.splice(entries.begin(), entries, found->second);
+    } else {
+        if (entries.size() >= capacity) {
+            // Вытесняем давно не использованную плитку, изменённую - с записью
+            Entry& victim = entries.back();
+            writeBack(victim);
+            index.erase(victim.tile);
+            entries.pop_back();
+        }
+        Entry entry;
+        entry.tile = tile;
+        if (!source.readTile(tile, entry.data)) {
+            LOG_ERROR("Failed to read tile {} of {}", tile, source.path());
+            exit(EXIT_FAILURE);
+        }
+        tileReads++;
+        entries.push_front(std::move(entry));
+        index[tile] = entries.begin();
+    }
+    Entry& entry = entries.front();
+    entry.dirty = entry.dirty || modify;
+    return entry.data.data();
+}
+
+void TileCache::flush() {
+    for (Entry& entry : entries) {
+        writeBack(entry);
+    }
+}
+
+void TileCache::writeBack(Entry& entry) {
+    if (!entry.dirty) return;
+    if (!target || !target->writeTile(entry.tile, entry.data)) {
+        LOG_ERROR("Failed to write tile {}", entry.tile);
+        exit(EXIT_FAILURE);
+    }
+    entry.dirty = false;
+    tileWrites++;
+}
+
+} // namespace ImageHandler
@@ -0,0 +1,140 @@
+#include "trace.h"
+#include "external/logger.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Trace {
+
+namespace {
+
+struct Event {
+    const char* name;
+    uint64_t beginNs;
+    uint64_t endNs;
+};
+
+// Буфер одного потока: пишет только владелец, читается при завершении после остановки потоков
+struct ThreadBuffer {
+    uint32_t tid = 0;
+    std::string name;
+    std::vector<Event> events;
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::string path;
+    std::chrono::steady_clock::time_point origin;
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+// Регистрация под мьютексом - один раз на поток, запись событий идёт без блокировок
+ThreadBuffer& localBuffer() {
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (!buffer) {
+        Registry& shared = registry();
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        shared.buffers.push_back(std::make_unique<ThreadBuffer>());
+        buffer = shared.buffers.back().get();
+        buffer->tid = static_cast<uint32_t>(shared.buffers.size());
+        buffer->name = "thread " + std::to_string(buffer->tid);
+    }
+    return *buffer;
+}
+
+// Имена спанов - литералы из кода, но кавычки и обратные косые экранируются на всякий случай
+void writeJsonString(FILE* out, const std::string& text) {
+    std::fputc('"', out);
+    for (char c : text) {
+        if (c == '"' || c == '\\') std::fputc('\\', out);
+        std::fputc(c, out);
+    }
+    std::fputc('"', out);
+}
+
+void finishAtExit() {
+    finish();
+}
+
+} // namespace
+
+namespace detail {
+
+uint64_t nowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - registry().origin).count());
+}
+
+void record(const char* name, uint64_t beginNs, uint64_t endNs) {
+    localBuffer().events.push_back(Event{ name, beginNs, endNs });
+}
+
+} // namespace detail
+
+void start(const std::string& path) {
+    Registry& shared = registry();
+    shared.path = path;
+    shared.origin = std::chrono::steady_clock::now();
+    detail::enabledFlag() = true;
+    nameThread("main");
+    // Трасса пишется и при завершении через exit() после ошибки; логгер создаётся раньше
+    // обработчика, поэтому разрушается после него
+    LOG_INFO("Spans are recorded to {}", path);
+    std::atexit(finishAtExit);
+}
+
+void nameThread(const std::string& name) {
+    if (enabled()) {
+        localBuffer().name = name;
+    }
+}
+
+void finish() {
+    if (!enabled()) return;
+    detail::enabledFlag() = false;
+    Registry& shared = registry();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+
+    FILE* out = std::fopen(shared.path.c_str(), "w");
+    if (!out) {
+        LOG_WARN("Failed to write the trace to {}", shared.path);
+        return;
+    }
+    size_t eventCount = 0;
+    std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", out);
+    bool first = true;
+    for (const auto& buffer : shared.buffers) {
+        // Метаданные трека: имя потока
+        std::fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+                     first ? "" : ",\n", buffer->tid);
+        writeJsonString(out, buffer->name);
+        std::fputs("}}", out);
+        first = false;
+        for (const Event& event : buffer->events) {
+            std::fputs(",\n{\"name\":", out);
+            writeJsonString(out, event.name);
+            // Время в микросекундах с долями, как ожидает формат
+            std::fprintf(out, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", buffer->tid,
+                         static_cast<double>(event.beginNs) / 1000.0,
+                         static_cast<double>(event.endNs - event.beginNs) / 1000.0);
+        }
+        eventCount += buffer->events.size();
+    }
+    std::fputs("\n]}\n", out);
+    if (std::fclose(out) != 0) {
+        LOG_WARN("Failed to write the trace to {}", shared.path);
+        return;
+    }
+    LOG_INFO("{} spans of {} threads were written to {}", eventCount, shared.buffers.size(), shared.path);
+}
+
+} // namespace Trace
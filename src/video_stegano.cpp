@@ -0,0 +1,165 @@
+#include "video_stegano.h"
+#include "stegano.h"
+#include "y4m.h"
+#include "frame_pipeline.h"
+#include "encryption/data_conversion.h"
+#include "encryption/utils.h"
+#include "memory_budget.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace Stegano {
+
+namespace {
+
+// Доля ёмкости кадра, занимаемая контейнером, когда длина ролика неизвестна
+constexpr size_t UNKNOWN_LENGTH_DIVISOR = 8;
+
+// Размер поля "байт контейнера на кадр" (uint32, big-endian)
+constexpr size_t PER_FRAME_SIZE = 4;
+
+size_t prefixWithCheckSize() {
+    return videoPrefixSize() + DataConversion::KEY_CHECK_SIZE;
+}
+
+// Число рабочих потоков конвейера, помещающихся в бюджет памяти: у каждого свой кадр, позиции,
+// плоскость LSB и множество позиций нагрузки, плюс кадры читателя и писателя и сам контейнер
+unsigned int budgetWorkers(size_t frameSize, size_t bytesPerFrame, size_t containerSize, unsigned int threadCount) {
+    size_t bits = (prefixWithCheckSize() + bytesPerFrame) * 8;
+    size_t perWorker = frameSize + frameSize / 4 + PositionStream::memoryEstimate(frameSize, bits);
+    unsigned int workers = MemoryBudget::fitWorkers(2 * frameSize + containerSize, perWorker, threadCount);
+    if (workers == 0) {
+        LOG_ERROR("The video frames do not fit into --max-memory {}: one worker needs about {}",
+                  MemoryBudget::formatSize(MemoryBudget::limit()), MemoryBudget::formatSize(2 * frameSize + containerSize + perWorker));
+        exit(EXIT_FAILURE);
+    }
+    if (workers < std::max(1u, threadCount)) {
+        LOG_INFO("The frame pipeline uses {} workers to stay within --max-memory", workers);
+    }
+    return workers;
+}
+
+} // namespace
+
+size_t videoPrefixSize() {
+    return DataConversion::HEADER_SIZE + PER_FRAME_SIZE;
+}
+
+void embedVideo(const std::string& inFile, const std::string& outFile, const std::vector<uint8_t>& container,
+                const std::vector<uint8_t>& key, EngineId engine, unsigned int noiseDensity, unsigned int threadCount) {
+    VideoHandler::Y4MReader reader(inFile);
+    const size_t frameCapacity = reader.frameSize() / 8;
+    if (frameCapacity <= prefixWithCheckSize()) {
+        LOG_ERROR("The video frames are too small to hold the message header");
+        exit(EXIT_FAILURE);
+    }
+
+    // Сколько байт контейнера несёт каждый кадр: равномерно по всему ролику, если его длина известна
+    const size_t maxPerFrame = frameCapacity - prefixWithCheckSize();
+    size_t frameCount = reader.estimatedFrameCount();
+    size_t bytesPerFrame = frameCount > 0 ? (container.size() + frameCount - 1) / frameCount
+                                          : maxPerFrame / UNKNOWN_LENGTH_DIVISOR;
+    bytesPerFrame = std::clamp<size_t>(bytesPerFrame, 1, maxPerFrame);
+    const size_t framesNeeded = std::max<size_t>(1, (container.size() + bytesPerFrame - 1) / bytesPerFrame);
+
+    // Префикс первого кадра: заголовок, байты на кадр и проверочное значение ключа над ними
+    DataConversion::ContainerHeader header;
+    header.containerLength = container.size();
+    header.engine = static_cast<uint8_t>(engine);
+    std::vector<uint8_t> prefix = DataConversion::headerToBytes(header);
+    std::vector<uint8_t> perFrame = DataConversion::uint32ToBytes(static_cast<uint32_t>(bytesPerFrame));
+    prefix.insert(prefix.end(), perFrame.begin(), perFrame.end());
+    std::vector<uint8_t> keyCheck = Utils::computeKeyCheck(prefix, key, DataConversion::KEY_CHECK_SIZE);
+    prefix.insert(prefix.end(), keyCheck.begin(), keyCheck.end());
+    LOG_INFO("The container ({} bytes) is spread over {} frames, {} bytes per frame", container.size(), framesNeeded, bytesPerFrame);
+
+    threadCount = budgetWorkers(reader.frameSize(), bytesPerFrame, container.size(), threadCount);
+    VideoHandler::Y4MWriter writer(outFile, reader.streamHeader());
+    size_t frames = Parallel::pipeline<VideoHandler::Frame>(threadCount,
+        [&](VideoHandler::Frame& frame) { return reader.readFrame(frame); },
+        [&](size_t index, VideoHandler::Frame& frame) {
+            std::vector<uint8_t> bytes = index == 0 ? prefix : std::vector<uint8_t>();
+            size_t begin = std::min(container.size(), index * bytesPerFrame);
+            size_t end = std::min(container.size(), begin + bytesPerFrame);
+            bytes.insert(bytes.end(), container.begin() + begin, container.begin() + end);
+            embedFrame(frame.data.data(), frame.data.size(), bytes, key, engine,
+                       framePositionStream(index), frameNoiseStream(index), noiseDensity);
+        },
+        [&](size_t, VideoHandler::Frame& frame) { writer.writeFrame(frame); });
+    writer.close();
+
+    if (frames < framesNeeded) {
+        if (!ImageHandler::isStdStream(outFile)) std::remove(outFile.c_str());
+        LOG_ERROR("The message is too big for the video: {} frames are needed, the clip has {}", framesNeeded, frames);
+        exit(EXIT_FAILURE);
+    }
+    LOG_INFO("The data was embeded into {} video frames", frames);
+}
+
+VideoExtraction extractVideo(const std::string& inFile, const std::vector<uint8_t>& key, unsigned int threadCount) {
+    VideoExtraction result;
+    VideoHandler::Y4MReader reader(inFile);
+    VideoHandler::Frame first;
+    const size_t frameCapacity = reader.frameSize() / 8;
+    if (frameCapacity <= prefixWithCheckSize() || !reader.readFrame(first)) {
+        result.status = VideoExtractStatus::CapacityExceeded;
+        return result;
+    }
+
+    // Неверный ключ отбрасывается по первому кадру, остальные кадры не читаются
+    DataConversion::ContainerHeader header;
+    size_t bytesPerFrame = 0;
+    bool matched = false;
+    for (EngineId engine : ALL_ENGINES) {
+        std::vector<uint8_t> prefix = extractFrame(first.data.data(), first.data.size(), prefixWithCheckSize(), key,
+                                                   engine, framePositionStream(0));
+        std::vector<uint8_t> checked(prefix.begin(), prefix.begin() + videoPrefixSize());
+        std::vector<uint8_t> keyCheck(prefix.begin() + videoPrefixSize(), prefix.end());
+        if (keyCheck != Utils::computeKeyCheck(checked, key, DataConversion::KEY_CHECK_SIZE)) continue;
+
+        header = DataConversion::bytesToHeader(std::vector<uint8_t>(checked.begin(), checked.begin() + DataConversion::HEADER_SIZE));
+        bytesPerFrame = DataConversion::bytesToUint32(std::vector<uint8_t>(checked.begin() + DataConversion::HEADER_SIZE, checked.end()));
+        if (header.engine == static_cast<uint8_t>(engine)) {
+            matched = true;
+            break;
+        }
+    }
+    if (!matched || bytesPerFrame == 0 || bytesPerFrame > frameCapacity - prefixWithCheckSize()) {
+        return result;
+    }
+
+    const size_t length = header.containerLength;
+    EngineId engine = static_cast<EngineId>(header.engine);
+    threadCount = budgetWorkers(reader.frameSize(), bytesPerFrame, length, threadCount);
+    result.container.resize(length);
+    size_t inFirst = std::min(length, bytesPerFrame);
+    std::vector<uint8_t> firstBytes = extractFrame(first.data.data(), first.data.size(), prefixWithCheckSize() + inFirst,
+                                                   key, engine, framePositionStream(0));
+    std::copy(firstBytes.begin() + prefixWithCheckSize(), firstBytes.end(), result.container.begin());
+
+    // Остальные кадры читаются ровно до конца контейнера; куски не пересекаются, поэтому пишутся без блокировок
+    const size_t framesLeft = (length - inFirst + bytesPerFrame - 1) / bytesPerFrame;
+    size_t framesRead = 0;
+    Parallel::pipeline<VideoHandler::Frame>(threadCount,
+        [&](VideoHandler::Frame& frame) { return framesRead < framesLeft && reader.readFrame(frame) && ++framesRead; },
+        [&](size_t index, VideoHandler::Frame& frame) {
+            size_t begin = inFirst + index * bytesPerFrame;
+            size_t count = std::min(bytesPerFrame, length - begin);
+            std::vector<uint8_t> bytes = extractFrame(frame.data.data(), frame.data.size(), count, key, engine,
+                                                      framePositionStream(index + 1));
+            std::copy(bytes.begin(), bytes.end(), result.container.begin() + begin);
+        },
+        [](size_t, VideoHandler::Frame&) {});
+
+    if (framesRead < framesLeft) {
+        result.status = VideoExtractStatus::CapacityExceeded;
+        result.container.clear();
+        return result;
+    }
+    LOG_INFO("The data was extracted from {} video frames", framesRead + 1);
+    result.status = VideoExtractStatus::Ok;
+    return result;
+}
+
+} // namespace Stegano
@@ -0,0 +1,451 @@
+#include "watch_folder.h"
+#include "encryption/encryption.h"
+#include "encryption/key_derivation.h"
+#include "external/logger.h"
+#include "image_handler.h"
+#include "mapped_image.h"
+#include "memory_budget.h"
+#include "stegano.h"
+#include "position_cache.h"
+#include "parallel.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#ifdef __linux__
+#include <csignal>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/signalfd.h>
+#define STEGANO_HAVE_INOTIFY 1
+#endif
+
+namespace fs = std::filesystem;
+
+namespace WatchFolder {
+
+#ifdef STEGANO_HAVE_INOTIFY
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr const char* TEMP_PREFIX = ".tmp-";
+// Временные файлы старше часа остались от прерванных процессов
+constexpr auto STALE_TEMP_AGE = std::chrono::hours(1);
+// Файлы, найденные при запуске, ставятся в очередь, если не менялись столько времени
+constexpr auto SETTLE_TIME = std::chrono::seconds(2);
+constexpr auto STATS_INTERVAL = std::chrono::seconds(10);
+constexpr int POLL_TIMEOUT_MS = 500;
+constexpr size_t EVENT_BUFFER_BYTES = 64 * 1024;
+
+// Скрытые имена (в том числе частично записанные файлы) не берутся из спула
+bool isSpoolEntry(const std::string& name) {
+    return !name.empty() && name[0] != '.';
+}
+
+// Очередь файлов спула, общая для цикла событий и рабочих потоков; имя в очереди или в работе
+// не ставится повторно
+class SpoolQueue {
+public:
+    void push(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!known.insert(name).second) return;
+        queue.push_back(name);
+        stats.queued = queue.size();
+        changed.notify_one();
+    }
+
+    // Очередь делится между рабочими: при накопившейся очереди поток берёт до maxBatch файлов,
+    // чтобы вывести их ключи одним пакетом; пустой результат - сигнал остановки
+    std::vector<std::string> popBatch(size_t workerCount, size_t maxBatch) {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&]() { return !queue.empty() || stopping; });
+        if (stopping) return {};
+        size_t take = std::clamp<size_t>(queue.size() / std::max<size_t>(1, workerCount), 1, std::max<size_t>(1, maxBatch));
+        std::vector<std::string> batch(queue.begin(), queue.begin() + take);
+        queue.erase(queue.begin(), queue.begin() + take);
+        stats.queued = queue.size();
+        stats.inProgress += take;
+        return batch;
+    }
+
+    void finish(const std::string& name, bool success, uint64_t carrierBytes) {
+        std::lock_guard<std::mutex> lock(mutex);
+        known.erase(name);
+        stats.inProgress--;
+        if (success) {
+            stats.processed++;
+            stats.carrierBytes += carrierBytes;
+        } else {
+            stats.failed++;
+        }
+    }
+
+    void stop() {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        changed.notify_all();
+    }
+
+    WatchStats snapshot() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::string> queue;
+    std::unordered_set<std::string> known;
+    WatchStats stats;
+    bool stopping = false;
+};
+
+// Встраивает контейнер в один файл спула и записывает результат во временный файл рядом с выходным.
+// Ошибки только логируются: здесь используются только варианты, которые не завершают программу,
+// поэтому один испорченный или слишком большой файл не останавливает наблюдение.
+std::optional<uint64_t> embedFile(const CliConfig& config, const fs::path& input, const fs::path& temp,
+                                  const std::vector<uint8_t>& container, DataConversion::ContainerLayout layout,
+                                  const std::vector<uint8_t>& steganoKey) {
+    Trace::Span span("watch file");
+    const std::string inFile = input.string();
+    const std::string tempFile = temp.string();
+    // Размер носителя проверяется по заголовку, до декодирования
+    auto info = ImageHandler::isSupportedFormat(inFile) ? ImageHandler::probeImage(inFile) : std::nullopt;
+    if (!info) {
+        LOG_ERROR("{} is not a supported image", inFile);
+        return std::nullopt;
+    }
+    const size_t headerBytes = DataConversion::HEADER_SIZE + DataConversion::KEY_CHECK_SIZE;
+    const uint64_t carrierBytes = static_cast<uint64_t>(info->width) * info->height * info->channels;
+    if ((headerBytes + container.size()) * 8 > carrierBytes) {
+        LOG_ERROR("The message is too big for {}", inFile);
+        return std::nullopt;
+    }
+
+    // Бюджет памяти проверяется для каждого файла; адаптивный режим отключается, если не помещается только он
+    const bool inPlace = ImageHandler::canEmbedInPlace(inFile, tempFile);
+    bool adaptive = config.adaptive;
+    if (MemoryBudget::limit() != 0) {
+        size_t positions = config.matrix ? static_cast<size_t>(carrierBytes)
+                                         : std::min<size_t>(carrierBytes, (headerBytes + container.size()) * 8);
+        size_t peak = MemoryBudget::embedBytes(info->encodedBytes, carrierBytes, positions, inPlace);
+        if (!MemoryBudget::fits(peak)) {
+            LOG_ERROR("{} needs about {} of memory on top of {} in use, but --max-memory is {}", inFile,
+                      MemoryBudget::formatSize(peak), MemoryBudget::formatSize(MemoryBudget::residentBytes()),
+                      MemoryBudget::formatSize(MemoryBudget::limit()));
+            return std::nullopt;
+        }
+        if (adaptive && !MemoryBudget::fits(peak + MemoryBudget::adaptiveBytes(carrierBytes, !inPlace))) {
+            LOG_WARN("The adaptive cost map of {} does not fit into --max-memory, uniform positions are used", inFile);
+            adaptive = false;
+        }
+    }
+
+    // Несжатые носители изменяются на месте в копии, остальные декодируются и кодируются заново
+    std::optional<ImageHandler::MappedImage> mapped;
+    ImageHandler::Image image;
+    if (inPlace) {
+        std::error_code ec;
+        fs::copy_file(input, temp, fs::copy_options::overwrite_existing, ec);
+        if (!ec) {
+            mapped = ImageHandler::MappedImage::open(tempFile, true);
+        }
+        if (!mapped) {
+            LOG_ERROR("Failed to prepare {} for in-place embedding", tempFile);
+            return std::nullopt;
+        }
+    } else {
+        auto loaded = ImageHandler::tryLoadImage(inFile);
+        if (!loaded) return std::nullopt;
+        image = std::move(*loaded);
+    }
+    const size_t carrierSize = mapped ? mapped->size() : image.data.size();
+
+    std::vector<uint8_t> costMap;
+    if (adaptive) {
+        costMap = Stegano::computeCostMap(mapped ? mapped->toImage() : image, 1);
+    }
+    Stegano::EmbedOptions options = Stegano::chooseEmbedOptions(
+        carrierSize, container.size(), headerBytes, *Stegano::engineFromName(config.engineName),
+        adaptive ? &costMap : nullptr, config.matrix, config.noiseDensity);
+    options.indexed = layout == DataConversion::ContainerLayout::Chunked;
+
+    DataConversion::ContainerHeader header;
+    header.engine = static_cast<uint8_t>(options.engine);
+    header.adaptiveLevel = options.adaptiveLevel;
+    header.matrixK = options.matrixK;
+    header.layout = layout;
+    auto embededText = Encryption::tryGetReadyToEmbedText(container, header, steganoKey);
+    if (!embededText) return std::nullopt;
+
+    if (mapped) {
+        if (!Stegano::tryEmbedDataInPlace(*mapped, *embededText, steganoKey, options)) return std::nullopt;
+        return carrierSize;
+    }
+    if (!Stegano::tryEmbedData(image, *embededText, steganoKey, options)) return std::nullopt;
+    if (!ImageHandler::trySaveImage(tempFile, image)) return std::nullopt;
+    return carrierSize;
+}
+
+// Файл, который не удалось встроить, убирается из спула, чтобы не обрабатываться снова
+void moveToFailed(const fs::path& input) {
+    std::error_code ec;
+    fs::path failedDir = input.parent_path() / FAILED_DIRECTORY;
+    fs::create_directories(failedDir, ec);
+    fs::rename(input, failedDir / input.filename(), ec);
+    if (ec) {
+        LOG_WARN("{} cannot be moved to {}: {}", input.string(), failedDir.string(), ec.message());
+    }
+}
+
+void workerLoop(const CliConfig& config, const std::vector<uint8_t>& steganoKey, SpoolQueue& spool,
+                size_t workerCount, unsigned int index) {
+    Trace::nameThread("watch worker " + std::to_string(index));
+    const fs::path spoolDir(config.watchDir);
+    const fs::path outDir(config.outDir);
+    const std::string tempPrefix = std::string(TEMP_PREFIX) + std::to_string(::getpid()) + "-";
+    const DataConversion::ContainerLayout layout = DataConversion::layoutForMessage(config.textMessage.size());
+    for (;;) {
+        std::vector<std::string> batch = spool.popBatch(workerCount, KeyDerivation::batchLanes());
+        if (batch.empty()) return;
+
+        // Соль и IV у каждого файла свои, ключи выводятся одним пакетом
+        std::vector<std::optional<std::vector<uint8_t>>> containers = Encryption::getEncryptedContainers(config, batch.size(), layout);
+        for (size_t i = 0; i < batch.size(); i++) {
+            const std::string& name = batch[i];
+            const fs::path input = spoolDir / name;
+            const fs::path temp = outDir / (tempPrefix + name);
+            std::error_code ec;
+            if (!fs::is_regular_file(input, ec)) {
+                // Файл уже убран из спула (например, обработан до перезапуска)
+                spool.finish(name, false, 0);
+                continue;
+            }
+
+            std::optional<uint64_t> carrierBytes;
+            if (containers[i]) {
+                carrierBytes = embedFile(config, input, temp, *containers[i], layout, steganoKey);
+            }
+            if (carrierBytes) {
+                // Сначала выходной файл появляется целиком, затем вход удаляется из спула
+                fs::rename(temp, outDir / name, ec);
+                if (ec) {
+                    LOG_ERROR("{} cannot be renamed into {}: {}", temp.string(), outDir.string(), ec.message());
+                    carrierBytes.reset();
+                } else {
+                    fs::remove(input, ec);
+                    LOG_INFO("{} was embedded into {}", name, (outDir / name).string());
+                }
+            }
+            if (!carrierBytes) {
+                fs::remove(temp, ec);
+                moveToFailed(input);
+            }
+            spool.finish(name, carrierBytes.has_value(), carrierBytes.value_or(0));
+        }
+    }
+}
+
+// Счётчики строками "имя значение", через временный файл и переименование
+void writeStats(const fs::path& spoolDir, const WatchStats& stats) {
+    fs::path temp = spoolDir / (std::string(TEMP_PREFIX) + STATS_FILE);
+    {
+        std::ofstream file(temp, std::ios::trunc);
+        file << "queued " << stats.queued << "\nin_progress " << stats.inProgress << "\nprocessed " << stats.processed
+             << "\nfailed " << stats.failed << "\ncarrier_bytes " << stats.carrierBytes
+             << "\nfiles_per_second " << stats.filesPerSecond << "\n";
+        // Один ключ и одинаковые размеры носителей дают повторные попадания в кэш позиций
+        Stegano::PositionCacheStats positions = Stegano::PositionCache::instance().stats();
+        file << "position_cache_hits " << positions.memoryHits + positions.fileHits
+             << "\nposition_cache_misses " << positions.misses
+             << "\nposition_cache_hit_rate " << positions.hitRate() << "\n";
+        if (!file) return;
+    }
+    std::error_code ec;
+    fs::rename(temp, spoolDir / STATS_FILE, ec);
+}
+
+void removeStaleTemps(const fs::path& directory) {
+    std::error_code ec;
+    auto now = fs::file_time_type::clock::now();
+    for (const auto& item : fs::directory_iterator(directory, ec)) {
+        std::error_code itemError;
+        const std::string name = item.path().filename().string();
+        if (name.rfind(TEMP_PREFIX, 0) != 0 || !item.is_regular_file(itemError)) continue;
+        auto modified = item.last_write_time(itemError);
+        if (!itemError && now - modified > STALE_TEMP_AGE) fs::remove(item.path(), itemError);
+    }
+}
+
+// Файл из спула, найденный без события о закрытии: ставится в очередь, когда перестаёт меняться
+struct PendingFile {
+    uintmax_t size = 0;
+    fs::file_time_type modified;
+    Clock::time_point seen;
+};
+
+} // namespace
+
+bool supported() {
+    return true;
+}
+
+int run(const CliConfig& config, const std::vector<uint8_t>& steganoKey) {
+    const fs::path spoolDir(config.watchDir);
+    const fs::path outDir(config.outDir);
+    removeStaleTemps(outDir);
+    removeStaleTemps(spoolDir);
+
+    // SIGINT и SIGTERM читаются из signalfd в цикле событий; маска наследуется рабочими потоками
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    int signalFd = signalfd(-1, &signals, SFD_CLOEXEC);
+    int inotifyFd = inotify_init1(IN_CLOEXEC);
+    if (signalFd < 0 || inotifyFd < 0 ||
+        inotify_add_watch(inotifyFd, spoolDir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        LOG_ERROR("Cannot watch the directory {}", spoolDir.string());
+        return EXIT_FAILURE;
+    }
+
+    // Каждый файл встраивается одним потоком, параллельны файлы
+    const unsigned int workerCount = Parallel::defaultThreadCount();
+    Parallel::setDefaultThreadCount(1);
+    SpoolQueue spool;
+    std::vector<std::thread> workers;
+    for (unsigned int w = 0; w < workerCount; w++) {
+        workers.emplace_back(workerLoop, std::cref(config), std::cref(steganoKey), std::ref(spool), workerCount, w);
+    }
+    LOG_INFO("Watching {} with {} workers, outputs go to {}", spoolDir.string(), workerCount, outDir.string());
+
+    // Наблюдение уже включено, поэтому файл, появившийся во время обхода, не теряется
+    std::unordered_map<std::string, PendingFile> pending;
+    auto scanSpool = [&]() {
+        std::error_code ec;
+        for (const auto& item : fs::directory_iterator(spoolDir, ec)) {
+            std::error_code itemError;
+            const std::string name = item.path().filename().string();
+            if (!isSpoolEntry(name) || !item.is_regular_file(itemError) || pending.count(name)) continue;
+            PendingFile file{ item.file_size(itemError), item.last_write_time(itemError), Clock::now() };
+            if (!itemError) pending.emplace(name, file);
+        }
+    };
+    scanSpool();
+
+    std::vector<char> events(EVENT_BUFFER_BYTES);
+    WatchStats reported;
+    uint64_t reportedProcessed = 0;
+    auto lastReport = Clock::now();
+    bool running = true;
+    while (running) {
+        pollfd fds[2] = { { inotifyFd, POLLIN, 0 }, { signalFd, POLLIN, 0 } };
+        if (poll(fds, 2, POLL_TIMEOUT_MS) < 0 && errno != EINTR) {
+            LOG_ERROR("Waiting for the spool events failed");
+            break;
+        }
+        if (fds[1].revents & POLLIN) {
+            signalfd_siginfo info;
+            if (read(signalFd, &info, sizeof(info)) > 0) {
+                LOG_INFO("Signal {} received, finishing the files in progress", info.ssi_signo);
+            }
+            running = false;
+        }
+        if (fds[0].revents & POLLIN) {
+            ssize_t length = read(inotifyFd, events.data(), events.size());
+            for (ssize_t offset = 0; offset < length;) {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(events.data() + offset);
+                offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+                if (event->mask & IN_Q_OVERFLOW) {
+                    // События потеряны: каталог обходится заново
+                    scanSpool();
+                    continue;
+                }
+                if (event->len == 0 || (event->mask & IN_ISDIR)) continue;
+                std::string name(event->name);
+                if (!isSpoolEntry(name)) continue;
+                // Файл закрыт после записи или переименован в спул - он готов
+                pending.erase(name);
+                spool.push(name);
+            }
+        }
+
+        const auto now = Clock::now();
+        for (auto it = pending.begin(); it != pending.end();) {
+            if (now - it->second.seen < SETTLE_TIME) {
+                ++it;
+                continue;
+            }
+            std::error_code ec;
+            fs::path path = spoolDir / it->first;
+            uintmax_t size = fs::file_size(path, ec);
+            auto modified = fs::last_write_time(path, ec);
+            if (ec) {
+                it = pending.erase(it);
+            } else if (size != it->second.size || modified != it->second.modified) {
+                it->second = PendingFile{ size, modified, now };
+                ++it;
+            } else {
+                spool.push(it->first);
+                it = pending.erase(it);
+            }
+        }
+
+        if (now - lastReport >= STATS_INTERVAL || !running) {
+            WatchStats stats = spool.snapshot();
+            double seconds = std::chrono::duration<double>(now - lastReport).count();
+            stats.filesPerSecond = seconds > 0 ? (stats.processed - reportedProcessed) / seconds : 0.0;
+            if (stats.queued != reported.queued || stats.inProgress != reported.inProgress ||
+                stats.processed != reported.processed || stats.failed != reported.failed) {
+                LOG_INFO("Watch: {} queued, {} in progress, {} processed ({:.2f} files/s), {} failed",
+                         stats.queued, stats.inProgress, stats.processed, stats.filesPerSecond, stats.failed);
+            }
+            writeStats(spoolDir, stats);
+            reported = stats;
+            reportedProcessed = stats.processed;
+            lastReport = now;
+        }
+    }
+
+    spool.stop();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    WatchStats stats = spool.snapshot();
+    stats.filesPerSecond = 0.0;
+    writeStats(spoolDir, stats);
+    LOG_INFO("Watch stopped: {} processed, {} failed, {} left in the spool", stats.processed, stats.failed, stats.queued);
+    Stegano::PositionCache::instance().logStats();
+    close(inotifyFd);
+    close(signalFd);
+    return EXIT_SUCCESS;
+}
+
+#else
+
+bool supported() {
+    return false;
+}
+
+int run(const CliConfig&, const std::vector<uint8_t>&) {
+    LOG_ERROR("The --watch mode needs inotify and is available only on Linux");
+    return EXIT_FAILURE;
+}
+
+#endif // STEGANO_HAVE_INOTIFY
+
+} // namespace WatchFolder
@@ -0,0 +1,207 @@
+#include "wav_audio.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+
+namespace AudioHandler {
+
+namespace {
+
+constexpr size_t CHUNK_HEADER_SIZE = 8;
+constexpr size_t RIFF_HEADER_SIZE = 12;
+constexpr uint16_t FORMAT_PCM = 1;
+constexpr uint16_t FORMAT_EXTENSIBLE = 0xFFFE;
+constexpr size_t IO_BUFFER_SIZE = 1 << 20;
+
+uint16_t loadLE16(const uint8_t* bytes) {
+    return static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+}
+
+uint32_t loadLE32(const uint8_t* bytes) {
+    return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+           (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+bool seekTo(FILE* file, uint64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(file, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+    return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+// Поля чанка "fmt ": PCM или WAVE_FORMAT_EXTENSIBLE с подформатом PCM (первые два байта GUID)
+bool parseFormat(const uint8_t* chunk, size_t size, WavFormat& format) {
+    if (size < 16) return false;
+    uint16_t tag = loadLE16(chunk);
+    if (tag == FORMAT_EXTENSIBLE) {
+        if (size < 40 || loadLE16(chunk + 24) != FORMAT_PCM) return false;
+    } else if (tag != FORMAT_PCM) {
+        return false;
+    }
+    format.channels = loadLE16(chunk + 2);
+    format.sampleRate = loadLE32(chunk + 4);
+    uint16_t blockAlign = loadLE16(chunk + 12);
+    format.bitsPerSample = loadLE16(chunk + 14);
+    if (format.bitsPerSample != 16 && format.bitsPerSample != 24) return false;
+    return format.channels > 0 && blockAlign == format.channels * format.bytesPerSample();
+}
+
+} // namespace
+
+bool isWavFile(const std::string& filename) {
+    if (filename.size() < 4) return false;
+    std::string ext = filename.substr(filename.size() - 4);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == ".wav";
+}
+
+std::optional<WavFile> WavFile::open(const std::string& filename) {
+    WavFile wav;
+    wav.filePath = filename;
+    std::error_code ec;
+    wav.wavFormat.fileSize = std::filesystem::file_size(filename, ec);
+    if (ec) return std::nullopt;
+    wav.file = std::fopen(filename.c_str(), "rb");
+    if (!wav.file) {
+        LOG_DEBUG("Failed to open {}", filename);
+        return std::nullopt;
+    }
+    // Блоки читаются целиком, а отдельные отсчёты - вразброс: буфер потока только добавил бы копирование
+    std::setvbuf(wav.file, nullptr, _IONBF, 0);
+
+    uint8_t riff[RIFF_HEADER_SIZE];
+    if (!wav.readAt(0, riff, sizeof(riff)) || std::memcmp(riff, "RIFF", 4) != 0 || std::memcmp(riff + 8, "WAVE", 4) != 0) {
+        LOG_DEBUG("{} is not a RIFF/WAVE file", filename);
+        return std::nullopt;
+    }
+
+    // Чанки идут подряд, каждый выровнен на чётную границу; интерпретируются только "fmt " и "data"
+    WavFormat& format = wav.wavFormat;
+    bool haveFormat = false;
+    bool haveData = false;
+    uint64_t offset = RIFF_HEADER_SIZE;
+    while (offset + CHUNK_HEADER_SIZE <= format.fileSize && !(haveFormat && haveData)) {
+        uint8_t chunk[CHUNK_HEADER_SIZE];
+        if (!wav.readAt(offset, chunk, sizeof(chunk))) return std::nullopt;
+        const uint64_t size = loadLE32(chunk + 4);
+        const uint64_t body = offset + CHUNK_HEADER_SIZE;
+        if (std::memcmp(chunk, "fmt ", 4) == 0) {
+            uint8_t fields[40] = {};
+            size_t length = static_cast<size_t>(std::min<uint64_t>(size, sizeof(fields)));
+            if (!wav.readAt(body, fields, length) || !parseFormat(fields, length, format)) {
+                LOG_DEBUG("{} does not hold 16- or 24-bit integer PCM", filename);
+                return std::nullopt;
+            }
+            haveFormat = true;
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            // Оборванная запись: чанк короче заявленного, используются только имеющиеся байты
+            format.dataOffset = body;
+            format.dataSize = std::min(size, format.fileSize - body);
+            haveData = true;
+        }
+        offset = body + size + (size & 1);
+    }
+    if (!haveFormat || !haveData) {
+        LOG_DEBUG("{} has no \"fmt \" or \"data\" chunk", filename);
+        return std::nullopt;
+    }
+    LOG_DEBUG("{}: {}-bit PCM, {} channels, {} Hz, {} samples", filename, format.bitsPerSample, format.channels,
+             format.sampleRate, format.sampleCount());
+    return wav;
+}
+
+WavFile::WavFile(WavFile&& other) noexcept
+    : file(other.file), filePath(std::move(other.filePath)), wavFormat(other.wavFormat), cursor(other.cursor) {
+    other.file = nullptr;
+}
+
+WavFile& WavFile::operator=(WavFile&& other) noexcept {
+    if (this != &other) {
+        if (file) std::fclose(file);
+        file = other.file;
+        filePath = std::move(other.filePath);
+        wavFormat = other.wavFormat;
+        cursor = other.cursor;
+        other.file = nullptr;
+    }
+    return *this;
+}
+
+WavFile::~WavFile() {
+    if (file) std::fclose(file);
+}
+
+bool WavFile::readAt(uint64_t offset, uint8_t* out, size_t length) {
+    return seekTo(file, offset) && std::fread(out, 1, length, file) == length;
+}
+
+bool WavFile::readBlock(WavBlock& block) {
+    const unsigned int sampleBytes = wavFormat.bytesPerSample();
+    const uint64_t samplesEnd = wavFormat.dataOffset + wavFormat.sampleCount() * sampleBytes;
+    const uint64_t maxBytes = BLOCK_SAMPLES * sampleBytes;
+    if (cursor >= wavFormat.fileSize) return false;
+
+    // Байты до отсчётов, сами отсчёты и всё после них (включая неполный последний отсчёт)
+    block.offset = cursor;
+    block.firstSample = 0;
+    block.sampleCount = 0;
+    uint64_t length = 0;
+    if (cursor < wavFormat.dataOffset) {
+        length = std::min(maxBytes, wavFormat.dataOffset - cursor);
+    } else if (cursor < samplesEnd) {
+        block.firstSample = (cursor - wavFormat.dataOffset) / sampleBytes;
+        block.sampleCount = static_cast<size_t>(std::min<uint64_t>(BLOCK_SAMPLES, wavFormat.sampleCount() - block.firstSample));
+        length = static_cast<uint64_t>(block.sampleCount) * sampleBytes;
+    } else {
+        length = std::min(maxBytes, wavFormat.fileSize - cursor);
+    }
+
+    block.data.resize(static_cast<size_t>(length));
+    if (!readAt(cursor, block.data.data(), block.data.size())) {
+        LOG_ERROR("Failed to read {} at offset {}", filePath, cursor);
+        exit(EXIT_FAILURE);
+    }
+    cursor += length;
+    return true;
+}
+
+bool WavFile::readSamples(uint64_t firstSample, size_t count, std::vector<uint8_t>& buffer) {
+    if (firstSample > wavFormat.sampleCount() || count > wavFormat.sampleCount() - firstSample) return false;
+    buffer.resize(count * wavFormat.bytesPerSample());
+    return readAt(wavFormat.dataOffset + firstSample * wavFormat.bytesPerSample(), buffer.data(), buffer.size());
+}
+
+WavWriter::WavWriter(const std::string& filename) {
+    out = std::fopen(filename.c_str(), "wb");
+    if (!out) {
+        LOG_ERROR("Failed to create the output audio {}", filename);
+        exit(EXIT_FAILURE);
+    }
+    std::setvbuf(out, nullptr, _IOFBF, IO_BUFFER_SIZE);
+}
+
+WavWriter::~WavWriter() {
+    if (out) std::fclose(out);
+}
+
+void WavWriter::writeBlock(const WavBlock& block) {
+    if (std::fwrite(block.data.data(), 1, block.data.size(), out) != block.data.size()) {
+        LOG_ERROR("Failed to write an audio block");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void WavWriter::close() {
+    bool failed = std::fflush(out) != 0;
+    failed = std::fclose(out) != 0 || failed;
+    out = nullptr;
+    if (failed) {
+        LOG_ERROR("Failed to write the output audio");
+        exit(EXIT_FAILURE);
+    }
+}
+
+} // namespace AudioHandler
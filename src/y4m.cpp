@@ -0,0 +1,173 @@
+#include "y4m.h"
+#include "image_handler.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+namespace VideoHandler {
+
+namespace {
+
+constexpr const char* STREAM_MAGIC = "YUV4MPEG2";
+constexpr size_t MAX_LINE = 4096;
+constexpr size_t IO_BUFFER_SIZE = 1 << 20;
+
+// Строка до '\n' (без него); false в конце потока
+bool readLine(FILE* in, std::string& line) {
+    line.clear();
+    int c;
+    while ((c = std::fgetc(in)) != EOF) {
+        if (c == '\n') return true;
+        line.push_back(static_cast<char>(c));
+        if (line.size() > MAX_LINE) return false;
+    }
+    return !line.empty();
+}
+
+// Размер кадра для 8-битных цветовых пространств YUV4MPEG2
+size_t planeBytes(const std::string& colorspace, size_t width, size_t height) {
+    size_t luma = width * height;
+    size_t halfWidth = (width + 1) / 2;
+    if (colorspace.empty() || colorspace == "420" || colorspace == "420jpeg" || colorspace == "420paldv" || colorspace == "420mpeg2") {
+        return luma + 2 * halfWidth * ((height + 1) / 2);
+    }
+    if (colorspace == "422") return luma + 2 * halfWidth * height;
+    if (colorspace == "411") return luma + 2 * ((width + 3) / 4) * height;
+    if (colorspace == "444") return 3 * luma;
+    if (colorspace == "444alpha") return 4 * luma;
+    if (colorspace == "mono") return luma;
+    return 0;
+}
+
+} // namespace
+
+bool isY4MFile(const std::string& filename) {
+    if (filename.size() < 4) return false;
+    std::string ext = filename.substr(filename.size() - 4);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == ".y4m";
+}
+
+Y4MReader::Y4MReader(const std::string& filename) : path(filename) {
+    if (ImageHandler::isStdStream(filename)) {
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+        in = stdin;
+    } else {
+        in = std::fopen(filename.c_str(), "rb");
+        ownsFile = true;
+    }
+    if (!in) {
+        LOG_ERROR("The file: {} does not exist", filename);
+        exit(EXIT_FAILURE);
+    }
+    std::setvbuf(in, nullptr, _IOFBF, IO_BUFFER_SIZE);
+
+    if (!readLine(in, header) || header.compare(0, 9, STREAM_MAGIC) != 0) {
+        LOG_ERROR("{} is not a YUV4MPEG2 stream", filename);
+        exit(EXIT_FAILURE);
+    }
+
+    std::istringstream tokens(header.substr(9));
+    std::string token, colorspace;
+    while (tokens >> token) {
+        if (token[0] == 'W') frameWidth = std::atoi(token.c_str() + 1);
+        else if (token[0] == 'H') frameHeight = std::atoi(token.c_str() + 1);
+        else if (token[0] == 'C') colorspace = token.substr(1);
+    }
+    if (frameWidth <= 0 || frameHeight <= 0) {
+        LOG_ERROR("The YUV4MPEG2 header of {} has no valid frame size", filename);
+        exit(EXIT_FAILURE);
+    }
+    frameBytes = planeBytes(colorspace, static_cast<size_t>(frameWidth), static_cast<size_t>(frameHeight));
+    if (frameBytes == 0) {
+        LOG_ERROR("Unsupported YUV4MPEG2 colorspace C{} (only 8-bit samples are supported)", colorspace);
+        exit(EXIT_FAILURE);
+    }
+    LOG_INFO("Video {}x{} (C{}) was opened, {} bytes per frame", frameWidth, frameHeight,
+             colorspace.empty() ? "420jpeg" : colorspace, frameBytes);
+}
+
+Y4MReader::~Y4MReader() {
+    if (ownsFile && in) std::fclose(in);
+}
+
+bool Y4MReader::readFrame(Frame& frame) {
+    std::string line;
+    if (!readLine(in, line)) return false;
+    if (line.compare(0, 5, "FRAME") != 0) {
+        LOG_ERROR("Corrupted YUV4MPEG2 stream: a FRAME line was expected");
+        exit(EXIT_FAILURE);
+    }
+    frame.parameters = line.substr(5);
+    frame.data.resize(frameBytes);
+    if (std::fread(frame.data.data(), 1, frameBytes, in) != frameBytes) {
+        LOG_ERROR("The YUV4MPEG2 stream ends in the middle of a frame");
+        exit(EXIT_FAILURE);
+    }
+    return true;
+}
+
+size_t Y4MReader::estimatedFrameCount() const {
+    std::error_code ec;
+    if (!ownsFile || !std::filesystem::is_regular_file(path, ec)) return 0;
+    size_t fileSize = static_cast<size_t>(std::filesystem::file_size(path, ec));
+    if (ec) return 0;
+    size_t frameRecord = frameBytes + 6; // "FRAME\n"
+    return (fileSize - std::min(fileSize, header.size() + 1)) / frameRecord;
+}
+
+Y4MWriter::Y4MWriter(const std::string& filename, const std::string& streamHeader) {
+    if (ImageHandler::isStdStream(filename)) {
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        out = stdout;
+    } else {
+        out = std::fopen(filename.c_str(), "wb");
+        ownsFile = true;
+    }
+    if (!out) {
+        LOG_ERROR("Failed to create the output video {}", filename);
+        exit(EXIT_FAILURE);
+    }
+    std::setvbuf(out, nullptr, _IOFBF, IO_BUFFER_SIZE);
+    if (std::fprintf(out, "%s\n", streamHeader.c_str()) < 0) {
+        LOG_ERROR("Failed to write the YUV4MPEG2 header");
+        exit(EXIT_FAILURE);
+    }
+}
+
+Y4MWriter::~Y4MWriter() {
+    if (ownsFile && out) std::fclose(out);
+}
+
+void Y4MWriter::writeFrame(const Frame& frame) {
+    if (std::fprintf(out, "FRAME%s\n", frame.parameters.c_str()) < 0 ||
+        std::fwrite(frame.data.data(), 1, frame.data.size(), out) != frame.data.size()) {
+        LOG_ERROR("Failed to write a video frame");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void Y4MWriter::close() {
+    bool failed = std::fflush(out) != 0;
+    if (ownsFile) {
+        failed = std::fclose(out) != 0 || failed;
+    }
+    out = nullptr;
+    if (failed) {
+        LOG_ERROR("Failed to write the output video");
+        exit(EXIT_FAILURE);
+    }
+}
+
+} // namespace VideoHandler
@@ -0,0 +1,69 @@
+// Checks that KeyDerivation::deriveKeys is byte-identical to PKCS5_PBKDF2_HMAC for every kernel the CPU
+// supports and for the OpenSSL-only path, at the production iteration count.
+// Registered with CTest when configured with -DSTEGANO_BUILD_TESTS=ON.
+// Fails if a kernel the CPU supports was disabled by the self-test or derives a different key.
+
+#include "encryption/key_derivation.h"
+#include "encryption/data_conversion.h"
+#include "encryption/sha256_lanes.h"
+
+#include <openssl/evp.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<uint8_t> opensslKey(const std::string& passphrase, const std::vector<uint8_t>& salt,
+                                int iterations, size_t keyLength) {
+    std::vector<uint8_t> key(keyLength);
+    if (PKCS5_PBKDF2_HMAC(passphrase.data(), static_cast<int>(passphrase.size()), salt.data(),
+                          static_cast<int>(salt.size()), iterations, EVP_sha256(),
+                          static_cast<int>(keyLength), key.data()) != 1) {
+        key.clear();
+    }
+    return key;
+}
+
+} // namespace
+
+int main() {
+    const int iterations = DataConversion::KDF_ITERATIONS;
+
+    // Пустой, блочный (64 байта) и длинный (больше блока, хешируется) пароли, пустая и длинная соли;
+    // экземпляров больше самого широкого ядра и не кратно числу дорожек
+    std::vector<std::string> passphrases = { "", std::string(64, 'k'), std::string(65, 'l'), std::string(200, 'p'),
+                                             "password" };
+    std::vector<std::vector<uint8_t>> salts = { {}, std::vector<uint8_t>(DataConversion::SALT_SIZE, 0xA5),
+                                                std::vector<uint8_t>(300, 0x01), {}, { 's', 'a', 'l', 't' } };
+    for (size_t i = 0; passphrases.size() < KeyDerivation::AVX512_LANES + 3; i++) {
+        passphrases.push_back("candidate-" + std::to_string(i));
+        salts.push_back(std::vector<uint8_t>(i * 7 % 90, static_cast<uint8_t>(i)));
+    }
+
+    std::vector<unsigned int> lanes = KeyDerivation::supportedLanes();
+    lanes.push_back(1);
+
+    int status = 0;
+    for (size_t keyLength : { size_t(32), size_t(72) }) {
+        std::vector<std::vector<uint8_t>> expected;
+        for (size_t i = 0; i < passphrases.size(); i++) {
+            expected.push_back(opensslKey(passphrases[i], salts[i], iterations, keyLength));
+            if (expected.back().empty()) {
+                std::printf("PKCS5_PBKDF2_HMAC failed\n");
+                return 1;
+            }
+        }
+        for (unsigned int width : lanes) {
+            if (KeyDerivation::batchLanes(width) != width) {
+                std::printf("%2u lanes: kernel supported by the CPU is disabled\n", width);
+                status = 1;
+                continue;
+            }
+            bool same = KeyDerivation::deriveKeys(passphrases, salts, iterations, keyLength, width) == expected;
+            std::printf("%2u lanes, %zu-byte keys: %s\n", width, keyLength, same ? "identical" : "MISMATCH");
+            if (!same) status = 1;
+        }
+    }
+    return status;
+}
@@ -0,0 +1,91 @@
+#!/usr/bin/env bash
+# Round trip through a real tiled TIFF written by this script and read back by libtiff: the message
+# embedded into an RGB tiled TIFF must be extracted again, and a palette TIFF must be rejected.
+# Usage: tiled_tiff_roundtrip.sh path/to/SteganoEncrypt
+set -u
+
+BINARY="$1"
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+
+fail() {
+    echo "FAIL: $*" >&2
+    if [ -f "$WORK/run.log" ]; then tail -n 20 "$WORK/run.log" >&2; fi
+    exit 1
+}
+
+byte() {
+    printf "\\$(printf %03o $(( $1 & 255 )))"
+}
+le16() {
+    byte "$1"; byte $(( $1 >> 8 ))
+}
+le32() {
+    le16 $(( $1 & 65535 )); le16 $(( $1 >> 16 ))
+}
+# IFD entry: tag, type (3 - SHORT, 4 - LONG), count, value or offset
+entry() {
+    le16 "$1"; le16 "$2"; le32 "$3"
+    if [ "$2" -eq 3 ] && [ "$3" -eq 1 ]; then le16 "$4"; le16 0; else le32 "$4"; fi
+}
+
+# Uncompressed little-endian tiled TIFF with 16x16 tiles and random 8-bit samples;
+# photometric 2 is RGB (3 samples), 3 is a palette (1 sample and a grey colour map)
+writeTiledTiff() {
+    local width=$1 height=$2 photometric=$3 file=$4
+    local samples=3 entries=11
+    if [ "$photometric" -eq 3 ]; then samples=1; entries=12; fi
+    local tiles=$(( ((width + 15) / 16) * ((height + 15) / 16) ))
+    local tileBytes=$(( 16 * 16 * samples ))
+
+    local ifdEnd=$(( 8 + 2 + entries * 12 + 4 ))
+    local bitsOffset=$ifdEnd
+    local colorMapOffset=$(( bitsOffset + 6 ))
+    local offsetsOffset=$(( colorMapOffset + (photometric == 3 ? 3 * 256 * 2 : 0) ))
+    local countsOffset=$(( offsetsOffset + tiles * 4 ))
+    local dataOffset=$(( countsOffset + tiles * 4 ))
+    {
+        printf 'II'; le16 42; le32 8
+        le16 "$entries"
+        entry 256 3 1 "$width"
+        entry 257 3 1 "$height"
+        if [ "$samples" -eq 3 ]; then entry 258 3 3 "$bitsOffset"; else entry 258 3 1 8; fi
+        entry 259 3 1 1
+        entry 262 3 1 "$photometric"
+        entry 277 3 1 "$samples"
+        entry 284 3 1 1
+        if [ "$photometric" -eq 3 ]; then entry 320 3 768 "$colorMapOffset"; fi
+        entry 322 3 1 16
+        entry 323 3 1 16
+        entry 324 4 "$tiles" "$offsetsOffset"
+        entry 325 4 "$tiles" "$countsOffset"
+        le32 0
+        le16 8; le16 8; le16 8
+        if [ "$photometric" -eq 3 ]; then
+            for _ in 1 2 3; do
+                for value in $(seq 0 255); do le16 $(( value * 257 )); done
+            done
+        fi
+        for tile in $(seq 0 $(( tiles - 1 ))); do le32 $(( dataOffset + tile * tileBytes )); done
+        for tile in $(seq 0 $(( tiles - 1 ))); do le32 "$tileBytes"; done
+        head -c $(( tiles * tileBytes )) /dev/urandom
+    } > "$file"
+}
+
+MESSAGE="tiled carrier message"
+writeTiledTiff 40 40 2 "$WORK/rgb.tif"
+cp "$WORK/rgb.tif" "$WORK/rgb-original.tif"
+"$BINARY" --crypt --text "$MESSAGE" --in "$WORK/rgb.tif" --out "$WORK/stego.tif" --key "tiff key" \
+    </dev/null >"$WORK/run.log" 2>&1 || fail "embedding into the RGB tiled TIFF failed"
+cmp -s "$WORK/rgb.tif" "$WORK/rgb-original.tif" || fail "the input TIFF was modified"
+"$BINARY" --encrypt --in "$WORK/stego.tif" --key "tiff key" </dev/null >"$WORK/run.log" 2>&1 || \
+    fail "extraction from the stego TIFF failed"
+grep -qx "$MESSAGE" "$WORK/run.log" || fail "the extracted message does not match"
+
+writeTiledTiff 40 40 3 "$WORK/palette.tif"
+if "$BINARY" --crypt --text "$MESSAGE" --in "$WORK/palette.tif" --out "$WORK/palette-stego.tif" --key "tiff key" \
+    </dev/null >"$WORK/run.log" 2>&1; then
+    fail "a palette TIFF was accepted as a carrier"
+fi
+grep -q "palette" "$WORK/run.log" || fail "the palette TIFF was rejected without naming the reason"
+echo "PASS"
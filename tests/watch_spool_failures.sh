@@ -0,0 +1,79 @@
+#!/usr/bin/env bash
+# Files that cannot be embedded (too small for the message, over the --max-memory budget) must go
+# to spool/failed/ while the --watch process keeps running and still embeds the good files.
+# Usage: watch_spool_failures.sh path/to/SteganoEncrypt
+set -u
+
+BINARY="$1"
+WORK="$(mktemp -d)"
+WATCH_PID=""
+cleanup() {
+    if [ -n "$WATCH_PID" ]; then kill -KILL "$WATCH_PID" 2>/dev/null; fi
+    rm -rf "$WORK"
+}
+trap cleanup EXIT
+
+fail() {
+    echo "FAIL: $*" >&2
+    if [ -f "$WORK/watch.log" ]; then tail -n 20 "$WORK/watch.log" >&2; fi
+    exit 1
+}
+
+be32() {
+    printf "\\x$(printf %02x $(( ($1 >> 24) & 255 )))\\x$(printf %02x $(( ($1 >> 16) & 255 )))"
+    printf "\\x$(printf %02x $(( ($1 >> 8) & 255 )))\\x$(printf %02x $(( $1 & 255 )))"
+}
+
+# Flat RGB QOI image; width * height must be a multiple of 62 (one QOI_OP_RUN byte per 62 pixels)
+writeQoi() {
+    local width=$1 height=$2 file=$3
+    {
+        printf 'qoif'
+        be32 "$width"
+        be32 "$height"
+        printf '\x03\x00'
+        head -c $(( width * height / 62 )) /dev/zero | tr '\0' '\375'
+        printf '\x00\x00\x00\x00\x00\x00\x00\x01'
+    } > "$file"
+}
+
+mkdir -p "$WORK/spool" "$WORK/out" "$WORK/staging"
+writeQoi 62 62 "$WORK/staging/good.qoi"
+writeQoi 31 2 "$WORK/staging/too-small.qoi"
+writeQoi 2480 2480 "$WORK/staging/over-budget.qoi"
+
+"$BINARY" --crypt --watch "$WORK/spool" --out-dir "$WORK/out" --text "spool message" --key "watch key" \
+    --max-memory 32M --threads 2 </dev/null >"$WORK/watch.log" 2>&1 &
+WATCH_PID=$!
+sleep 1
+
+# A rename within one file system arrives as IN_MOVED_TO
+for name in too-small.qoi over-budget.qoi good.qoi; do
+    mv "$WORK/staging/$name" "$WORK/spool/$name"
+done
+
+for _ in $(seq 1 100); do
+    if [ -f "$WORK/out/good.qoi" ] && [ -f "$WORK/spool/failed/too-small.qoi" ] && \
+       [ -f "$WORK/spool/failed/over-budget.qoi" ]; then
+        break
+    fi
+    kill -0 "$WATCH_PID" 2>/dev/null || fail "the watch process exited while processing the spool"
+    sleep 0.2
+done
+
+kill -0 "$WATCH_PID" 2>/dev/null || fail "the watch process is not running after the failed files"
+[ -f "$WORK/spool/failed/too-small.qoi" ] || fail "too-small.qoi was not moved to failed/"
+[ -f "$WORK/spool/failed/over-budget.qoi" ] || fail "over-budget.qoi was not moved to failed/"
+[ -f "$WORK/out/good.qoi" ] || fail "good.qoi was not embedded"
+
+kill -TERM "$WATCH_PID"
+wait "$WATCH_PID"
+STATUS=$?
+WATCH_PID=""
+[ "$STATUS" -eq 0 ] || fail "the watch process exited with status $STATUS after SIGTERM"
+grep -q "^processed 1$" "$WORK/spool/.watch-stats" || fail "the stats do not report one processed file"
+grep -q "^failed 2$" "$WORK/spool/.watch-stats" || fail "the stats do not report two failed files"
+
+"$BINARY" --encrypt --in "$WORK/out/good.qoi" --key "watch key" </dev/null 2>&1 | grep -qx "spool message" || \
+    fail "the message cannot be extracted from good.qoi"
+echo "PASS"